@@ -0,0 +1,474 @@
+#include "async_writer.h"
+#include "engine.h"
+#include "wav_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <iomanip>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#define PNAS_IO_URING 1
+#endif
+
+namespace {
+
+constexpr int MAX_IO_THREADS = 4;
+
+bool aligned(size_t bytes, int64_t offset) {
+    return bytes % ASYNC_ALIGN == 0 && offset % static_cast<int64_t>(ASYNC_ALIGN) == 0;
+}
+
+} // namespace
+
+#ifdef PNAS_IO_URING
+
+/**
+ * Minimal io_uring: one submission and one completion ring mapped from
+ * the kernel, driven only by AsyncWriter's ring thread. That thread is
+ * the single writer of the SQ tail and reader of the CQ head; it also
+ * outlives every request, since the kernel cancels requests whose
+ * submitting thread has exited.
+ */
+struct AsyncWriter::Uring {
+    int fd = -1;
+    bool fixed = false;                 // Buffers registered: WRITE_FIXED
+    void* sqMap = MAP_FAILED;
+    size_t sqMapLen = 0;
+    void* cqMap = MAP_FAILED;
+    size_t cqMapLen = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesLen = 0;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    std::vector<Job> ops;               // Per user_data tag
+    std::vector<int> freeTags;
+    unsigned queued = 0;                // In the SQ, not yet taken by the kernel
+    int inFlight = 0;                   // Taken, not yet reaped
+
+    bool setup(unsigned entries) {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+        if (fd < 0) return false;
+
+        sqMapLen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqMapLen = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sqMapLen = cqMapLen = std::max(sqMapLen, cqMapLen);
+        sqMap = mmap(nullptr, sqMapLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqMap == MAP_FAILED) return false;
+        cqMap = single ? sqMap : mmap(nullptr, cqMapLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqMap == MAP_FAILED) return false;
+        sqesLen = p.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) return false;
+
+        char* sq = static_cast<char*>(sqMap);
+        char* cq = static_cast<char*>(cqMap);
+        sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+
+        // The CQ holds twice the SQ, so in-flight tags can never overflow it
+        ops.resize(p.sq_entries);
+        for (unsigned i = 0; i < p.sq_entries; ++i) freeTags.push_back(static_cast<int>(i));
+        return true;
+    }
+
+    bool registerBuffers(const std::vector<uint8_t*>& buffers, size_t bytes) {
+        std::vector<iovec> iov(buffers.size());
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            iov[i].iov_base = buffers[i];
+            iov[i].iov_len = bytes;
+        }
+        // Fails under a low RLIMIT_MEMLOCK; plain WRITE still works
+        fixed = syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iov.data(),
+                        static_cast<unsigned>(iov.size())) == 0;
+        return fixed;
+    }
+
+    void push(const Job& job, int writeFd, uint8_t* data) {
+        int tag = freeTags.back();
+        freeTags.pop_back();
+        ops[tag] = job;
+
+        unsigned tail = *sqTail;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        sqe->fd = writeFd;
+        sqe->addr = reinterpret_cast<uint64_t>(data);
+        sqe->len = static_cast<uint32_t>(job.bytes);
+        sqe->off = static_cast<uint64_t>(job.offset);
+        sqe->buf_index = fixed ? static_cast<uint16_t>(job.slot) : 0;
+        sqe->user_data = static_cast<uint64_t>(tag);
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        ++queued;
+    }
+
+    /**
+     * Hand queued entries to the kernel and, if `wait`, block until at
+     * least one completion is ready. False on a hard error.
+     */
+    bool enter(bool wait) {
+        for (;;) {
+            unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+            int n = static_cast<int>(syscall(__NR_io_uring_enter, fd, queued, wait ? 1 : 0, flags, nullptr, 0));
+            if (n >= 0) {
+                queued -= static_cast<unsigned>(n);
+                inFlight += n;
+                return true;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) return false;
+            if (errno != EINTR) std::this_thread::yield();
+        }
+    }
+
+    /**
+     * Calls `done(job, result)` for each ready completion
+     */
+    template <typename Done>
+    void reap(Done done) {
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes[head & *cqMask];
+            int tag = static_cast<int>(cqe.user_data);
+            freeTags.push_back(tag);
+            --inFlight;
+            done(ops[tag], cqe.res);
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * Take back entries the kernel never accepted (after a hard error)
+     */
+    template <typename Done>
+    void unqueue(Done done) {
+        for (; queued > 0; --queued) {
+            unsigned tail = *sqTail - 1;
+            int tag = static_cast<int>(sqes[tail & *sqMask].user_data);
+            __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+            freeTags.push_back(tag);
+            done(ops[tag]);
+        }
+    }
+
+    ~Uring() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqesLen);
+        if (cqMap != MAP_FAILED && cqMap != sqMap) munmap(cqMap, cqMapLen);
+        if (sqMap != MAP_FAILED) munmap(sqMap, sqMapLen);
+        if (fd >= 0) ::close(fd);
+    }
+};
+
+#else
+
+struct AsyncWriter::Uring {};
+
+#endif
+
+AsyncWriter::AsyncWriter() = default;
+
+AsyncWriter::~AsyncWriter() {
+    close();
+}
+
+bool AsyncWriter::open(const std::string& path, const AsyncWriterConfig& config, int extraBuffers) {
+    close();
+    config_ = config;
+    config_.queueDepth = std::max(1, config.queueDepth);
+    config_.bufferBytes = std::max(ASYNC_ALIGN, (config.bufferBytes + ASYNC_ALIGN - 1) / ASYNC_ALIGN * ASYNC_ALIGN);
+    failed_ = false;
+    stopping_ = false;
+    pending_ = 0;
+
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Cannot create " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+#ifdef O_DIRECT
+    if (config_.direct) {
+        directFd_ = ::open(path.c_str(), O_WRONLY | O_DIRECT);
+        if (directFd_ < 0) {
+            std::cerr << "O_DIRECT not available for " << path << " (" << std::strerror(errno)
+                      << "), writing through the page cache" << std::endl;
+        }
+    }
+#endif
+
+    int count = config_.queueDepth + std::max(0, extraBuffers);
+    buffers_.assign(count, nullptr);
+    inFlight_.assign(count, 0);
+    owned_.assign(count, false);
+    free_.clear();
+    for (int i = count - 1; i >= 0; --i) {
+        void* p = nullptr;
+        if (posix_memalign(&p, ASYNC_ALIGN, config_.bufferBytes) != 0) {
+            close();
+            return false;
+        }
+        buffers_[i] = static_cast<uint8_t*>(p);
+        free_.push_back(i);
+    }
+
+#ifdef PNAS_IO_URING
+    if (!config_.forceThreads) {
+        ring_ = std::make_unique<Uring>();
+        if (ring_->setup(static_cast<unsigned>(count))) {
+            ring_->registerBuffers(buffers_, config_.bufferBytes);
+            threads_.emplace_back(&AsyncWriter::ringLoop, this);
+        } else {
+            ring_.reset();
+        }
+    }
+#endif
+    if (!ring_) {
+        for (int i = 0; i < std::min(config_.queueDepth, MAX_IO_THREADS); ++i) {
+            threads_.emplace_back(&AsyncWriter::threadLoop, this);
+        }
+    }
+    return true;
+}
+
+const char* AsyncWriter::backendName() const {
+#ifdef PNAS_IO_URING
+    if (ring_) return ring_->fixed ? "io_uring, registered buffers" : "io_uring";
+#endif
+    return "thread pool";
+}
+
+uint8_t* AsyncWriter::acquire(int& slot) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return !free_.empty(); });
+    slot = free_.back();
+    free_.pop_back();
+    owned_[slot] = true;
+    return buffers_[slot];
+}
+
+bool AsyncWriter::submit(int slot, size_t bytes, int64_t offset, bool release) {
+    bool direct = directFd_ >= 0 && aligned(bytes, offset);
+    std::lock_guard<std::mutex> lock(mutex_);
+    owned_[slot] = !release;
+    if (bytes == 0) {
+        complete(slot, true);
+        return true;
+    }
+    ++inFlight_[slot];
+    ++pending_;
+    jobs_.push_back(Job{slot, bytes, offset, direct});
+    changed_.notify_all();
+    return !failed_;
+}
+
+void AsyncWriter::release(int slot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    owned_[slot] = false;
+    complete(slot, true);
+}
+
+void AsyncWriter::complete(int slot, bool ok) {
+    if (!ok) failed_ = true;
+    if (inFlight_[slot] == 0 && !owned_[slot]) {
+        free_.push_back(slot);
+    }
+    changed_.notify_all();
+}
+
+bool AsyncWriter::finish(const Job& job, ssize_t written) {
+    bool ok = written >= 0;
+    if (ok && static_cast<size_t>(written) < job.bytes) {
+        // Short write: the rest through the buffered descriptor
+        ok = writeAt(fd_, buffers_[job.slot] + written, job.bytes - written, job.offset + written);
+    } else if (!ok && job.direct && written == -EINVAL) {
+        // The file system refused this direct write after all
+        ok = writeAt(fd_, buffers_[job.slot], job.bytes, job.offset);
+    }
+    return ok;
+}
+
+void AsyncWriter::threadLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        changed_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+        if (jobs_.empty()) return;
+        Job job = jobs_.front();
+        jobs_.erase(jobs_.begin());
+        lock.unlock();
+        ssize_t n = pwrite(job.direct ? directFd_ : fd_, buffers_[job.slot], job.bytes, job.offset);
+        bool ok = finish(job, n < 0 ? -errno : n);
+        lock.lock();
+        --inFlight_[job.slot];
+        --pending_;
+        complete(job.slot, ok);
+    }
+}
+
+void AsyncWriter::ringLoop() {
+#ifdef PNAS_IO_URING
+    Uring& ring = *ring_;
+    auto done = [this](const Job& job, bool ok) {
+        --inFlight_[job.slot];
+        --pending_;
+        complete(job.slot, ok);
+    };
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        if (ring.inFlight == 0 && ring.queued == 0) {
+            changed_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+            if (jobs_.empty()) return;
+        }
+        size_t taken = 0;
+        for (; taken < jobs_.size() && !ring.freeTags.empty(); ++taken) {
+            const Job& job = jobs_[taken];
+            ring.push(job, job.direct ? directFd_ : fd_, buffers_[job.slot]);
+        }
+        jobs_.erase(jobs_.begin(), jobs_.begin() + static_cast<std::ptrdiff_t>(taken));
+
+        // Nothing new to hand over: sleep until a write completes (new
+        // jobs wait for that, but the ring is busy meanwhile)
+        bool wait = ring.queued == 0;
+        lock.unlock();
+        bool entered = ring.enter(wait);
+        lock.lock();
+        if (!entered) ring.unqueue([&](const Job& job) { done(job, false); });
+        ring.reap([&](const Job& job, int result) {
+            lock.unlock();
+            bool ok = finish(job, result);
+            lock.lock();
+            done(job, ok);
+        });
+    }
+#endif
+}
+
+bool AsyncWriter::writeSync(const void* data, size_t bytes, int64_t offset) {
+    return writeAt(fd_, data, bytes, offset);
+}
+
+bool AsyncWriter::drain() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return pending_ == 0; });
+    bool ok = !failed_;
+    failed_ = false;
+    return ok;
+}
+
+bool AsyncWriter::close(int64_t size) {
+    if (fd_ < 0) return true;
+    bool ok = drain();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    changed_.notify_all();
+    for (auto& t : threads_) t.join();
+    threads_.clear();
+    ring_.reset();
+
+    if (size >= 0 && ftruncate(fd_, size) != 0) ok = false;
+    if (directFd_ >= 0) ::close(directFd_);
+    if (::close(fd_) != 0) ok = false;
+    fd_ = -1;
+    directFd_ = -1;
+    for (uint8_t* b : buffers_) std::free(b);
+    buffers_.clear();
+    return ok;
+}
+
+int runIoBenchmark(const std::string& path, int megabytes) {
+    constexpr size_t BLOCK_BYTES = 4 << 20;
+    buildRenderTables();
+    int channels = outputChannels();
+    int64_t blocks = std::max<int64_t>(1, static_cast<int64_t>(megabytes) * (1 << 20) / BLOCK_BYTES);
+    int blockFrames = static_cast<int>(BLOCK_BYTES / (sizeof(float) * channels));
+    size_t blockBytes = static_cast<size_t>(blockFrames) * channels * sizeof(float);
+    std::string scratch = path + ".iobench";
+
+    std::cout << "Disk write: " << blocks * blockBytes / (1 << 20) << " MB of rendered stimulus in "
+              << BLOCK_BYTES / (1 << 20) << " MB blocks to " << scratch << "\n"
+              << "  backend                                     MB/s\n";
+    auto report = [&](const std::string& name, double seconds, bool ok) {
+        std::cout << "  " << std::left << std::setw(42) << name << std::right << std::fixed << std::setprecision(0)
+                  << std::setw(6) << (ok ? blocks * blockBytes / (1 << 20) / seconds : 0.0)
+                  << (ok ? "" : "  (failed)") << "\n" << std::defaultfloat;
+        return ok;
+    };
+    // Each run ends with fsync so the page cache does not flatter buffered writes
+    bool ok = true;
+
+    {
+        std::vector<float> block(static_cast<size_t>(blockFrames) * channels);
+        int fd = ::open(scratch.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        auto start = std::chrono::steady_clock::now();
+        bool good = fd >= 0;
+        for (int64_t b = 0; good && b < blocks; ++b) {
+            renderOutputBlock(block.data(), b * blockFrames, blockFrames);
+            const char* p = reinterpret_cast<const char*>(block.data());
+            size_t left = blockBytes;
+            while (good && left > 0) {
+                ssize_t n = ::write(fd, p, left);
+                if (n < 0 && errno == EINTR) continue;
+                good = n > 0;
+                p += n;
+                left -= static_cast<size_t>(n);
+            }
+        }
+        good = good && fsync(fd) == 0;
+        if (fd >= 0) ::close(fd);
+        ok = report("write()", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), good) && ok;
+    }
+
+    for (int variant = 0; variant < 4; ++variant) {
+        AsyncWriterConfig config;
+        config.bufferBytes = BLOCK_BYTES;
+        config.forceThreads = variant >= 2;
+        config.direct = variant % 2 == 1;
+        AsyncWriter writer;
+        auto start = std::chrono::steady_clock::now();
+        bool good = writer.open(scratch, config);
+        std::string name = writer.backendName();
+        for (int64_t b = 0; good && b < blocks; ++b) {
+            int slot;
+            uint8_t* buffer = writer.acquire(slot);
+            renderOutputBlock(reinterpret_cast<float*>(buffer), b * blockFrames, blockFrames);
+            good = writer.submit(slot, blockBytes, b * static_cast<int64_t>(blockBytes));
+        }
+        good = writer.drain() && good;
+        int fd = ::open(scratch.c_str(), O_WRONLY);
+        good = fd >= 0 && fsync(fd) == 0 && good;
+        if (fd >= 0) ::close(fd);
+        good = writer.close() && good;
+        if (config.direct) name += ", O_DIRECT";
+        ok = report(name, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), good) && ok;
+    }
+    std::remove(scratch.c_str());
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+/**
+ * Asynchronous positional file writer for offline renders and session
+ * recordings.
+ *
+ * Callers take a page-aligned buffer from a fixed pool, fill it and
+ * submit it with a file offset; at most `queueDepth` buffers are in
+ * flight, and acquire() waits for one to complete when the pool is empty.
+ *
+ * On Linux the writes go through io_uring (raw syscalls, no liburing):
+ * the pool is registered with the ring so each write is a WRITE_FIXED
+ * with no per-call page pinning, and one ring thread batches submissions
+ * and reaps completions. Where io_uring is missing or refused (older
+ * kernels, seccomp, macOS) a small thread pool issues pwrite() instead,
+ * with the same interface.
+ *
+ * With `direct` the file is also opened O_DIRECT and page-aligned writes
+ * bypass the page cache; anything unaligned (headers, the tail of a
+ * file) goes through a normal descriptor.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+constexpr size_t ASYNC_ALIGN = 4096;
+
+struct AsyncWriterConfig {
+    int queueDepth = 8;                 // Buffers in flight (and in the pool)
+    size_t bufferBytes = 4 << 20;       // Per buffer, a multiple of ASYNC_ALIGN
+    bool direct = false;                // O_DIRECT for aligned writes
+    bool forceThreads = false;          // Skip io_uring
+};
+
+class AsyncWriter {
+public:
+    AsyncWriter();
+    ~AsyncWriter();
+    AsyncWriter(const AsyncWriter&) = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+    /**
+     * Create or truncate `path`. The pool holds queueDepth buffers, plus
+     * `extraBuffers` for callers that keep one while others are in flight.
+     */
+    bool open(const std::string& path, const AsyncWriterConfig& config, int extraBuffers = 0);
+
+    /**
+     * A free buffer of bufferBytes() bytes (thread-safe; waits for a
+     * completion if every buffer is busy)
+     */
+    uint8_t* acquire(int& slot);
+
+    /**
+     * Write the first `bytes` of `slot` at `offset` (thread-safe). With
+     * `release` the buffer returns to the pool once written; otherwise
+     * the caller keeps it and may append past `bytes` while it is in
+     * flight, but must not change the submitted bytes.
+     */
+    bool submit(int slot, size_t bytes, int64_t offset, bool release = true);
+
+    /**
+     * Hand back a buffer without writing it
+     */
+    void release(int slot);
+
+    /**
+     * Synchronous write through the buffered descriptor (headers, patches)
+     */
+    bool writeSync(const void* data, size_t bytes, int64_t offset);
+
+    /**
+     * Wait until every submitted write has completed. Returns false if
+     * any write failed since the last call.
+     */
+    bool drain();
+
+    /**
+     * Drain, truncate to `size` (if >= 0) and close
+     */
+    bool close(int64_t size = -1);
+
+    size_t bufferBytes() const { return config_.bufferBytes; }
+    bool isOpen() const { return fd_ >= 0; }
+    const char* backendName() const;
+
+private:
+    struct Job {
+        int slot;
+        size_t bytes;
+        int64_t offset;
+        bool direct;
+    };
+    struct Uring;
+
+    void complete(int slot, bool ok);
+    bool finish(const Job& job, ssize_t written);
+    void threadLoop();
+    void ringLoop();
+
+    AsyncWriterConfig config_;
+    int fd_ = -1;                       // Buffered
+    int directFd_ = -1;                 // O_DIRECT, or -1
+    std::vector<uint8_t*> buffers_;
+    std::vector<int> inFlight_;         // Per slot: writes not yet completed
+    std::vector<bool> owned_;           // Per slot: held by a caller
+    std::vector<int> free_;
+    int pending_ = 0;
+    bool failed_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+
+    std::unique_ptr<Uring> ring_;       // io_uring backend, or null
+
+    std::vector<std::thread> threads_;  // Ring thread, or the pwrite() pool
+    std::vector<Job> jobs_;             // Submitted, not yet issued
+    bool stopping_ = false;
+};
+
+/**
+ * Sequential write throughput: buffered write() against the async writer
+ * (io_uring and thread pool, with and without O_DIRECT) for `megabytes`
+ * of rendered stimulus in a scratch file next to `path`
+ */
+int runIoBenchmark(const std::string& path, int megabytes);
@@ -0,0 +1,204 @@
+#include "audio_device.h"
+#include "engine.h"
+#include "watchdog.h"
+#include "clock_drift.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+namespace {
+
+SDL_AudioDeviceID openDevice(const char* name, int bufferFrames, SDL_AudioSpec* obtained) {
+    SDL_AudioSpec desiredSpec;
+    SDL_zero(desiredSpec);
+
+    desiredSpec.freq = SAMPLE_RATE;
+    desiredSpec.format = AUDIO_F32SYS;  // 32-bit float
+    desiredSpec.channels = static_cast<Uint8>(outputChannels());  // Mono unless a trigger channel is added
+    desiredSpec.samples = static_cast<Uint16>(bufferFrames);
+    desiredSpec.callback = audioCallback;
+    desiredSpec.userdata = nullptr;
+
+    return SDL_OpenAudioDevice(name, 0, &desiredSpec, obtained, 0);
+}
+
+std::string lastGoodPath() {
+    char* dir = SDL_GetPrefPath("PNAS", "PNASSound");
+    if (!dir) return std::string();
+    std::string path = std::string(dir) + "last_device.cfg";
+    SDL_free(dir);
+    return path;
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+/**
+ * When the device stopped playing: one callback period after the last
+ * heartbeat, not when the event loop noticed
+ */
+std::chrono::steady_clock::time_point playbackStoppedAt(const AudioOutput& out) {
+    auto now = std::chrono::steady_clock::now();
+    int64_t lastNs = g_lastCallbackNs.load(std::memory_order_relaxed);
+    if (lastNs == 0) return now;  // Never called back
+    int64_t periodNs = static_cast<int64_t>(1e9 * out.spec.samples / out.spec.freq);
+    return std::min(now, std::chrono::steady_clock::time_point(std::chrono::nanoseconds(lastNs + periodNs)));
+}
+
+/**
+ * Reopen after a loss and put the frame clock back on the pulse grid
+ */
+void recover(AudioOutput& out) {
+    auto reopenStart = std::chrono::steady_clock::now();
+    if (!openAudioOutput(out)) {
+        std::cerr << "⚠ No playback device available, waiting for one to be plugged in...\n";
+        return;
+    }
+
+    // Frames that would have played during the gap; skipping them keeps
+    // every later onset exactly where it was scheduled before the dropout.
+    double gapMs = millisecondsSince(out.lostAt);
+    int64_t gapFrames = std::llround(gapMs * SAMPLE_RATE / 1000.0);
+    g_samplePosition.fetch_add(gapFrames);
+
+    startAudioOutput(out);
+    out.lost = false;
+
+    std::cout << "🔌 Audio resumed on '" << (out.name.empty() ? "default" : out.name) << "'"
+              << std::fixed << std::setprecision(1)
+              << " | gap " << gapMs << " ms (" << gapFrames << " frames skipped)"
+              << " | reopen " << millisecondsSince(reopenStart) << " ms\n"
+              << std::defaultfloat;
+}
+
+} // namespace
+
+void listAudioOutputs() {
+    int count = SDL_GetNumAudioDevices(0);
+    std::cout << "Playback devices:\n";
+    for (int i = 0; i < count; ++i) {
+        std::cout << "  [" << i << "] " << SDL_GetAudioDeviceName(i, 0) << "\n";
+    }
+}
+
+bool openAudioOutput(AudioOutput& out) {
+    if (!out.preferred.empty()) {
+        out.id = openDevice(out.preferred.c_str(), out.bufferFrames, &out.spec);
+        if (out.id != 0) {
+            out.name = out.preferred;
+            return true;
+        }
+        std::cerr << "Preferred device '" << out.preferred << "' unavailable: " << SDL_GetError() << std::endl;
+    }
+
+    out.id = openDevice(nullptr, out.bufferFrames, &out.spec);
+    if (out.id != 0) {
+        out.name.clear();
+        return true;
+    }
+
+    // Default device may be the one that just vanished; try the rest
+    int count = SDL_GetNumAudioDevices(0);
+    for (int i = 0; i < count; ++i) {
+        const char* name = SDL_GetAudioDeviceName(i, 0);
+        if (!name) continue;
+        out.id = openDevice(name, out.bufferFrames, &out.spec);
+        if (out.id != 0) {
+            out.name = name;
+            return true;
+        }
+    }
+
+    std::cerr << "Failed to open audio device: " << SDL_GetError() << std::endl;
+    return false;
+}
+
+bool loadLastGoodOutput(AudioOutput& out) {
+    std::string path = lastGoodPath();
+    std::ifstream file(path);
+    if (path.empty() || !file) return false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.compare(0, 7, "device=") == 0) {
+            out.preferred = line.substr(7);
+        }
+    }
+    return !out.preferred.empty();
+}
+
+void saveLastGoodOutput(const AudioOutput& out) {
+    std::string path = lastGoodPath();
+    if (path.empty()) return;
+    if (out.name.empty()) {
+        std::remove(path.c_str());  // Default device needs no entry; drop a stale one
+        return;
+    }
+
+    std::ofstream file(path, std::ios::trunc);
+    // Only the name: rate, layout and block size come from the run itself
+    file << "device=" << out.name << "\n";
+}
+
+void startAudioOutput(AudioOutput& out) {
+    resetClockDrift(out.spec.freq);  // New device, new clock
+    setOutputTiming(out.spec.freq, out.spec.samples);
+    SDL_PauseAudioDevice(out.id, 0);
+    armWatchdog(1000.0 * out.spec.samples / out.spec.freq);
+}
+
+void closeAudioOutput(AudioOutput& out) {
+    disarmWatchdog();
+    if (out.id == 0) return;
+    SDL_PauseAudioDevice(out.id, 1);
+    SDL_CloseAudioDevice(out.id);
+    out.id = 0;
+}
+
+void handleAudioDeviceEvent(const SDL_Event& event, AudioOutput& out) {
+    if (event.adevice.iscapture) return;
+
+    if (event.type == SDL_AUDIODEVICEREMOVED) {
+        if (out.lost || event.adevice.which != out.id) return;
+
+        std::cout << "🔌 Audio device removed: '" << (out.name.empty() ? "default" : out.name) << "'\n";
+        out.lostAt = playbackStoppedAt(out);
+        out.lost = true;
+        closeAudioOutput(out);
+        recover(out);
+        return;
+    }
+
+    if (event.type == SDL_AUDIODEVICEADDED) {
+        const char* added = SDL_GetAudioDeviceName(event.adevice.which, 0);
+        if (out.lost) {
+            recover(out);
+        } else if (added && !out.preferred.empty() && out.name != out.preferred && out.preferred == added) {
+            // Preferred device is back; leave the fallback
+            std::cout << "🔌 Preferred device '" << added << "' reconnected, switching back\n";
+            out.lostAt = playbackStoppedAt(out);
+            out.lost = true;
+            closeAudioOutput(out);
+            recover(out);
+        }
+    }
+}
+
+void handleWatchdogAction(int action, AudioOutput& out) {
+    if (out.lost) return;  // Hot-plug recovery already owns the device
+
+    out.lostAt = playbackStoppedAt(out);
+    out.lost = true;
+    closeAudioOutput(out);
+
+    if (action == WATCHDOG_FAILOVER && !out.backup.empty()) {
+        std::cout << "🔁 Switching to backup device '" << out.backup << "'\n";
+        out.preferred = out.backup;
+    }
+    recover(out);
+}
@@ -0,0 +1,63 @@
+/**
+ * Output device management: preferred/fallback open and hot-plug recovery.
+ */
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <chrono>
+#include <string>
+
+struct AudioOutput {
+    SDL_AudioDeviceID id = 0;
+    std::string preferred;      // Requested device name (empty = system default)
+    std::string backup;         // Device to fail over to when the watchdog gives up
+    std::string name;           // Device actually opened (empty = system default)
+    int bufferFrames = 1024;    // Requested device buffer
+    SDL_AudioSpec spec{};       // Obtained spec
+
+    // Hot-plug bookkeeping
+    bool lost = false;
+    std::chrono::steady_clock::time_point lostAt;
+};
+
+/**
+ * Print the available playback devices
+ */
+void listAudioOutputs();
+
+/**
+ * Open the preferred device, falling back to the system default and then
+ * to any other playback device. The device is left paused.
+ */
+bool openAudioOutput(AudioOutput& out);
+
+/**
+ * Last-good device cache (SDL pref path). Loading sets `preferred` to the
+ * device that last opened and started successfully.
+ */
+bool loadLastGoodOutput(AudioOutput& out);
+void saveLastGoodOutput(const AudioOutput& out);
+
+/**
+ * Unpause the device and arm the watchdog for its callback period
+ */
+void startAudioOutput(AudioOutput& out);
+
+/**
+ * Pause and close the device if open
+ */
+void closeAudioOutput(AudioOutput& out);
+
+/**
+ * React to SDL_AUDIODEVICEADDED / SDL_AUDIODEVICEREMOVED. On recovery the
+ * engine frame clock is advanced by the length of the gap so the pulse
+ * train resumes on the same 25ms grid it would have followed without the
+ * dropout. Render tables are reused as-is.
+ */
+void handleAudioDeviceEvent(const SDL_Event& event, AudioOutput& out);
+
+/**
+ * Carry out a WatchdogAction posted by the watchdog thread
+ */
+void handleWatchdogAction(int action, AudioOutput& out);
@@ -0,0 +1,434 @@
+#include "batch_render.h"
+#include "bench.h"
+#include "engine.h"
+#include "wav_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr int CHUNK_FRAMES = 1 << 16;
+constexpr char CACHE_SALT[] = "pnas-variant-1";    // Bump when the variant renderer changes
+
+enum VariantEnvelope {
+    ENVELOPE_LINEAR = 0,    // Quarter-length linear fades, as the engine
+    ENVELOPE_HANN = 1,
+    ENVELOPE_RECT = 2,
+};
+
+const char* const ENVELOPE_NAMES[] = {"linear", "hann", "rect"};
+
+struct ProtocolVariant {
+    std::string name;
+    int sampleRate = SAMPLE_RATE;
+    double intervalMs = STIMULUS_INTERVAL_MS;
+    double carrierHz = TONE_FREQUENCY;
+    double toneMs = TONE_DURATION_MS;
+    VariantEnvelope envelope = ENVELOPE_LINEAR;
+    double amplitude = AMPLITUDE;
+    double seconds = 60.0;
+};
+
+struct VariantJob {
+    ProtocolVariant variant;
+    std::string path;
+    std::string tmpPath;
+    int64_t frames = 0;
+    int64_t chunks = 0;
+    int intervalFrames = 0;
+    std::vector<float> tone;
+    int fd = -1;
+    int64_t dataOffset = 0;
+    bool cached = false;
+    int sameAs = -1;        // Earlier job in this manifest with the same parameters
+    std::atomic<int64_t> remaining{0};
+    std::atomic<bool> failed{false};
+};
+
+struct Task {
+    int job;
+    int64_t chunk;          // -1 = open the variant and split it
+};
+
+/**
+ * Per-worker deques: the owner works newest-first from the back, thieves
+ * take the oldest task from the front. A worker with nothing to take
+ * sleeps until a task is pushed or the batch is finished.
+ */
+class StealingPool {
+public:
+    explicit StealingPool(int workers) : queues_(workers) {}
+
+    void push(int worker, Task task) {
+        pending_.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(queues_[worker].mutex);
+            queues_[worker].tasks.push_back(task);
+        }
+        queued_.fetch_add(1);
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        wake_.notify_one();
+    }
+
+    bool next(int worker, Task& task) {
+        if (take(queues_[worker], task, false)) return true;
+        int n = static_cast<int>(queues_.size());
+        for (int i = 1; i < n; ++i) {
+            if (take(queues_[(worker + i) % n], task, true)) {
+                steals_.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Tasks queued or running; zero means the batch is finished
+    void done() {
+        if (pending_.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(wakeMutex_);
+            wake_.notify_all();
+        }
+    }
+    bool idle() const { return pending_.load() == 0; }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        wake_.wait(lock, [this] { return queued_.load() > 0 || pending_.load() == 0; });
+    }
+    uint64_t steals() const { return steals_.load(); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool take(Queue& queue, Task& task, bool front) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        queued_.fetch_sub(1);
+        if (front) {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        } else {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+        return true;
+    }
+
+    std::vector<Queue> queues_;
+    std::atomic<int64_t> pending_{0};
+    std::atomic<int64_t> queued_{0};        // Pushed and not yet taken
+    std::atomic<uint64_t> steals_{0};
+    std::mutex wakeMutex_;
+    std::condition_variable wake_;
+};
+
+bool parseVariant(const std::string& line, ProtocolVariant& v, std::string& error) {
+    std::istringstream in(line);
+    std::string field;
+    while (in >> field) {
+        size_t eq = field.find('=');
+        if (eq == std::string::npos) {
+            error = "expected key=value, got '" + field + "'";
+            return false;
+        }
+        std::string key = field.substr(0, eq);
+        std::string value = field.substr(eq + 1);
+        char* end = nullptr;
+        double number = std::strtod(value.c_str(), &end);
+        bool numeric = !value.empty() && *end == '\0';
+
+        if (key == "name") {
+            v.name = value;
+        } else if (key == "envelope") {
+            auto it = std::find(std::begin(ENVELOPE_NAMES), std::end(ENVELOPE_NAMES), value);
+            if (it == std::end(ENVELOPE_NAMES)) {
+                error = "unknown envelope '" + value + "'";
+                return false;
+            }
+            v.envelope = static_cast<VariantEnvelope>(it - std::begin(ENVELOPE_NAMES));
+        } else if (!numeric) {
+            error = "bad value for " + key + ": '" + value + "'";
+            return false;
+        } else if (key == "rate") {
+            v.sampleRate = static_cast<int>(number);
+        } else if (key == "interval_ms") {
+            v.intervalMs = number;
+        } else if (key == "carrier_hz") {
+            v.carrierHz = number;
+        } else if (key == "tone_ms") {
+            v.toneMs = number;
+        } else if (key == "amplitude") {
+            v.amplitude = number;
+        } else if (key == "seconds") {
+            v.seconds = number;
+        } else {
+            error = "unknown key '" + key + "'";
+            return false;
+        }
+    }
+
+    if (v.sampleRate < 8000 || v.sampleRate > 384000) {
+        error = "rate must be 8000-384000";
+    } else if (v.carrierHz <= 0.0 || v.carrierHz >= v.sampleRate / 2.0) {
+        error = "carrier_hz must be between 0 and Nyquist";
+    } else if (v.toneMs <= 0.0 || v.toneMs >= v.intervalMs) {
+        error = "tone_ms must be positive and shorter than interval_ms";
+    } else if (v.amplitude <= 0.0 || v.amplitude > 1.0) {
+        error = "amplitude must be in (0, 1]";
+    } else if (v.sampleRate * v.toneMs / 1000.0 < 1.0) {
+        error = "tone_ms must be at least one sample long";
+    } else if (v.seconds * v.sampleRate < 1.0) {
+        error = "seconds must be at least one frame long";
+    } else if (v.seconds * v.sampleRate * sizeof(float) > 0xFFFFFFFFULL - 64) {
+        error = "too long for a WAV file";
+    } else {
+        return true;
+    }
+    return false;
+}
+
+bool loadManifest(const std::string& path, std::vector<ProtocolVariant>& variants) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Cannot open manifest " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    for (int number = 1; std::getline(in, line); ++number) {
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        ProtocolVariant v;
+        std::string error;
+        if (!parseVariant(line, v, error)) {
+            std::cerr << path << ":" << number << ": " << error << std::endl;
+            return false;
+        }
+        if (v.name.empty()) v.name = "line" + std::to_string(number);
+        variants.push_back(v);
+    }
+    return true;
+}
+
+/**
+ * Content address: every parameter that changes the samples, not the name
+ */
+std::string cacheKey(const ProtocolVariant& v) {
+    char canonical[256];
+    std::snprintf(canonical, sizeof(canonical), "%s rate=%d interval_ms=%.17g carrier_hz=%.17g tone_ms=%.17g "
+                  "envelope=%s amplitude=%.17g frames=%lld", CACHE_SALT, v.sampleRate, v.intervalMs,
+                  v.carrierHz, v.toneMs, ENVELOPE_NAMES[v.envelope], v.amplitude,
+                  static_cast<long long>(v.seconds * v.sampleRate));
+    uint64_t h = 1469598103934665603ULL;
+    for (const char* p = canonical; *p; ++p) {
+        h = (h ^ static_cast<uint8_t>(*p)) * 1099511628211ULL;
+    }
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(h));
+    return hex;
+}
+
+/**
+ * Tone burst for one variant, built the way buildRenderTables() builds
+ * the engine's so the default variant matches --render sample for sample
+ */
+std::vector<float> buildTone(const ProtocolVariant& v) {
+    int samples = static_cast<int>(v.sampleRate * v.toneMs / 1000.0);
+    int fadeLength = std::max(samples / 4, 1);
+    std::vector<float> tone(std::max(samples, 1));
+    for (int i = 0; i < samples; ++i) {
+        double tLocal = static_cast<double>(i) / v.sampleRate;
+        double sample = v.amplitude * std::sin(2.0 * M_PI * v.carrierHz * tLocal);
+        if (v.envelope == ENVELOPE_LINEAR) {
+            if (i < fadeLength) {
+                sample *= static_cast<double>(i) / fadeLength;
+            } else if (i > samples - fadeLength) {
+                sample *= static_cast<double>(samples - i) / fadeLength;
+            }
+        } else if (v.envelope == ENVELOPE_HANN) {
+            sample *= 0.5 - 0.5 * std::cos(2.0 * M_PI * i / samples);
+        }
+        tone[i] = static_cast<float>(sample);
+    }
+    return tone;
+}
+
+void renderVariantChunk(const VariantJob& job, float* out, int64_t startFrame, int frames) {
+    int toneSamples = static_cast<int>(job.tone.size());
+    int pos = static_cast<int>(startFrame % job.intervalFrames);
+    int i = 0;
+    while (i < frames) {
+        int run;
+        if (pos < toneSamples) {
+            run = std::min(toneSamples - pos, frames - i);
+            std::memcpy(out + i, job.tone.data() + pos, run * sizeof(float));
+        } else {
+            run = std::min(job.intervalFrames - pos, frames - i);
+            std::fill(out + i, out + i + run, 0.0f);
+        }
+        i += run;
+        pos += run;
+        if (pos == job.intervalFrames) pos = 0;
+    }
+}
+
+/**
+ * Check the cache, create the file and queue its chunks on this worker
+ */
+void openVariant(StealingPool& pool, int worker, std::vector<std::unique_ptr<VariantJob>>& jobs, int index) {
+    VariantJob& job = *jobs[index];
+    struct stat st;
+    if (stat(job.path.c_str(), &st) == 0) {
+        job.cached = true;
+        return;
+    }
+
+    job.fd = open(job.tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    std::vector<uint8_t> header = wavHeader(WAV_RIFF, job.frames, 1, job.variant.sampleRate);
+    if (job.fd < 0 || !writeAt(job.fd, header.data(), header.size(), 0)) {
+        std::cerr << "Cannot write " << job.tmpPath << ": " << std::strerror(errno) << std::endl;
+        if (job.fd >= 0) close(job.fd);
+        job.failed.store(true);
+        return;
+    }
+    job.dataOffset = static_cast<int64_t>(header.size());
+    job.remaining.store(job.chunks);
+    // Last chunk pushed first so the owner starts at the front of the file
+    for (int64_t c = job.chunks - 1; c >= 0; --c) {
+        pool.push(worker, Task{index, c});
+    }
+}
+
+void renderChunk(VariantJob& job, int64_t chunk, std::vector<float>& buffer) {
+    if (!job.failed.load(std::memory_order_relaxed)) {
+        int64_t start = chunk * CHUNK_FRAMES;
+        int frames = static_cast<int>(std::min<int64_t>(CHUNK_FRAMES, job.frames - start));
+        renderVariantChunk(job, buffer.data(), start, frames);
+        int64_t offset = job.dataOffset + start * static_cast<int64_t>(sizeof(float));
+        if (!writeAt(job.fd, buffer.data(), static_cast<size_t>(frames) * sizeof(float), offset)) {
+            job.failed.store(true);
+        }
+    }
+
+    // The worker finishing the last chunk publishes the file
+    if (job.remaining.fetch_sub(1) == 1) {
+        bool ok = close(job.fd) == 0 && !job.failed.load();
+        if (ok && std::rename(job.tmpPath.c_str(), job.path.c_str()) != 0) ok = false;
+        if (!ok) {
+            std::cerr << "Write to " << job.tmpPath << " failed" << std::endl;
+            job.failed.store(true);
+            unlink(job.tmpPath.c_str());
+        }
+    }
+}
+
+} // namespace
+
+int runBatchRender(const BatchConfig& config) {
+    std::vector<ProtocolVariant> variants;
+    if (!loadManifest(config.manifest, variants)) return 1;
+    if (mkdir(config.dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "Cannot create " << config.dir << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<VariantJob>> jobs;
+    std::map<std::string, int> firstWithKey;
+    for (const ProtocolVariant& v : variants) {
+        auto job = std::make_unique<VariantJob>();
+        job->variant = v;
+        auto first = firstWithKey.emplace(cacheKey(v), static_cast<int>(jobs.size()));
+        if (!first.second) job->sameAs = first.first->second;
+        job->path = config.dir + "/" + cacheKey(v) + ".wav";
+        job->tmpPath = job->path + ".part";
+        job->frames = static_cast<int64_t>(v.seconds * v.sampleRate);
+        job->chunks = (job->frames + CHUNK_FRAMES - 1) / CHUNK_FRAMES;
+        job->intervalFrames = static_cast<int>(v.sampleRate * v.intervalMs / 1000.0);
+        job->tone = buildTone(v);
+        jobs.push_back(std::move(job));
+    }
+
+    int threads = threadCount(config.threads);
+    StealingPool pool(threads);
+    int queued = 0;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        if (jobs[i]->sameAs >= 0) continue;
+        pool.push(queued++ % threads, Task{static_cast<int>(i), -1});
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto worker = [&](int self) {
+        std::vector<float> buffer(CHUNK_FRAMES);
+        Task task;
+        while (!pool.idle()) {
+            if (!pool.next(self, task)) {
+                pool.wait();
+                continue;
+            }
+            if (task.chunk < 0) {
+                openVariant(pool, self, jobs, task.job);
+            } else {
+                renderChunk(*jobs[task.job], task.chunk, buffer);
+            }
+            pool.done();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; ++i) workers.emplace_back(worker, i);
+    worker(0);
+    for (auto& t : workers) t.join();
+    double elapsed = secondsSince(start);
+
+    int rendered = 0;
+    int cached = 0;
+    int failed = 0;
+    double renderedMinutes = 0.0;
+    for (const auto& job : jobs) {
+        // A repeat within the manifest shares the first one's file
+        if (job->sameAs >= 0) {
+            const VariantJob& first = *jobs[job->sameAs];
+            job->cached = true;
+            job->failed.store(first.failed.load());
+        }
+        const char* state = job->failed.load() ? "FAILED" : job->cached ? "cached" : "rendered";
+        std::cout << "  " << std::left << std::setw(20) << job->variant.name << std::right << " "
+                  << job->path << "  " << state << "\n";
+        if (job->failed.load()) {
+            ++failed;
+        } else if (job->cached) {
+            ++cached;
+        } else {
+            ++rendered;
+            renderedMinutes += job->variant.seconds / 60.0;
+        }
+    }
+    std::cout << std::fixed << std::setprecision(1) << "Batch: " << jobs.size() << " variants, " << rendered
+              << " rendered, " << cached << " cached (hit rate "
+              << (jobs.empty() ? 0.0 : 100.0 * cached / jobs.size()) << "%), " << failed << " failed\n"
+              << "  " << renderedMinutes << " min of audio in " << std::setprecision(2) << elapsed << " s on "
+              << threads << " threads (" << std::setprecision(1) << renderedMinutes / elapsed
+              << " min of audio/s), " << pool.steals() << " tasks stolen\n" << std::defaultfloat;
+    return failed == 0 ? 0 : 1;
+}
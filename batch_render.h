@@ -0,0 +1,38 @@
+/**
+ * Batch rendering of protocol variants for rate and carrier sweeps.
+ *
+ * A manifest lists one variant per line as key=value pairs:
+ *
+ *   name=40hz-2k carrier_hz=2000 interval_ms=25 envelope=hann rate=48000 seconds=300
+ *
+ * Keys: name, rate, interval_ms, carrier_hz, tone_ms, envelope
+ * (linear|hann|rect), amplitude, seconds. Omitted keys take the engine
+ * defaults, so an empty variant renders exactly what --render does. '#'
+ * starts a comment.
+ *
+ * Each variant is stored as float WAV under a hash of its parameters
+ * (not its name), so re-running a manifest skips what is already there.
+ * Files are written under a temporary name and renamed when complete; an
+ * interrupted run never leaves a file that counts as cached.
+ *
+ * Work is spread over a work-stealing pool: opening a variant splits it
+ * into chunk tasks on the opening worker's deque, and idle workers steal
+ * the oldest tasks from the others, so one long variant still uses every
+ * core.
+ */
+
+#pragma once
+
+#include <string>
+
+struct BatchConfig {
+    std::string manifest;
+    std::string dir = "renders";    // Content-addressed output directory
+    int threads = 0;                // 0 = one per core
+};
+
+/**
+ * Render every variant in the manifest not yet in the cache and report
+ * throughput and cache hit rate
+ */
+int runBatchRender(const BatchConfig& config);
@@ -0,0 +1,41 @@
+#include "bench.h"
+#include "engine.h"
+
+#include <algorithm>
+#include <thread>
+
+int threadCount(int requested) {
+    if (requested > 0) return requested;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+const char* verdict(bool ok) {
+    return ok ? "PASS" : "FAIL";
+}
+
+CallbackPacer::CallbackPacer(int blockFrames, double speed)
+    : blockFrames_(blockFrames),
+      buffer_(static_cast<size_t>(blockFrames) * outputChannels()),
+      period_(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(blockFrames / (SAMPLE_RATE * speed)))),
+      next_(std::chrono::steady_clock::now()) {}
+
+float* CallbackPacer::render() {
+    auto start = std::chrono::steady_clock::now();
+    audioCallback(nullptr, reinterpret_cast<Uint8*>(buffer_.data()), static_cast<int>(buffer_.size() * sizeof(float)));
+    maxCallbackMs_ = std::max(maxCallbackMs_, 1000.0 * secondsSince(start));
+    return buffer_.data();
+}
+
+void CallbackPacer::wait() {
+    next_ += period_;
+    std::this_thread::sleep_until(next_);
+}
+
+double CallbackPacer::budgetMs() const {
+    return 1000.0 * blockFrames_ / SAMPLE_RATE;
+}
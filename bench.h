@@ -0,0 +1,49 @@
+/**
+ * Scaffolding shared by the headless --bench-* and --*-check tools:
+ * worker counts, timing, verdicts and a paced audio-callback driver.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+/**
+ * `requested` workers, or one per core when it is 0
+ */
+int threadCount(int requested);
+
+/**
+ * Seconds of steady-clock time since `start`
+ */
+double secondsSince(std::chrono::steady_clock::time_point start);
+
+/**
+ * "PASS" or "FAIL"
+ */
+const char* verdict(bool ok);
+
+/**
+ * Runs the engine's audio callback on fixed blocks at `speed` times real
+ * time, as a device would, keeping the slowest callback. Each block is
+ * rendered by render() into buffer(); wait() sleeps until the next one is
+ * due.
+ */
+class CallbackPacer {
+public:
+    CallbackPacer(int blockFrames, double speed);
+
+    float* render();
+    void wait();
+
+    float* buffer() { return buffer_.data(); }
+    double maxCallbackMs() const { return maxCallbackMs_; }
+    double budgetMs() const;        // One block at real time
+
+private:
+    int blockFrames_;
+    std::vector<float> buffer_;
+    std::chrono::steady_clock::duration period_;
+    std::chrono::steady_clock::time_point next_;
+    double maxCallbackMs_ = 0.0;
+};
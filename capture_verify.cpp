@@ -0,0 +1,629 @@
+#include "capture_verify.h"
+#include "engine.h"
+#include "fft.h"
+#include "spsc_ring.h"
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Complex = std::complex<double>;
+
+constexpr int FFT_SIZE = 4096;
+constexpr int HOP = FFT_SIZE - SAMPLES_PER_TONE + 1;   // Correlation outputs per FFT block
+constexpr double MATCH_THRESHOLD = 0.8;     // Normalized correlation of a pulse candidate
+constexpr double MIN_LEVEL = 0.02;          // Candidate gain vs the rendered tone (-34 dB)
+constexpr int PEAK_SPACING = SAMPLES_PER_INTERVAL / 2;
+constexpr int STAND_IN_BLOCK = 441;         // 10 ms per stand-in "callback"
+constexpr int LATENCY_TRACK = 64;           // Matched pulses the search window follows
+constexpr size_t STAMP_FIT = 128;           // Block stamps in the capture clock fit
+constexpr double CHECK_TOLERANCE_MS = 0.25;
+// Synthetic loopback recording written by writeCaptureTestWav(): the
+// acoustic path delay and every CAPTURE_TEST_DROP_EVERY-th pulse left out
+constexpr double CAPTURE_TEST_DELAY_MS = 4.3;
+constexpr int CAPTURE_TEST_DROP_EVERY = 40;
+constexpr auto PROCESS_INTERVAL = std::chrono::milliseconds(10);
+
+struct CaptureStamp {
+    int64_t index;          // Capture stream index of the block's first sample
+    int64_t hostNs;         // Host time it was recorded
+};
+
+struct ExpectedOnset {
+    int64_t frame;
+    int64_t pulse;
+};
+
+struct Detection {
+    int64_t hostNs;
+    double ncc;
+    double gain;            // Correlation amplitude relative to the rendered tone
+};
+
+struct Peak {
+    bool open = false;
+    bool needNext = false;
+    int64_t index = 0;
+    double y = 0.0, yPrev = 0.0, yNext = 0.0;
+    double ncc = 0.0;
+};
+
+CaptureVerifyConfig g_config;
+int g_sampleRate = SAMPLE_RATE;
+SDL_AudioDeviceID g_device = 0;
+std::vector<float> g_fileSamples;
+
+// Capture side (device callback or stand-in thread) -> worker
+SpscRing<float> g_samples(1 << 18);         // ~6 s at 44.1kHz
+SpscRing<CaptureStamp> g_stamps(4096);
+int64_t g_producedIndex = 0;                // Capture side only
+std::atomic<uint64_t> g_overrun{0};
+
+// Audio thread -> worker
+SpscRing<ExpectedOnset> g_onsets(1024);
+std::atomic<uint64_t> g_onsetsDropped{0};
+
+std::thread g_worker;
+std::thread g_standIn;
+std::mutex g_mutex;
+std::condition_variable g_wake;
+bool g_stop = false;
+std::atomic<bool> g_standInRunning{false};
+
+// Worker state
+std::vector<Complex> g_templateSpectrum;    // Conjugated, FFT_SIZE bins
+double g_templateEnergy = 0.0;
+std::vector<Complex> g_fftBuffer;
+std::vector<float> g_signal;                // Capture samples from g_signalStart on
+int64_t g_signalStart = 0;
+int64_t g_corrNext = 0;                     // Next correlation output index
+std::deque<CaptureStamp> g_stampList;       // Newest STAMP_FIT, without a gap
+double g_stampIntercept = 0.0;              // Host ns - front stamp ns = intercept + slope * (index - front index)
+double g_stampSlope = 0.0;
+Peak g_peak;
+double g_prevY = 0.0;
+std::deque<Detection> g_detections;
+std::deque<ExpectedOnset> g_expected;
+std::deque<double> g_recentLatency;
+int64_t g_centerNs = 0;                     // Search window centre after the audible time
+std::ofstream g_log;
+
+// Report
+uint64_t g_checked = 0;
+uint64_t g_missing = 0;
+uint64_t g_extra = 0;
+uint64_t g_unexpectedMissing = 0;           // Check mode: pulses the test recording has
+uint64_t g_unexpectedDetected = 0;          // Check mode: pulses it leaves out
+std::vector<double> g_latencyMs;
+std::vector<double> g_ncc;
+std::vector<double> g_gain;
+
+void pushCapture(const float* samples, int count, int64_t firstNs) {
+    // Stamp first so the worker never sees samples it cannot place in
+    // time; after an overrun the next block's stamp supersedes this one
+    g_stamps.push(CaptureStamp{g_producedIndex, firstNs});
+    if (!g_samples.push(samples, count)) {
+        g_overrun.fetch_add(count, std::memory_order_relaxed);
+        return;
+    }
+    g_producedIndex += count;
+}
+
+void captureCallback(void* /*userdata*/, Uint8* stream, int len) {
+    int64_t nowNs = hostTimeNs();
+    int count = len / static_cast<int>(sizeof(float));
+    // The block ends at callback time
+    int64_t firstNs = nowNs - static_cast<int64_t>(count) * 1000000000LL / g_sampleRate;
+    pushCapture(reinterpret_cast<const float*>(stream), count, firstNs);
+}
+
+void onsetTap(int64_t frame, int64_t /*hostNs*/, int64_t pulse) {
+    if (!g_onsets.push(ExpectedOnset{frame, pulse})) {
+        g_onsetsDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Feed the WAV stand-in in real time. Sample n is stamped with the host
+ * time engine frame n is heard, so the file runs on the output clock.
+ */
+void standInLoop() {
+    int64_t index = 0;
+    int64_t total = static_cast<int64_t>(g_fileSamples.size());
+    while (g_standInRunning.load() && index < total) {
+        int64_t stampNs;
+        if (!audibleHostNs(index, stampNs)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        int count = static_cast<int>(std::min<int64_t>(STAND_IN_BLOCK, total - index));
+        int64_t readyNs = stampNs + static_cast<int64_t>(count) * 1000000000LL / g_sampleRate;
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(readyNs)));
+        pushCapture(g_fileSamples.data() + index, count, stampNs);
+        index += count;
+    }
+}
+
+bool loadStandIn(const std::string& path) {
+    SDL_AudioSpec spec;
+    Uint8* data = nullptr;
+    Uint32 length = 0;
+    if (!SDL_LoadWAV(path.c_str(), &spec, &data, &length)) {
+        std::cerr << "Cannot load capture stand-in " << path << ": " << SDL_GetError() << std::endl;
+        return false;
+    }
+    SDL_AudioCVT cvt;
+    if (SDL_BuildAudioCVT(&cvt, spec.format, spec.channels, spec.freq, AUDIO_F32SYS, 1, g_sampleRate) < 0) {
+        std::cerr << "Cannot convert capture stand-in " << path << ": " << SDL_GetError() << std::endl;
+        SDL_FreeWAV(data);
+        return false;
+    }
+    std::vector<Uint8> work(static_cast<size_t>(length) * std::max(cvt.len_mult, 1));
+    std::memcpy(work.data(), data, length);
+    SDL_FreeWAV(data);
+    cvt.buf = work.data();
+    cvt.len = static_cast<int>(length);
+    if (cvt.needed && SDL_ConvertAudio(&cvt) < 0) {
+        std::cerr << "Cannot convert capture stand-in " << path << ": " << SDL_GetError() << std::endl;
+        return false;
+    }
+    int bytes = cvt.needed ? cvt.len_cvt : cvt.len;
+    const float* samples = reinterpret_cast<const float*>(work.data());
+    g_fileSamples.assign(samples, samples + bytes / sizeof(float));
+    return true;
+}
+
+bool openCaptureDevice(const std::string& name) {
+    SDL_AudioSpec desired;
+    SDL_zero(desired);
+    desired.freq = g_sampleRate;
+    desired.format = AUDIO_F32SYS;
+    desired.channels = 1;
+    desired.samples = 512;
+    desired.callback = captureCallback;
+    desired.userdata = nullptr;
+
+    SDL_AudioSpec obtained;
+    g_device = SDL_OpenAudioDevice(name.empty() ? nullptr : name.c_str(), 1, &desired, &obtained, 0);
+    if (g_device == 0) {
+        std::cerr << "Cannot open capture device " << (name.empty() ? "(default)" : name)
+                  << ": " << SDL_GetError() << std::endl;
+        return false;
+    }
+    SDL_PauseAudioDevice(g_device, 0);
+    return true;
+}
+
+void buildTemplate() {
+    const float* tone = toneTemplate();
+    g_templateSpectrum.assign(FFT_SIZE, Complex(0.0));
+    g_templateEnergy = 0.0;
+    for (int i = 0; i < SAMPLES_PER_TONE; ++i) {
+        g_templateSpectrum[i] = tone[i];
+        g_templateEnergy += static_cast<double>(tone[i]) * tone[i];
+    }
+    fft(g_templateSpectrum, false);
+    for (Complex& bin : g_templateSpectrum) bin = std::conj(bin);
+    g_fftBuffer.resize(FFT_SIZE);
+}
+
+/**
+ * Least-squares line through the recent block stamps, so callback jitter
+ * does not land in the detected onset times
+ */
+void fitStamps() {
+    const CaptureStamp& front = g_stampList.front();
+    g_stampSlope = 1e9 / g_sampleRate;
+    g_stampIntercept = 0.0;
+    if (g_stampList.size() < 8) {
+        const CaptureStamp& back = g_stampList.back();
+        g_stampIntercept = (back.hostNs - front.hostNs) - g_stampSlope * (back.index - front.index);
+        return;
+    }
+    double meanX = 0.0, meanY = 0.0;
+    for (const CaptureStamp& s : g_stampList) {
+        meanX += static_cast<double>(s.index - front.index);
+        meanY += static_cast<double>(s.hostNs - front.hostNs);
+    }
+    meanX /= g_stampList.size();
+    meanY /= g_stampList.size();
+    double cov = 0.0, var = 0.0;
+    for (const CaptureStamp& s : g_stampList) {
+        double dx = static_cast<double>(s.index - front.index) - meanX;
+        cov += dx * (static_cast<double>(s.hostNs - front.hostNs) - meanY);
+        var += dx * dx;
+    }
+    if (var > 0.0) g_stampSlope = cov / var;
+    g_stampIntercept = meanY - g_stampSlope * meanX;
+}
+
+/**
+ * Host time of a (fractional) capture index
+ */
+int64_t captureHostNs(double index) {
+    const CaptureStamp& front = g_stampList.front();
+    return front.hostNs + std::llround(g_stampIntercept + g_stampSlope * (index - front.index));
+}
+
+void emitPeak() {
+    if (g_continuousTone.load(std::memory_order_relaxed)) return;   // Test tone correlates everywhere
+
+    // Parabolic interpolation of the correlation peak
+    double denom = g_peak.yPrev - 2.0 * g_peak.y + g_peak.yNext;
+    double frac = denom < 0.0 ? std::clamp(0.5 * (g_peak.yPrev - g_peak.yNext) / denom, -0.5, 0.5) : 0.0;
+    g_detections.push_back(Detection{captureHostNs(g_peak.index + frac), g_peak.ncc, g_peak.y / g_templateEnergy});
+}
+
+void scanPeak(int64_t index, double y, double ncc) {
+    if (g_peak.open && g_peak.needNext) {
+        g_peak.yNext = y;
+        g_peak.needNext = false;
+    }
+    if (g_peak.open && index - g_peak.index > PEAK_SPACING) {
+        emitPeak();
+        g_peak.open = false;
+    }
+    // Highest raw correlation wins, so an equally well-shaped echo loses
+    if (ncc >= MATCH_THRESHOLD && y >= MIN_LEVEL * g_templateEnergy && (!g_peak.open || y > g_peak.y)) {
+        g_peak.open = true;
+        g_peak.needNext = true;
+        g_peak.index = index;
+        g_peak.y = y;
+        g_peak.yPrev = g_prevY;
+        g_peak.ncc = ncc;
+    }
+    g_prevY = y;
+}
+
+/**
+ * One overlap-save block: HOP correlation outputs from FFT_SIZE samples,
+ * normalized by the signal energy under the template.
+ */
+void correlateBlock() {
+    const float* x = g_signal.data() + (g_corrNext - g_signalStart);
+    for (int i = 0; i < FFT_SIZE; ++i) g_fftBuffer[i] = x[i];
+    fft(g_fftBuffer, false);
+    for (int i = 0; i < FFT_SIZE; ++i) g_fftBuffer[i] *= g_templateSpectrum[i];
+    fft(g_fftBuffer, true);
+
+    double energy = 0.0;
+    for (int j = 0; j < SAMPLES_PER_TONE; ++j) energy += static_cast<double>(x[j]) * x[j];
+    double templateNorm = std::sqrt(g_templateEnergy);
+    for (int k = 0; k < HOP; ++k) {
+        if (k > 0) {
+            double in = x[k + SAMPLES_PER_TONE - 1], out = x[k - 1];
+            energy = std::max(0.0, energy + in * in - out * out);
+        }
+        double y = g_fftBuffer[k].real();
+        double ncc = y / (templateNorm * std::sqrt(energy) + 1e-12);
+        scanPeak(g_corrNext + k, y, ncc);
+    }
+    g_corrNext += HOP;
+}
+
+double median(std::deque<double> values) {
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values[values.size() / 2];
+}
+
+void recordPulse(const ExpectedOnset& expected, int64_t expectedNs, const Detection* detection) {
+    ++g_checked;
+    bool dropped = expected.pulse % CAPTURE_TEST_DROP_EVERY == CAPTURE_TEST_DROP_EVERY - 1;
+    if (detection) {
+        double latencyMs = (detection->hostNs - expectedNs) / 1e6;
+        g_latencyMs.push_back(latencyMs);
+        g_ncc.push_back(detection->ncc);
+        g_gain.push_back(detection->gain);
+        g_recentLatency.push_back(latencyMs);
+        if (g_recentLatency.size() > LATENCY_TRACK) g_recentLatency.pop_front();
+        g_centerNs = std::llround(median(g_recentLatency) * 1e6);
+        if (dropped) ++g_unexpectedDetected;
+    } else {
+        ++g_missing;
+        if (!dropped) ++g_unexpectedMissing;
+    }
+
+    if (g_log.is_open()) {
+        g_log << expected.pulse << ',' << expected.frame << ',' << expectedNs << ',';
+        if (detection) {
+            g_log << detection->hostNs << ',' << std::fixed << std::setprecision(1)
+                  << (detection->hostNs - expectedNs) / 1e3 << ',' << std::setprecision(3) << detection->ncc
+                  << std::defaultfloat;
+        } else {
+            g_log << ",,";
+        }
+        g_log << '\n';
+    }
+}
+
+/**
+ * Settle every expected onset whose search window the correlation has
+ * fully passed: the strongest detection inside it is the pulse, anything
+ * else there or between windows is extra. Audible times are looked up
+ * here rather than on arrival, when the frame clock fit has more data.
+ */
+void matchOnsets() {
+    if (g_stampList.empty()) return;
+    int64_t finalNs = captureHostNs(static_cast<double>(g_corrNext - PEAK_SPACING - 1));
+    int64_t halfWindowNs = static_cast<int64_t>(SAMPLES_PER_INTERVAL) * 500000000LL / SAMPLE_RATE;
+
+    while (!g_expected.empty()) {
+        const ExpectedOnset& expected = g_expected.front();
+        int64_t expectedNs;
+        if (!audibleHostNs(expected.frame, expectedNs)) break;
+        int64_t lo = expectedNs + g_centerNs - halfWindowNs;
+        int64_t hi = expectedNs + g_centerNs + halfWindowNs;
+        if (finalNs < hi) break;
+
+        while (!g_detections.empty() && g_detections.front().hostNs < lo) {
+            g_detections.pop_front();
+            ++g_extra;
+        }
+        const Detection* best = nullptr;
+        size_t inWindow = 0;
+        for (; inWindow < g_detections.size() && g_detections[inWindow].hostNs < hi; ++inWindow) {
+            if (!best || g_detections[inWindow].gain > best->gain) best = &g_detections[inWindow];
+        }
+        recordPulse(expected, expectedNs, best);
+        if (inWindow > 1) g_extra += inWindow - 1;
+        g_detections.erase(g_detections.begin(), g_detections.begin() + inWindow);
+        g_expected.pop_front();
+    }
+
+    // Nothing expected (paused): anything heard is extra
+    if (g_expected.empty()) {
+        while (!g_detections.empty() && g_detections.front().hostNs < finalNs - 2 * halfWindowNs) {
+            g_detections.pop_front();
+            ++g_extra;
+        }
+    }
+}
+
+void process() {
+    float chunk[4096];
+    size_t got;
+    while ((got = g_samples.pop(chunk, 4096)) > 0) {
+        g_signal.insert(g_signal.end(), chunk, chunk + got);
+    }
+    CaptureStamp stamp;
+    bool stamped = false;
+    while (g_stamps.pop(stamp)) {
+        // An overrun leaves a gap the line cannot span: start over
+        if (!g_stampList.empty() && stamp.index <= g_stampList.back().index) g_stampList.clear();
+        g_stampList.push_back(stamp);
+        if (g_stampList.size() > STAMP_FIT) g_stampList.pop_front();
+        stamped = true;
+    }
+    if (stamped) fitStamps();
+
+    ExpectedOnset onset;
+    while (g_onsets.pop(onset)) g_expected.push_back(onset);
+
+    while (g_signalStart + static_cast<int64_t>(g_signal.size()) >= g_corrNext + FFT_SIZE) {
+        correlateBlock();
+    }
+    matchOnsets();
+
+    // Keep only what the next block needs
+    int64_t drop = g_corrNext - g_signalStart;
+    if (drop > 0) {
+        g_signal.erase(g_signal.begin(), g_signal.begin() + drop);
+        g_signalStart = g_corrNext;
+    }
+}
+
+void workerLoop() {
+    std::unique_lock<std::mutex> lock(g_mutex);
+    while (!g_stop) {
+        g_wake.wait_for(lock, PROCESS_INTERVAL, [] { return g_stop; });
+        lock.unlock();
+        process();
+        lock.lock();
+    }
+}
+
+double percentile(std::vector<double> values, double p) {
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+}
+
+void putLE(std::vector<uint8_t>& out, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+} // namespace
+
+bool startCaptureVerify(const CaptureVerifyConfig& config, int sampleRate) {
+    g_config = config;
+    g_sampleRate = sampleRate;
+    g_producedIndex = 0;
+    g_samples.reset(g_samples.capacity());
+    g_stamps.reset(g_stamps.capacity());
+    g_onsets.reset(g_onsets.capacity());
+    g_overrun.store(0);
+    g_onsetsDropped.store(0);
+    g_signal.clear();
+    g_signalStart = 0;
+    g_corrNext = 0;
+    g_stampList.clear();
+    g_stampIntercept = 0.0;
+    g_stampSlope = 0.0;
+    g_peak = Peak();
+    g_prevY = 0.0;
+    g_detections.clear();
+    g_expected.clear();
+    g_recentLatency.clear();
+    g_centerNs = 0;
+    g_checked = g_missing = g_extra = g_unexpectedMissing = g_unexpectedDetected = 0;
+    g_latencyMs.clear();
+    g_ncc.clear();
+    g_gain.clear();
+    buildTemplate();
+
+    if (!config.logPath.empty()) {
+        g_log.open(config.logPath);
+        if (!g_log) {
+            std::cerr << "Cannot open capture log " << config.logPath << std::endl;
+            return false;
+        }
+        g_log << "pulse,frame,expected_ns,captured_ns,latency_us,ncc\n";
+    }
+    if (!addOnsetTap(onsetTap)) {
+        std::cerr << "No free engine tap for capture verification" << std::endl;
+        return false;
+    }
+
+    if (!config.file.empty()) {
+        if (!loadStandIn(config.file)) return false;
+        g_standInRunning.store(true);
+        g_standIn = std::thread(standInLoop);
+        std::cout << "Capture verify: stand-in " << config.file << " ("
+                  << std::fixed << std::setprecision(1) << g_fileSamples.size() / static_cast<double>(g_sampleRate)
+                  << " s)" << std::defaultfloat << std::endl;
+    } else {
+        if (!openCaptureDevice(config.device)) return false;
+        std::cout << "Capture verify: recording from "
+                  << (config.device.empty() ? "the default capture device" : config.device) << std::endl;
+    }
+
+    g_stop = false;
+    g_worker = std::thread(workerLoop);
+    return true;
+}
+
+bool stopCaptureVerify() {
+    if (!g_worker.joinable()) return true;
+    if (g_device != 0) {
+        SDL_CloseAudioDevice(g_device);
+        g_device = 0;
+    }
+    if (g_standIn.joinable()) {
+        g_standInRunning.store(false);
+        g_standIn.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_stop = true;
+    }
+    g_wake.notify_all();
+    g_worker.join();
+    g_log.close();
+
+    std::cout << "Capture verify: " << g_checked << " pulses checked, " << g_latencyMs.size() << " detected, "
+              << g_missing << " missing";
+    if (g_checked > 0) {
+        std::cout << " (" << std::fixed << std::setprecision(2) << 100.0 * g_missing / g_checked << "%)"
+                  << std::defaultfloat;
+    }
+    std::cout << ", " << g_extra << " extra detections\n";
+    if (g_overrun.load() > 0 || g_onsetsDropped.load() > 0) {
+        std::cout << "  Dropped: " << g_overrun.load() << " capture samples, "
+                  << g_onsetsDropped.load() << " onset notices\n";
+    }
+    if (g_latencyMs.empty()) return false;
+
+    double mean = 0.0;
+    for (double l : g_latencyMs) mean += l;
+    mean /= g_latencyMs.size();
+    double var = 0.0;
+    for (double l : g_latencyMs) var += (l - mean) * (l - mean);
+    double rmsUs = std::sqrt(var / g_latencyMs.size()) * 1e3;
+    double medianMs = percentile(g_latencyMs, 0.5);
+    double outputMs = outputLatencyNs() / 1e6;
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "  Latency after the audible time: median " << medianMs << " ms, p5 " << percentile(g_latencyMs, 0.05)
+              << " ms, p95 " << percentile(g_latencyMs, 0.95) << " ms (render -> capture "
+              << medianMs + outputMs << " ms incl. " << outputMs << " ms output buffer)\n"
+              << std::setprecision(1)
+              << "  Onset jitter: " << rmsUs << " us RMS, "
+              << (percentile(g_latencyMs, 1.0) - percentile(g_latencyMs, 0.0)) * 1e3 << " us peak-to-peak\n"
+              << "  Template match: median correlation " << std::setprecision(3) << percentile(g_ncc, 0.5)
+              << ", pulse level " << std::setprecision(1) << 20.0 * std::log10(percentile(g_gain, 0.5) * AMPLITUDE)
+              << " dBFS\n" << std::defaultfloat;
+
+    if (!g_config.check) return true;
+    bool ok = std::fabs(medianMs - CAPTURE_TEST_DELAY_MS) <= CHECK_TOLERANCE_MS &&
+              g_unexpectedMissing == 0 && g_unexpectedDetected == 0 && g_extra == 0;
+    std::cout << "  Check against the test recording (" << std::fixed << std::setprecision(1)
+              << CAPTURE_TEST_DELAY_MS << std::defaultfloat << " ms, every "
+              << CAPTURE_TEST_DROP_EVERY << "th pulse dropped): " << (ok ? "PASS" : "FAIL")
+              << " (" << g_unexpectedMissing << " unexpected misses, " << g_unexpectedDetected
+              << " unexpected detections)\n";
+    return ok;
+}
+
+int writeCaptureTestWav(const std::string& path, double seconds) {
+    buildRenderTables();
+    const float* tone = toneTemplate();
+    size_t total = static_cast<size_t>(seconds * SAMPLE_RATE);
+    std::vector<float> signal(total, 0.0f);
+
+    constexpr double PULSE_GAIN = 0.4;
+    constexpr double ECHO_GAIN = 0.25;
+    constexpr double ECHO_MS = 3.0;
+    constexpr double HUM_LEVEL = 0.02;
+    constexpr double NOISE_LEVEL = 0.005;
+    int delay = static_cast<int>(std::lround(CAPTURE_TEST_DELAY_MS * SAMPLE_RATE / 1000.0));
+    int echo = static_cast<int>(std::lround(ECHO_MS * SAMPLE_RATE / 1000.0));
+
+    std::mt19937 rng(40);
+    std::uniform_int_distribution<int> jitter(-2, 2);
+    std::normal_distribution<double> noise(0.0, NOISE_LEVEL);
+
+    for (int64_t pulse = 0;; ++pulse) {
+        size_t onset = static_cast<size_t>(pulse * SAMPLES_PER_INTERVAL + delay + jitter(rng));
+        if (onset + echo + SAMPLES_PER_TONE >= total) break;
+        if (pulse % CAPTURE_TEST_DROP_EVERY == CAPTURE_TEST_DROP_EVERY - 1) continue;
+        for (int i = 0; i < SAMPLES_PER_TONE; ++i) {
+            signal[onset + i] += static_cast<float>(PULSE_GAIN * tone[i]);
+            signal[onset + echo + i] += static_cast<float>(ECHO_GAIN * PULSE_GAIN * tone[i]);
+        }
+    }
+    for (size_t i = 0; i < total; ++i) {
+        signal[i] += static_cast<float>(HUM_LEVEL * std::sin(2.0 * M_PI * 50.0 * i / SAMPLE_RATE) + noise(rng));
+    }
+
+    std::vector<uint8_t> wav;
+    uint32_t dataBytes = static_cast<uint32_t>(total * 2);
+    wav.insert(wav.end(), {'R', 'I', 'F', 'F'});
+    putLE(wav, 36 + dataBytes, 4);
+    wav.insert(wav.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+    putLE(wav, 16, 4);
+    putLE(wav, 1, 2);                   // PCM
+    putLE(wav, 1, 2);                   // Mono
+    putLE(wav, SAMPLE_RATE, 4);
+    putLE(wav, SAMPLE_RATE * 2, 4);
+    putLE(wav, 2, 2);
+    putLE(wav, 16, 2);
+    wav.insert(wav.end(), {'d', 'a', 't', 'a'});
+    putLE(wav, dataBytes, 4);
+    for (float s : signal) {
+        putLE(wav, static_cast<uint16_t>(static_cast<int16_t>(std::lrint(std::clamp(s, -1.0f, 1.0f) * 32767.0f))), 2);
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out.write(reinterpret_cast<const char*>(wav.data()), wav.size())) {
+        std::cerr << "Cannot write " << path << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << path << ": " << seconds << " s synthetic loopback, "
+              << CAPTURE_TEST_DELAY_MS << " ms path delay, every " << CAPTURE_TEST_DROP_EVERY
+              << "th pulse dropped" << std::endl;
+    return 0;
+}
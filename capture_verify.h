@@ -0,0 +1,45 @@
+/**
+ * Loopback capture verification: proof that what reached the DAC matches
+ * the stimulus spec.
+ *
+ * An SDL capture device is opened alongside playback (a loopback cable
+ * from the output, or a reference microphone). Its callback only copies
+ * samples and a host timestamp into wait-free rings; a worker thread
+ * cross-correlates the stream against the rendered tone burst in FFT
+ * blocks (overlap-save), picks one peak per pulse, and matches the peaks
+ * to the onsets the engine delivered at their audible host times. The
+ * report gives per-pulse latency, onset jitter and missing pulses.
+ *
+ * A WAV file can stand in for the capture device. It is fed in real time
+ * on the output device's frame clock, as a loopback on the same interface
+ * would be, so the check needs no sound hardware.
+ */
+
+#pragma once
+
+#include <string>
+
+struct CaptureVerifyConfig {
+    std::string device;         // SDL capture device name (empty = default)
+    std::string file;           // WAV stand-in for the capture device
+    std::string logPath;        // Per-pulse CSV (empty = none)
+    bool check = false;         // Judge the result against the synthetic test recording
+};
+
+/**
+ * Open the capture source and start correlating. Must be called before
+ * the audio device is started (registers an onset tap).
+ */
+bool startCaptureVerify(const CaptureVerifyConfig& config, int sampleRate);
+
+/**
+ * Stop and print the report. Returns false if no pulse was detected, or
+ * in check mode if the result does not match the test recording.
+ */
+bool stopCaptureVerify();
+
+/**
+ * Write `seconds` of a synthetic loopback recording of the default pulse
+ * grid (delay, echo, jitter, hum, noise and dropped pulses) as 16-bit WAV.
+ */
+int writeCaptureTestWav(const std::string& path, double seconds);
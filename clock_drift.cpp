@@ -0,0 +1,195 @@
+#include "clock_drift.h"
+#include "engine.h"
+#include "spsc_ring.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+constexpr auto UPDATE_INTERVAL = std::chrono::milliseconds(250);
+constexpr double MIN_SPAN_SECONDS = 10.0;       // Before that, callback jitter dominates the slope
+constexpr double OUTLIER_NS = 50e6;             // Residual that no scheduling delay explains
+constexpr int OUTLIERS_BEFORE_RESET = 3;        // Consecutive outliers => clock discontinuity
+constexpr double SESSION_SECONDS = 3600.0;
+
+struct ClockSample {
+    int64_t frame;
+    int64_t hostNs;
+};
+
+SpscRing<ClockSample> g_samples(1024);
+
+/**
+ * Running least-squares fit of host ns against frames, centred on the
+ * first sample so the sums stay well inside double precision for hours.
+ */
+struct LineFit {
+    int64_t originFrame = 0;
+    int64_t originNs = 0;
+    uint64_t n = 0;
+    double meanX = 0.0, meanY = 0.0;
+    double sxx = 0.0, sxy = 0.0, syy = 0.0;
+    double minX = 0.0, maxX = 0.0;
+
+    void add(const ClockSample& s) {
+        if (n == 0) {
+            originFrame = s.frame;
+            originNs = s.hostNs;
+        }
+        double x = static_cast<double>(s.frame - originFrame);
+        double y = static_cast<double>(s.hostNs - originNs);
+        ++n;
+        double dx = x - meanX;
+        double dy = y - meanY;
+        meanX += dx / n;
+        meanY += dy / n;
+        sxx += dx * (x - meanX);
+        sxy += dx * (y - meanY);
+        syy += dy * (y - meanY);
+        minX = n == 1 ? x : std::min(minX, x);
+        maxX = n == 1 ? x : std::max(maxX, x);
+    }
+
+    double slope() const { return sxx > 0.0 ? sxy / sxx : 0.0; }  // ns per frame
+
+    double predict(int64_t frame) const {
+        return originNs + meanY + slope() * (static_cast<double>(frame - originFrame) - meanX);
+    }
+
+    double residualRms() const {
+        if (n < 3 || sxx <= 0.0) return 0.0;
+        return std::sqrt(std::max(0.0, (syy - sxy * sxy / sxx) / (n - 2)));
+    }
+};
+
+LineFit g_fit;                  // Estimator thread only
+int g_outliers = 0;
+std::atomic<int> g_nominalRate{SAMPLE_RATE};
+std::atomic<bool> g_resetRequested{false};
+
+// Published snapshot
+std::mutex g_snapshotMutex;
+ClockDrift g_estimate;
+LineFit g_published;
+
+std::thread g_thread;
+std::mutex g_mutex;
+std::condition_variable g_wake;
+bool g_stop = false;
+
+void clockTap(const float* /*block*/, int /*frames*/, int64_t startFrame, int64_t hostNs) {
+    g_samples.push(ClockSample{startFrame, hostNs});  // A dropped sample only thins the fit
+}
+
+void publish() {
+    ClockDrift estimate;
+    double nsPerFrame = g_fit.slope();
+    estimate.spanSeconds = (g_fit.maxX - g_fit.minX) / g_nominalRate.load();
+    if (g_fit.n >= 3 && nsPerFrame > 0.0) {
+        estimate.frameRateHz = 1e9 / nsPerFrame;
+        estimate.ppm = (estimate.frameRateHz / g_nominalRate.load() - 1.0) * 1e6;
+        estimate.pulseRateHz = estimate.frameRateHz / SAMPLES_PER_INTERVAL;
+        estimate.jitterUs = g_fit.residualRms() / 1e3;
+        estimate.valid = estimate.spanSeconds >= MIN_SPAN_SECONDS;
+    }
+
+    std::lock_guard<std::mutex> lock(g_snapshotMutex);
+    g_estimate = estimate;
+    g_published = g_fit;
+}
+
+void update() {
+    if (g_resetRequested.exchange(false)) {
+        ClockSample stale;
+        while (g_samples.pop(stale)) {}
+        g_fit = LineFit();
+        g_outliers = 0;
+    }
+
+    ClockSample sample;
+    while (g_samples.pop(sample)) {
+        // A frame clock jump the line cannot explain (hot-plug gap skip,
+        // device swap) starts a new fit instead of bending the old one
+        if (g_fit.n >= 16 && std::fabs(sample.hostNs - g_fit.predict(sample.frame)) > OUTLIER_NS) {
+            if (++g_outliers < OUTLIERS_BEFORE_RESET) continue;
+            g_fit = LineFit();
+        }
+        g_outliers = 0;
+        g_fit.add(sample);
+    }
+    publish();
+}
+
+void estimatorLoop() {
+    std::unique_lock<std::mutex> lock(g_mutex);
+    while (!g_stop) {
+        g_wake.wait_for(lock, UPDATE_INTERVAL);
+        update();
+    }
+    update();
+}
+
+} // namespace
+
+bool startClockDrift(int nominalRate) {
+    g_nominalRate.store(nominalRate);
+    if (!addBlockTap(clockTap)) {
+        std::cerr << "No free engine tap for the clock drift estimator" << std::endl;
+        return false;
+    }
+    g_stop = false;
+    g_thread = std::thread(estimatorLoop);
+    return true;
+}
+
+void stopClockDrift() {
+    if (!g_thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_stop = true;
+    }
+    g_wake.notify_one();
+    g_thread.join();
+
+    ClockDrift estimate = clockDriftEstimate();
+    if (!estimate.valid) {
+        std::cout << "Clock drift: not enough data (" << std::fixed << std::setprecision(1)
+                  << estimate.spanSeconds << " s)\n" << std::defaultfloat;
+        return;
+    }
+    double nominalPulseHz = static_cast<double>(g_nominalRate.load()) / SAMPLES_PER_INTERVAL;
+    std::cout << std::fixed << std::setprecision(3)
+              << "Clock drift over " << std::setprecision(1) << estimate.spanSeconds << " s: "
+              << std::setprecision(2) << estimate.frameRateHz << " frames/s ("
+              << std::showpos << std::setprecision(1) << estimate.ppm << std::noshowpos << " ppm)"
+              << " | pulse rate " << std::setprecision(4) << estimate.pulseRateHz
+              << " Hz (nominal " << nominalPulseHz << ")"
+              << " | " << std::setprecision(0) << estimate.pulseRateHz * SESSION_SECONDS
+              << " pulses per hour (nominal " << nominalPulseHz * SESSION_SECONDS << ")"
+              << " | callback jitter " << std::setprecision(0) << estimate.jitterUs << " us RMS\n"
+              << std::defaultfloat;
+}
+
+void resetClockDrift(int nominalRate) {
+    g_nominalRate.store(nominalRate);
+    g_resetRequested.store(true);
+}
+
+ClockDrift clockDriftEstimate() {
+    std::lock_guard<std::mutex> lock(g_snapshotMutex);
+    return g_estimate;
+}
+
+bool driftFrameToHostNs(int64_t frame, int64_t& hostNs) {
+    std::lock_guard<std::mutex> lock(g_snapshotMutex);
+    if (!g_estimate.valid) return false;
+    hostNs = std::llround(g_published.predict(frame));
+    return true;
+}
@@ -0,0 +1,50 @@
+/**
+ * Audio-clock vs host-clock drift estimator.
+ *
+ * Every block start (engine frame, callback host time) is fed through a
+ * wait-free ring to a background thread that fits host time against frame
+ * count by least squares. The slope gives the device's true frame rate in
+ * steady_clock seconds, and with it the effective pulse rate and the ppm
+ * error against the nominal rate. The fit restarts whenever the device is
+ * (re)started, since a new device brings a new clock.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+struct ClockDrift {
+    bool valid = false;         // Enough span for a stable slope
+    double frameRateHz = 0.0;   // Device frames per host second
+    double ppm = 0.0;           // (frameRateHz / nominal - 1) * 1e6
+    double pulseRateHz = 0.0;   // Onsets per host second
+    double spanSeconds = 0.0;   // Host time covered by the fit
+    double jitterUs = 0.0;      // RMS residual of the callback times
+};
+
+/**
+ * Start estimating against `nominalRate` (the opened device rate).
+ * Must be called before the audio device is started.
+ */
+bool startClockDrift(int nominalRate);
+
+/**
+ * Stop the estimator and print the end-of-session report
+ */
+void stopClockDrift();
+
+/**
+ * Discard the current fit (device reopened, possibly at a new rate)
+ */
+void resetClockDrift(int nominalRate);
+
+/**
+ * Latest estimate (any thread except the audio thread)
+ */
+ClockDrift clockDriftEstimate();
+
+/**
+ * Host time of `frame` on the fitted line. Returns false until the fit is
+ * valid, in which case callers keep their own nominal-rate mapping.
+ */
+bool driftFrameToHostNs(int64_t frame, int64_t& hostNs);
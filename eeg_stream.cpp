@@ -0,0 +1,171 @@
+#include "eeg_stream.h"
+#include "engine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr double WANDER_RATE_HZ = 0.1;      // Gamma frequency wander cycle
+constexpr double AMPLITUDE_RATE_HZ = 0.23;  // Gamma amplitude modulation
+constexpr double BROWN_LEAK = 0.995;
+
+std::thread g_synthThread;
+std::atomic<bool> g_synthRunning{false};
+EegSynthConfig g_synthConfig;
+std::atomic<int64_t> g_synthStartNs{0};
+
+bool makeAddress(const std::string& path, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "EEG socket path too long: " << path << std::endl;
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+/**
+ * Closed-form phase of the wandering gamma rhythm, t seconds after start
+ */
+double synthPhase(const EegSynthConfig& config, double t) {
+    double wander = config.wanderHz / WANDER_RATE_HZ * (1.0 - std::cos(2.0 * M_PI * WANDER_RATE_HZ * t));
+    return 2.0 * M_PI * config.gammaHz * t + wander;
+}
+
+void synthLoop(std::string path) {
+    const EegSynthConfig& config = g_synthConfig;
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    sockaddr_un addr;
+    if (fd < 0 || !makeAddress(path, addr)) {
+        if (fd >= 0) close(fd);
+        g_synthRunning.store(false);
+        return;
+    }
+
+    std::mt19937 rng(40);
+    std::normal_distribution<double> white(0.0, 1.0);
+    double brown = 0.0;
+
+    int count = std::clamp(config.packetSamples, 1, EEG_MAX_PACKET_SAMPLES);
+    std::vector<uint8_t> packet(sizeof(EegPacketHeader) + count * sizeof(float));
+    EegPacketHeader header{EEG_PACKET_MAGIC, static_cast<uint32_t>(config.sampleRate),
+                           static_cast<uint32_t>(count), 0, 0};
+    float* samples = reinterpret_cast<float*>(packet.data() + sizeof(EegPacketHeader));
+
+    int64_t startNs = g_synthStartNs.load();
+    int64_t transportNs = static_cast<int64_t>(config.transportMs * 1e6);
+    for (int64_t n = 0; g_synthRunning.load(); n += count) {
+        double t0 = static_cast<double>(n) / config.sampleRate;
+        if (config.seconds > 0.0 && t0 >= config.seconds) break;
+
+        for (int i = 0; i < count; ++i) {
+            double t = static_cast<double>(n + i) / config.sampleRate;
+            double amplitude = 1.0 + 0.3 * std::sin(2.0 * M_PI * AMPLITUDE_RATE_HZ * t);
+            brown = brown * BROWN_LEAK + 0.1 * white(rng);
+            samples[i] = static_cast<float>(amplitude * std::cos(synthPhase(config, t)) +
+                                            config.noise * (2.0 * brown + 0.3 * white(rng)));
+        }
+
+        // A packet leaves once its last sample has been taken
+        header.firstNs = startNs + n * 1000000000LL / config.sampleRate;
+        int64_t sendNs = startNs + (n + count) * 1000000000LL / config.sampleRate + transportNs;
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(sendNs)));
+        std::memcpy(packet.data(), &header, sizeof(header));
+        sendto(fd, packet.data(), packet.size(), 0, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    }
+    close(fd);
+    g_synthRunning.store(false);
+}
+
+} // namespace
+
+int openEegReceiver(const std::string& path) {
+    sockaddr_un addr;
+    if (!makeAddress(path, addr)) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        std::cerr << "EEG socket failed: " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        std::cerr << "EEG bind to " << path << " failed: " << std::strerror(errno) << std::endl;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void closeEegReceiver(int fd, const std::string& path) {
+    if (fd < 0) return;
+    close(fd);
+    unlink(path.c_str());
+}
+
+bool receiveEegPacket(int fd, EegPacketHeader& header, float* samples, int timeoutMs) {
+    pollfd pfd{fd, POLLIN, 0};
+    if (poll(&pfd, 1, timeoutMs) <= 0) return false;
+
+    uint8_t buffer[sizeof(EegPacketHeader) + EEG_MAX_PACKET_SAMPLES * sizeof(float)];
+    ssize_t len = recv(fd, buffer, sizeof(buffer), 0);
+    if (len < static_cast<ssize_t>(sizeof(EegPacketHeader))) return false;
+
+    std::memcpy(&header, buffer, sizeof(header));
+    // An empty packet has no last sample to stamp; more than the buffer holds would overrun `samples`
+    if (header.magic != EEG_PACKET_MAGIC || header.sampleRate == 0 || header.count == 0 || header.count > EEG_MAX_PACKET_SAMPLES ||
+        static_cast<size_t>(len) < sizeof(EegPacketHeader) + header.count * sizeof(float)) {
+        return false;
+    }
+    std::memcpy(samples, buffer + sizeof(EegPacketHeader), header.count * sizeof(float));
+    return true;
+}
+
+bool startEegSynth(const std::string& path, const EegSynthConfig& config) {
+    if (g_synthThread.joinable()) return false;
+    g_synthConfig = config;
+    g_synthStartNs.store(hostTimeNs());
+    g_synthRunning.store(true);
+    g_synthThread = std::thread(synthLoop, path);
+    return true;
+}
+
+void stopEegSynth() {
+    if (!g_synthThread.joinable()) return;
+    g_synthRunning.store(false);
+    g_synthThread.join();
+    g_synthStartNs.store(0);
+}
+
+bool eegSynthPhaseAt(int64_t hostNs, double& phase) {
+    int64_t startNs = g_synthStartNs.load();
+    if (startNs == 0) return false;
+    phase = synthPhase(g_synthConfig, (hostNs - startNs) / 1e9);
+    return true;
+}
+
+int runEegSynth(const std::string& path, const EegSynthConfig& config) {
+    std::cout << "Synthetic EEG -> " << path << ": " << config.sampleRate << " Hz, "
+              << config.packetSamples << " samples/packet, gamma " << config.gammaHz
+              << " +/- " << config.wanderHz << " Hz" << std::endl;
+    startEegSynth(path, config);
+    while (g_synthRunning.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    stopEegSynth();
+    return 0;
+}
@@ -0,0 +1,67 @@
+/**
+ * Local EEG sample stream over a UNIX datagram socket, and a synthetic
+ * gamma-band generator that stands in for an amplifier in tests.
+ *
+ * Each datagram is an EegPacketHeader followed by `count` float32 samples
+ * of one channel (native byte order; both ends are on this host). The
+ * first sample was taken at `firstNs` on the host steady clock, which all
+ * processes on a machine share, so no clock exchange is needed.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+constexpr uint32_t EEG_PACKET_MAGIC = 0x31474545;  // "EEG1"
+constexpr int EEG_MAX_PACKET_SAMPLES = 256;
+
+struct EegPacketHeader {
+    uint32_t magic;
+    uint32_t sampleRate;
+    uint32_t count;
+    uint32_t reserved;
+    int64_t firstNs;        // Host time of the first sample
+};
+
+/**
+ * Bind a datagram socket at `path` (an existing socket file is replaced).
+ * Returns the descriptor or -1.
+ */
+int openEegReceiver(const std::string& path);
+void closeEegReceiver(int fd, const std::string& path);
+
+/**
+ * Wait up to `timeoutMs` for one packet. `samples` must hold
+ * EEG_MAX_PACKET_SAMPLES floats. Packets with no samples, more than
+ * EEG_MAX_PACKET_SAMPLES, or fewer bytes than their count are dropped.
+ */
+bool receiveEegPacket(int fd, EegPacketHeader& header, float* samples, int timeoutMs);
+
+struct EegSynthConfig {
+    int sampleRate = 1000;
+    int packetSamples = 2;          // Samples per datagram
+    double gammaHz = 40.0;          // Centre of the gamma rhythm
+    double wanderHz = 1.5;          // Slow frequency wander around the centre
+    double noise = 1.0;             // Background (brown + white) relative to gamma amplitude
+    double transportMs = 0.0;       // Extra delay between sampling and sending
+    double seconds = 0.0;           // 0 = until stopped
+};
+
+/**
+ * Generate in real time and send to the receiver at `path`. The gamma
+ * rhythm's true phase is tracked so tests can check the estimator.
+ */
+bool startEegSynth(const std::string& path, const EegSynthConfig& config);
+void stopEegSynth();
+
+/**
+ * Ground-truth gamma phase (radians) of the running generator at host
+ * time `hostNs`. Returns false when no generator runs in this process.
+ */
+bool eegSynthPhaseAt(int64_t hostNs, double& phase);
+
+/**
+ * Standalone generator (--eeg-synth). Runs until `seconds` or interrupted.
+ */
+int runEegSynth(const std::string& path, const EegSynthConfig& config);
@@ -0,0 +1,589 @@
+#include "engine.h"
+#include "clock_drift.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+std::atomic<bool> g_isPlaying{true};
+std::atomic<int64_t> g_samplePosition{0};
+std::atomic<bool> g_continuousTone{false};
+std::atomic<uint64_t> g_callbackCount{0};
+std::atomic<int64_t> g_lastCallbackNs{0};
+std::atomic<int64_t> g_firstNonZeroNs{0};
+
+namespace {
+
+// Continuous tone repeats exactly every SAMPLE_RATE / gcd(SAMPLE_RATE, TONE_FREQUENCY) frames
+constexpr int CONTINUOUS_PERIOD = SAMPLE_RATE / std::gcd(SAMPLE_RATE, TONE_FREQUENCY);
+
+float g_toneTable[SAMPLES_PER_TONE];
+std::vector<float> g_continuousTable;
+
+int g_outputChannels = 1;
+int g_triggerChannel = -1;
+
+constexpr int MAX_BLOCK_TAPS = 8;
+BlockTap g_blockTaps[MAX_BLOCK_TAPS];
+int g_blockTapCount = 0;
+OnsetTap g_onsetTaps[MAX_BLOCK_TAPS];
+int g_onsetTapCount = 0;
+MixStage g_mixStages[MAX_BLOCK_TAPS];
+int g_mixStageCount = 0;
+
+// Onset grid, owned by the audio thread
+PulseGrid g_grid;
+std::atomic<int64_t> g_pendingOnset{-1};
+std::atomic<int64_t> g_pendingStart{-1};
+
+// Triggered mode; the burst frame is owned by the audio thread
+bool g_triggered = false;
+std::atomic<uint64_t> g_fireRequested{0};
+uint64_t g_fireServed = 0;
+int64_t g_burstFrame = -1;
+std::atomic<uint64_t> g_fireTooClose{0};
+std::atomic<uint64_t> g_scheduleApplied{0};
+std::atomic<uint64_t> g_scheduleLate{0};
+std::atomic<uint64_t> g_scheduleTooClose{0};
+
+// Delivered onsets, newest at g_onsetCount - 1
+std::atomic<int64_t> g_onsetHistory[ONSET_HISTORY];
+std::atomic<uint64_t> g_onsetCount{0};
+
+// Latest block start and grid, seqlock-published by the audio thread
+std::atomic<uint32_t> g_anchorSeq{0};
+std::atomic<int64_t> g_anchorFrame{0};
+std::atomic<int64_t> g_anchorNs{0};
+std::atomic<int64_t> g_gridBase{0};
+std::atomic<int64_t> g_gridIndex{0};
+
+// Pre-rendered stimulus; the cursor is written by the audio thread only
+StimulusSource g_source;
+std::atomic<int64_t> g_sourceFrame{0};
+
+// Noise: the audio callback's own generator, and the prototype other
+// rendering threads copy when the version moves
+NoiseMode g_noiseMode = NOISE_OFF;
+NoiseGenerator g_noise;
+NoiseGenerator g_noisePrototype;
+std::atomic<uint32_t> g_noiseVersion{0};
+
+std::atomic<int> g_deviceRate{SAMPLE_RATE};
+std::atomic<int> g_latencyFrames{0};
+
+void publishAnchor(int64_t frame, int64_t hostNs) {
+    uint32_t seq = g_anchorSeq.load(std::memory_order_relaxed);
+    g_anchorSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    g_anchorFrame.store(frame, std::memory_order_relaxed);
+    g_anchorNs.store(hostNs, std::memory_order_relaxed);
+    g_gridBase.store(g_grid.base, std::memory_order_relaxed);
+    g_gridIndex.store(g_grid.index, std::memory_order_relaxed);
+    g_anchorSeq.store(seq + 2, std::memory_order_release);
+}
+
+/**
+ * Move the grid so the next onset lands on the pending request. Only at a
+ * block start that is past the current pulse's tone and marker, and only
+ * if every frame until the target is silent on the new grid.
+ */
+void applyScheduledOnset(int64_t pos) {
+    int64_t target = g_pendingOnset.load(std::memory_order_acquire);
+    if (target < 0) return;
+
+    if (target <= pos) {
+        g_pendingOnset.compare_exchange_strong(target, -1);
+        g_scheduleLate.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (pos < g_grid.base + TRIGGER_SPAN_FRAMES || g_grid.intervalPos(pos) < TRIGGER_SPAN_FRAMES ||
+        target - pos > SAMPLES_PER_INTERVAL - TRIGGER_SPAN_FRAMES) {
+        return;  // Not yet; try again next block
+    }
+
+    int64_t lastOnset = pos - g_grid.intervalPos(pos);
+    g_pendingOnset.compare_exchange_strong(target, -1);
+    if (target - lastOnset < MIN_ONSET_SPACING_FRAMES) {
+        g_scheduleTooClose.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    g_grid = PulseGrid{target, g_grid.pulseIndex(pos) + 1};
+    g_scheduleApplied.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * Begin a pending synchronized start if its first onset falls in this
+ * block. Returns the number of leading frames to keep silent, or -1 if
+ * playback does not start here.
+ */
+int applyScheduledStart(int64_t pos, int frames) {
+    int64_t start = g_pendingStart.load(std::memory_order_acquire);
+    if (start < 0) return -1;
+
+    int64_t first = start;
+    if (first < pos) {
+        first += (pos - start + SAMPLES_PER_INTERVAL - 1) / SAMPLES_PER_INTERVAL * SAMPLES_PER_INTERVAL;
+    }
+    if (first >= pos + frames) return -1;
+
+    g_pendingStart.compare_exchange_strong(start, -1);
+    g_grid = PulseGrid{start, 0};
+    g_isPlaying.store(true);
+    return static_cast<int>(first - pos);
+}
+
+/**
+ * Start a triggered pulse at `pos` if one was requested since the last
+ * block. Returns true if this block begins with a pulse.
+ */
+bool applyTriggeredOnset(int64_t pos) {
+    uint64_t requested = g_fireRequested.load(std::memory_order_acquire);
+    if (requested == g_fireServed) return false;
+    g_fireServed = requested;
+
+    if (g_burstFrame >= 0 && pos - g_burstFrame < MIN_ONSET_SPACING_FRAMES) {
+        g_fireTooClose.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    int64_t pulse = g_burstFrame >= 0 ? g_grid.index + 1 : 0;
+    g_grid = PulseGrid{pos, pulse};
+    g_burstFrame = pos;
+    return true;
+}
+
+/**
+ * Triggered mode renders on the grid of the latest burst; keep only that
+ * burst's tone and marker
+ */
+void gateToBurst(float* out, int64_t startFrame, int frames) {
+    int64_t keepFrom = g_burstFrame < 0 ? startFrame + frames : g_burstFrame;
+    int64_t keepTo = g_burstFrame < 0 ? keepFrom : g_burstFrame + TRIGGER_SPAN_FRAMES;
+    int from = static_cast<int>(std::clamp<int64_t>(keepFrom - startFrame, 0, frames));
+    int to = static_cast<int>(std::clamp<int64_t>(keepTo - startFrame, from, frames));
+    std::fill(out, out + from * g_outputChannels, 0.0f);
+    std::fill(out + to * g_outputChannels, out + frames * g_outputChannels, 0.0f);
+}
+
+/**
+ * Generator for the calling thread: the engine's own on the audio thread
+ * (`live`), else a per-thread copy so offline render workers each continue
+ * their chunks without a replay
+ */
+NoiseGenerator& noiseGenerator(bool live) {
+    if (live) return g_noise;
+    thread_local NoiseGenerator noise;
+    thread_local uint32_t version = 0;
+    uint32_t current = g_noiseVersion.load(std::memory_order_acquire);
+    if (version != current) {
+        noise = g_noisePrototype;
+        version = current;
+    }
+    return noise;
+}
+
+void renderStimulus(float* out, int64_t startFrame, int frames, bool live);
+void renderOutput(float* out, int64_t startFrame, int frames, bool live);
+
+/**
+ * Record a delivered onset and hand it to the taps
+ */
+void deliverOnset(int64_t onset, int64_t pos, int64_t callbackNs) {
+    uint64_t count = g_onsetCount.load(std::memory_order_relaxed);
+    g_onsetHistory[count % ONSET_HISTORY].store(onset, std::memory_order_relaxed);
+    g_onsetCount.store(count + 1, std::memory_order_release);
+
+    int64_t onsetNs = callbackNs + (onset - pos) * 1000000000LL / SAMPLE_RATE;
+    int64_t pulse = g_grid.pulseIndex(onset);
+    for (int i = 0; i < g_onsetTapCount; ++i) {
+        g_onsetTaps[i](onset, onsetNs, pulse);
+    }
+}
+
+/**
+ * Play the stimulus source from its cursor after `lead` silent frames and
+ * move the grid so its pulses fall where the source has them. Returns the
+ * number of stimulus frames played.
+ */
+int renderSourceBlock(float* out, int64_t pos, int lead, int frames) {
+    int channels = g_outputChannels;
+    int64_t cursor = g_sourceFrame.load(std::memory_order_relaxed);
+    int played = static_cast<int>(std::clamp<int64_t>(g_source.frames - cursor, 0, frames - lead));
+    int64_t from = pos + lead;
+
+    std::fill(out, out + lead * channels, 0.0f);
+    if (played > 0) g_source.read(out + lead * channels, cursor, played);
+    std::fill(out + (lead + played) * channels, out + frames * channels, 0.0f);
+
+    g_grid = PulseGrid{from + g_source.firstOnset - cursor, 0};
+    if (g_source.marker && g_triggerChannel >= 0) {
+        // No marker before pulse 0
+        int skip = static_cast<int>(std::clamp<int64_t>(g_grid.base - from, 0, played));
+        renderTriggerBlock(out + (lead + skip) * channels + g_triggerChannel, channels, from + skip, played - skip);
+    }
+    g_sourceFrame.store(cursor + played, std::memory_order_relaxed);
+    return played;
+}
+
+} // namespace
+
+int64_t hostTimeNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+PulseGrid pulseGrid() {
+    PulseGrid grid;
+    uint32_t seq;
+    do {
+        seq = g_anchorSeq.load(std::memory_order_acquire);
+        grid.base = g_gridBase.load(std::memory_order_relaxed);
+        grid.index = g_gridIndex.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || seq != g_anchorSeq.load(std::memory_order_relaxed));
+    return grid;
+}
+
+void scheduleOnset(int64_t frame) {
+    g_pendingOnset.store(std::max<int64_t>(frame, 0), std::memory_order_release);
+}
+
+void startPlaybackAt(int64_t frame) {
+    g_pendingStart.store(std::max<int64_t>(frame, 0), std::memory_order_release);
+}
+
+void setTriggeredMode(bool on) {
+    g_triggered = on;
+}
+
+void fireOnset() {
+    g_fireRequested.fetch_add(1, std::memory_order_release);
+}
+
+uint64_t triggeredTooClose() {
+    return g_fireTooClose.load();
+}
+
+OnsetScheduleStats onsetScheduleStats() {
+    OnsetScheduleStats stats;
+    stats.applied = g_scheduleApplied.load();
+    stats.late = g_scheduleLate.load();
+    stats.tooClose = g_scheduleTooClose.load();
+    return stats;
+}
+
+int recentOnsets(int64_t* frames, int max) {
+    max = std::min(max, ONSET_HISTORY);
+    uint64_t count = g_onsetCount.load(std::memory_order_acquire);
+    int n = static_cast<int>(std::min<uint64_t>(count, max));
+    for (int i = 0; i < n; ++i) {
+        frames[i] = g_onsetHistory[(count - n + i) % ONSET_HISTORY].load(std::memory_order_relaxed);
+    }
+    // Entries the audio thread lapped meanwhile are dropped from the front
+    int64_t overwritten = static_cast<int64_t>(g_onsetCount.load(std::memory_order_acquire)) - ONSET_HISTORY;
+    int lapped = static_cast<int>(std::clamp<int64_t>(overwritten - static_cast<int64_t>(count - n), 0, n));
+    std::copy(frames + lapped, frames + n, frames);
+    return n - lapped;
+}
+
+bool frameClockAnchor(int64_t& frame, int64_t& hostNs) {
+    uint32_t seq;
+    do {
+        seq = g_anchorSeq.load(std::memory_order_acquire);
+        frame = g_anchorFrame.load(std::memory_order_relaxed);
+        hostNs = g_anchorNs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || seq != g_anchorSeq.load(std::memory_order_relaxed));
+    return hostNs != 0;
+}
+
+void setOutputTiming(int sampleRate, int latencyFrames) {
+    g_deviceRate.store(sampleRate);
+    g_latencyFrames.store(latencyFrames);
+}
+
+int64_t outputLatencyNs() {
+    return static_cast<int64_t>(g_latencyFrames.load()) * 1000000000LL / g_deviceRate.load();
+}
+
+bool audibleFrameAt(int64_t hostNs, double& frame) {
+    int64_t anchorFrame, anchorNs;
+    if (!frameClockAnchor(anchorFrame, anchorNs)) return false;
+
+    // The fitted line strips callback jitter from the anchor
+    double rate = g_deviceRate.load();
+    int64_t fittedNs;
+    ClockDrift drift = clockDriftEstimate();
+    if (drift.valid && driftFrameToHostNs(anchorFrame, fittedNs)) {
+        anchorNs = fittedNs;
+        rate = drift.frameRateHz;
+    }
+    frame = anchorFrame + (hostNs - outputLatencyNs() - anchorNs) * rate / 1e9;
+    return true;
+}
+
+bool audibleHostNs(int64_t frame, int64_t& hostNs) {
+    int64_t renderedNs;
+    if (!driftFrameToHostNs(frame, renderedNs)) {
+        int64_t anchorFrame, anchorNs;
+        if (!frameClockAnchor(anchorFrame, anchorNs)) return false;
+        renderedNs = anchorNs + std::llround((frame - anchorFrame) * 1e9 / g_deviceRate.load());
+    }
+    hostNs = renderedNs + outputLatencyNs();
+    return true;
+}
+
+void buildRenderTables() {
+    // Tone burst with a short linear fade in/out to avoid clicks
+    int fadeLength = SAMPLES_PER_TONE / 4;
+    for (int i = 0; i < SAMPLES_PER_TONE; ++i) {
+        double tLocal = static_cast<double>(i) / SAMPLE_RATE;
+        double sample = AMPLITUDE * std::sin(2.0 * M_PI * TONE_FREQUENCY * tLocal);
+        if (i < fadeLength) {
+            sample *= static_cast<double>(i) / fadeLength;
+        } else if (i > SAMPLES_PER_TONE - fadeLength) {
+            sample *= static_cast<double>(SAMPLES_PER_TONE - i) / fadeLength;
+        }
+        g_toneTable[i] = static_cast<float>(sample);
+    }
+
+    g_continuousTable.resize(CONTINUOUS_PERIOD);
+    for (int i = 0; i < CONTINUOUS_PERIOD; ++i) {
+        double t = static_cast<double>(i) / SAMPLE_RATE;
+        g_continuousTable[i] = static_cast<float>(AMPLITUDE * std::sin(2.0 * M_PI * TONE_FREQUENCY * t));
+    }
+}
+
+const float* toneTemplate() {
+    return g_toneTable;
+}
+
+float generateSample(int64_t position) {
+    // Continuous tone mode for testing
+    if (g_continuousTone.load()) {
+        return g_continuousTable[position % CONTINUOUS_PERIOD];
+    }
+
+    // Only generate tone for first 1ms of each 25ms interval
+    int posInInterval = g_grid.intervalPos(position);
+    if (posInInterval < SAMPLES_PER_TONE) {
+        return g_toneTable[posInInterval];
+    }
+
+    return 0.0f; // Silence between tones
+}
+
+void renderBlock(float* out, int64_t startFrame, int frames) {
+    renderStimulus(out, startFrame, frames, false);
+}
+
+namespace {
+
+void renderStimulus(float* out, int64_t startFrame, int frames, bool live) {
+    if (g_continuousTone.load()) {
+        int pos = static_cast<int>(startFrame % CONTINUOUS_PERIOD);
+        for (int i = 0; i < frames; ++i) {
+            out[i] = g_continuousTable[pos];
+            if (++pos == CONTINUOUS_PERIOD) pos = 0;
+        }
+        return;
+    }
+    if (g_noiseMode == NOISE_SHAM) {
+        noiseGenerator(live).render(out, startFrame, frames);
+        return;
+    }
+
+    // Walk the block in runs of tone / silence instead of testing every sample
+    int posInInterval = g_grid.intervalPos(startFrame);
+    int i = 0;
+    while (i < frames) {
+        int run;
+        if (posInInterval < SAMPLES_PER_TONE) {
+            run = std::min(SAMPLES_PER_TONE - posInInterval, frames - i);
+            std::memcpy(out + i, g_toneTable + posInInterval, run * sizeof(float));
+        } else {
+            run = std::min(SAMPLES_PER_INTERVAL - posInInterval, frames - i);
+            std::fill(out + i, out + i + run, 0.0f);
+        }
+        i += run;
+        posInInterval += run;
+        if (posInInterval == SAMPLES_PER_INTERVAL) posInInterval = 0;
+    }
+    if (g_noiseMode == NOISE_MASK) noiseGenerator(live).render(out, startFrame, frames, true);
+}
+
+void renderOutput(float* out, int64_t startFrame, int frames, bool live) {
+    renderStimulus(out, startFrame, frames, live);
+    if (g_outputChannels == 1) return;
+
+    // Spread the mono render across the frame in place, last frame first
+    // so no sample is overwritten before it is read.
+    int channels = g_outputChannels;
+    for (int i = frames - 1; i >= 0; --i) {
+        float s = out[i];
+        float* frame = out + static_cast<size_t>(i) * channels;
+        for (int c = channels - 1; c >= 0; --c) {
+            frame[c] = c == g_triggerChannel ? 0.0f : s;
+        }
+    }
+
+    // The marker follows the onset grid; the continuous test tone has none
+    if (g_triggerChannel >= 0 && !g_continuousTone.load()) {
+        renderTriggerBlock(out + g_triggerChannel, channels, startFrame, frames);
+    }
+}
+
+} // namespace
+
+void setStimulusNoise(NoiseMode mode, const NoiseConfig& config) {
+    g_noiseMode = mode;
+    g_noisePrototype.init(config);
+    g_noise = g_noisePrototype;
+    g_noiseVersion.fetch_add(1, std::memory_order_release);
+}
+
+bool pulseToneIn(int64_t startFrame, int frames) {
+    int posInInterval = g_grid.intervalPos(startFrame);
+    return posInInterval < SAMPLES_PER_TONE || SAMPLES_PER_INTERVAL - posInInterval < frames;
+}
+
+bool setOutputLayout(int channels, int triggerChannel) {
+    if (channels < 1 || channels > MAX_OUTPUT_CHANNELS || triggerChannel >= channels ||
+        (triggerChannel >= 0 && channels < 2)) {
+        return false;
+    }
+    g_outputChannels = channels;
+    g_triggerChannel = triggerChannel;
+    return true;
+}
+
+int outputChannels() {
+    return g_outputChannels;
+}
+
+int triggerChannel() {
+    return g_triggerChannel;
+}
+
+void renderTriggerBlock(float* out, int stride, int64_t startFrame, int frames) {
+    int64_t onsetIndex = g_grid.pulseIndex(startFrame);
+    int posInInterval = g_grid.intervalPos(startFrame);
+    int i = 0;
+    while (i < frames) {
+        if (posInInterval >= TRIGGER_SPAN_FRAMES) {
+            // Jump to the next onset
+            i += SAMPLES_PER_INTERVAL - posInInterval;
+            posInInterval = 0;
+            ++onsetIndex;
+            continue;
+        }
+
+        float level;
+        if (posInInterval < TRIGGER_PULSE_FRAMES) {
+            level = TRIGGER_LEVEL;
+        } else if (posInInterval < TRIGGER_COUNTER_START) {
+            level = 0.0f;
+        } else {
+            int bit = (posInInterval - TRIGGER_COUNTER_START) / TRIGGER_BIT_FRAMES;
+            level = ((onsetIndex >> bit) & 1) ? TRIGGER_LEVEL : 0.0f;
+        }
+        out[static_cast<size_t>(i) * stride] = level;
+        ++i;
+        ++posInInterval;
+    }
+}
+
+void renderOutputBlock(float* out, int64_t startFrame, int frames) {
+    renderOutput(out, startFrame, frames, false);
+}
+
+void setStimulusSource(const StimulusSource& source) {
+    g_source = source;
+    g_sourceFrame.store(0);
+}
+
+int64_t stimulusPosition() {
+    return g_sourceFrame.load(std::memory_order_relaxed);
+}
+
+bool addBlockTap(BlockTap tap) {
+    if (g_blockTapCount == MAX_BLOCK_TAPS) return false;
+    g_blockTaps[g_blockTapCount++] = tap;
+    return true;
+}
+
+bool addOnsetTap(OnsetTap tap) {
+    if (g_onsetTapCount == MAX_BLOCK_TAPS) return false;
+    g_onsetTaps[g_onsetTapCount++] = tap;
+    return true;
+}
+
+bool addMixStage(MixStage stage) {
+    if (g_mixStageCount == MAX_BLOCK_TAPS) return false;
+    g_mixStages[g_mixStageCount++] = stage;
+    return true;
+}
+
+void audioCallback(void* /*userdata*/, Uint8* stream, int len) {
+    int64_t callbackNs = hostTimeNs();
+    float* buffer = reinterpret_cast<float*>(stream);
+    int frames = len / static_cast<int>(sizeof(float) * g_outputChannels);
+
+    int64_t pos = g_samplePosition.load();
+    bool playing = g_isPlaying.load();
+    bool pulsed = !g_continuousTone.load();
+
+    int lead = 0;
+    if (!playing) {
+        lead = applyScheduledStart(pos, frames);
+        playing = lead >= 0;
+    }
+    applyScheduledOnset(pos);
+    bool burst = g_triggered && playing && pulsed && applyTriggeredOnset(pos);
+    bool fromSource = playing && pulsed && g_source.read;
+    // Whether the block carries pulses, for mix stages that key on them
+    bool pulses = playing && pulsed && g_noiseMode != NOISE_SHAM && (!g_triggered || burst);
+
+    int64_t end = pos + frames;
+    if (fromSource) {
+        end = pos + lead + renderSourceBlock(buffer, pos, lead, frames);
+    } else if (playing) {
+        renderOutput(buffer, pos, frames, true);
+        std::fill(buffer, buffer + lead * g_outputChannels, 0.0f);
+        if (g_triggered && pulsed) gateToBurst(buffer, pos, frames);
+    } else {
+        std::fill(buffer, buffer + frames * g_outputChannels, 0.0f);
+    }
+
+    // Onsets are the grid points that fall inside this block
+    if (playing && pulsed && g_triggered) {
+        if (burst) deliverOnset(pos, pos, callbackNs);
+    } else if (playing && pulsed) {
+        int64_t from = fromSource ? std::max(pos + lead, g_grid.base) : pos + lead;
+        int64_t onset = from + (SAMPLES_PER_INTERVAL - g_grid.intervalPos(from)) % SAMPLES_PER_INTERVAL;
+        for (; onset < end; onset += SAMPLES_PER_INTERVAL) {
+            deliverOnset(onset, pos, callbackNs);
+        }
+    }
+
+    for (int i = 0; i < g_mixStageCount; ++i) {
+        g_mixStages[i](buffer, frames, pos, pulses);
+    }
+
+    g_samplePosition.store(pos + frames);
+    publishAnchor(pos, callbackNs);
+
+    if (g_firstNonZeroNs.load(std::memory_order_relaxed) == 0 &&
+        std::any_of(buffer, buffer + frames * g_outputChannels, [](float s) { return s != 0.0f; })) {
+        g_firstNonZeroNs.store(callbackNs, std::memory_order_relaxed);
+    }
+
+    for (int i = 0; i < g_blockTapCount; ++i) {
+        g_blockTaps[i](buffer, frames, pos, callbackNs);
+    }
+
+    g_lastCallbackNs.store(hostTimeNs(), std::memory_order_relaxed);
+    g_callbackCount.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,295 @@
+/**
+ * Stimulus engine: render tables, frame clock and the SDL audio callback.
+ */
+
+#pragma once
+
+#include "noise.h"
+
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <cstdint>
+
+// Audio parameters
+constexpr int SAMPLE_RATE = 44100;           // Standard audio sample rate
+constexpr int TONE_FREQUENCY = 1000;         // 1kHz pure tone
+constexpr double TONE_DURATION_MS = 1.0;     // 1ms tone duration
+constexpr double STIMULUS_INTERVAL_MS = 25.0; // 25ms interval (40Hz)
+constexpr double AMPLITUDE = 0.5;            // Volume (0.0 - 1.0)
+
+// Derived constants
+constexpr int SAMPLES_PER_TONE = static_cast<int>(SAMPLE_RATE * TONE_DURATION_MS / 1000.0);
+constexpr int SAMPLES_PER_INTERVAL = static_cast<int>(SAMPLE_RATE * STIMULUS_INTERVAL_MS / 1000.0);
+
+// Sync-trigger marker: a square pulse covering the tone, one low guard
+// cell, then the onset counter (grid pulse number) LSB first,
+// one cell per bit, high = 1. 24 bits wrap after 116 hours at 40Hz.
+constexpr int MAX_OUTPUT_CHANNELS = 8;
+constexpr float TRIGGER_LEVEL = 1.0f;
+constexpr int TRIGGER_PULSE_FRAMES = SAMPLES_PER_TONE;
+constexpr int TRIGGER_BIT_FRAMES = 8;
+constexpr int TRIGGER_COUNTER_BITS = 24;
+constexpr int TRIGGER_COUNTER_START = TRIGGER_PULSE_FRAMES + TRIGGER_BIT_FRAMES;
+constexpr int TRIGGER_SPAN_FRAMES = TRIGGER_COUNTER_START + TRIGGER_COUNTER_BITS * TRIGGER_BIT_FRAMES;
+static_assert(TRIGGER_SPAN_FRAMES < SAMPLES_PER_INTERVAL / 2, "trigger burst must leave a long low gap");
+
+// Closed-loop scheduling never packs onsets closer than this (80Hz)
+constexpr int MIN_ONSET_SPACING_FRAMES = SAMPLES_PER_INTERVAL / 2;
+constexpr int ONSET_HISTORY = 16;
+
+// Global state
+extern std::atomic<bool> g_isPlaying;
+extern std::atomic<int64_t> g_samplePosition;  // Engine frame clock (next frame to render)
+extern std::atomic<bool> g_continuousTone;     // For testing: continuous 1kHz tone
+
+// Callback heartbeat (relaxed stores only, read by the watchdog)
+extern std::atomic<uint64_t> g_callbackCount;
+extern std::atomic<int64_t> g_lastCallbackNs;
+
+// Host time the first non-silent block was handed to the device (0 = not yet)
+extern std::atomic<int64_t> g_firstNonZeroNs;
+
+/**
+ * Onset grid: pulse `index` sits at frame `base` and pulses repeat every
+ * SAMPLES_PER_INTERVAL frames from there. The default grid puts pulse n at
+ * frame n * SAMPLES_PER_INTERVAL; closed-loop stimulation moves it one
+ * onset at a time through scheduleOnset().
+ */
+struct PulseGrid {
+    int64_t base = 0;
+    int64_t index = 0;
+
+    int intervalPos(int64_t frame) const {
+        int64_t r = (frame - base) % SAMPLES_PER_INTERVAL;
+        return static_cast<int>(r < 0 ? r + SAMPLES_PER_INTERVAL : r);
+    }
+
+    int64_t pulseIndex(int64_t frame) const {
+        return index + (frame - base - intervalPos(frame)) / SAMPLES_PER_INTERVAL;
+    }
+};
+
+struct OnsetScheduleStats {
+    uint64_t applied = 0;
+    uint64_t late = 0;          // Target already rendered when reached
+    uint64_t tooClose = 0;      // Under MIN_ONSET_SPACING_FRAMES after the last onset
+};
+
+/**
+ * Host monotonic time in nanoseconds (steady_clock epoch)
+ */
+int64_t hostTimeNs();
+
+/**
+ * Start frame and callback host time of the latest block, read
+ * consistently (seqlock). Returns false before the first callback.
+ */
+bool frameClockAnchor(int64_t& frame, int64_t& hostNs);
+
+/**
+ * Grid in effect for the latest block (any thread)
+ */
+PulseGrid pulseGrid();
+
+/**
+ * Ask for the next onset at engine frame `frame` (any thread except the
+ * audio thread). The audio thread moves the grid at the first block start
+ * where that cuts into no pulse already playing; a newer request replaces
+ * one not yet applied.
+ */
+void scheduleOnset(int64_t frame);
+OnsetScheduleStats onsetScheduleStats();
+
+/**
+ * Start playback so the first onset falls exactly on engine frame `frame`
+ * as pulse 0 of a fresh grid (any thread except the audio thread), for
+ * starts agreed with other stations. Takes effect while paused; frames
+ * before the onset stay silent. If `frame` has already been rendered,
+ * playback joins that grid at its next pulse. A newer request replaces
+ * one not yet reached.
+ */
+void startPlaybackAt(int64_t frame);
+
+/**
+ * Triggered mode: no free-running pulse train. Each fireOnset() puts one
+ * pulse (tone and sync marker) at the start of the next block the audio
+ * thread renders, the earliest frame not yet handed to the device.
+ * Requests arriving together make one pulse; one under
+ * MIN_ONSET_SPACING_FRAMES after the previous pulse is dropped and
+ * counted. Set before the device starts.
+ */
+void setTriggeredMode(bool on);
+
+/**
+ * Request a triggered pulse (any thread except the audio thread; wait-free)
+ */
+void fireOnset();
+uint64_t triggeredTooClose();
+
+/**
+ * The last `max` (<= ONSET_HISTORY) onsets delivered to the device, oldest
+ * first (any thread). Returns the number written.
+ */
+int recentOnsets(int64_t* frames, int max);
+
+/**
+ * Device timing for the audible-frame mapping: the opened rate and the
+ * frames between a block being rendered and being heard (one device
+ * buffer). Set on every device start.
+ */
+void setOutputTiming(int sampleRate, int latencyFrames);
+int64_t outputLatencyNs();
+
+/**
+ * Engine frame being heard at host time `hostNs`: the latest block anchor
+ * on the drift-fitted line (nominal rate until it converges), shifted by
+ * the output latency. Fractional so a UI can place it between frames.
+ * Returns false before the first callback. Not for the audio thread.
+ */
+bool audibleFrameAt(int64_t hostNs, double& frame);
+
+/**
+ * Host time at which `frame` is heard (inverse of audibleFrameAt)
+ */
+bool audibleHostNs(int64_t frame, int64_t& hostNs);
+
+/**
+ * Precompute the enveloped tone burst and the continuous-tone cycle.
+ * Must be called once before the first block is rendered.
+ */
+void buildRenderTables();
+
+/**
+ * The enveloped tone burst every pulse starts with (SAMPLES_PER_TONE
+ * samples). Valid after buildRenderTables().
+ */
+const float* toneTemplate();
+
+/**
+ * Generate a single sample of the 40Hz stimulus pattern
+ */
+float generateSample(int64_t position);
+
+/**
+ * Render `frames` mono samples starting at frame `startFrame`.
+ * The output is a pure function of the frame index, the mode and the grid.
+ */
+void renderBlock(float* out, int64_t startFrame, int frames);
+
+/**
+ * Noise in the synthesized stimulus: NOISE_MASK adds it under the pulse
+ * train, NOISE_SHAM plays it in place of the pulses (the grid, the sync
+ * marker and the onset taps carry on as usual) for sham sessions. Frame n
+ * of the noise depends only on the config and n, so offline renders stay
+ * reproducible. Not applied to the continuous test tone or to a
+ * StimulusSource. Only valid before the audio device is started.
+ */
+enum NoiseMode {
+    NOISE_OFF = 0,
+    NOISE_MASK = 1,
+    NOISE_SHAM = 2,
+};
+
+void setStimulusNoise(NoiseMode mode, const NoiseConfig& config);
+
+/**
+ * Interleaved device layout. The stimulus goes to every channel except
+ * `triggerChannel` (0-based, -1 = none), which carries the sync marker.
+ * Only valid before the audio device is opened.
+ */
+bool setOutputLayout(int channels, int triggerChannel);
+int outputChannels();
+int triggerChannel();
+
+/**
+ * Write the sync-trigger marker for `frames` frames into every `stride`-th
+ * float of `out`. Frames outside a marker burst are left untouched.
+ */
+void renderTriggerBlock(float* out, int stride, int64_t startFrame, int frames);
+
+/**
+ * Render `frames` interleaved frames in the current output layout: the
+ * stimulus and the trigger channel come out of the same pass, so the
+ * marker is sample-aligned with each onset.
+ */
+void renderOutputBlock(float* out, int64_t startFrame, int frames);
+
+/**
+ * Pre-rendered stimulus played in place of the synthesized pulse train.
+ * `read` writes `frames` interleaved frames in the output layout from
+ * stimulus frame `frame` on, and runs on the audio thread (same rules as
+ * BlockTap). Pulse 0 sits at stimulus frame `firstOnset` and pulses
+ * repeat every SAMPLES_PER_INTERVAL; with `marker` the engine draws the
+ * sync marker on the trigger channel at those pulses. While paused the
+ * stimulus holds its place and resumes from it.
+ */
+struct StimulusSource {
+    void (*read)(float* out, int64_t frame, int frames) = nullptr;
+    int64_t frames = 0;
+    int64_t firstOnset = 0;
+    bool marker = true;
+};
+
+/**
+ * Play `source` (or synthesize again with a default StimulusSource).
+ * Only valid before the audio device is started.
+ */
+void setStimulusSource(const StimulusSource& source);
+
+/**
+ * Stimulus frames played so far (any thread). The source has ended when
+ * this reaches its length.
+ */
+int64_t stimulusPosition();
+
+/**
+ * Observer for every block written to the device (interleaved frames in
+ * the output layout). Taps run on the audio thread, so they must be
+ * wait-free and must not make syscalls.
+ */
+using BlockTap = void (*)(const float* block, int frames, int64_t startFrame, int64_t hostNs);
+
+/**
+ * Register a tap. Only valid before the audio device is started.
+ */
+bool addBlockTap(BlockTap tap);
+
+/**
+ * Stage that adds into every block (interleaved, output layout) after the
+ * stimulus is rendered and before the taps see it, whether or not the
+ * stimulus is playing: background maskers. `pulses` is set when the block
+ * carries the pulse train (playing, pulsed, not a sham session); the
+ * stimulus level is no guide to that once masking noise is mixed in.
+ * Same rules as BlockTap.
+ */
+using MixStage = void (*)(float* block, int frames, int64_t startFrame, bool pulses);
+
+/**
+ * Whether any of `frames` frames from `startFrame` falls in a pulse's tone
+ * on the current grid. Audio thread only (mix stages).
+ */
+bool pulseToneIn(int64_t startFrame, int frames);
+
+/**
+ * Register a mix stage. Only valid before the audio device is started.
+ */
+bool addMixStage(MixStage stage);
+
+/**
+ * Observer for every pulse onset delivered to the device: the engine frame
+ * of the onset, its host time (callback time plus the onset's offset into
+ * the block) and its pulse number on the grid. The pulse train is one
+ * and the same on every stimulus channel, so an onset has no channel.
+ * Same rules as BlockTap.
+ */
+using OnsetTap = void (*)(int64_t frame, int64_t hostNs, int64_t pulse);
+
+/**
+ * Register an onset tap. Only valid before the audio device is started.
+ */
+bool addOnsetTap(OnsetTap tap);
+
+/**
+ * SDL audio callback function
+ */
+void audioCallback(void* userdata, Uint8* stream, int len);
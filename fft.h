@@ -0,0 +1,39 @@
+/**
+ * In-place radix-2 FFT shared by the analysis threads. The size must be a
+ * power of two; the inverse transform is scaled by 1/n.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <complex>
+#include <utility>
+#include <vector>
+
+inline void fft(std::vector<std::complex<double>>& a, bool inverse) {
+    using Complex = std::complex<double>;
+    size_t n = a.size();
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(a[i], a[j]);
+    }
+    for (size_t len = 2; len <= n; len <<= 1) {
+        double angle = 2.0 * M_PI / len * (inverse ? 1.0 : -1.0);
+        Complex step(std::cos(angle), std::sin(angle));
+        for (size_t i = 0; i < n; i += len) {
+            Complex w(1.0);
+            for (size_t k = 0; k < len / 2; ++k) {
+                Complex u = a[i + k];
+                Complex v = a[i + k + len / 2] * w;
+                a[i + k] = u + v;
+                a[i + k + len / 2] = u - v;
+                w *= step;
+            }
+        }
+    }
+    if (inverse) {
+        for (Complex& x : a) x /= static_cast<double>(n);
+    }
+}
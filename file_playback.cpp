@@ -0,0 +1,636 @@
+#include "file_playback.h"
+#include "bench.h"
+#include "engine.h"
+#include "resampler.h"
+#include "wav_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr int64_t TOUCH_CHUNK = 1 << 20;            // Bytes faulted in per step
+constexpr double BEHIND_SECONDS = 2.0;              // Kept mapped after the cursor passes
+constexpr auto TOUCH_INTERVAL = std::chrono::milliseconds(10);
+
+constexpr int RESAMPLE_PULL = 1024;                // Output frames converted per step
+
+constexpr int CHECK_BLOCK_FRAMES = 512;
+constexpr double CHECK_SPEED = 16.0;                // Times real time
+constexpr double CHECK_PAUSE_SECONDS = 2.0;
+
+// Sample decoders, one per file format
+struct Pcm16 {
+    static constexpr int BYTES = 2;
+    static float get(const uint8_t* p) {
+        int16_t v;
+        std::memcpy(&v, p, 2);
+        return v * (1.0f / 32768.0f);
+    }
+};
+
+struct Pcm24 {
+    static constexpr int BYTES = 3;
+    static float get(const uint8_t* p) {
+        int32_t v = static_cast<int32_t>(static_cast<uint32_t>(p[0]) << 8 | static_cast<uint32_t>(p[1]) << 16 |
+                                         static_cast<uint32_t>(p[2]) << 24) >> 8;
+        return v * (1.0f / 8388608.0f);
+    }
+};
+
+struct Pcm32 {
+    static constexpr int BYTES = 4;
+    static float get(const uint8_t* p) {
+        int32_t v;
+        std::memcpy(&v, p, 4);
+        return static_cast<float>(v * (1.0 / 2147483648.0));
+    }
+};
+
+struct Float32 {
+    static constexpr int BYTES = 4;
+    static float get(const uint8_t* p) {
+        float v;
+        std::memcpy(&v, p, 4);
+        return v;
+    }
+};
+
+struct Float64 {
+    static constexpr int BYTES = 8;
+    static float get(const uint8_t* p) {
+        double v;
+        std::memcpy(&v, p, 8);
+        return static_cast<float>(v);
+    }
+};
+
+FilePlaybackConfig g_config;
+WavInfo g_info;
+uint8_t* g_map = nullptr;           // Whole file, read-only
+size_t g_mapBytes = 0;
+const uint8_t* g_data = nullptr;    // First sample
+int64_t g_frameBytes = 0;
+int g_outChannels = 1;
+int g_channelMap[MAX_OUTPUT_CHANNELS];  // File channel per output channel, -1 = silent
+size_t g_pageBytes = 4096;
+int64_t g_stimulusFrames = 0;       // Length at SAMPLE_RATE
+int64_t g_firstOnset = 0;           // Pulse 0, at SAMPLE_RATE
+
+// Conversion of files at other rates, on the audio thread
+bool g_resample = false;
+Resampler g_resampler;
+void (*g_decode)(float*, int64_t, int) = nullptr;
+std::vector<float> g_decoded;       // File frames, all file channels
+std::vector<float> g_converted;     // Converted frames, all file channels
+
+// Pre-toucher
+std::thread g_toucher;
+std::atomic<bool> g_running{false};
+int64_t g_touched = 0;              // Mapping bytes below this have been faulted in
+int64_t g_released = 0;             // Mapping bytes below this have been let go
+bool g_locked = false;              // Resident window is mlock()ed
+std::atomic<uint64_t> g_behind{0};  // Times the cursor had passed the resident window
+std::atomic<int64_t> g_minAhead{-1};  // Least resident lead seen (bytes)
+
+/**
+ * Engine stimulus source: convert frames out of the mapping into the
+ * output layout
+ */
+template <typename Format>
+void readFrames(float* out, int64_t frame, int frames) {
+    const uint8_t* p = g_data + frame * g_frameBytes;
+    for (int i = 0; i < frames; ++i, p += g_frameBytes) {
+        for (int c = 0; c < g_outChannels; ++c) {
+            int src = g_channelMap[c];
+            *out++ = src < 0 ? 0.0f : Format::get(p + src * Format::BYTES);
+        }
+    }
+}
+
+/**
+ * Decode frames with all the file's channels interleaved, silence outside
+ * the file (resampler input)
+ */
+template <typename Format>
+void decodeFrames(float* out, int64_t frame, int frames) {
+    for (int i = 0; i < frames; ++i, ++frame) {
+        if (frame < 0 || frame >= g_info.frames) {
+            for (int c = 0; c < g_info.channels; ++c) *out++ = 0.0f;
+            continue;
+        }
+        const uint8_t* p = g_data + frame * g_frameBytes;
+        for (int c = 0; c < g_info.channels; ++c) *out++ = Format::get(p + c * Format::BYTES);
+    }
+}
+
+using ReadFn = void (*)(float*, int64_t, int);
+
+template <typename Format>
+ReadFn pick(bool decode) {
+    return decode ? decodeFrames<Format> : readFrames<Format>;
+}
+
+/**
+ * Routing reader for the format, or with `decode` the resampler's decoder
+ */
+ReadFn readerFor(const WavInfo& info, bool decode) {
+    if (info.isFloat) {
+        if (info.bitsPerSample == 32) return pick<Float32>(decode);
+        if (info.bitsPerSample == 64) return pick<Float64>(decode);
+        return nullptr;
+    }
+    switch (info.bitsPerSample) {
+        case 16: return pick<Pcm16>(decode);
+        case 24: return pick<Pcm24>(decode);
+        case 32: return pick<Pcm32>(decode);
+        default: return nullptr;
+    }
+}
+
+/**
+ * Engine stimulus source for a file at another rate: decode into the
+ * resampler as it asks, convert, then route. A jump of the cursor
+ * restarts the converter at the new position.
+ */
+void readResampled(float* out, int64_t frame, int frames) {
+    if (frame != g_resampler.position()) g_resampler.reset(frame);
+    int fileChannels = g_info.channels;
+    int capacity = static_cast<int>(g_decoded.size()) / fileChannels;
+    while (frames > 0) {
+        int n = std::min(frames, RESAMPLE_PULL);
+        for (int need = g_resampler.needed(n); need > 0;) {
+            int count = std::min(need, capacity);
+            g_decode(g_decoded.data(), g_resampler.nextInput(), count);
+            g_resampler.push(g_decoded.data(), count);
+            need -= count;
+        }
+        n = g_resampler.pull(g_converted.data(), n);
+        for (int i = 0; i < n; ++i) {
+            const float* in = g_converted.data() + static_cast<size_t>(i) * fileChannels;
+            for (int c = 0; c < g_outChannels; ++c) {
+                int src = g_channelMap[c];
+                *out++ = src < 0 ? 0.0f : in[src];
+            }
+        }
+        frames -= n;
+    }
+}
+
+/**
+ * File frame under engine frame `frame`
+ */
+int64_t fileFrame(int64_t frame) {
+    return g_resample ? frame * g_info.sampleRate / SAMPLE_RATE : frame;
+}
+
+/**
+ * One sample, decoded without the templates (check reference)
+ */
+float decodeSample(const uint8_t* p, const WavInfo& info) {
+    if (info.isFloat) return info.bitsPerSample == 32 ? Float32::get(p) : Float64::get(p);
+    if (info.bitsPerSample == 16) return Pcm16::get(p);
+    if (info.bitsPerSample == 24) return Pcm24::get(p);
+    return Pcm32::get(p);
+}
+
+std::string formatName(const WavInfo& info) {
+    return std::to_string(info.bitsPerSample) + (info.isFloat ? "-bit float" : "-bit PCM");
+}
+
+/**
+ * Route file channels to the output layout. Returns false if the
+ * channel counts do not fit together.
+ */
+bool mapChannels(int fileChannels, StimulusSource& source) {
+    if (fileChannels > 1 && outputChannels() == 1) {
+        if (fileChannels > MAX_OUTPUT_CHANNELS) return false;
+        setOutputLayout(fileChannels, -1);
+    }
+    int channels = outputChannels();
+    int trigger = triggerChannel();
+    g_outChannels = channels;
+
+    if (fileChannels == 1) {
+        for (int c = 0; c < channels; ++c) g_channelMap[c] = c == trigger ? -1 : 0;
+        source.marker = true;
+    } else if (fileChannels == channels) {
+        for (int c = 0; c < channels; ++c) g_channelMap[c] = c;
+        source.marker = false;
+    } else if (trigger >= 0 && fileChannels == channels - 1) {
+        for (int c = 0, src = 0; c < channels; ++c) g_channelMap[c] = c == trigger ? -1 : src++;
+        source.marker = true;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int64_t pageDown(int64_t bytes) {
+    return bytes / static_cast<int64_t>(g_pageBytes) * static_cast<int64_t>(g_pageBytes);
+}
+
+/**
+ * Fault in (and lock) the mapping up to byte `target`, a chunk at a time,
+ * asking the kernel to read the following chunk while this one is touched
+ */
+void advanceTo(int64_t target) {
+    target = std::min<int64_t>(target, g_mapBytes);
+    while (g_touched < target && g_running.load(std::memory_order_relaxed)) {
+        int64_t to = std::min<int64_t>(g_touched + TOUCH_CHUNK, g_mapBytes);
+        if (to < static_cast<int64_t>(g_mapBytes)) {
+            madvise(g_map + to, std::min<int64_t>(TOUCH_CHUNK, g_mapBytes - to), MADV_WILLNEED);
+        }
+        if (g_locked && mlock(g_map + g_touched, to - g_touched) != 0) {
+            munlock(g_map, g_mapBytes);
+            g_locked = false;
+        }
+        volatile uint8_t sink = 0;
+        for (int64_t off = g_touched; off < to; off += g_pageBytes) sink = sink + g_map[off];
+        g_touched = to;
+    }
+}
+
+void releaseTo(int64_t target) {
+    target = pageDown(target);
+    if (target <= g_released) return;
+    if (g_locked) munlock(g_map + g_released, target - g_released);
+    madvise(g_map + g_released, target - g_released, MADV_DONTNEED);
+    g_released = target;
+}
+
+void touchLoop() {
+    int64_t aheadBytes = static_cast<int64_t>(g_config.aheadSeconds * g_info.sampleRate) * g_frameBytes;
+    int64_t behindBytes = static_cast<int64_t>(BEHIND_SECONDS * g_info.sampleRate) * g_frameBytes;
+    while (g_running.load()) {
+        int64_t cursor = g_info.dataOffset + fileFrame(stimulusPosition()) * g_frameBytes;
+        if (cursor > g_touched && g_touched < static_cast<int64_t>(g_mapBytes)) {
+            g_behind.fetch_add(1, std::memory_order_relaxed);
+            g_touched = pageDown(cursor);
+        }
+        if (g_touched < static_cast<int64_t>(g_mapBytes)) {
+            int64_t ahead = g_touched - cursor;
+            int64_t least = g_minAhead.load(std::memory_order_relaxed);
+            if (least < 0 || ahead < least) g_minAhead.store(ahead, std::memory_order_relaxed);
+        }
+        advanceTo(cursor + aheadBytes);
+        releaseTo(cursor - behindBytes);
+        std::this_thread::sleep_for(TOUCH_INTERVAL);
+    }
+}
+
+void unmapFile() {
+    if (g_map) munmap(g_map, g_mapBytes);
+    g_map = nullptr;
+    g_data = nullptr;
+}
+
+// Check state, written by the driver and read by the onset tap on the same thread
+int64_t g_checkOffset = 0;          // Engine frame minus stimulus frame in the current block
+int64_t g_checkNextPulse = 0;
+uint64_t g_checkOnsets = 0;
+uint64_t g_checkMisplaced = 0;
+
+void checkOnsetTap(int64_t frame, int64_t /*hostNs*/, int64_t pulse) {
+    int64_t stimulusFrame = frame - g_checkOffset;
+    if (pulse != g_checkNextPulse || stimulusFrame != g_firstOnset + pulse * SAMPLES_PER_INTERVAL) {
+        ++g_checkMisplaced;
+    }
+    g_checkNextPulse = pulse + 1;
+    ++g_checkOnsets;
+}
+
+uint64_t hashFloats(uint64_t h, const float* p, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t bits;
+        std::memcpy(&bits, p + i, 4);
+        h = (h ^ bits) * 1099511628211ULL;
+    }
+    return h;
+}
+
+struct CheckBlock {
+    int64_t frame;                  // First stimulus frame played, -1 = paused
+    int frames;                     // Stimulus frames played
+    uint64_t hash;                  // Of the file's channels in the output
+};
+
+long majorFaults() {
+    struct rusage usage;
+#ifdef RUSAGE_THREAD
+    getrusage(RUSAGE_THREAD, &usage);
+#else
+    getrusage(RUSAGE_SELF, &usage);
+#endif
+    return usage.ru_majflt;
+}
+
+/**
+ * Drop the file from the page cache, so playback starts from the disk
+ */
+void evictFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    fsync(fd);
+#ifdef POSIX_FADV_DONTNEED
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    close(fd);
+}
+
+/**
+ * Play the installed file through the audio callback at CHECK_SPEED,
+ * pausing for CHECK_PAUSE_SECONDS a third of the way in. Returns the
+ * major faults taken meanwhile; fills `blocks` and `silentOk` when asked.
+ */
+long playThrough(std::vector<CheckBlock>* blocks, bool& silentOk, double& maxCallbackMs) {
+    int channels = outputChannels();
+    int64_t pauseAt = g_stimulusFrames / 3;
+    int pauseBlocks = static_cast<int>(CHECK_PAUSE_SECONDS * SAMPLE_RATE / CHECK_BLOCK_FRAMES);
+    silentOk = true;
+
+    long faults = majorFaults();
+    CallbackPacer pacer(CHECK_BLOCK_FRAMES, CHECK_SPEED);
+    while (stimulusPosition() < g_stimulusFrames) {
+        int64_t cursor = stimulusPosition();
+        if (pauseBlocks > 0 && cursor >= pauseAt) {
+            g_isPlaying.store(false);
+            --pauseBlocks;
+        } else {
+            g_isPlaying.store(true);
+        }
+        g_checkOffset = g_samplePosition.load() - cursor;
+
+        const float* buffer = pacer.render();
+
+        // Unplayed frames (paused, past the end) must be silent on every channel
+        int played = static_cast<int>(stimulusPosition() - cursor);
+        if (std::any_of(buffer + static_cast<size_t>(played) * channels,
+                        buffer + static_cast<size_t>(CHECK_BLOCK_FRAMES) * channels, [](float s) { return s != 0.0f; })) {
+            silentOk = false;
+        }
+        if (blocks) {
+            uint64_t hash = 14695981039346656037ULL;
+            for (int i = 0; i < played; ++i) {
+                for (int c = 0; c < channels; ++c) {
+                    if (g_channelMap[c] >= 0) hash = hashFloats(hash, &buffer[static_cast<size_t>(i) * channels + c], 1);
+                }
+            }
+            blocks->push_back(CheckBlock{played > 0 ? cursor : -1, played, hash});
+        }
+        pacer.wait();
+    }
+    g_isPlaying.store(true);
+    maxCallbackMs = pacer.maxCallbackMs();
+    return majorFaults() - faults;
+}
+
+/**
+ * Decode `frames` file frames from `frame` on with pread(), all channels
+ * interleaved and silence outside the file
+ */
+bool preadFrames(int fd, int64_t frame, int frames, std::vector<float>& out) {
+    out.assign(static_cast<size_t>(frames) * g_info.channels, 0.0f);
+    int64_t from = std::max<int64_t>(frame, 0);
+    int64_t to = std::min<int64_t>(frame + frames, g_info.frames);
+    if (from >= to) return true;
+    std::vector<uint8_t> raw(static_cast<size_t>(to - from) * g_frameBytes);
+    if (pread(fd, raw.data(), raw.size(), g_info.dataOffset + from * g_frameBytes) != static_cast<ssize_t>(raw.size())) {
+        return false;
+    }
+    int bytes = g_info.bitsPerSample / 8;
+    for (size_t i = 0; i < raw.size() / bytes; ++i) {
+        out[static_cast<size_t>(from - frame) * g_info.channels + i] = decodeSample(raw.data() + i * bytes, g_info);
+    }
+    return true;
+}
+
+/**
+ * Decode the played blocks again with pread() (through a converter of its
+ * own for a file at another rate) and compare hashes
+ */
+int64_t verifyBlocks(const std::string& path, const std::vector<CheckBlock>& blocks) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return -1;
+    Resampler reference;
+    if (g_resample) reference.init(g_info.sampleRate, SAMPLE_RATE, g_info.channels, CHECK_BLOCK_FRAMES);
+    std::vector<float> in, frames(static_cast<size_t>(CHECK_BLOCK_FRAMES) * g_info.channels);
+    int64_t verified = 0;
+    for (const CheckBlock& block : blocks) {
+        if (block.frame < 0) continue;
+        const float* samples = frames.data();
+        if (g_resample) {
+            if (block.frame != reference.position()) reference.reset(block.frame);
+            int need = reference.needed(block.frames);
+            if (!preadFrames(fd, reference.nextInput(), need, in)) break;
+            reference.push(in.data(), need);
+            reference.pull(frames.data(), block.frames);
+        } else {
+            if (!preadFrames(fd, block.frame, block.frames, in)) break;
+            samples = in.data();
+        }
+        uint64_t hash = 14695981039346656037ULL;
+        for (int i = 0; i < block.frames; ++i) {
+            for (int c = 0; c < g_outChannels; ++c) {
+                if (g_channelMap[c] < 0) continue;
+                hash = hashFloats(hash, &samples[static_cast<size_t>(i) * g_info.channels + g_channelMap[c]], 1);
+            }
+        }
+        if (hash != block.hash) break;
+        verified += block.frames;
+    }
+    close(fd);
+    return verified;
+}
+
+} // namespace
+
+bool startFilePlayback(const FilePlaybackConfig& config) {
+    WavInfo info;
+    if (!readWavInfo(config.path, info) || info.bitsPerSample == 0) {
+        std::cerr << "Cannot read " << config.path << " as WAV, RF64 or Wave64" << std::endl;
+        return false;
+    }
+    bool resample = info.sampleRate != SAMPLE_RATE;
+    ReadFn read = readerFor(info, resample);
+    if (!read) {
+        std::cerr << config.path << ": " << formatName(info) << " samples are not supported" << std::endl;
+        return false;
+    }
+    if (resample && !g_resampler.init(static_cast<int>(info.sampleRate), SAMPLE_RATE, info.channels, RESAMPLE_PULL)) {
+        std::cerr << config.path << " is at " << info.sampleRate << " Hz, which cannot be converted" << std::endl;
+        return false;
+    }
+    if (info.frames == 0) {
+        std::cerr << config.path << " holds no samples" << std::endl;
+        return false;
+    }
+    StimulusSource source;
+    if (!mapChannels(info.channels, source)) {
+        std::cerr << config.path << " has " << info.channels << " channels, which do not fit "
+                  << outputChannels() << " output channels" << std::endl;
+        return false;
+    }
+
+    int fd = open(config.path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Cannot open " << config.path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    g_frameBytes = static_cast<int64_t>(info.channels) * info.bitsPerSample / 8;
+    g_mapBytes = static_cast<size_t>(info.dataOffset + info.frames * g_frameBytes);
+    void* map = mmap(nullptr, g_mapBytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        std::cerr << "Cannot map " << config.path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    g_map = static_cast<uint8_t*>(map);
+    g_data = g_map + info.dataOffset;
+    g_info = info;
+    g_config = config;
+    g_pageBytes = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    madvise(g_map, g_mapBytes, MADV_SEQUENTIAL);
+
+    // Lock the resident window too if it fits under the memlock limit
+    int64_t windowBytes = static_cast<int64_t>((config.aheadSeconds + BEHIND_SECONDS) * info.sampleRate) * g_frameBytes +
+                          2 * TOUCH_CHUNK;
+    struct rlimit limit;
+    g_locked = config.aheadSeconds > 0.0 && getrlimit(RLIMIT_MEMLOCK, &limit) == 0 &&
+               (limit.rlim_cur == RLIM_INFINITY || static_cast<int64_t>(limit.rlim_cur) >= windowBytes);
+    g_touched = 0;
+    g_released = 0;
+    g_behind.store(0);
+    g_minAhead.store(-1);
+
+    // The first window is resident before the device starts
+    g_running.store(true);
+    if (config.aheadSeconds > 0.0) {
+        advanceTo(info.dataOffset + static_cast<int64_t>(config.aheadSeconds * info.sampleRate) * g_frameBytes);
+        g_toucher = std::thread(touchLoop);
+    }
+
+    // Stimulus frames are at SAMPLE_RATE; a converted file's onset is rounded onto that clock
+    g_resample = resample;
+    g_stimulusFrames = info.frames;
+    g_firstOnset = config.firstOnset;
+    if (resample) {
+        g_decode = read;
+        g_decoded.assign(static_cast<size_t>(g_resampler.needed(RESAMPLE_PULL)) * info.channels, 0.0f);
+        g_converted.assign(static_cast<size_t>(RESAMPLE_PULL) * info.channels, 0.0f);
+        g_stimulusFrames = info.frames * SAMPLE_RATE / info.sampleRate;
+        g_firstOnset = std::llround(static_cast<double>(config.firstOnset) * SAMPLE_RATE / info.sampleRate);
+        g_resampler.reset();
+        read = readResampled;
+    }
+    source.read = read;
+    source.frames = g_stimulusFrames;
+    source.firstOnset = g_firstOnset;
+    setStimulusSource(source);
+
+    std::cout << "Playing " << config.path << ": " << std::fixed << std::setprecision(1)
+              << info.frames / static_cast<double>(info.sampleRate) / 60.0 << " min, " << info.channels << " ch "
+              << formatName(info) << ", " << wavContainerName(info.container) << std::defaultfloat
+              << ", pulse 0 at file frame " << config.firstOnset
+              << (source.marker && triggerChannel() >= 0 ? ", sync marker added" : "");
+    if (resample) {
+        std::cout << ", resampled from " << info.sampleRate << " Hz (" << g_resampler.taps() << " taps, "
+                  << g_resampler.kernelName() << ")";
+    }
+    std::cout << "\n";
+    return true;
+}
+
+void stopFilePlayback() {
+    if (!g_map) return;
+    g_running.store(false);
+    if (g_toucher.joinable()) g_toucher.join();
+    if (g_locked) munlock(g_map, g_mapBytes);
+    int64_t played = stimulusPosition();
+    setStimulusSource(StimulusSource());
+    unmapFile();
+
+    std::cout << "Stimulus file " << g_config.path << ": played " << std::fixed << std::setprecision(1)
+              << played / static_cast<double>(SAMPLE_RATE) / 60.0 << " of "
+              << g_stimulusFrames / static_cast<double>(SAMPLE_RATE) / 60.0 << " min";
+    if (g_config.aheadSeconds > 0.0) {
+        int64_t least = g_minAhead.load();
+        std::cout << ", at least " << std::setprecision(2)
+                  << std::max<int64_t>(least, 0) / static_cast<double>(g_frameBytes * g_info.sampleRate)
+                  << " s resident ahead" << (g_locked ? " (locked)" : "") << ", fell behind "
+                  << g_behind.load() << " times";
+    }
+    std::cout << std::defaultfloat << "\n";
+}
+
+bool filePlaybackFinished() {
+    return g_map && stimulusPosition() >= g_stimulusFrames;
+}
+
+int runFilePlaybackCheck(const FilePlaybackConfig& config) {
+    buildRenderTables();
+    if (!addOnsetTap(checkOnsetTap)) return 1;
+    int64_t pulses = 0;
+
+    // Cold, without the pre-toucher: what the callback would face alone
+    FilePlaybackConfig bare = config;
+    bare.aheadSeconds = 0.0;
+    evictFile(config.path);
+    if (!startFilePlayback(bare)) return 1;
+    bool silentBare;
+    double maxBareMs;
+    long bareFaults = playThrough(nullptr, silentBare, maxBareMs);
+    stopFilePlayback();
+
+    // Cold, with it
+    evictFile(config.path);
+    g_checkOnsets = 0;
+    g_checkMisplaced = 0;
+    g_checkNextPulse = 0;
+    if (!startFilePlayback(config)) return 1;
+    std::vector<CheckBlock> blocks;
+    bool silentOk;
+    double maxMs;
+    long faults = playThrough(&blocks, silentOk, maxMs);
+    int64_t frames = g_stimulusFrames;
+    stopFilePlayback();
+
+    // The channel routing outlives the mapping, for the reference decode
+    int64_t verified = verifyBlocks(config.path, blocks);
+    if (frames > g_firstOnset) {
+        pulses = (frames - g_firstOnset - 1) / SAMPLES_PER_INTERVAL + 1;
+    }
+
+    bool samplesOk = verified == frames && silentOk;
+    bool onsetsOk = static_cast<int64_t>(g_checkOnsets) == pulses && g_checkMisplaced == 0;
+    bool faultsOk = faults == 0;
+    double budgetMs = 1000.0 * CHECK_BLOCK_FRAMES / SAMPLE_RATE;
+
+    std::cout << "Playback check: " << CHECK_SPEED << "x real time, " << CHECK_BLOCK_FRAMES
+              << "-frame callbacks, file evicted from the page cache first\n" << std::fixed << std::setprecision(1)
+              << "  samples      " << verified / static_cast<double>(SAMPLE_RATE) << " of "
+              << frames / static_cast<double>(SAMPLE_RATE) << " s as in the file"
+              << (g_resample ? " (converted from " + std::to_string(g_info.sampleRate) + " Hz)" : "") << ", "
+              << CHECK_PAUSE_SECONDS << " s pause " << (silentOk ? "silent" : "NOT silent")
+              << "  " << verdict(samplesOk) << "\n"
+              << "  onsets       " << g_checkOnsets << " of " << pulses << " on the file's pulse grid, "
+              << g_checkMisplaced << " misplaced  " << verdict(onsetsOk) << "\n"
+              << "  page faults  " << faults << " major in the callback thread (" << bareFaults
+              << " without the pre-toucher)  " << verdict(faultsOk) << "\n"
+              << std::setprecision(3) << "  callback     max " << maxMs << " ms (" << maxBareMs
+              << " ms without), budget " << budgetMs << " ms\n" << std::defaultfloat;
+    return samplesOk && onsetsOk && faultsOk ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+/**
+ * Playback of pre-rendered or external stimulus files: WAV, RF64 or
+ * Wave64 holding 16/24/32-bit PCM or 32/64-bit float, played exactly as
+ * given at SAMPLE_RATE.
+ *
+ * The file is mapped read-only and the audio callback converts frames
+ * straight out of the mapped pages into the output layout; nothing is
+ * loaded up front, so a multi-hour RF64 starts at once. The mapping is
+ * advised sequential, and a background thread faults in (and, where the
+ * memlock limit allows, locks) every page a few seconds ahead of the play
+ * cursor and lets go of pages well behind it, so the callback finds its
+ * samples resident and never waits on the disk.
+ *
+ * Onsets stay on the engine's pulse grid: the file's pulse 0 is at file
+ * frame `firstOnset` and pulses repeat every SAMPLES_PER_INTERVAL, so the
+ * onset log, LSL markers and the sync marker carry the frames at which
+ * the file's pulses are actually played. Pause holds the file where it
+ * is; resume continues from there.
+ *
+ * A file at another sample rate (48 or 96 kHz from a collaborator) is
+ * converted to SAMPLE_RATE on the audio thread by the polyphase
+ * Resampler, decoding only the frames it asks for; `firstOnset` is then
+ * rounded onto the SAMPLE_RATE clock.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+struct FilePlaybackConfig {
+    std::string path;
+    int64_t firstOnset = 0;     // File frame of pulse 0
+    double aheadSeconds = 4.0;  // Kept resident ahead of the play cursor
+};
+
+/**
+ * Map the file and install it as the engine's stimulus. Call after the
+ * output layout is set and before the audio device is started. A mono
+ * file goes to every stimulus channel; a file with one channel per output
+ * channel is played verbatim (its own trigger channel included); one with
+ * a channel per stimulus channel gets the engine's sync marker. A
+ * multichannel file on a mono layout opens its own channel count.
+ */
+bool startFilePlayback(const FilePlaybackConfig& config);
+
+/**
+ * Stop the pre-toucher, unmap and report. Only after the audio device is
+ * closed.
+ */
+void stopFilePlayback();
+
+/**
+ * True once every frame of the file has been played
+ */
+bool filePlaybackFinished();
+
+/**
+ * Headless check: play the whole file from a cold page cache, pausing
+ * once; every block against the file, every onset against its pulse
+ * grid, and major page faults in the callback thread
+ */
+int runFilePlaybackCheck(const FilePlaybackConfig& config);
@@ -0,0 +1,797 @@
+#include "flac_export.h"
+#include "bench.h"
+#include "async_writer.h"
+#include "engine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr int CHUNK_BLOCKS = 32;            // FLAC frames per worker task (~3 s)
+constexpr int WINDOW_PER_THREAD = 4;        // Encoded chunks waiting for the writer
+constexpr int MAX_PARTITION_ORDER = 8;      // Subset limit
+constexpr int MAX_FIXED_ORDER = 4;
+constexpr int MAX_RICE_PARAM = 14;          // 4-bit parameters; 15 is the escape code
+constexpr int STREAMINFO_BYTES = 4 + 4 + 34;
+constexpr int FLAC_DATA_ALIGN = 4096;       // Metadata padded so frames start on a page (O_DIRECT)
+
+struct CrcTables {
+    uint8_t crc8[256];
+    uint16_t crc16[256];
+
+    CrcTables() {
+        for (int i = 0; i < 256; ++i) {
+            uint8_t c8 = static_cast<uint8_t>(i);
+            uint16_t c16 = static_cast<uint16_t>(i << 8);
+            for (int b = 0; b < 8; ++b) {
+                c8 = static_cast<uint8_t>((c8 & 0x80) ? (c8 << 1) ^ 0x07 : c8 << 1);
+                c16 = static_cast<uint16_t>((c16 & 0x8000) ? (c16 << 1) ^ 0x8005 : c16 << 1);
+            }
+            crc8[i] = c8;
+            crc16[i] = c16;
+        }
+    }
+};
+
+const CrcTables g_crc;
+
+uint8_t crc8(const uint8_t* p, size_t n) {
+    uint8_t c = 0;
+    while (n--) c = g_crc.crc8[c ^ *p++];
+    return c;
+}
+
+uint16_t crc16(const uint8_t* p, size_t n) {
+    uint16_t c = 0;
+    while (n--) c = static_cast<uint16_t>((c << 8) ^ g_crc.crc16[(c >> 8) ^ *p++]);
+    return c;
+}
+
+int32_t quantize(float x, int bits) {
+    float scale = static_cast<float>((1 << (bits - 1)) - 1);
+    return static_cast<int32_t>(std::lrint(std::max(-1.0f, std::min(1.0f, x)) * scale));
+}
+
+/**
+ * Render `frames` interleaved frames from `startFrame` and round them to
+ * `bits`-bit integers
+ */
+void renderQuantized(std::vector<float>& scratch, std::vector<int32_t>& out, int64_t startFrame, int frames, int bits) {
+    size_t count = static_cast<size_t>(frames) * outputChannels();
+    scratch.resize(count);
+    out.resize(count);
+    renderOutputBlock(scratch.data(), startFrame, frames);
+    for (size_t i = 0; i < count; ++i) out[i] = quantize(scratch[i], bits);
+}
+
+uint32_t fold(int32_t r) {
+    return (static_cast<uint32_t>(r) << 1) ^ static_cast<uint32_t>(r >> 31);
+}
+
+// Bits of a folded value: the two's-complement width of the residual
+int foldedWidth(uint32_t u) {
+    return u ? 32 - __builtin_clz(u) : 0;
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    void write(uint32_t value, int bits) {
+        if (bits == 0) return;
+        acc_ = (acc_ << bits) | (value & (bits == 32 ? 0xFFFFFFFFu : (1u << bits) - 1));
+        count_ += bits;
+        while (count_ >= 8) {
+            count_ -= 8;
+            out_.push_back(static_cast<uint8_t>(acc_ >> count_));
+        }
+    }
+
+    void writeSigned(int32_t value, int bits) { write(static_cast<uint32_t>(value), bits); }
+
+    void writeUnary(uint32_t zeros) {
+        for (; zeros >= 24; zeros -= 24) write(0, 24);
+        write(1, static_cast<int>(zeros) + 1);
+    }
+
+    void align() {
+        if (count_ > 0) write(0, 8 - count_);
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    uint64_t acc_ = 0;
+    int count_ = 0;
+};
+
+void writeUtf8(BitWriter& bw, uint64_t v) {
+    if (v < 0x80) {
+        bw.write(static_cast<uint32_t>(v), 8);
+        return;
+    }
+    int extra = v < 0x800 ? 1 : v < 0x10000 ? 2 : v < 0x200000 ? 3 : v < 0x4000000 ? 4 : v < 0x80000000ULL ? 5 : 6;
+    uint32_t lead = extra == 6 ? 0xFE : (0xFF00u >> (extra + 1)) & 0xFF;
+    bw.write(lead | static_cast<uint32_t>(v >> (6 * extra)), 8);
+    for (int i = extra - 1; i >= 0; --i) bw.write(0x80 | static_cast<uint32_t>((v >> (6 * i)) & 0x3F), 8);
+}
+
+/**
+ * Residual of the fixed polynomial predictor of `order` for samples
+ * [order, n). Samples are at most 25 bits (a 24-bit side channel), so
+ * even order 4 stays well inside 32 bits.
+ */
+void fixedResidual(const int32_t* x, int n, int order, int32_t* r) {
+    switch (order) {
+    case 0:
+        std::copy(x, x + n, r);
+        break;
+    case 1:
+        for (int i = 1; i < n; ++i) r[i - 1] = x[i] - x[i - 1];
+        break;
+    case 2:
+        for (int i = 2; i < n; ++i) r[i - 2] = x[i] - 2 * x[i - 1] + x[i - 2];
+        break;
+    case 3:
+        for (int i = 3; i < n; ++i) r[i - 3] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+        break;
+    default:
+        for (int i = 4; i < n; ++i) r[i - 4] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+        break;
+    }
+}
+
+/**
+ * Fixed order with the smallest total absolute residual, from one pass of
+ * running differences (the choice libFLAC makes)
+ */
+int bestFixedOrder(const int32_t* x, int n) {
+    int maxOrder = std::min(MAX_FIXED_ORDER, n - 1);
+    if (n <= MAX_FIXED_ORDER) return maxOrder;
+    uint64_t sums[MAX_FIXED_ORDER + 1] = {};
+    int32_t e1 = x[3] - x[2];
+    int32_t e2 = e1 - (x[2] - x[1]);
+    int32_t e3 = e2 - ((x[2] - x[1]) - (x[1] - x[0]));
+    for (int i = MAX_FIXED_ORDER; i < n; ++i) {
+        int32_t d0 = x[i];
+        int32_t d1 = d0 - x[i - 1];
+        int32_t d2 = d1 - e1;
+        int32_t d3 = d2 - e2;
+        int32_t d4 = d3 - e3;
+        sums[0] += static_cast<uint32_t>(std::abs(d0));
+        sums[1] += static_cast<uint32_t>(std::abs(d1));
+        sums[2] += static_cast<uint32_t>(std::abs(d2));
+        sums[3] += static_cast<uint32_t>(std::abs(d3));
+        sums[4] += static_cast<uint32_t>(std::abs(d4));
+        e1 = d1;
+        e2 = d2;
+        e3 = d3;
+    }
+    return static_cast<int>(std::min_element(sums, sums + maxOrder + 1) - sums);
+}
+
+struct Partition {
+    int param;          // Rice parameter, or -1 for escaped raw samples
+    int rawBits;        // Escaped: bits per sample (0 for a zero run)
+    uint64_t bits;      // Coded size
+};
+
+// Folded sum and widest value of one partition's residual
+struct PartitionStats {
+    uint64_t sum;
+    int width;
+};
+
+Partition choosePartition(int count, const PartitionStats& stats) {
+    Partition escaped{-1, stats.width, 4 + 5 + static_cast<uint64_t>(count) * stats.width};
+    // Parameter near log2 of the mean folded value
+    uint64_t mean = count > 0 ? (stats.sum + count - 1) / count : 0;
+    int k = mean <= 1 ? 0 : std::min(MAX_RICE_PARAM, 62 - __builtin_clzll(mean - 1));
+    Partition rice{k, 0, 4 + static_cast<uint64_t>(count) * (k + 1) + (stats.sum >> k)};
+    return escaped.bits <= rice.bits ? escaped : rice;
+}
+
+struct SubframePlan {
+    int type = 0;                       // 0 CONSTANT, 1 VERBATIM, 2 FIXED
+    int order = 0;
+    int partitionOrder = 0;
+    uint64_t bits = 0;
+};
+
+/**
+ * Cheapest partition order for the `n - order` residuals of an n-sample
+ * block: statistics of the finest partitions are merged pairwise, so
+ * every order costs one pass over the residual in total. Fills `parts`
+ * for the chosen order if given.
+ */
+void planResidual(const int32_t* r, int n, int order, SubframePlan& plan, std::vector<PartitionStats>& stats,
+                  std::vector<Partition>* parts = nullptr) {
+    int finest = 0;
+    while (finest < MAX_PARTITION_ORDER && (n & ((2 << finest) - 1)) == 0 && (n >> (finest + 1)) > order) ++finest;
+
+    int size = n >> finest;
+    stats.resize(static_cast<size_t>(1) << finest);
+    for (int j = 0, i = 0; j < (1 << finest); ++j) {
+        uint64_t sum = 0;
+        uint32_t any = 0;
+        for (int end = (j + 1) * size - order; i < end; ++i) {
+            uint32_t u = fold(r[i]);
+            sum += u;
+            any |= u;
+        }
+        stats[j] = PartitionStats{sum, foldedWidth(any)};
+    }
+
+    plan.bits = UINT64_MAX;
+    for (int p = finest;; --p) {
+        int count = 1 << p;
+        uint64_t bits = 2 + 4;
+        for (int j = 0; j < count; ++j) bits += choosePartition(j == 0 ? (n >> p) - order : n >> p, stats[j]).bits;
+        if (bits < plan.bits) {
+            plan.bits = bits;
+            plan.partitionOrder = p;
+            if (parts) {
+                parts->clear();
+                for (int j = 0; j < count; ++j) parts->push_back(choosePartition(j == 0 ? (n >> p) - order : n >> p, stats[j]));
+            }
+        }
+        if (p == 0) break;
+        for (int j = 0; j < count / 2; ++j) {
+            stats[j] = PartitionStats{stats[2 * j].sum + stats[2 * j + 1].sum,
+                                      std::max(stats[2 * j].width, stats[2 * j + 1].width)};
+        }
+    }
+}
+
+SubframePlan planSubframe(const int32_t* x, int n, int bits, std::vector<int32_t>& residual,
+                          std::vector<PartitionStats>& stats) {
+    SubframePlan best;
+    if (std::all_of(x + 1, x + n, [&](int32_t v) { return v == x[0]; })) {
+        best.bits = 8 + static_cast<uint64_t>(bits);
+        return best;
+    }
+    best.type = 1;
+    best.bits = 8 + static_cast<uint64_t>(n) * bits;
+    SubframePlan plan;
+    plan.type = 2;
+    plan.order = bestFixedOrder(x, n);
+    residual.resize(n);
+    fixedResidual(x, n, plan.order, residual.data());
+    planResidual(residual.data(), n, plan.order, plan, stats);
+    plan.bits += 8 + static_cast<uint64_t>(plan.order) * bits;
+    return plan.bits < best.bits ? plan : best;
+}
+
+void writeResidual(BitWriter& bw, const int32_t* r, int n, const SubframePlan& plan, const std::vector<Partition>& parts) {
+    bw.write(0, 2);                         // Rice, 4-bit parameters
+    bw.write(static_cast<uint32_t>(plan.partitionOrder), 4);
+    const int32_t* q = r;
+    for (int j = 0; j < (1 << plan.partitionOrder); ++j) {
+        int count = (n >> plan.partitionOrder) - (j == 0 ? plan.order : 0);
+        const Partition& part = parts[j];
+        if (part.param < 0) {
+            bw.write(15, 4);
+            bw.write(static_cast<uint32_t>(part.rawBits), 5);
+            for (int i = 0; i < count && part.rawBits > 0; ++i) bw.writeSigned(q[i], part.rawBits);
+        } else {
+            int k = part.param;
+            bw.write(static_cast<uint32_t>(k), 4);
+            for (int i = 0; i < count; ++i) {
+                uint32_t u = fold(q[i]);
+                bw.writeUnary(u >> k);
+                bw.write(u, k);
+            }
+        }
+        q += count;
+    }
+}
+
+void writeSubframe(BitWriter& bw, const SubframePlan& plan, const int32_t* x, int n, int bits,
+                   std::vector<int32_t>& residual, std::vector<PartitionStats>& stats) {
+    if (plan.type == 0) {
+        bw.write(0, 8);                     // CONSTANT
+        bw.writeSigned(x[0], bits);
+    } else if (plan.type == 1) {
+        bw.write(1 << 1, 8);                // VERBATIM
+        for (int i = 0; i < n; ++i) bw.writeSigned(x[i], bits);
+    } else {
+        bw.write(static_cast<uint32_t>(8 + plan.order) << 1, 8);   // FIXED
+        for (int i = 0; i < plan.order; ++i) bw.writeSigned(x[i], bits);
+        residual.resize(n);
+        fixedResidual(x, n, plan.order, residual.data());
+        SubframePlan again = plan;
+        std::vector<Partition> parts;
+        planResidual(residual.data(), n, plan.order, again, stats, &parts);
+        writeResidual(bw, residual.data(), n, again, parts);
+    }
+}
+
+int sampleRateCode(int rate) {
+    switch (rate) {
+    case 44100: return 9;
+    case 48000: return 10;
+    case 96000: return 11;
+    }
+    return 0;                               // From STREAMINFO
+}
+
+// Per-worker encoder buffers
+struct EncoderScratch {
+    std::vector<int32_t> channels[4];       // Two inputs, mid, side
+    std::vector<int32_t> residual;
+    std::vector<PartitionStats> stats;
+};
+
+/**
+ * Append one FLAC frame for `n` interleaved frames of `x`. A stereo pair
+ * is coded as whichever of left/right, left/side, side/right or mid/side
+ * is smallest; identical channels leave a constant side.
+ */
+void encodeFrame(std::vector<uint8_t>& out, const int32_t* x, int n, int channels, int bits, int64_t number,
+                 EncoderScratch& scratch) {
+    std::vector<SubframePlan> plans;
+    std::vector<const int32_t*> inputs;
+    std::vector<int> inputBits;
+    int assignment = channels - 1;          // Independent
+    if (channels == 2) {
+        std::vector<int32_t>* ch = scratch.channels;
+        for (auto* v = ch; v != ch + 4; ++v) v->resize(n);
+        for (int i = 0; i < n; ++i) {
+            int32_t l = x[2 * i];
+            int32_t r = x[2 * i + 1];
+            ch[0][i] = l;
+            ch[1][i] = r;
+            ch[2][i] = (l + r) >> 1;
+            ch[3][i] = l - r;
+        }
+        SubframePlan left = planSubframe(ch[0].data(), n, bits, scratch.residual, scratch.stats);
+        SubframePlan right = planSubframe(ch[1].data(), n, bits, scratch.residual, scratch.stats);
+        SubframePlan mid = planSubframe(ch[2].data(), n, bits, scratch.residual, scratch.stats);
+        SubframePlan side = planSubframe(ch[3].data(), n, bits + 1, scratch.residual, scratch.stats);
+        uint64_t costs[4] = {left.bits + right.bits, left.bits + side.bits, side.bits + right.bits, mid.bits + side.bits};
+        int best = static_cast<int>(std::min_element(costs, costs + 4) - costs);
+        const int pick[4][2] = {{0, 1}, {0, 3}, {3, 1}, {2, 3}};
+        SubframePlan* planOf[4] = {&left, &right, &mid, &side};
+        for (int c : pick[best]) {
+            plans.push_back(std::move(*planOf[c]));
+            inputs.push_back(ch[c].data());
+            inputBits.push_back(c == 3 ? bits + 1 : bits);
+        }
+        assignment = best == 0 ? 1 : 7 + best;
+    } else {
+        scratch.channels[0].resize(static_cast<size_t>(n) * channels);
+        for (int c = 0; c < channels; ++c) {
+            int32_t* v = scratch.channels[0].data() + static_cast<size_t>(c) * n;
+            for (int i = 0; i < n; ++i) v[i] = x[static_cast<size_t>(i) * channels + c];
+            plans.push_back(planSubframe(v, n, bits, scratch.residual, scratch.stats));
+            inputs.push_back(v);
+            inputBits.push_back(bits);
+        }
+    }
+
+    size_t start = out.size();
+    BitWriter bw(out);
+    bw.write(0xFFF8, 16);                   // Sync, fixed block size
+    int sizeCode = n == FLAC_BLOCK_FRAMES ? 12 : n <= 256 ? 6 : 7;
+    bw.write(static_cast<uint32_t>(sizeCode), 4);
+    bw.write(static_cast<uint32_t>(sampleRateCode(SAMPLE_RATE)), 4);
+    bw.write(static_cast<uint32_t>(assignment), 4);
+    bw.write(bits == 16 ? 4 : 6, 3);
+    bw.write(0, 1);
+    writeUtf8(bw, static_cast<uint64_t>(number));
+    if (sizeCode == 6) bw.write(static_cast<uint32_t>(n - 1), 8);
+    if (sizeCode == 7) bw.write(static_cast<uint32_t>(n - 1), 16);
+    out.push_back(crc8(out.data() + start, out.size() - start));
+
+    for (size_t c = 0; c < plans.size(); ++c) {
+        writeSubframe(bw, plans[c], inputs[c], n, inputBits[c], scratch.residual, scratch.stats);
+    }
+    bw.align();
+    uint16_t crc = crc16(out.data() + start, out.size() - start);
+    out.push_back(static_cast<uint8_t>(crc >> 8));
+    out.push_back(static_cast<uint8_t>(crc));
+}
+
+/**
+ * "fLaC", STREAMINFO and a PADDING block filling the metadata out to
+ * FLAC_DATA_ALIGN bytes
+ */
+std::vector<uint8_t> streamInfo(int channels, int bits, int64_t totalFrames, uint32_t minFrame, uint32_t maxFrame) {
+    std::vector<uint8_t> h = {'f', 'L', 'a', 'C', 0x00, 0, 0, 34};
+    BitWriter bw(h);
+    bw.write(FLAC_BLOCK_FRAMES, 16);
+    bw.write(FLAC_BLOCK_FRAMES, 16);
+    bw.write(minFrame, 24);
+    bw.write(maxFrame, 24);
+    bw.write(SAMPLE_RATE, 20);
+    bw.write(static_cast<uint32_t>(channels - 1), 3);
+    bw.write(static_cast<uint32_t>(bits - 1), 5);
+    bw.write(static_cast<uint32_t>(static_cast<uint64_t>(totalFrames) >> 32), 4);
+    bw.write(static_cast<uint32_t>(totalFrames), 32);
+    h.insert(h.end(), 16, 0);                // MD5 not computed (allowed: zero)
+    uint32_t padding = FLAC_DATA_ALIGN - STREAMINFO_BYTES - 4;
+    h.insert(h.end(), {0x81, static_cast<uint8_t>(padding >> 16), static_cast<uint8_t>(padding >> 8),
+                       static_cast<uint8_t>(padding)});                 // Last metadata block
+    h.insert(h.end(), padding, 0);
+    return h;
+}
+
+class BitReader {
+public:
+    BitReader(const uint8_t* p, size_t bytes) : p_(p), bytes_(bytes) {}
+
+    bool ok() const { return !overrun_; }
+    size_t bytePos() const { return bit_ / 8; }
+
+    uint32_t read(int bits) {
+        uint32_t v = 0;
+        for (int i = 0; i < bits; ++i) v = (v << 1) | bit();
+        return v;
+    }
+
+    int32_t readSigned(int bits) {
+        if (bits == 0) return 0;
+        uint32_t v = read(bits);
+        return bits == 32 ? static_cast<int32_t>(v) : static_cast<int32_t>(v << (32 - bits)) >> (32 - bits);
+    }
+
+    uint32_t readUnary() {
+        uint32_t zeros = 0;
+        while (!overrun_ && bit() == 0) ++zeros;
+        return zeros;
+    }
+
+    void align() { bit_ = (bit_ + 7) & ~static_cast<size_t>(7); }
+
+private:
+    uint32_t bit() {
+        if (bit_ / 8 >= bytes_) {
+            overrun_ = true;
+            return 0;
+        }
+        uint32_t b = (p_[bit_ / 8] >> (7 - bit_ % 8)) & 1;
+        ++bit_;
+        return b;
+    }
+
+    const uint8_t* p_;
+    size_t bytes_;
+    size_t bit_ = 0;
+    bool overrun_ = false;
+};
+
+/**
+ * Decode one subframe of the subset this encoder writes (plus wasted
+ * bits). False on anything else.
+ */
+bool decodeSubframe(BitReader& br, int n, int bits, int32_t* x) {
+    if (br.read(1) != 0) return false;
+    uint32_t type = br.read(6);
+    int wasted = 0;
+    if (br.read(1)) wasted = static_cast<int>(br.readUnary()) + 1;
+    bits -= wasted;
+
+    if (type == 0) {
+        int32_t v = br.readSigned(bits);
+        std::fill(x, x + n, v);
+    } else if (type == 1) {
+        for (int i = 0; i < n; ++i) x[i] = br.readSigned(bits);
+    } else if (type >= 8 && type <= 12) {
+        int order = static_cast<int>(type - 8);
+        if (order >= n) return false;
+        for (int i = 0; i < order; ++i) x[i] = br.readSigned(bits);
+        uint32_t method = br.read(2);
+        if (method > 1) return false;
+        int paramBits = method == 0 ? 4 : 5;
+        uint32_t escape = method == 0 ? 15 : 31;
+        int partitionOrder = static_cast<int>(br.read(4));
+        if ((n >> partitionOrder) < order || (n & ((1 << partitionOrder) - 1)) != 0) return false;
+        int i = order;
+        for (int j = 0; j < (1 << partitionOrder); ++j) {
+            int count = j == 0 ? (n >> partitionOrder) - order : n >> partitionOrder;
+            uint32_t k = br.read(paramBits);
+            if (k == escape) {
+                int raw = static_cast<int>(br.read(5));
+                for (int m = 0; m < count; ++m) x[i++] = br.readSigned(raw);
+            } else {
+                for (int m = 0; m < count; ++m) {
+                    uint32_t u = (br.readUnary() << k) | br.read(static_cast<int>(k));
+                    x[i++] = static_cast<int32_t>(u >> 1) ^ -static_cast<int32_t>(u & 1);
+                }
+            }
+        }
+        for (int s = order; s < n; ++s) {
+            int64_t p;
+            switch (order) {
+            case 0: p = 0; break;
+            case 1: p = x[s - 1]; break;
+            case 2: p = 2LL * x[s - 1] - x[s - 2]; break;
+            case 3: p = 3LL * x[s - 1] - 3LL * x[s - 2] + x[s - 3]; break;
+            default: p = 4LL * x[s - 1] - 6LL * x[s - 2] + 4LL * x[s - 3] - x[s - 4]; break;
+            }
+            x[s] = static_cast<int32_t>(x[s] + p);
+        }
+    } else {
+        return false;
+    }
+    if (wasted > 0) {
+        for (int i = 0; i < n; ++i) x[i] = static_cast<int32_t>(static_cast<uint32_t>(x[i]) << wasted);
+    }
+    return br.ok();
+}
+
+/**
+ * Decode `path` frame by frame and compare it with a fresh render
+ * rounded to `bits`. Prints the outcome; returns the frames matched or
+ * -1 on any difference.
+ */
+int64_t verifyFlac(const std::string& path, int channels, int bits, int64_t totalFrames) {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* map = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    const uint8_t* data = static_cast<const uint8_t*>(map);
+
+    auto fail = [&](const char* what, int64_t frame) {
+        std::cout << "  Decode check FAILED at frame " << frame << ": " << what << "\n";
+        munmap(map, size);
+        return static_cast<int64_t>(-1);
+    };
+    if (size < STREAMINFO_BYTES || std::memcmp(data, "fLaC", 4) != 0) return fail("not a FLAC file", 0);
+    BitReader info(data + 8, 34);
+    info.read(16 + 16 + 24 + 24);
+    int rate = static_cast<int>(info.read(20));
+    int infoChannels = static_cast<int>(info.read(3)) + 1;
+    int infoBits = static_cast<int>(info.read(5)) + 1;
+    int64_t infoFrames = (static_cast<int64_t>(info.read(4)) << 32) | info.read(32);
+    if (rate != SAMPLE_RATE || infoChannels != channels || infoBits != bits || infoFrames != totalFrames) {
+        return fail("STREAMINFO does not match the render", 0);
+    }
+
+    std::vector<float> scratch;
+    std::vector<int32_t> expected;
+    std::vector<int32_t> decoded(static_cast<size_t>(FLAC_BLOCK_FRAMES) * channels);
+    std::vector<int32_t> channel(FLAC_BLOCK_FRAMES);
+    size_t pos = 4;
+    for (bool last = false; !last;) {
+        if (pos + 4 > size) return fail("truncated metadata", 0);
+        last = (data[pos] & 0x80) != 0;
+        pos += 4 + ((size_t(data[pos + 1]) << 16) | (size_t(data[pos + 2]) << 8) | data[pos + 3]);
+    }
+    int64_t frame = 0;
+    for (int64_t number = 0; frame < totalFrames; ++number) {
+        BitReader br(data + pos, size - pos);
+        if (br.read(15) != 0x7FFC) return fail("lost frame sync", frame);
+        br.read(1);
+        int sizeCode = static_cast<int>(br.read(4));
+        int rateCode = static_cast<int>(br.read(4));
+        int assignment = static_cast<int>(br.read(4));
+        int bitsCode = static_cast<int>(br.read(3));
+        br.read(1);
+        uint32_t lead = br.read(8);
+        int extra = 0;
+        while (extra < 7 && (lead & (0x80u >> extra))) ++extra;
+        uint64_t decodedNumber = extra == 0 ? lead : lead & (0x7Fu >> extra);
+        for (int i = 1; i < extra; ++i) decodedNumber = (decodedNumber << 6) | (br.read(8) & 0x3F);
+        int n = sizeCode == 6 ? static_cast<int>(br.read(8)) + 1
+              : sizeCode == 7 ? static_cast<int>(br.read(16)) + 1
+              : sizeCode >= 8 ? 256 << (sizeCode - 8)
+              : sizeCode >= 2 ? 576 << (sizeCode - 2) : 192;
+        if (rateCode == 12) br.read(8);
+        if (rateCode == 13 || rateCode == 14) br.read(16);
+        size_t headerBytes = br.bytePos();
+        if (br.read(8) != crc8(data + pos, headerBytes)) return fail("header CRC", frame);
+        bool stereo = channels == 2 && assignment >= 8 && assignment <= 10;
+        if (static_cast<int64_t>(decodedNumber) != number || (assignment != channels - 1 && !stereo) ||
+            bitsCode != (bits == 16 ? 4 : 6) || n > FLAC_BLOCK_FRAMES || frame + n > totalFrames) {
+            return fail("unexpected frame header", frame);
+        }
+
+        for (int c = 0; c < channels; ++c) {
+            // The side channel of a stereo pair has one extra bit
+            bool side = stereo && c == (assignment == 9 ? 0 : 1);
+            if (!decodeSubframe(br, n, side ? bits + 1 : bits, channel.data())) return fail("bad subframe", frame);
+            for (int i = 0; i < n; ++i) decoded[static_cast<size_t>(i) * channels + c] = channel[i];
+        }
+        for (int i = 0; stereo && i < n; ++i) {
+            int32_t& a = decoded[2 * static_cast<size_t>(i)];
+            int32_t& b = decoded[2 * static_cast<size_t>(i) + 1];
+            if (assignment == 8) {
+                b = a - b;                  // Left, side
+            } else if (assignment == 9) {
+                a = a + b;                  // Side, right
+            } else {
+                int32_t mid = static_cast<int32_t>(static_cast<uint32_t>(a) << 1) | (b & 1);
+                int32_t s = b;
+                a = (mid + s) >> 1;
+                b = (mid - s) >> 1;
+            }
+        }
+        br.align();
+        size_t frameBytes = br.bytePos();
+        uint32_t crc = br.read(16);
+        if (!br.ok() || crc != crc16(data + pos, frameBytes)) return fail("frame CRC", frame);
+
+        renderQuantized(scratch, expected, frame, n, bits);
+        if (!std::equal(expected.begin(), expected.end(), decoded.begin())) return fail("samples differ", frame);
+        pos += frameBytes + 2;
+        frame += n;
+    }
+    munmap(map, size);
+    if (pos != size) {
+        std::cout << "  Decode check FAILED: " << size - pos << " bytes after the last frame\n";
+        return -1;
+    }
+    return frame;
+}
+
+} // namespace
+
+int runFlacRender(const RenderConfig& config) {
+    buildRenderTables();
+    int channels = outputChannels();
+    int bits = config.bits;
+    if (channels > 8) {
+        std::cerr << "FLAC holds at most 8 channels (output layout has " << channels << ")" << std::endl;
+        return 1;
+    }
+    if (bits != 16 && bits != 24) {
+        std::cerr << "FLAC export supports 16 or 24 bits per sample" << std::endl;
+        return 1;
+    }
+    int threads = threadCount(config.threads);
+    int64_t totalFrames = static_cast<int64_t>(config.seconds * SAMPLE_RATE);
+    int64_t blocks = (totalFrames + FLAC_BLOCK_FRAMES - 1) / FLAC_BLOCK_FRAMES;
+    int64_t chunks = (blocks + CHUNK_BLOCKS - 1) / CHUNK_BLOCKS;
+
+    AsyncWriter writer;
+    if (!writer.open(config.path, config.io)) return 1;
+    std::string backend = writer.backendName();
+
+    // Finished chunks by number; workers stay within `window` of the writer
+    struct Encoded {
+        std::vector<uint8_t> bytes;
+        uint32_t minFrame = UINT32_MAX;
+        uint32_t maxFrame = 0;
+        bool ready = false;
+    };
+    int window = threads * WINDOW_PER_THREAD;
+    std::vector<Encoded> slots(window);
+    int64_t written = 0;
+    bool failed = false;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::atomic<int64_t> next{0};
+
+    auto worker = [&] {
+        std::vector<float> scratch;
+        std::vector<int32_t> samples;
+        EncoderScratch encoder;
+        Encoded encoded;
+        for (;;) {
+            int64_t chunk = next.fetch_add(1);
+            if (chunk >= chunks) return;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return failed || chunk < written + window; });
+                if (failed) return;
+            }
+            int64_t first = chunk * CHUNK_BLOCKS * FLAC_BLOCK_FRAMES;
+            int frames = static_cast<int>(std::min<int64_t>(static_cast<int64_t>(CHUNK_BLOCKS) * FLAC_BLOCK_FRAMES,
+                                                            totalFrames - first));
+            renderQuantized(scratch, samples, first, frames, bits);
+            encoded.bytes.clear();
+            encoded.minFrame = UINT32_MAX;
+            encoded.maxFrame = 0;
+            for (int offset = 0, b = 0; offset < frames; offset += FLAC_BLOCK_FRAMES, ++b) {
+                int n = std::min(FLAC_BLOCK_FRAMES, frames - offset);
+                size_t before = encoded.bytes.size();
+                encodeFrame(encoded.bytes, samples.data() + static_cast<size_t>(offset) * channels, n, channels, bits,
+                            chunk * CHUNK_BLOCKS + b, encoder);
+                uint32_t frameBytes = static_cast<uint32_t>(encoded.bytes.size() - before);
+                encoded.minFrame = std::min(encoded.minFrame, frameBytes);
+                encoded.maxFrame = std::max(encoded.maxFrame, frameBytes);
+            }
+            encoded.ready = true;
+            std::lock_guard<std::mutex> lock(mutex);
+            std::swap(slots[chunk % window], encoded);
+            changed.notify_all();
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (int i = 0; i < threads; ++i) pool.emplace_back(worker);
+
+    // Append chunks in order through the writer's buffers
+    int64_t offset = FLAC_DATA_ALIGN;
+    uint32_t minFrame = UINT32_MAX;
+    uint32_t maxFrame = 0;
+    int slot = -1;
+    uint8_t* buffer = nullptr;
+    size_t fill = 0;
+    bool ok = true;
+    Encoded encoded;
+    for (int64_t chunk = 0; chunk < chunks && ok; ++chunk) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return slots[chunk % window].ready; });
+            std::swap(encoded, slots[chunk % window]);
+            slots[chunk % window].ready = false;
+            ++written;
+            changed.notify_all();
+        }
+        minFrame = std::min(minFrame, encoded.minFrame);
+        maxFrame = std::max(maxFrame, encoded.maxFrame);
+        for (size_t done = 0; done < encoded.bytes.size() && ok;) {
+            if (buffer == nullptr) buffer = writer.acquire(slot);
+            size_t n = std::min(encoded.bytes.size() - done, writer.bufferBytes() - fill);
+            std::memcpy(buffer + fill, encoded.bytes.data() + done, n);
+            fill += n;
+            done += n;
+            if (fill == writer.bufferBytes()) {
+                ok = writer.submit(slot, fill, offset);
+                offset += static_cast<int64_t>(fill);
+                buffer = nullptr;
+                fill = 0;
+            }
+        }
+    }
+    if (!ok) {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed = true;
+        changed.notify_all();
+    }
+    for (auto& t : pool) t.join();
+    if (buffer != nullptr) {
+        ok = writer.submit(slot, fill, offset) && ok;
+        offset += static_cast<int64_t>(fill);
+    }
+    std::vector<uint8_t> header = streamInfo(channels, bits, totalFrames, totalFrames > 0 ? minFrame : 0, maxFrame);
+    ok = writer.writeSync(header.data(), header.size(), 0) && ok;
+    ok = writer.close(offset) && ok;
+    if (!ok) {
+        std::cerr << "Write to " << config.path << " failed: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    double elapsed = secondsSince(start);
+
+    double minutes = static_cast<double>(totalFrames) / SAMPLE_RATE / 60.0;
+    double floatBytes = static_cast<double>(totalFrames) * channels * sizeof(float);
+    double pcmBytes = static_cast<double>(totalFrames) * channels * bits / 8;
+    std::cout << "Exported " << config.path << ": " << std::fixed << std::setprecision(1) << minutes << " min, "
+              << channels << " ch, " << bits << "-bit FLAC, " << offset / 1e6 << " MB ("
+              << std::setprecision(2) << 100.0 * offset / floatBytes << "% of float WAV, "
+              << 100.0 * offset / pcmBytes << "% of " << bits << "-bit PCM) in " << elapsed << " s on "
+              << threads << " threads, " << backend << (config.io.direct ? ", O_DIRECT" : "") << " ("
+              << std::setprecision(1) << minutes / elapsed << " min of audio/s)\n" << std::defaultfloat;
+
+    start = std::chrono::steady_clock::now();
+    int64_t checked = verifyFlac(config.path, channels, bits, totalFrames);
+    if (checked < 0) return 1;
+    elapsed = secondsSince(start);
+    std::cout << "  Decode check: " << blocks << " frames, bit-exact against the render ("
+              << std::fixed << std::setprecision(1) << minutes / elapsed << " min of audio/s)\n" << std::defaultfloat;
+    return 0;
+}
@@ -0,0 +1,31 @@
+/**
+ * FLAC export of rendered sessions, for participants who download them
+ * over slow links.
+ *
+ * The timeline is cut into fixed FLAC_BLOCK_FRAMES blocks. Each block is
+ * an independent FLAC frame (its number is known up front), so worker
+ * threads render and encode chunks of blocks in any order while the main
+ * thread appends finished chunks to the file in timeline order.
+ *
+ * The encoder is self-contained and stays in the FLAC "subset" that every
+ * decoder plays: CONSTANT, FIXED (orders 0-4) or VERBATIM subframes,
+ * partitioned Rice residuals, and the cheapest of left/right, left/side,
+ * side/right and mid/side for a stereo pair. Runs of zero residual (the
+ * silent 96% of each period) are stored as escaped partitions of zero-bit
+ * samples, a few bits each. The float stimulus is rounded to 16- or
+ * 24-bit integers; after writing, the file is decoded again and compared
+ * sample for sample with a fresh, equally rounded render.
+ */
+
+#pragma once
+
+#include "offline_render.h"
+
+constexpr int FLAC_BLOCK_FRAMES = 4096;
+
+/**
+ * Render `config.seconds` of the default grid to `config.path` as FLAC
+ * with `config.bits` bits per sample, report the size and speed, then
+ * decode the file and check it against the render
+ */
+int runFlacRender(const RenderConfig& config);
@@ -0,0 +1,161 @@
+#include "flicker.h"
+#include "engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+
+namespace {
+
+constexpr double DEFAULT_REFRESH_HZ = 60.0;
+constexpr double MIN_CLEAN_REFRESH_HZ = 80.0;  // Below this 40Hz cannot be a square wave
+
+FlickerConfig g_config;
+bool g_active = false;
+bool g_vsync = false;
+int64_t g_periodNs = 0;
+int64_t g_offsetNs = 0;         // --av-offset-ms
+int64_t g_nextNs = 0;           // Scheduled present time of the next frame
+int64_t g_lastPresentNs = 0;
+bool g_lastLit = false;
+
+// Statistics
+uint64_t g_frames = 0;
+uint64_t g_missed = 0;
+uint64_t g_flashes = 0;
+double g_edgeErrorSumUs = 0.0;
+double g_edgeErrorWorstUs = 0.0;
+
+std::ofstream g_log;
+
+} // namespace
+
+bool startFlicker(SDL_Window* window, SDL_Renderer* renderer, const FlickerConfig& config) {
+    g_config = config;
+
+    double refreshHz = config.refreshHz;
+    if (refreshHz <= 0.0) {
+        SDL_DisplayMode mode;
+        int display = SDL_GetWindowDisplayIndex(window);
+        if (display >= 0 && SDL_GetCurrentDisplayMode(display, &mode) == 0 && mode.refresh_rate > 0) {
+            refreshHz = mode.refresh_rate;
+        } else {
+            refreshHz = DEFAULT_REFRESH_HZ;
+        }
+    }
+    g_periodNs = std::llround(1e9 / refreshHz);
+    g_offsetNs = std::llround(config.avOffsetMs * 1e6);
+
+    SDL_RendererInfo info;
+    g_vsync = SDL_GetRendererInfo(renderer, &info) == 0 && (info.flags & SDL_RENDERER_PRESENTVSYNC);
+
+    if (!config.logPath.empty()) {
+        g_log.open(config.logPath, std::ios::trunc);
+        if (!g_log) {
+            std::cerr << "Cannot open flicker log " << config.logPath << std::endl;
+            return false;
+        }
+        g_log << "frame,target_ns,present_ns,lit,audible_frame,edge_error_us\n";
+    }
+
+    g_frames = g_missed = g_flashes = 0;
+    g_edgeErrorSumUs = g_edgeErrorWorstUs = 0.0;
+    g_lastPresentNs = 0;
+    g_lastLit = false;
+    g_nextNs = hostTimeNs() + g_periodNs;
+    g_active = true;
+
+    std::cout << "Visual flicker: " << std::fixed << std::setprecision(1) << refreshHz << " Hz display ("
+              << (g_vsync ? "vsync" : "paced") << "), output latency "
+              << outputLatencyNs() / 1e6 << " ms, offset " << config.avOffsetMs << " ms\n"
+              << std::defaultfloat;
+    if (refreshHz < MIN_CLEAN_REFRESH_HZ) {
+        std::cerr << "⚠ A " << refreshHz << " Hz display cannot show a clean 40Hz flicker; use 120 Hz or more\n";
+    }
+    return true;
+}
+
+void renderFlickerFrame(SDL_Renderer* renderer) {
+    if (!g_active) return;
+    int64_t target = g_nextNs;
+
+    // Audio frame heard at the target present time. Shifting by half a
+    // display frame picks the frame nearest each onset for the rising edge.
+    bool lit = false;
+    int64_t onsetFrame = -1;      // Set on the first lit frame of a flash
+    int64_t audibleFrame = -1;
+    double heard;
+    if (audibleFrameAt(target - g_offsetNs, heard)) {
+        audibleFrame = std::llround(heard);
+        int64_t shifted = audibleFrame + std::llround(g_periodNs * SAMPLE_RATE / 2e9);
+
+        // Delivered onsets, so a moved (closed-loop) grid is followed too
+        int64_t onsets[ONSET_HISTORY];
+        int count = recentOnsets(onsets, ONSET_HISTORY);
+        int64_t dutyFrames = std::llround(g_config.duty * SAMPLES_PER_INTERVAL);
+        for (int i = count - 1; i >= 0 && !lit; --i) {
+            lit = shifted >= onsets[i] && shifted - onsets[i] < dutyFrames;
+            if (lit && !g_lastLit) onsetFrame = onsets[i];
+        }
+    }
+
+    Uint8 level = lit ? 255 : 0;
+    SDL_SetRenderDrawColor(renderer, level, level, level, 255);
+    SDL_RenderClear(renderer);
+
+    if (!g_vsync) {
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(target)));
+    }
+    SDL_RenderPresent(renderer);
+    int64_t presentNs = hostTimeNs();
+
+    ++g_frames;
+    if (g_lastPresentNs != 0 && presentNs - g_lastPresentNs > g_periodNs * 3 / 2) {
+        g_missed += std::llround(static_cast<double>(presentNs - g_lastPresentNs) / g_periodNs) - 1;
+    }
+
+    double edgeErrorUs = 0.0;
+    int64_t onsetNs;
+    if (onsetFrame >= 0 && audibleHostNs(onsetFrame, onsetNs)) {
+        ++g_flashes;
+        edgeErrorUs = (presentNs - g_offsetNs - onsetNs) / 1e3;
+        g_edgeErrorSumUs += edgeErrorUs;
+        g_edgeErrorWorstUs = std::max(g_edgeErrorWorstUs, std::fabs(edgeErrorUs));
+    }
+
+    if (g_log.is_open()) {
+        g_log << g_frames - 1 << "," << target << "," << presentNs << "," << (lit ? 1 : 0) << ","
+              << audibleFrame << ",";
+        if (onsetFrame >= 0) g_log << std::fixed << std::setprecision(1) << edgeErrorUs << std::defaultfloat;
+        g_log << "\n";
+    }
+
+    // Vsync: the next slot follows the vblank we just hit. Paced: keep the
+    // grid, skipping slots we are already past.
+    g_nextNs = g_vsync ? presentNs + g_periodNs : target + g_periodNs;
+    while (!g_vsync && g_nextNs <= presentNs) {
+        g_nextNs += g_periodNs;
+    }
+    g_lastPresentNs = presentNs;
+    g_lastLit = lit;
+}
+
+bool stopFlicker() {
+    if (!g_active) return true;
+    g_active = false;
+    if (g_log.is_open()) g_log.close();
+
+    std::cout << "Visual flicker: " << g_frames << " frames, " << g_missed << " missed, "
+              << g_flashes << " flashes";
+    if (g_flashes > 0) {
+        std::cout << std::fixed << std::setprecision(0)
+                  << " | light vs sound onset: mean " << g_edgeErrorSumUs / g_flashes
+                  << " us, worst " << g_edgeErrorWorstUs << " us" << std::defaultfloat;
+    }
+    std::cout << "\n";
+    return g_flashes > 0;
+}
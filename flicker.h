@@ -0,0 +1,39 @@
+/**
+ * Audio-synchronized 40Hz visual flicker (GENUS-style light + sound).
+ *
+ * Each display frame is scheduled for a predicted present time; the frame
+ * is lit when the audio audible at that instant (audibleFrameAt(), shifted
+ * by a user offset) is within the flash part of its pulse interval, so
+ * flashes line up with what the subject hears rather than with what was
+ * last rendered. Presents use vsync when the renderer has it and
+ * a sleep-paced grid otherwise (dummy/offscreen drivers).
+ */
+
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <string>
+
+struct FlickerConfig {
+    bool enabled = false;
+    double refreshHz = 0.0;     // 0 = current display mode
+    double avOffsetMs = 0.0;    // Added light delay (positive = later)
+    double duty = 0.5;          // Lit share of each 25ms interval
+    std::string logPath;        // CSV of every present timestamp
+};
+
+/**
+ * Start presenting flicker frames on `renderer`
+ */
+bool startFlicker(SDL_Window* window, SDL_Renderer* renderer, const FlickerConfig& config);
+
+/**
+ * Draw and present one frame at the next scheduled slot (blocks until then)
+ */
+void renderFlickerFrame(SDL_Renderer* renderer);
+
+/**
+ * Print frame, miss and alignment statistics and close the log. Returns
+ * false if no flash was presented.
+ */
+bool stopFlicker();
@@ -0,0 +1,297 @@
+#include "lsl_outlet.h"
+
+#include <iostream>
+
+#ifdef PNAS_WITH_LSL
+
+#include "engine.h"
+#include "bench.h"
+#include "clock_drift.h"
+#include "spsc_ring.h"
+
+#include <lsl_cpp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr auto PUBLISH_INTERVAL = std::chrono::milliseconds(50);
+constexpr double MAX_SPACING_ERROR_US = 50.0;   // Check pass marks: stamps vs the frame clock,
+constexpr double MAX_DELAY_MS = 250.0;          // publish batching plus the inlet's pull
+constexpr double MIN_PULSE_SHARE = 0.9;         // Pulses received vs the grid over the run
+
+struct MarkerEvent {
+    int64_t frame;
+    int64_t hostNs;     // 0 = resolve from the frame clock anchor
+    int64_t pulse;      // Grid pulse number (LSL_PULSE only)
+    int32_t marker;
+};
+
+// Onsets come from the audio thread, session events from the UI thread:
+// one single-producer ring each.
+SpscRing<MarkerEvent> g_onsetQueue(4096);
+SpscRing<MarkerEvent> g_sessionQueue(256);
+std::atomic<uint64_t> g_dropped{0};
+
+std::unique_ptr<lsl::stream_outlet> g_outlet;
+double g_lslOffset = 0.0;   // lsl::local_clock() - hostTimeNs() in seconds
+int g_sampleRate = SAMPLE_RATE;
+
+std::thread g_thread;
+std::mutex g_mutex;
+std::condition_variable g_wake;
+bool g_stop = false;
+uint64_t g_published = 0;
+
+void onsetTap(int64_t frame, int64_t hostNs, int64_t pulse) {
+    if (!g_onsetQueue.push(MarkerEvent{frame, hostNs, pulse, LSL_PULSE})) {
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Host time of `frame`: the drift fit once it has converged, else
+ * extrapolated from the latest block anchor at the nominal rate. False
+ * until the first block has anchored the frame clock.
+ */
+bool frameToHostNs(int64_t frame, int64_t& hostNs) {
+    if (driftFrameToHostNs(frame, hostNs)) return true;
+
+    int64_t anchorFrame, anchorNs;
+    if (!frameClockAnchor(anchorFrame, anchorNs)) return false;
+    hostNs = anchorNs + (frame - anchorFrame) * 1000000000LL / g_sampleRate;
+    return true;
+}
+
+/**
+ * Offset between the LSL clock and ours, from the tightest of a few
+ * bracketed reads
+ */
+double measureLslOffset() {
+    double best = 0.0;
+    int64_t bestSpan = INT64_MAX;
+    for (int i = 0; i < 16; ++i) {
+        int64_t before = hostTimeNs();
+        double lsl = lsl::local_clock();
+        int64_t after = hostTimeNs();
+        if (after - before < bestSpan) {
+            bestSpan = after - before;
+            best = lsl - (before + after) * 0.5e-9;
+        }
+    }
+    return best;
+}
+
+std::string markerText(const MarkerEvent& event) {
+    switch (event.marker) {
+        case LSL_PULSE:           return "pulse " + std::to_string(event.pulse);
+        case LSL_SESSION_START:   return "session_start";
+        case LSL_SESSION_STOP:    return "session_stop";
+        case LSL_PAUSE:           return "pause";
+        case LSL_RESUME:          return "resume";
+        case LSL_MODE_PULSED:     return "mode pulsed";
+        case LSL_MODE_CONTINUOUS: return "mode continuous";
+    }
+    return "unknown";
+}
+
+void publishPending() {
+    std::vector<MarkerEvent> batch;
+    MarkerEvent event;
+    // Session events stay queued until the device has run its first block
+    int64_t anchorFrame, anchorNs;
+    bool anchored = frameClockAnchor(anchorFrame, anchorNs);
+    while (anchored && g_sessionQueue.pop(event)) {
+        frameToHostNs(event.frame, event.hostNs);
+        batch.push_back(event);
+    }
+    while (g_onsetQueue.pop(event)) {
+        driftFrameToHostNs(event.frame, event.hostNs);  // Strip callback jitter when possible
+        batch.push_back(event);
+    }
+    if (batch.empty()) return;
+
+    std::stable_sort(batch.begin(), batch.end(),
+                     [](const MarkerEvent& a, const MarkerEvent& b) { return a.frame < b.frame; });
+
+    std::vector<std::vector<std::string>> samples;
+    std::vector<double> stamps;
+    samples.reserve(batch.size());
+    stamps.reserve(batch.size());
+    for (const MarkerEvent& e : batch) {
+        samples.push_back({markerText(e)});
+        stamps.push_back(e.hostNs * 1e-9 + g_lslOffset);
+    }
+    g_outlet->push_chunk(samples, stamps);
+    g_published += batch.size();
+}
+
+void publisherLoop() {
+    std::unique_lock<std::mutex> lock(g_mutex);
+    while (!g_stop) {
+        g_wake.wait_for(lock, PUBLISH_INTERVAL);
+        publishPending();
+    }
+    publishPending();
+}
+
+} // namespace
+
+bool startLslOutlet(const std::string& streamName, int sampleRate) {
+    g_sampleRate = sampleRate;
+
+    lsl::stream_info info(streamName, "Markers", 1, lsl::IRREGULAR_RATE, lsl::cf_string,
+                          "pnas_sound_" + streamName);
+    lsl::xml_element desc = info.desc();
+    desc.append_child_value("sample_rate", std::to_string(sampleRate));
+    desc.append_child_value("frames_per_interval", std::to_string(SAMPLES_PER_INTERVAL));
+    desc.append_child_value("tone_frequency", std::to_string(TONE_FREQUENCY));
+    g_outlet.reset(new lsl::stream_outlet(info));
+
+    g_lslOffset = measureLslOffset();
+    if (!addOnsetTap(onsetTap)) {
+        std::cerr << "No free engine tap for the LSL outlet" << std::endl;
+        g_outlet.reset();
+        return false;
+    }
+
+    g_stop = false;
+    g_thread = std::thread(publisherLoop);
+    std::cout << "LSL outlet '" << streamName << "' (Markers)\n";
+    return true;
+}
+
+void stopLslOutlet() {
+    if (!g_thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_stop = true;
+    }
+    g_wake.notify_one();
+    g_thread.join();
+    g_outlet.reset();
+
+    std::cout << "LSL outlet: " << g_published << " markers published";
+    if (g_dropped.load() > 0) {
+        std::cout << ", " << g_dropped.load() << " dropped (queue full)";
+    }
+    std::cout << "\n";
+}
+
+void lslSessionEvent(LslMarker marker) {
+    if (!g_outlet) return;
+    if (!g_sessionQueue.push(MarkerEvent{g_samplePosition.load(), 0, 0, marker})) {
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+int runLslCheck(const std::string& streamName, double seconds) {
+    std::cout << "Resolving LSL stream '" << streamName << "'..." << std::endl;
+    std::vector<lsl::stream_info> found = lsl::resolve_stream("name", streamName, 1, 10.0);
+    if (found.empty()) {
+        std::cerr << "No LSL stream named '" << streamName << "'" << std::endl;
+        return 1;
+    }
+
+    lsl::stream_inlet inlet(found[0]);
+    int sampleRate = SAMPLE_RATE;
+    int interval = SAMPLES_PER_INTERVAL;
+    lsl::stream_info full = inlet.info(5.0);
+    std::sscanf(full.desc().child_value("sample_rate"), "%d", &sampleRate);
+    std::sscanf(full.desc().child_value("frames_per_interval"), "%d", &interval);
+
+    std::map<std::string, int> counts;
+    std::vector<double> spacingErrorsUs;
+    std::vector<double> delaysMs;
+    long long lastPulse = -1;
+    double lastStamp = 0.0;
+
+    double end = lsl::local_clock() + seconds;
+    std::vector<std::string> sample;
+    while (lsl::local_clock() < end) {
+        double stamp;
+        try {
+            stamp = inlet.pull_sample(sample, 0.5);
+        } catch (const std::exception& e) {
+            std::cerr << "LSL inlet: " << e.what() << std::endl;
+            return 1;
+        }
+        if (stamp == 0.0 || sample.empty()) continue;
+
+        // Same clock on this host; a remote outlet needs the correction
+        stamp += inlet.time_correction(1.0);
+        delaysMs.push_back((lsl::local_clock() - stamp) * 1e3);
+
+        long long pulse;
+        if (std::sscanf(sample[0].c_str(), "pulse %lld", &pulse) == 1) {
+            ++counts["pulse"];
+            if (lastPulse >= 0 && pulse > lastPulse) {
+                double expected = static_cast<double>(pulse - lastPulse) * interval / sampleRate;
+                spacingErrorsUs.push_back((stamp - lastStamp - expected) * 1e6);
+            }
+            lastPulse = pulse;
+            lastStamp = stamp;
+        } else {
+            ++counts[sample[0]];
+        }
+    }
+
+    std::cout << "Markers received in " << seconds << " s:\n";
+    for (const auto& entry : counts) {
+        std::cout << "  " << std::left << std::setw(16) << entry.first << std::right << entry.second << "\n";
+    }
+    double worstUs = 0.0, sumUs = 0.0;
+    for (double e : spacingErrorsUs) {
+        worstUs = std::max(worstUs, std::fabs(e));
+        sumUs += e;
+    }
+    if (!spacingErrorsUs.empty()) {
+        std::cout << std::fixed << std::setprecision(2)
+                  << "Pulse spacing vs frame clock: mean " << sumUs / spacingErrorsUs.size()
+                  << " us, worst " << worstUs << " us\n";
+    }
+    if (!delaysMs.empty()) {
+        std::sort(delaysMs.begin(), delaysMs.end());
+        std::cout << std::fixed << std::setprecision(1)
+                  << "Delivery delay: median " << delaysMs[delaysMs.size() / 2]
+                  << " ms, max " << delaysMs.back() << " ms\n";
+    }
+    std::cout << std::defaultfloat;
+
+    double expectedPulses = seconds * sampleRate / interval;
+    bool ok = counts["pulse"] >= MIN_PULSE_SHARE * expectedPulses && !spacingErrorsUs.empty() &&
+              worstUs <= MAX_SPACING_ERROR_US && delaysMs.back() <= MAX_DELAY_MS;
+    std::cout << verdict(ok) << ": at least " << static_cast<int>(MIN_PULSE_SHARE * 100) << "% of "
+              << static_cast<long long>(expectedPulses) << " pulses, spacing error at most " << MAX_SPACING_ERROR_US
+              << " us, delivery delay at most " << MAX_DELAY_MS << " ms" << std::endl;
+    return ok ? 0 : 1;
+}
+
+#else
+
+bool startLslOutlet(const std::string& /*streamName*/, int /*sampleRate*/) {
+    std::cerr << "Built without LSL support (rebuild with PNAS_WITH_LSL)" << std::endl;
+    return false;
+}
+
+void stopLslOutlet() {}
+
+void lslSessionEvent(LslMarker /*marker*/) {}
+
+int runLslCheck(const std::string& /*streamName*/, double /*seconds*/) {
+    std::cerr << "Built without LSL support (rebuild with PNAS_WITH_LSL)" << std::endl;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,47 @@
+/**
+ * Lab Streaming Layer marker outlet (built with PNAS_WITH_LSL).
+ *
+ * Publishes one string marker per pulse onset ("pulse <n>", n = the grid
+ * pulse number, the same counter as the trigger channel) and the
+ * session events below. Every marker is stamped from the engine frame
+ * clock, mapped to lsl::local_clock(); the UI loop only supplies the frame
+ * at which an event takes effect. The audio thread and the UI feed
+ * lock-free queues, and a publisher thread pushes them in batches.
+ */
+
+#pragma once
+
+#include <string>
+
+enum LslMarker {
+    LSL_PULSE,
+    LSL_SESSION_START,
+    LSL_SESSION_STOP,
+    LSL_PAUSE,
+    LSL_RESUME,
+    LSL_MODE_PULSED,
+    LSL_MODE_CONTINUOUS,
+};
+
+/**
+ * Create the outlet `streamName` (type "Markers") and start publishing.
+ * Must be called before the audio device is started.
+ */
+bool startLslOutlet(const std::string& streamName, int sampleRate);
+
+/**
+ * Publish outstanding markers and destroy the outlet
+ */
+void stopLslOutlet();
+
+/**
+ * Queue a session event at the current frame clock position (UI thread only)
+ */
+void lslSessionEvent(LslMarker marker);
+
+/**
+ * Inlet check: follow `streamName` for `seconds` and report marker counts,
+ * pulse spacing against the frame clock and delivery delay. Fails on
+ * missing pulses, a spacing error over 50 us or a delay over 250 ms.
+ */
+int runLslCheck(const std::string& streamName, double seconds);
@@ -12,20 +12,42 @@
  * - 60dB intensity
  */
 
+#include "engine.h"
+#include "audio_device.h"
+#include "watchdog.h"
+#include "shm_ring.h"
+#include "rtp.h"
+#include "startup.h"
+#include "onset_log.h"
+#include "lsl_outlet.h"
+#include "clock_drift.h"
+#include "flicker.h"
+#include "phase_lock.h"
+#include "eeg_stream.h"
+#include "net_sync.h"
+#include "capture_verify.h"
+#include "trigger_input.h"
+#include "offline_render.h"
+#include "batch_render.h"
+#include "session_record.h"
+#include "async_writer.h"
+#include "file_playback.h"
+#include "stdout_stream.h"
+#include "resampler.h"
+#include "masker.h"
+#include "noise.h"
+
 #include <SDL2/SDL.h>
-#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <sstream>
 #include <iomanip>
-
-// Audio parameters
-constexpr int SAMPLE_RATE = 44100;           // Standard audio sample rate
-constexpr int TONE_FREQUENCY = 1000;         // 1kHz pure tone
-constexpr double TONE_DURATION_MS = 1.0;     // 1ms tone duration
-constexpr double STIMULUS_INTERVAL_MS = 25.0; // 25ms interval (40Hz)
-constexpr double AMPLITUDE = 0.5;            // Volume (0.0 - 1.0)
+#include <string>
+#include <unistd.h>
 
 // Session parameters
 constexpr int SESSION_DURATION_MINUTES = 60; // Auto-stop after 60 minutes
@@ -33,69 +55,59 @@ constexpr int SESSION_DURATION_MINUTES = 60; // Auto-stop after 60 minutes
 // Window parameters
 constexpr int WINDOW_WIDTH = 400;
 constexpr int WINDOW_HEIGHT = 200;
+constexpr double PULSE_STRIP_MS = 100.0;     // Audible history shown on the pulse strip
 
-// Derived constants
-constexpr int SAMPLES_PER_TONE = static_cast<int>(SAMPLE_RATE * TONE_DURATION_MS / 1000.0);
-constexpr int SAMPLES_PER_INTERVAL = static_cast<int>(SAMPLE_RATE * STIMULUS_INTERVAL_MS / 1000.0);
-
-// Global state
-std::atomic<bool> g_isPlaying{true};
-std::atomic<int> g_samplePosition{0};
-std::atomic<bool> g_continuousTone{false};  // For testing: continuous 1kHz tone
-
-/**
- * Generate a single sample of the 40Hz stimulus pattern
- */
-float generateSample(int position) {
-    double t = static_cast<double>(position) / SAMPLE_RATE;
-    
-    // Continuous tone mode for testing
-    if (g_continuousTone.load()) {
-        return static_cast<float>(AMPLITUDE * std::sin(2.0 * M_PI * TONE_FREQUENCY * t));
-    }
-    
-    // Position within current 25ms interval
-    int posInInterval = position % SAMPLES_PER_INTERVAL;
-    
-    // Only generate tone for first 1ms of each 25ms interval
-    if (posInInterval < SAMPLES_PER_TONE) {
-        // Generate 1kHz sine wave
-        double tLocal = static_cast<double>(posInInterval) / SAMPLE_RATE;
-        double sample = AMPLITUDE * std::sin(2.0 * M_PI * TONE_FREQUENCY * tLocal);
-        
-        // Apply envelope to avoid clicks (short fade in/out)
-        int fadeLength = SAMPLES_PER_TONE / 4;
-        if (posInInterval < fadeLength) {
-            sample *= static_cast<double>(posInInterval) / fadeLength;
-        } else if (posInInterval > SAMPLES_PER_TONE - fadeLength) {
-            sample *= static_cast<double>(SAMPLES_PER_TONE - posInInterval) / fadeLength;
-        }
-        
-        return static_cast<float>(sample);
-    }
-    
-    return 0.0f; // Silence between tones
-}
-
-/**
- * SDL audio callback function
- */
-void audioCallback(void* /*userdata*/, Uint8* stream, int len) {
-    float* buffer = reinterpret_cast<float*>(stream);
-    int samples = len / sizeof(float);
-    
-    int pos = g_samplePosition.load();
-    
-    for (int i = 0; i < samples; ++i) {
-        if (g_isPlaying.load()) {
-            buffer[i] = generateSample(pos + i);
-        } else {
-            buffer[i] = 0.0f;
-        }
-    }
-    
-    g_samplePosition.store(pos + samples);
-}
+struct Options {
+    std::string device;         // Preferred playback device (empty = default)
+    std::string backupDevice;   // Watchdog failover target
+    std::string shmName;        // Publish rendered blocks to this shared-memory ring
+    std::string shmRead;        // Reader tool: follow this ring
+    bool benchShm = false;
+    RtpConfig rtp;              // RTP output (enabled when destinations are given)
+    int rtpReceivePort = -1;    // Receiver mode
+    int rtpChannels = 1;        // Channels the receiver expects
+    double jitterMs = 20.0;
+    bool benchRtp = false;
+    int benchStartup = 0;       // Launches for the time-to-first-pulse benchmark
+    std::string onsetLog;       // Binary onset log path
+    std::string exportOnsets[2];  // Convert LOG to CSV
+    int triggerChannel = 0;     // 1-based sync-trigger channel (0 = mono output)
+    std::string lslName;        // LSL marker outlet stream name
+    std::string lslCheck;       // Inlet check: follow this stream
+    double lslCheckSeconds = 10.0;
+    FlickerConfig flicker;      // Full-screen 40Hz light in lockstep with the sound
+    PhaseLockConfig phaseLock;  // Closed loop (enabled when a socket path is given)
+    std::string eegSynth;       // Tool: synthetic EEG generator to this socket
+    bool phaseLockCheck = false;  // Feed the closed loop from an in-process generator
+    NetSyncConfig netSync;      // Multi-station start (coordinator port or agent address)
+    bool captureVerify = false; // Correlate a capture device (or WAV stand-in) against the pulses
+    CaptureVerifyConfig capture;
+    std::string captureTestWav; // Tool: write a synthetic loopback recording
+    double captureTestSeconds = 30.0;
+    bool triggerIn = false;     // Fire pulses from an audio-input threshold crossing
+    TriggerInputConfig triggerInput;
+    RenderConfig render;        // Tool: write a session file (enabled when a path is given)
+    bool renderFormatGiven = false;
+    double benchRender = 0.0;   // Offline render benchmark over this many seconds of audio
+    BatchConfig batch;          // Tool: render a manifest of variants (enabled when given)
+    std::string recordPath;     // Record the device output (.wav, .rf64, .w64)
+    bool recordCheck = false;   // Tool: streaming writer crash test
+    AsyncWriterConfig io;       // Disk writes for --render and --record
+    int benchIo = 0;            // Disk write benchmark over this many MB
+    FilePlaybackConfig playFile;  // Play a stimulus file (enabled when a path is given)
+    bool playFileCheck = false; // Tool: headless playback check of that file
+    bool toStdout = false;      // Tool: stream raw PCM to stdout
+    StdoutConfig stdoutPcm;
+    double benchStdout = 0.0;   // Pipe throughput benchmark over this many seconds of audio
+    double benchResample = 0.0; // Sample-rate conversion benchmark over this many seconds per hop
+    std::vector<MaskerConfig> maskers;  // Background files mixed under the pulses
+    bool maskerCheck = false;   // Tool: headless masker mixer check
+    NoiseMode noise = NOISE_OFF;  // Noise under (mask) or instead of (sham) the pulses
+    NoiseConfig noiseConfig;
+    double benchNoise = 0.0;    // Noise generator benchmark over this many seconds per source
+    double checkSeconds = 0.0;  // Headless run (offscreen video, dummy audio) for this long
+    bool listDevices = false;
+};
 
 /**
  * Draw a filled rectangle
@@ -107,28 +119,23 @@ void drawRect(SDL_Renderer* renderer, int x, int y, int w, int h, Uint8 r, Uint8
 }
 
 /**
- * Draw visual feedback for audio pulses
+ * Draw visual feedback for audio pulses. The indicator shows the state
+ * only: sampling a 1ms pulse at 60fps would alias into random flashes, so
+ * timing is left to the pulse strip.
  */
-void drawPulseIndicator(SDL_Renderer* renderer, int samplePos) {
-    int posInInterval = samplePos % SAMPLES_PER_INTERVAL;
-    bool isPulsing = posInInterval < SAMPLES_PER_TONE;
-    
+void drawPulseIndicator(SDL_Renderer* renderer) {
     // Pulse indicator circle (simulated with rectangles)
     int centerX = WINDOW_WIDTH / 2;
     int centerY = 80;
-    int baseSize = 30;
-    int size = isPulsing ? baseSize + 15 : baseSize;
-    
+    int size = 30;
+
     if (g_isPlaying.load()) {
         if (g_continuousTone.load()) {
             // Blue for continuous tone
             drawRect(renderer, centerX - size, centerY - size, size * 2, size * 2, 50, 150, 255);
-        } else if (isPulsing) {
-            // Bright green when pulsing
-            drawRect(renderer, centerX - size, centerY - size, size * 2, size * 2, 0, 255, 100);
         } else {
-            // Dim green between pulses
-            drawRect(renderer, centerX - size, centerY - size, size * 2, size * 2, 0, 100, 50);
+            // Green while the 40Hz train is playing
+            drawRect(renderer, centerX - size, centerY - size, size * 2, size * 2, 0, 200, 100);
         }
     } else {
         // Gray when paused
@@ -136,13 +143,43 @@ void drawPulseIndicator(SDL_Renderer* renderer, int samplePos) {
     }
 }
 
+/**
+ * Scrolling strip of the last PULSE_STRIP_MS of audible time, "now" at the
+ * right edge. Each pulse is drawn where it actually sounded, so the gap to
+ * the right edge is the acoustic pulse phase at any frame rate.
+ */
+void drawPulseStrip(SDL_Renderer* renderer, int64_t hostNs) {
+    const int x0 = 20, y0 = 132, width = WINDOW_WIDTH - 40, height = 12;
+    drawRect(renderer, x0, y0, width, height, 50, 50, 55);
+
+    double heard;
+    if (!audibleFrameAt(hostNs, heard)) return;
+    if (g_isPlaying.load() && g_continuousTone.load()) {
+        drawRect(renderer, x0, y0, width, height, 50, 150, 255);
+        return;
+    }
+
+    // Delivered onsets rather than the grid, so closed-loop timing shows too
+    int64_t onsets[ONSET_HISTORY];
+    int count = recentOnsets(onsets, ONSET_HISTORY);
+    double spanFrames = PULSE_STRIP_MS * SAMPLE_RATE / 1000.0;
+    double pxPerFrame = width / spanFrames;
+    int toneWidth = std::max(2, static_cast<int>(SAMPLES_PER_TONE * pxPerFrame));
+    for (int i = 0; i < count; ++i) {
+        double age = heard - onsets[i];
+        if (age < 0.0 || age >= spanFrames) continue;
+        int x = x0 + width - static_cast<int>(age * pxPerFrame);
+        drawRect(renderer, x, y0, std::min(toneWidth, x0 + width - x), height, 0, 255, 100);
+    }
+}
+
 /**
  * Draw status indicators
  */
 void drawStatus(SDL_Renderer* renderer, int elapsedSeconds) {
     // Status bar background
     drawRect(renderer, 0, WINDOW_HEIGHT - 50, WINDOW_WIDTH, 50, 40, 40, 40);
-    
+
     // Play/Pause indicator
     if (g_isPlaying.load()) {
         // Green play indicator
@@ -152,7 +189,7 @@ void drawStatus(SDL_Renderer* renderer, int elapsedSeconds) {
         drawRect(renderer, 20, WINDOW_HEIGHT - 35, 8, 20, 200, 50, 50);
         drawRect(renderer, 32, WINDOW_HEIGHT - 35, 8, 20, 200, 50, 50);
     }
-    
+
     // Mode indicator
     if (g_continuousTone.load()) {
         // Blue for test mode
@@ -161,7 +198,12 @@ void drawStatus(SDL_Renderer* renderer, int elapsedSeconds) {
         // Green for normal 40Hz mode
         drawRect(renderer, 60, WINDOW_HEIGHT - 35, 60, 20, 0, 150, 100);
     }
-    
+
+    // Watchdog flag: audio callback stalled
+    if (g_watchdogState.load() >= WATCHDOG_STALLED) {
+        drawRect(renderer, 0, 0, WINDOW_WIDTH, 6, 220, 40, 40);
+    }
+
     // Time bar (progress visualization)
     int minutes = elapsedSeconds / 60;
     int barWidth = (minutes % 60) * (WINDOW_WIDTH - 160) / 60;
@@ -205,73 +247,635 @@ void printInfo() {
     std::cout << "========================================\n";
 }
 
-int main(int /*argc*/, char* /*argv*/[]) {
+void printUsage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [options]\n"
+              << "  --device NAME         Preferred playback device\n"
+              << "  --backup-device NAME  Device to fail over to if the callback stalls\n"
+              << "  --list-devices        List playback devices and exit\n"
+              << "  --shm NAME            Publish rendered blocks to a POSIX shared-memory ring\n"
+              << "  --shm-read NAME       Attach to a ring and print statistics\n"
+              << "  --bench-shm           Shared-memory ring throughput test\n"
+              << "  --rtp-send HOST:PORT  Stream rendered audio as RTP (repeatable)\n"
+              << "  --rtp-format L16|L24  RTP payload format (default L16)\n"
+              << "  --rtp-ptime MS        RTP packet time (default 1)\n"
+              << "  --rtp-loss PCT        Drop this share of RTP packets (testing)\n"
+              << "  --rtp-receive PORT    Play an RTP stream through the default device\n"
+              << "  --rtp-channels N      Channels of the received stream, as the sender's layout (default 1)\n"
+              << "  --jitter-ms MS        Receiver jitter buffer (default 20)\n"
+              << "  --bench-rtp           RTP loopback latency / loss test\n"
+              << "  --bench-startup N     Time from process start to first pulse over N launches\n"
+              << "  --onset-log FILE      Log frame index and host time of every pulse onset\n"
+              << "  --export-onsets LOG CSV  Convert an onset log to CSV (CSV '-' = stdout)\n"
+              << "  --trigger-channel N   Open N channels and put the sync marker on channel N\n"
+              << "  --lsl NAME            Publish pulse and session markers as an LSL stream\n"
+              << "  --lsl-check NAME [S]  Follow an LSL marker stream for S seconds (default 10)\n"
+              << "  --lsl-serve NAME S    Headless LSL outlet (offscreen video, dummy audio) for S seconds\n"
+              << "  --flicker             Full-screen 40Hz flashes locked to the audible pulses\n"
+              << "  --flicker-hz HZ       Display refresh rate (default: current display mode)\n"
+              << "  --av-offset-ms MS     Delay the flashes by MS relative to the sound\n"
+              << "  --flicker-log FILE    Record every present timestamp as CSV\n"
+              << "  --flicker-check S     Headless flicker run (offscreen video, dummy audio) for S seconds\n"
+              << "  --phase-lock PATH     Time pulses to the EEG gamma phase received on a UNIX socket\n"
+              << "  --phase-target DEG    EEG phase at which pulses are heard (default 0 = peak)\n"
+              << "  --phase-center HZ     Centre of the tracked gamma band (default 40)\n"
+              << "  --eeg-synth PATH      Send synthetic gamma-band EEG to a phase-lock socket\n"
+              << "  --phase-lock-check S  Headless closed loop on a synthetic EEG stream for S seconds\n"
+              << "  --sync-coordinator PORT  Coordinate a multi-station start on UDP PORT\n"
+              << "  --sync-agents N       Agents the coordinator waits for (default 0)\n"
+              << "  --sync-agent HOST:PORT  Start together with the coordinator at HOST:PORT\n"
+              << "  --sync-lead S         Seconds from all agents ready to the start (default 2)\n"
+              << "  --sync-sim-offset-ms MS  Simulated station clock offset, for testing\n"
+              << "  --sync-sim-skew-ppm PPM  Simulated station clock skew, for testing\n"
+              << "  --sync-check S        Headless synchronized start, checked against the same-host clock\n"
+              << "  --capture-verify      Record a loopback/reference mic and check every delivered pulse\n"
+              << "  --capture-device NAME Capture device for --capture-verify (default: system default)\n"
+              << "  --capture-file WAV    Use a WAV recording in place of the capture device\n"
+              << "  --capture-log FILE    Per-pulse capture latency as CSV\n"
+              << "  --capture-test-wav FILE [S]  Write an S-second synthetic loopback recording (default 30)\n"
+              << "  --capture-check WAV S Headless capture verification against a test recording\n"
+              << "  --trigger-in          Fire each pulse from a threshold crossing on an audio input\n"
+              << "  --trigger-in-device NAME  Capture device for --trigger-in (default: system default)\n"
+              << "  --trigger-in-channel N    Input channel to watch, 1-based (default 1)\n"
+              << "  --trigger-in-threshold L  Crossing level, 0..1 (default 0.5)\n"
+              << "  --trigger-in-debounce-ms MS  Ignore contact bounce for this long (default 20)\n"
+              << "  --trigger-in-check S  Headless triggered run from a synthetic response box\n"
+              << "  --render FILE         Write a session to FILE at disk speed and exit (.wav, .rf64, .w64, .raw, .flac)\n"
+              << "  --render-seconds S    Session length for --render / --stdout (default 3600)\n"
+              << "  --render-format F     wav, rf64, w64 (32-bit float), raw (float32) or flac, default from the extension\n"
+              << "  --render-bits N       Bits per sample for FLAC: 16 (default) or 24\n"
+              << "  --render-threads N    Render / batch threads (default: one per core)\n"
+              << "  --batch MANIFEST      Render every protocol variant in MANIFEST not already cached\n"
+              << "  --batch-dir DIR       Content-addressed output directory for --batch (default renders)\n"
+              << "  --record FILE         Record the device output to FILE (.wav, .rf64, .w64), flushed every second\n"
+              << "  --record-check        Crash test of the streaming WAV / RF64 / Wave64 writer\n"
+              << "  --io-depth N          Disk writes in flight for --render / --record (default 8)\n"
+              << "  --io-direct           Write --render / --record output with O_DIRECT (bypass the page cache)\n"
+              << "  --io-threads          Write through a thread pool instead of io_uring\n"
+              << "  --bench-render [S]    Offline render speed against thread count (default 600 s of audio)\n"
+              << "  --bench-io [MB]       Disk write speed: write() against io_uring and threads (default 1024 MB)\n"
+              << "  --play-file FILE      Play a stimulus file (.wav, .rf64, .w64) as given, from a memory mapping\n"
+              << "  --play-file-onset N   File frame of the file's first pulse (default 0)\n"
+              << "  --play-file-check FILE  Headless playback of FILE: samples, onsets and page faults\n"
+              << "  --stdout [FORMAT]     Stream raw PCM to stdout and exit: s16le, s24le, s32le or f32le (default)\n"
+              << "  --stdout-vmsplice     Map --stdout pages into the pipe; only for readers that use read()\n"
+              << "  --bench-stdout [S]    Pipe throughput, write() against vmsplice (default 3600 s of audio)\n"
+              << "  --bench-resample [S]  Sample-rate conversion speed and SNR, 44.1/48/96 kHz (default 60 s per hop)\n"
+              << "  --masker FILE         Mix a background file (music, noise) under the pulses, looped (up to 4)\n"
+              << "  --masker-gain DB      Level of the last --masker (default -20 dB)\n"
+              << "  --masker-duck DB      Extra gain of the last --masker while the pulses play (default -6 dB, 0 = off)\n"
+              << "  --masker-once         Play the last --masker once instead of looping it\n"
+              << "  --masker-check        Headless masker check: fidelity, ducking and a decoder stall\n"
+              << "  --noise COLOR         Add noise under the pulses: white, pink, brown or band (around the tone)\n"
+              << "  --sham                Play the noise instead of the pulses, markers unchanged (default pink)\n"
+              << "  --noise-level DB      Noise level, dB full scale RMS (default -30)\n"
+              << "  --noise-seed N        Noise seed; the same seed gives the same noise (default 1)\n"
+              << "  --bench-noise [S]     Noise generator speed, determinism and spectra (default 60 s per source)\n";
+}
+
+/**
+ * Stop playback and every sink fed from the audio thread. Each stop is a
+ * no-op for a part that never started, so this also unwinds a failed start.
+ */
+void stopAll(AudioOutput& audio) {
+    stopWatchdog();
+    closeAudioOutput(audio);
+    stopFilePlayback();
+    stopMaskers();
+    stopShmOutput();
+    stopRtpOutput();
+    stopPhaseLock();
+    stopEegSynth();
+    stopNetSync();
+    stopCaptureVerify();
+    stopTriggerInput();
+    stopSessionRecord();
+    stopOnsetLog();
+    stopLslOutlet();
+    stopClockDrift();
+}
+
+/**
+ * Parse command line options
+ */
+bool parseArgs(int argc, char* argv[], Options& opts) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "--device") == 0 && i + 1 < argc) {
+            opts.device = argv[++i];
+        } else if (std::strcmp(arg, "--backup-device") == 0 && i + 1 < argc) {
+            opts.backupDevice = argv[++i];
+        } else if (std::strcmp(arg, "--list-devices") == 0) {
+            opts.listDevices = true;
+        } else if (std::strcmp(arg, "--shm") == 0 && i + 1 < argc) {
+            opts.shmName = argv[++i];
+        } else if (std::strcmp(arg, "--shm-read") == 0 && i + 1 < argc) {
+            opts.shmRead = argv[++i];
+        } else if (std::strcmp(arg, "--bench-shm") == 0) {
+            opts.benchShm = true;
+        } else if (std::strcmp(arg, "--rtp-send") == 0 && i + 1 < argc) {
+            opts.rtp.destinations.push_back(argv[++i]);
+        } else if (std::strcmp(arg, "--rtp-format") == 0 && i + 1 < argc) {
+            if (!parseRtpEncoding(argv[++i], opts.rtp.encoding)) {
+                std::cerr << "Unknown RTP format: " << argv[i] << "\n";
+                return false;
+            }
+        } else if (std::strcmp(arg, "--rtp-ptime") == 0 && i + 1 < argc) {
+            opts.rtp.ptimeMs = std::atof(argv[++i]);
+        } else if (std::strcmp(arg, "--rtp-loss") == 0 && i + 1 < argc) {
+            opts.rtp.lossPercent = std::atof(argv[++i]);
+        } else if (std::strcmp(arg, "--rtp-receive") == 0 && i + 1 < argc) {
+            opts.rtpReceivePort = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--rtp-channels") == 0 && i + 1 < argc) {
+            opts.rtpChannels = std::clamp(std::atoi(argv[++i]), 1, MAX_OUTPUT_CHANNELS);
+        } else if (std::strcmp(arg, "--jitter-ms") == 0 && i + 1 < argc) {
+            opts.jitterMs = std::atof(argv[++i]);
+        } else if (std::strcmp(arg, "--bench-rtp") == 0) {
+            opts.benchRtp = true;
+        } else if (std::strcmp(arg, "--bench-startup") == 0 && i + 1 < argc) {
+            opts.benchStartup = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(arg, "--onset-log") == 0 && i + 1 < argc) {
+            opts.onsetLog = argv[++i];
+        } else if (std::strcmp(arg, "--export-onsets") == 0 && i + 2 < argc) {
+            opts.exportOnsets[0] = argv[++i];
+            opts.exportOnsets[1] = argv[++i];
+        } else if (std::strcmp(arg, "--trigger-channel") == 0 && i + 1 < argc) {
+            opts.triggerChannel = std::atoi(argv[++i]);
+            if (opts.triggerChannel < 2 || opts.triggerChannel > MAX_OUTPUT_CHANNELS) {
+                std::cerr << "--trigger-channel must be between 2 and " << MAX_OUTPUT_CHANNELS << "\n";
+                return false;
+            }
+        } else if (std::strcmp(arg, "--lsl") == 0 && i + 1 < argc) {
+            opts.lslName = argv[++i];
+        } else if (std::strcmp(arg, "--lsl-check") == 0 && i + 1 < argc) {
+            opts.lslCheck = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                opts.lslCheckSeconds = std::atof(argv[++i]);
+            }
+        } else if (std::strcmp(arg, "--lsl-serve") == 0 && i + 2 < argc) {
+            opts.lslName = argv[++i];
+            opts.checkSeconds = std::max(1.0, std::atof(argv[++i]));
+        } else if (std::strcmp(arg, "--flicker") == 0) {
+            opts.flicker.enabled = true;
+        } else if (std::strcmp(arg, "--flicker-hz") == 0 && i + 1 < argc) {
+            opts.flicker.refreshHz = std::atof(argv[++i]);
+        } else if (std::strcmp(arg, "--av-offset-ms") == 0 && i + 1 < argc) {
+            opts.flicker.avOffsetMs = std::atof(argv[++i]);
+        } else if (std::strcmp(arg, "--flicker-log") == 0 && i + 1 < argc) {
+            opts.flicker.logPath = argv[++i];
+        } else if (std::strcmp(arg, "--flicker-check") == 0 && i + 1 < argc) {
+            opts.flicker.enabled = true;
+            opts.checkSeconds = std::max(1.0, std::atof(argv[++i]));
+        } else if (std::strcmp(arg, "--phase-lock") == 0 && i + 1 < argc) {
+            opts.phaseLock.socketPath = argv[++i];
+        } else if (std::strcmp(arg, "--phase-target") == 0 && i + 1 < argc) {
+            opts.phaseLock.targetPhaseDeg = std::atof(argv[++i]);
+        } else if (std::strcmp(arg, "--phase-center") == 0 && i + 1 < argc) {
+            opts.phaseLock.centerHz = std::atof(argv[++i]);
+        } else if (std::strcmp(arg, "--eeg-synth") == 0 && i + 1 < argc) {
+            opts.eegSynth = argv[++i];
+        } else if (std::strcmp(arg, "--phase-lock-check") == 0 && i + 1 < argc) {
+            opts.phaseLockCheck = true;
+            opts.checkSeconds = std::max(1.0, std::atof(argv[++i]));
+            if (opts.phaseLock.socketPath.empty()) {
+                opts.phaseLock.socketPath = "/tmp/pnas_eeg_" + std::to_string(getpid()) + ".sock";
+            }
+        } else if (std::strcmp(arg, "--sync-coordinator") == 0 && i + 1 < argc) {
+            opts.netSync.coordinatorPort = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--sync-agents") == 0 && i + 1 < argc) {
+            opts.netSync.agents = std::max(0, std::atoi(argv[++i]));
+        } else if (std::strcmp(arg, "--sync-agent") == 0 && i + 1 < argc) {
+            opts.netSync.coordinator = argv[++i];
+        } else if (std::strcmp(arg, "--sync-lead") == 0 && i + 1 < argc) {
+            opts.netSync.leadSeconds = std::max(0.5, std::atof(argv[++i]));
+        } else if (std::strcmp(arg, "--sync-sim-offset-ms") == 0 && i + 1 < argc) {
+            opts.netSync.simOffsetMs = std::atof(argv[++i]);
+        } else if (std::strcmp(arg, "--sync-sim-skew-ppm") == 0 && i + 1 < argc) {
+            opts.netSync.simSkewPpm = std::atof(argv[++i]);
+        } else if (std::strcmp(arg, "--sync-check") == 0 && i + 1 < argc) {
+            opts.netSync.check = true;
+            opts.checkSeconds = std::max(1.0, std::atof(argv[++i]));
+        } else if (std::strcmp(arg, "--capture-verify") == 0) {
+            opts.captureVerify = true;
+        } else if (std::strcmp(arg, "--capture-device") == 0 && i + 1 < argc) {
+            opts.captureVerify = true;
+            opts.capture.device = argv[++i];
+        } else if (std::strcmp(arg, "--capture-file") == 0 && i + 1 < argc) {
+            opts.captureVerify = true;
+            opts.capture.file = argv[++i];
+        } else if (std::strcmp(arg, "--capture-log") == 0 && i + 1 < argc) {
+            opts.capture.logPath = argv[++i];
+        } else if (std::strcmp(arg, "--capture-test-wav") == 0 && i + 1 < argc) {
+            opts.captureTestWav = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                opts.captureTestSeconds = std::max(1.0, std::atof(argv[++i]));
+            }
+        } else if (std::strcmp(arg, "--capture-check") == 0 && i + 2 < argc) {
+            opts.captureVerify = true;
+            opts.capture.check = true;
+            opts.capture.file = argv[++i];
+            opts.checkSeconds = std::max(1.0, std::atof(argv[++i]));
+        } else if (std::strcmp(arg, "--trigger-in") == 0) {
+            opts.triggerIn = true;
+        } else if (std::strcmp(arg, "--trigger-in-device") == 0 && i + 1 < argc) {
+            opts.triggerIn = true;
+            opts.triggerInput.device = argv[++i];
+        } else if (std::strcmp(arg, "--trigger-in-channel") == 0 && i + 1 < argc) {
+            opts.triggerInput.channel = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(arg, "--trigger-in-threshold") == 0 && i + 1 < argc) {
+            opts.triggerInput.threshold = std::clamp(std::atof(argv[++i]), 0.01, 1.0);
+        } else if (std::strcmp(arg, "--trigger-in-debounce-ms") == 0 && i + 1 < argc) {
+            opts.triggerInput.debounceMs = std::max(0.0, std::atof(argv[++i]));
+        } else if (std::strcmp(arg, "--trigger-in-check") == 0 && i + 1 < argc) {
+            opts.triggerIn = true;
+            opts.triggerInput.standIn = true;
+            opts.checkSeconds = std::max(1.0, std::atof(argv[++i]));
+        } else if (std::strcmp(arg, "--render") == 0 && i + 1 < argc) {
+            opts.render.path = argv[++i];
+        } else if (std::strcmp(arg, "--render-seconds") == 0 && i + 1 < argc) {
+            opts.render.seconds = std::max(1.0 / SAMPLE_RATE, std::atof(argv[++i]));
+        } else if (std::strcmp(arg, "--render-format") == 0 && i + 1 < argc) {
+            if (!parseRenderFormat(argv[++i], opts.render.format)) {
+                std::cerr << "Unknown render format: " << argv[i] << "\n";
+                return false;
+            }
+            opts.renderFormatGiven = true;
+        } else if (std::strcmp(arg, "--render-bits") == 0 && i + 1 < argc) {
+            opts.render.bits = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--render-threads") == 0 && i + 1 < argc) {
+            opts.render.threads = std::max(1, std::atoi(argv[++i]));
+            opts.batch.threads = opts.render.threads;
+        } else if (std::strcmp(arg, "--batch") == 0 && i + 1 < argc) {
+            opts.batch.manifest = argv[++i];
+        } else if (std::strcmp(arg, "--batch-dir") == 0 && i + 1 < argc) {
+            opts.batch.dir = argv[++i];
+        } else if (std::strcmp(arg, "--record") == 0 && i + 1 < argc) {
+            opts.recordPath = argv[++i];
+        } else if (std::strcmp(arg, "--record-check") == 0) {
+            opts.recordCheck = true;
+        } else if (std::strcmp(arg, "--io-depth") == 0 && i + 1 < argc) {
+            opts.io.queueDepth = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(arg, "--io-direct") == 0) {
+            opts.io.direct = true;
+        } else if (std::strcmp(arg, "--io-threads") == 0) {
+            opts.io.forceThreads = true;
+        } else if (std::strcmp(arg, "--play-file") == 0 && i + 1 < argc) {
+            opts.playFile.path = argv[++i];
+        } else if (std::strcmp(arg, "--play-file-onset") == 0 && i + 1 < argc) {
+            opts.playFile.firstOnset = std::max(0LL, std::atoll(argv[++i]));
+        } else if (std::strcmp(arg, "--play-file-check") == 0 && i + 1 < argc) {
+            opts.playFile.path = argv[++i];
+            opts.playFileCheck = true;
+        } else if (std::strcmp(arg, "--stdout") == 0) {
+            opts.toStdout = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-' && !parsePcmFormat(argv[++i], opts.stdoutPcm.format)) {
+                std::cerr << "Unknown PCM format: " << argv[i] << "\n";
+                return false;
+            }
+        } else if (std::strcmp(arg, "--stdout-vmsplice") == 0) {
+            opts.stdoutPcm.vmsplice = true;
+        } else if (std::strcmp(arg, "--bench-stdout") == 0) {
+            opts.benchStdout = 3600.0;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                opts.benchStdout = std::max(1.0, std::atof(argv[++i]));
+            }
+        } else if (std::strcmp(arg, "--bench-resample") == 0) {
+            opts.benchResample = 60.0;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                opts.benchResample = std::max(1.0, std::atof(argv[++i]));
+            }
+        } else if (std::strcmp(arg, "--masker") == 0 && i + 1 < argc) {
+            if (opts.maskers.size() == MAX_MASKERS) {
+                std::cerr << "At most " << MAX_MASKERS << " maskers\n";
+                return false;
+            }
+            opts.maskers.emplace_back();
+            opts.maskers.back().path = argv[++i];
+        } else if ((std::strcmp(arg, "--masker-gain") == 0 || std::strcmp(arg, "--masker-duck") == 0) && i + 1 < argc) {
+            if (opts.maskers.empty()) {
+                std::cerr << arg << " must follow a --masker\n";
+                return false;
+            }
+            double db = std::min(0.0, std::atof(argv[++i]));
+            if (std::strcmp(arg, "--masker-gain") == 0) {
+                opts.maskers.back().gainDb = db;
+            } else {
+                opts.maskers.back().duckDb = db;
+            }
+        } else if (std::strcmp(arg, "--masker-once") == 0) {
+            if (opts.maskers.empty()) {
+                std::cerr << arg << " must follow a --masker\n";
+                return false;
+            }
+            opts.maskers.back().loop = false;
+        } else if (std::strcmp(arg, "--masker-check") == 0) {
+            opts.maskerCheck = true;
+        } else if (std::strcmp(arg, "--noise") == 0 && i + 1 < argc) {
+            if (!parseNoiseColor(argv[++i], opts.noiseConfig.color)) {
+                std::cerr << "Unknown noise color: " << argv[i] << " (white, pink, brown, band)\n";
+                return false;
+            }
+            if (opts.noise == NOISE_OFF) opts.noise = NOISE_MASK;
+        } else if (std::strcmp(arg, "--sham") == 0) {
+            opts.noise = NOISE_SHAM;
+        } else if (std::strcmp(arg, "--noise-level") == 0 && i + 1 < argc) {
+            opts.noiseConfig.levelDb = std::min(0.0, std::atof(argv[++i]));
+        } else if (std::strcmp(arg, "--noise-seed") == 0 && i + 1 < argc) {
+            opts.noiseConfig.seed = std::strtoull(argv[++i], nullptr, 0);
+        } else if (std::strcmp(arg, "--bench-noise") == 0) {
+            opts.benchNoise = 60.0;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                opts.benchNoise = std::max(1.0, std::atof(argv[++i]));
+            }
+        } else if (std::strcmp(arg, "--bench-io") == 0) {
+            opts.benchIo = 1024;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                opts.benchIo = std::max(4, std::atoi(argv[++i]));
+            }
+        } else if (std::strcmp(arg, "--bench-render") == 0) {
+            opts.benchRender = 600.0;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                opts.benchRender = std::max(1.0, std::atof(argv[++i]));
+            }
+        } else if (std::strcmp(arg, "--startup-probe") == 0) {
+            g_startupProbe = true;
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    // A stimulus file fixes where the pulses are
+    if (!opts.playFile.path.empty() && (opts.triggerIn || !opts.phaseLock.socketPath.empty())) {
+        std::cerr << "--play-file cannot be combined with --trigger-in or --phase-lock\n";
+        return false;
+    }
+    // Noise is part of the synthesized stimulus, which a file replaces and
+    // triggered mode gates to the burst
+    if (opts.noise != NOISE_OFF && (!opts.playFile.path.empty() || opts.triggerIn)) {
+        std::cerr << "--noise and --sham cannot be combined with --play-file or --trigger-in\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    if (!parseArgs(argc, argv, opts)) {
+        return 1;
+    }
+
+    // Headless tools
+    if (!opts.shmRead.empty()) {
+        return runShmReader(opts.shmRead);
+    }
+    if (opts.benchShm) {
+        return runShmBenchmark();
+    }
+    if (opts.rtpReceivePort >= 0) {
+        return runRtpReceiver(opts.rtpReceivePort, opts.rtpChannels, opts.jitterMs);
+    }
+    if (opts.benchRtp) {
+        return runRtpBenchmark(opts.rtp, opts.jitterMs);
+    }
+    if (opts.benchStartup > 0) {
+        return runStartupBenchmark(argv[0], opts.benchStartup);
+    }
+    if (!opts.exportOnsets[0].empty()) {
+        return exportOnsetCsv(opts.exportOnsets[0], opts.exportOnsets[1]);
+    }
+    if (!opts.lslCheck.empty()) {
+        return runLslCheck(opts.lslCheck, opts.lslCheckSeconds);
+    }
+    if (!opts.eegSynth.empty()) {
+        return runEegSynth(opts.eegSynth, EegSynthConfig());
+    }
+    if (!opts.captureTestWav.empty()) {
+        return writeCaptureTestWav(opts.captureTestWav, opts.captureTestSeconds);
+    }
+    if (opts.recordCheck) {
+        return runRecordCheck();
+    }
+    if (opts.benchResample > 0.0) {
+        return runResamplerBenchmark(opts.benchResample);
+    }
+    if (opts.benchNoise > 0.0) {
+        return runNoiseBenchmark(opts.benchNoise);
+    }
+    if (opts.maskerCheck) {
+        if (opts.triggerChannel > 0) {
+            setOutputLayout(opts.triggerChannel, opts.triggerChannel - 1);
+        }
+        return runMaskerCheck();
+    }
+    if (opts.playFileCheck) {
+        if (opts.triggerChannel > 0) {
+            setOutputLayout(opts.triggerChannel, opts.triggerChannel - 1);
+        }
+        return runFilePlaybackCheck(opts.playFile);
+    }
+    if (!opts.batch.manifest.empty()) {
+        return runBatchRender(opts.batch);
+    }
+    if (opts.noise != NOISE_OFF) {
+        setStimulusNoise(opts.noise, opts.noiseConfig);
+    }
+    if (!opts.render.path.empty() || opts.benchRender > 0.0 || opts.benchIo > 0 || opts.toStdout ||
+        opts.benchStdout > 0.0) {
+        if (opts.triggerChannel > 0) {
+            setOutputLayout(opts.triggerChannel, opts.triggerChannel - 1);
+        }
+        if (opts.toStdout) {
+            opts.stdoutPcm.seconds = opts.render.seconds;
+            return runStdoutStream(opts.stdoutPcm);
+        }
+        if (opts.benchStdout > 0.0) {
+            return runStdoutBenchmark(opts.benchStdout);
+        }
+        if (opts.benchRender > 0.0) {
+            return runRenderBenchmark(opts.benchRender);
+        }
+        if (opts.benchIo > 0) {
+            return runIoBenchmark("pnas", opts.benchIo);
+        }
+        if (!opts.renderFormatGiven && !parseRenderFormat(opts.render.path, opts.render.format)) {
+            std::cerr << "Cannot tell the format of " << opts.render.path << "; use --render-format\n";
+            return 1;
+        }
+        opts.render.io = opts.io;
+        return runOfflineRender(opts.render);
+    }
+
     printInfo();
-    
-    // Initialize SDL
-    if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO | SDL_INIT_EVENTS) < 0) {
+
+    // Headless checks: no display or sound card needed
+    if (opts.checkSeconds > 0.0) {
+        setenv("SDL_VIDEODRIVER", "offscreen", 0);
+        setenv("SDL_AUDIODRIVER", "dummy", 0);
+    }
+
+    // Audio comes up first so the first pulse never waits on GPU or
+    // window-system setup; video is initialized once sound is running.
+    if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_EVENTS) < 0) {
         std::cerr << "SDL initialization failed: " << SDL_GetError() << std::endl;
         return 1;
     }
-    
+
+    if (opts.listDevices) {
+        listAudioOutputs();
+        SDL_Quit();
+        return 0;
+    }
+
+    // Render tables are built once and reused across device reopens
+    buildRenderTables();
+    if (opts.triggerChannel > 0) {
+        setOutputLayout(opts.triggerChannel, opts.triggerChannel - 1);
+        std::cout << "Sync trigger on channel " << opts.triggerChannel
+                  << " (stimulus on channels 1-" << opts.triggerChannel - 1 << ")\n";
+    }
+    if (opts.noise != NOISE_OFF) {
+        std::cout << (opts.noise == NOISE_SHAM ? "Sham: " : "Masking noise: ") << noiseColorName(opts.noiseConfig.color)
+                  << " at " << opts.noiseConfig.levelDb << " dBFS, seed " << opts.noiseConfig.seed << "\n";
+    }
+
+    // One teardown for every failed start below
+    AudioOutput audio;
+    SDL_Window* window = nullptr;
+    SDL_Renderer* renderer = nullptr;
+    auto fail = [&] {
+        if (renderer) SDL_DestroyRenderer(renderer);
+        if (window) SDL_DestroyWindow(window);
+        stopAll(audio);
+        SDL_Quit();
+        return 1;
+    };
+    if (!opts.playFile.path.empty() && !startFilePlayback(opts.playFile)) {
+        return fail();
+    }
+    if (!startMaskers(opts.maskers)) {
+        return fail();
+    }
+
+    // Open audio device: explicit choice, else the last device that worked
+    audio.preferred = opts.device;
+    audio.backup = opts.backupDevice;
+    if (audio.preferred.empty() && loadLastGoodOutput(audio)) {
+        std::cout << "Using last-good audio device '" << audio.preferred << "'\n";
+    }
+    // A triggered pulse waits for the next output block: keep blocks short
+    if (opts.triggerIn) {
+        audio.bufferFrames = TRIGGER_OUTPUT_BUFFER_FRAMES;
+    }
+
+    if (!openAudioOutput(audio)) {
+        return fail();
+    }
+
+    std::cout << "\nAudio device opened successfully.\n";
+    std::cout << "Starting 40Hz stimulation...\n\n";
+
+    if (!opts.shmName.empty() &&
+        !startShmOutput(opts.shmName, audio.spec.freq, audio.spec.channels, audio.spec.samples)) {
+        return fail();
+    }
+
+    if (!opts.rtp.destinations.empty() &&
+        !startRtpOutput(opts.rtp, audio.spec.freq, audio.spec.channels)) {
+        return fail();
+    }
+
+    if (!opts.onsetLog.empty() && !startOnsetLog(opts.onsetLog, audio.spec.freq)) {
+        return fail();
+    }
+
+    if (!opts.lslName.empty() && !startLslOutlet(opts.lslName, audio.spec.freq)) {
+        return fail();
+    }
+
+    if (!opts.phaseLock.socketPath.empty() && !startPhaseLock(opts.phaseLock)) {
+        return fail();
+    }
+    if (opts.phaseLockCheck) {
+        startEegSynth(opts.phaseLock.socketPath, EegSynthConfig());
+    }
+
+    // Multi-station session: stay silent until the agreed start
+    bool netSync = opts.netSync.coordinatorPort > 0 || !opts.netSync.coordinator.empty();
+    if (netSync) {
+        g_isPlaying.store(false);
+        if (!startNetSync(opts.netSync)) {
+            return fail();
+        }
+    }
+
+    // Capture opens before playback starts so the first pulse is recorded
+    if (opts.captureVerify && !startCaptureVerify(opts.capture, audio.spec.freq)) {
+        return fail();
+    }
+
+    if (opts.triggerIn && !startTriggerInput(opts.triggerInput, audio.spec.freq)) {
+        return fail();
+    }
+
+    if (!opts.recordPath.empty() &&
+        !startSessionRecord(opts.recordPath, audio.spec.freq, audio.spec.channels, opts.io)) {
+        return fail();
+    }
+
+    // Frame 0: stamped from the first block once the device is running
+    lslSessionEvent(LSL_SESSION_START);
+
+    // Device clock vs steady_clock, reported live and at exit
+    startClockDrift(audio.spec.freq);
+
+    // Start audio playback under the watchdog
+    startWatchdog(!audio.backup.empty());
+    startAudioOutput(audio);
+    saveLastGoodOutput(audio);
+    reportStartupMark("audio_open", hostTimeNs());
+    std::cout << "Watchdog: stalls detected within " << watchdogDetectionBoundMs() << " ms\n";
+
+    // Video second
+    if (SDL_InitSubSystem(SDL_INIT_VIDEO) < 0) {
+        std::cerr << "SDL video initialization failed: " << SDL_GetError() << std::endl;
+        return fail();
+    }
+
     // Create window
-    SDL_Window* window = SDL_CreateWindow(
+    window = SDL_CreateWindow(
         "40Hz Stimulation | SPACE:Pause  T:Test  Q:Quit",
         SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
         WINDOW_WIDTH, WINDOW_HEIGHT,
-        SDL_WINDOW_SHOWN
+        SDL_WINDOW_SHOWN | (opts.flicker.enabled && opts.checkSeconds == 0.0 ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0)
     );
-    
+
     if (!window) {
         std::cerr << "Window creation failed: " << SDL_GetError() << std::endl;
-        SDL_Quit();
-        return 1;
+        return fail();
     }
-    
+
     // Create renderer
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    Uint32 rendererFlags = SDL_RENDERER_ACCELERATED | (opts.flicker.enabled ? SDL_RENDERER_PRESENTVSYNC : 0);
+    renderer = SDL_CreateRenderer(window, -1, rendererFlags);
+    if (!renderer && opts.flicker.enabled) {
+        renderer = SDL_CreateRenderer(window, -1, 0);  // Offscreen driver: software, paced by us
+    }
     if (!renderer) {
         std::cerr << "Renderer creation failed: " << SDL_GetError() << std::endl;
-        SDL_DestroyWindow(window);
-        SDL_Quit();
-        return 1;
+        return fail();
     }
-    
-    // Set up audio specification
-    SDL_AudioSpec desiredSpec, obtainedSpec;
-    SDL_zero(desiredSpec);
-    
-    desiredSpec.freq = SAMPLE_RATE;
-    desiredSpec.format = AUDIO_F32SYS;  // 32-bit float
-    desiredSpec.channels = 1;            // Mono
-    desiredSpec.samples = 1024;          // Buffer size
-    desiredSpec.callback = audioCallback;
-    desiredSpec.userdata = nullptr;
-    
-    // Open audio device
-    SDL_AudioDeviceID audioDevice = SDL_OpenAudioDevice(
-        nullptr, 0, &desiredSpec, &obtainedSpec, 0
-    );
-    
-    if (audioDevice == 0) {
-        std::cerr << "Failed to open audio device: " << SDL_GetError() << std::endl;
-        SDL_DestroyRenderer(renderer);
-        SDL_DestroyWindow(window);
-        SDL_Quit();
-        return 1;
+
+    if (opts.flicker.enabled &&
+        !startFlicker(window, renderer, opts.flicker)) {
+        return fail();
     }
-    
-    std::cout << "\nAudio device opened successfully.\n";
-    std::cout << "Starting 40Hz stimulation...\n\n";
-    
-    // Start audio playback
-    SDL_PauseAudioDevice(audioDevice, 0);
-    
+
     // Main loop
     bool running = true;
     SDL_Event event;
     auto startTime = std::chrono::steady_clock::now();
-    
+    long long titleSecond = -1;
+
     while (running) {
         while (SDL_PollEvent(&event)) {
             switch (event.type) {
@@ -279,6 +883,11 @@ int main(int /*argc*/, char* /*argv*/[]) {
                     running = false;
                     break;
                     
+                case SDL_AUDIODEVICEADDED:
+                case SDL_AUDIODEVICEREMOVED:
+                    handleAudioDeviceEvent(event, audio);
+                    break;
+                    
                 case SDL_KEYDOWN:
                     switch (event.key.keysym.sym) {
                         case SDLK_q:
@@ -289,8 +898,10 @@ int main(int /*argc*/, char* /*argv*/[]) {
                         case SDLK_SPACE:
                             g_isPlaying.store(!g_isPlaying.load());
                             if (g_isPlaying.load()) {
+                                lslSessionEvent(LSL_RESUME);
                                 std::cout << "▶ Resumed\n";
                             } else {
+                                lslSessionEvent(LSL_PAUSE);
                                 std::cout << "⏸ Paused\n";
                             }
                             break;
@@ -298,13 +909,21 @@ int main(int /*argc*/, char* /*argv*/[]) {
                         case SDLK_t:
                             g_continuousTone.store(!g_continuousTone.load());
                             if (g_continuousTone.load()) {
+                                lslSessionEvent(LSL_MODE_CONTINUOUS);
                                 std::cout << "🔊 Continuous 1kHz tone (test mode)\n";
                             } else {
+                                lslSessionEvent(LSL_MODE_PULSED);
                                 std::cout << "🔊 40Hz pulsed mode (normal)\n";
                             }
                             break;
                     }
                     break;
+                    
+                default:
+                    if (event.type == watchdogEventType()) {
+                        handleWatchdogAction(event.user.code, audio);
+                    }
+                    break;
             }
         }
         
@@ -318,40 +937,79 @@ int main(int /*argc*/, char* /*argv*/[]) {
             running = false;
             break;
         }
+        if (filePlaybackFinished()) {
+            std::cout << "\n\n⏱ Stimulus file complete. Auto-stopping...\n";
+            running = false;
+            break;
+        }
+        if (opts.checkSeconds > 0.0 &&
+            std::chrono::duration<double>(now - startTime).count() >= opts.checkSeconds) {
+            running = false;
+            break;
+        }
         
-        // Clear screen
-        SDL_SetRenderDrawColor(renderer, 30, 30, 35, 255);
-        SDL_RenderClear(renderer);
-        
-        // Draw UI elements
-        drawPulseIndicator(renderer, g_samplePosition.load());
-        drawStatus(renderer, static_cast<int>(elapsed));
-        drawKeyHints(renderer);
+        // Update window title with time (once a second; flicker runs at display rate)
+        if (elapsed != titleSecond) {
+            titleSecond = elapsed;
+            std::ostringstream title;
+            title << "40Hz Stimulation | " 
+                  << std::setfill('0') << std::setw(2) << elapsed / 60 << ":"
+                  << std::setfill('0') << std::setw(2) << elapsed % 60;
+            ClockDrift drift = clockDriftEstimate();
+            if (drift.valid) {
+                title << " | " << std::fixed << std::setprecision(3) << drift.pulseRateHz << " Hz "
+                      << std::showpos << std::setprecision(1) << drift.ppm << std::noshowpos << " ppm";
+            }
+            title << " | SPACE:Pause  T:Test  Q:Quit";
+            SDL_SetWindowTitle(window, title.str().c_str());
+        }
         
-        // Update window title with time
-        std::ostringstream title;
-        title << "40Hz Stimulation | " 
-              << std::setfill('0') << std::setw(2) << elapsed / 60 << ":"
-              << std::setfill('0') << std::setw(2) << elapsed % 60
-              << " | SPACE:Pause  T:Test  Q:Quit";
-        SDL_SetWindowTitle(window, title.str().c_str());
+        if (opts.flicker.enabled) {
+            // Flicker owns frame pacing: one present per display frame
+            renderFlickerFrame(renderer);
+        } else {
+            // Clear screen
+            SDL_SetRenderDrawColor(renderer, 30, 30, 35, 255);
+            SDL_RenderClear(renderer);
+            
+            // Draw UI elements
+            drawPulseIndicator(renderer);
+            drawPulseStrip(renderer, hostTimeNs());
+            drawStatus(renderer, static_cast<int>(elapsed));
+            drawKeyHints(renderer);
+            
+            // Present
+            SDL_RenderPresent(renderer);
+        }
         
-        // Present
-        SDL_RenderPresent(renderer);
+        // Startup probe: done once the first pulse is out and the window is up
+        if (g_startupProbe && g_firstNonZeroNs.load() != 0) {
+            reportStartupMark("first_pulse", g_firstNonZeroNs.load());
+            reportStartupMark("window", hostTimeNs());
+            running = false;
+        }
         
         // Small delay to reduce CPU usage
-        SDL_Delay(16); // ~60 FPS
+        if (!opts.flicker.enabled) {
+            SDL_Delay(16); // ~60 FPS
+        }
     }
-    
+
     std::cout << "\n\nStopping...\n";
-    
+    lslSessionEvent(LSL_SESSION_STOP);
+
     // Cleanup
-    SDL_PauseAudioDevice(audioDevice, 1);
-    SDL_CloseAudioDevice(audioDevice);
+    bool flickerOk = stopFlicker();
+    stopEegSynth();
+    bool lockOk = stopPhaseLock();
+    bool syncOk = stopNetSync();
+    bool captureOk = stopCaptureVerify();
+    bool triggerOk = stopTriggerInput();
+    stopAll(audio);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
-    
+
     std::cout << "Done.\n";
-    return 0;
+    return flickerOk && lockOk && syncOk && captureOk && triggerOk ? 0 : 1;
 }
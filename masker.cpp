@@ -0,0 +1,464 @@
+#include "masker.h"
+#include "bench.h"
+#include "engine.h"
+#include "resampler.h"
+#include "spsc_ring.h"
+#include "wav_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+constexpr double RING_SECONDS = 2.0;                // Queued ahead of the callback, at least
+constexpr int DECODE_FRAMES = 4096;                 // Output frames per decoder step
+constexpr auto DECODE_INTERVAL = std::chrono::milliseconds(5);
+constexpr int MIX_CHUNK = 256;                      // Frames per ducking decision
+constexpr int FADE_FRAMES = SAMPLE_RATE / 100;      // Underrun fade out and in (10 ms)
+constexpr int RESUME_FRAMES = SAMPLE_RATE / 2;      // Queued before fading back in
+constexpr int DUCK_HOLD_FRAMES = 4 * SAMPLES_PER_INTERVAL;  // Bridges the gaps between pulses
+constexpr double DUCK_ATTACK_SECONDS = 0.01;
+constexpr double DUCK_RELEASE_SECONDS = 0.3;
+
+constexpr int CHECK_BLOCK_FRAMES = 512;
+constexpr double CHECK_SPEED = 8.0;                 // Times real time
+constexpr int CHECK_RATE = 48000;                   // Test file, converted on the decoder thread
+constexpr double CHECK_FILE_SECONDS = 10.0;         // Whole cycles of the tone: loops seamlessly
+constexpr double CHECK_TONE_HZ = 440.0;
+constexpr double CHECK_TONE_LEVEL = 0.5;
+constexpr double CHECK_PAUSE_AT = 12.0;             // Pulses play until here, then pause
+constexpr double CHECK_STALL_AT = 16.0;             // Decoder stalled from here...
+constexpr double CHECK_STALL_SECONDS = 5.0;         // ...for longer than the ring holds
+constexpr double CHECK_SECONDS = 26.0;
+
+struct Source {
+    MaskerConfig config;
+    WavInfo info;
+    int fd = -1;
+    int channels = 1;               // In the ring: 1, or one per stimulus channel
+    bool resample = false;
+    Resampler resampler;
+    SpscRing<float> ring;
+    std::atomic<bool> ended{false}; // Decoder reached the end (not looping)
+    std::atomic<uint64_t> underruns{0};
+    std::atomic<int64_t> mixed{0};
+
+    // Decoder thread
+    int64_t fileFrame = 0;          // Next file frame to read
+    std::vector<uint8_t> raw;
+    std::vector<float> decoded;     // File channels
+    std::vector<float> routed;      // Ring channels, at the file rate
+    std::vector<float> converted;   // Ring channels, at SAMPLE_RATE
+
+    // Audio thread
+    float gain = 1.0f;
+    float duck = 1.0f;
+    float env = 1.0f;               // Ducking envelope
+    float fade = 0.0f;              // Underrun fade, fades in at the start too
+    bool starved = false;
+    std::vector<float> scratch;     // MIX_CHUNK frames
+    std::vector<float> last;        // Last frame mixed, held while a fade runs past the ring
+};
+
+std::vector<std::unique_ptr<Source>> g_sources;
+int g_outChannels = 1;
+int g_trigger = -1;
+float g_attack = 1.0f;              // One-pole coefficients per frame
+float g_release = 1.0f;
+int g_hold = 0;                     // Audio thread: frames the ducking key stays on
+std::thread g_decoder;
+std::atomic<bool> g_running{false};
+std::atomic<bool> g_stall{false};   // Check: decoder pushes nothing while set
+
+/**
+ * Read `frames` file frames from the decoder's position on, starting over
+ * at the end when looping, routed to the ring channels in s.routed.
+ * Returns the frames read (fewer only at the end of a file not looped, or
+ * on a read error).
+ */
+int readRouted(Source& s, int frames) {
+    int fileChannels = s.info.channels;
+    int64_t frameBytes = static_cast<int64_t>(fileChannels) * s.info.bitsPerSample / 8;
+    int got = 0;
+    while (got < frames) {
+        if (s.fileFrame >= s.info.frames) {
+            if (!s.config.loop) break;
+            s.fileFrame = 0;
+        }
+        int n = static_cast<int>(std::min<int64_t>(frames - got, s.info.frames - s.fileFrame));
+        size_t bytes = static_cast<size_t>(n) * frameBytes;
+        if (pread(s.fd, s.raw.data(), bytes, s.info.dataOffset + s.fileFrame * frameBytes) != static_cast<ssize_t>(bytes)) {
+            break;
+        }
+        decodeWavSamples(s.raw.data(), s.info, s.decoded.data(), static_cast<size_t>(n) * fileChannels);
+
+        float* out = s.routed.data() + static_cast<size_t>(got) * s.channels;
+        if (s.channels == fileChannels) {
+            std::copy(s.decoded.begin(), s.decoded.begin() + static_cast<size_t>(n) * fileChannels, out);
+        } else {
+            // Downmix to the one ring channel
+            for (int i = 0; i < n; ++i) {
+                float sum = 0.0f;
+                for (int c = 0; c < fileChannels; ++c) sum += s.decoded[static_cast<size_t>(i) * fileChannels + c];
+                out[i] = sum / fileChannels;
+            }
+        }
+        s.fileFrame += n;
+        got += n;
+    }
+    return got;
+}
+
+/**
+ * Push DECODE_FRAMES more frames if the ring has room. Returns true if it
+ * did.
+ */
+bool decodeStep(Source& s) {
+    if (s.ended.load(std::memory_order_relaxed)) return false;
+    if (s.ring.capacity() - s.ring.size() < static_cast<size_t>(DECODE_FRAMES) * s.channels) return false;
+
+    bool end = false;
+    if (!s.resample) {
+        int got = readRouted(s, DECODE_FRAMES);
+        s.ring.push(s.routed.data(), static_cast<size_t>(got) * s.channels);
+        end = got < DECODE_FRAMES;
+    } else {
+        // Past the end the converter is flushed with silence
+        int need = s.resampler.needed(DECODE_FRAMES);
+        int got = readRouted(s, need);
+        std::fill(s.routed.begin() + static_cast<size_t>(got) * s.channels,
+                  s.routed.begin() + static_cast<size_t>(need) * s.channels, 0.0f);
+        s.resampler.push(s.routed.data(), need);
+        int out = s.resampler.pull(s.converted.data(), DECODE_FRAMES);
+        s.ring.push(s.converted.data(), static_cast<size_t>(out) * s.channels);
+        end = got < need;
+    }
+    if (end) s.ended.store(true, std::memory_order_release);
+    return true;
+}
+
+void decodeLoop() {
+    while (g_running.load()) {
+        bool progress = false;
+        if (!g_stall.load(std::memory_order_relaxed)) {
+            for (auto& source : g_sources) {
+                while (g_running.load(std::memory_order_relaxed) && decodeStep(*source)) progress = true;
+            }
+        }
+        if (!progress) std::this_thread::sleep_for(DECODE_INTERVAL);
+    }
+}
+
+/**
+ * Mix `frames` frames of one source into `out`: gain, ducking envelope and
+ * underrun fade per frame. When the ring runs dry mid-fade the last frame
+ * is held until the fade is down; a source that is not looped fades out
+ * over its last frames.
+ */
+void mixSource(Source& s, float* out, int frames, bool ducked) {
+    int ch = s.channels;
+    int64_t available = static_cast<int64_t>(s.ring.size()) / ch;
+    bool ended = s.ended.load(std::memory_order_acquire);
+    if (!s.starved && !ended && available < frames + FADE_FRAMES) {
+        s.starved = true;
+        s.underruns.fetch_add(1, std::memory_order_relaxed);
+    } else if (s.starved && (available >= RESUME_FRAMES || ended)) {
+        s.starved = false;
+    }
+    if (s.starved && s.fade <= 0.0f) return;        // Silent until the ring refills
+
+    int take = static_cast<int>(std::min<int64_t>(frames, available));
+    if (take > 0) s.ring.pop(s.scratch.data(), static_cast<size_t>(take) * ch);
+
+    float target = ducked ? s.duck : 1.0f;
+    float coef = target < s.env ? g_attack : g_release;
+    float step = (s.starved ? -1.0f : 1.0f) / FADE_FRAMES;
+    for (int i = 0; i < frames; ++i) {
+        const float* in = s.last.data();
+        if (i < take) {
+            in = s.scratch.data() + static_cast<size_t>(i) * ch;
+        } else if (s.fade > 0.0f) {
+            step = -1.0f / FADE_FRAMES;
+        } else {
+            break;
+        }
+        s.env += (target - s.env) * coef;
+        s.fade = std::clamp(s.fade + step, 0.0f, 1.0f);
+        if (ended) s.fade = std::min(s.fade, std::max(0.0f, static_cast<float>(available - 1 - i) / FADE_FRAMES));
+        float g = s.gain * s.env * s.fade;
+        float* frame = out + static_cast<size_t>(i) * g_outChannels;
+        for (int c = 0, k = 0; c < g_outChannels; ++c) {
+            if (c == g_trigger) continue;
+            frame[c] += g * in[ch == 1 ? 0 : k++];
+        }
+    }
+    if (take > 0) std::copy_n(s.scratch.data() + static_cast<size_t>(take - 1) * ch, ch, s.last.data());
+    s.mixed.fetch_add(take, std::memory_order_relaxed);
+}
+
+void maskerStage(float* block, int frames, int64_t startFrame, bool pulses) {
+    for (int done = 0; done < frames;) {
+        int n = std::min(MIX_CHUNK, frames - done);
+        float* out = block + static_cast<size_t>(done) * g_outChannels;
+
+        // Key on the pulses themselves; masking noise keeps the level up
+        bool key = pulses && pulseToneIn(startFrame + done, n);
+        g_hold = key ? DUCK_HOLD_FRAMES : std::max(0, g_hold - n);
+
+        for (auto& source : g_sources) mixSource(*source, out, n, g_hold > 0);
+        done += n;
+    }
+}
+
+float dbToGain(double db) {
+    return static_cast<float>(std::pow(10.0, db / 20.0));
+}
+
+std::string formatName(const WavInfo& info) {
+    return std::to_string(info.bitsPerSample) + (info.isFloat ? "-bit float" : "-bit PCM");
+}
+
+bool openSource(const MaskerConfig& config, int stimulusChannels, Source& s) {
+    s.config = config;
+    if (!readWavInfo(config.path, s.info) || s.info.bitsPerSample == 0 || s.info.frames == 0) {
+        std::cerr << "Cannot read " << config.path << " as WAV, RF64 or Wave64 with samples" << std::endl;
+        return false;
+    }
+    float probe;
+    uint8_t zero[8] = {};
+    if (!decodeWavSamples(zero, s.info, &probe, 1)) {
+        std::cerr << config.path << ": " << formatName(s.info) << " samples are not supported" << std::endl;
+        return false;
+    }
+    s.fd = open(config.path.c_str(), O_RDONLY);
+    if (s.fd < 0) {
+        std::cerr << "Cannot open " << config.path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(s.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    // One ring channel per stimulus channel if the file has them, else mono
+    s.channels = s.info.channels == stimulusChannels ? stimulusChannels : 1;
+    int inputFrames = DECODE_FRAMES;
+    s.resample = s.info.sampleRate != SAMPLE_RATE;
+    if (s.resample) {
+        if (!s.resampler.init(s.info.sampleRate, SAMPLE_RATE, s.channels, DECODE_FRAMES)) {
+            std::cerr << config.path << " is at " << s.info.sampleRate << " Hz, which cannot be converted" << std::endl;
+            return false;
+        }
+        inputFrames = s.resampler.needed(DECODE_FRAMES);
+        s.converted.assign(static_cast<size_t>(DECODE_FRAMES) * s.channels, 0.0f);
+    }
+    int64_t frameBytes = static_cast<int64_t>(s.info.channels) * s.info.bitsPerSample / 8;
+    s.raw.assign(static_cast<size_t>(inputFrames) * frameBytes, 0);
+    s.decoded.assign(static_cast<size_t>(inputFrames) * s.info.channels, 0.0f);
+    s.routed.assign(static_cast<size_t>(inputFrames) * s.channels, 0.0f);
+    if (s.resample) {
+        // Silence before the first frame fills the converter's history
+        int lead = static_cast<int>(-s.resampler.nextInput());
+        std::fill(s.routed.begin(), s.routed.end(), 0.0f);
+        s.resampler.push(s.routed.data(), lead);
+    }
+    s.ring.reset(static_cast<size_t>(RING_SECONDS * SAMPLE_RATE) * s.channels);
+    s.scratch.assign(static_cast<size_t>(MIX_CHUNK) * s.channels, 0.0f);
+    s.last.assign(s.channels, 0.0f);
+    s.gain = dbToGain(config.gainDb);
+    s.duck = dbToGain(config.duckDb);
+    return true;
+}
+
+void closeSources() {
+    for (auto& source : g_sources) {
+        if (source->fd >= 0) close(source->fd);
+    }
+    g_sources.clear();
+}
+
+/**
+ * Float WAV of a whole number of tone cycles at CHECK_RATE
+ */
+bool writeCheckFile(const std::string& path) {
+    int64_t frames = static_cast<int64_t>(CHECK_FILE_SECONDS * CHECK_RATE);
+    std::vector<uint8_t> header = wavHeader(WAV_RIFF, frames, 1, CHECK_RATE);
+    std::vector<float> samples(frames);
+    for (int64_t i = 0; i < frames; ++i) {
+        samples[i] = static_cast<float>(CHECK_TONE_LEVEL * std::sin(2.0 * M_PI * CHECK_TONE_HZ * i / CHECK_RATE));
+    }
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(header.data()), header.size());
+    out.write(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(float));
+    return static_cast<bool>(out);
+}
+
+double rmsDb(const std::vector<float>& m, double from, double to) {
+    double sum = 0.0;
+    int64_t a = static_cast<int64_t>(from * SAMPLE_RATE), b = static_cast<int64_t>(to * SAMPLE_RATE);
+    for (int64_t i = a; i < b; ++i) sum += static_cast<double>(m[i]) * m[i];
+    double reference = CHECK_TONE_LEVEL / std::sqrt(2.0);
+    return 20.0 * std::log10(std::sqrt(sum / (b - a)) / reference);
+}
+
+} // namespace
+
+bool startMaskers(const std::vector<MaskerConfig>& maskers) {
+    if (maskers.empty()) return true;
+    g_outChannels = outputChannels();
+    g_trigger = triggerChannel();
+    int stimulusChannels = g_outChannels - (g_trigger >= 0 ? 1 : 0);
+    g_attack = static_cast<float>(1.0 - std::exp(-1.0 / (DUCK_ATTACK_SECONDS * SAMPLE_RATE)));
+    g_release = static_cast<float>(1.0 - std::exp(-1.0 / (DUCK_RELEASE_SECONDS * SAMPLE_RATE)));
+    g_hold = 0;
+
+    for (const MaskerConfig& config : maskers) {
+        g_sources.push_back(std::make_unique<Source>());
+        if (!openSource(config, stimulusChannels, *g_sources.back())) {
+            closeSources();
+            return false;
+        }
+    }
+    if (!addMixStage(maskerStage)) {
+        std::cerr << "No room for another mix stage" << std::endl;
+        closeSources();
+        return false;
+    }
+
+    // Full rings before the device starts
+    for (auto& source : g_sources) {
+        while (decodeStep(*source)) {
+        }
+    }
+    g_running.store(true);
+    g_decoder = std::thread(decodeLoop);
+
+    for (auto& source : g_sources) {
+        const Source& s = *source;
+        std::cout << "Masker " << s.config.path << ": " << std::fixed << std::setprecision(1)
+                  << s.info.frames / static_cast<double>(s.info.sampleRate) / 60.0 << " min, " << s.info.channels
+                  << " ch " << formatName(s.info) << std::defaultfloat << std::setprecision(3);
+        if (s.resample) std::cout << ", resampled from " << s.info.sampleRate << " Hz";
+        std::cout << ", gain " << s.config.gainDb << " dB";
+        if (s.config.duckDb != 0.0) std::cout << ", ducked " << s.config.duckDb << " dB under the pulses";
+        std::cout << (s.config.loop ? ", looped" : "") << "\n";
+    }
+    return true;
+}
+
+void stopMaskers() {
+    if (g_sources.empty()) return;
+    g_running.store(false);
+    if (g_decoder.joinable()) g_decoder.join();
+    for (auto& source : g_sources) {
+        std::cout << "Masker " << source->config.path << ": " << std::fixed << std::setprecision(1)
+                  << source->mixed.load() / static_cast<double>(SAMPLE_RATE) << " s mixed, "
+                  << source->underruns.load() << " underruns\n" << std::defaultfloat;
+    }
+    closeSources();
+}
+
+int runMaskerCheck() {
+    const std::string path = "masker_check.wav";
+    if (!writeCheckFile(path)) {
+        std::cerr << "Cannot write " << path << std::endl;
+        return 1;
+    }
+    buildRenderTables();
+    MaskerConfig config;
+    config.path = path;
+    config.gainDb = -6.0;
+    config.duckDb = -12.0;
+    if (!startMaskers({config})) return 1;
+    Source& source = *g_sources.front();
+
+    // Masker alone on the first stimulus channel: output minus the stimulus
+    int channels = outputChannels();
+    int probe = triggerChannel() == 0 ? 1 : 0;
+    int64_t total = static_cast<int64_t>(CHECK_SECONDS * SAMPLE_RATE) / CHECK_BLOCK_FRAMES * CHECK_BLOCK_FRAMES;
+    std::vector<float> masker(total), stimulus(static_cast<size_t>(CHECK_BLOCK_FRAMES) * channels);
+    uint64_t underrunsBefore = 0;
+    int64_t silentFrames = 0;
+
+    g_samplePosition.store(0);
+    CallbackPacer pacer(CHECK_BLOCK_FRAMES, CHECK_SPEED);
+    for (int64_t pos = 0; pos < total; pos += CHECK_BLOCK_FRAMES) {
+        double t = static_cast<double>(pos) / SAMPLE_RATE;
+        bool playing = t < CHECK_PAUSE_AT;
+        bool stalled = t >= CHECK_STALL_AT && t < CHECK_STALL_AT + CHECK_STALL_SECONDS;
+        if (stalled && !g_stall.load()) underrunsBefore = source.underruns.load();
+        g_isPlaying.store(playing);
+        g_stall.store(stalled);
+
+        const float* buffer = pacer.render();
+
+        if (playing) {
+            renderOutputBlock(stimulus.data(), pos, CHECK_BLOCK_FRAMES);
+        } else {
+            std::fill(stimulus.begin(), stimulus.end(), 0.0f);
+        }
+        for (int i = 0; i < CHECK_BLOCK_FRAMES; ++i) {
+            size_t k = static_cast<size_t>(i) * channels + probe;
+            masker[pos + i] = buffer[k] - stimulus[k];
+            if (t >= CHECK_STALL_AT && masker[pos + i] == 0.0f) ++silentFrames;
+        }
+
+        pacer.wait();
+    }
+    g_stall.store(false);
+    g_isPlaying.store(true);
+    uint64_t underruns = source.underruns.load();
+    stopMaskers();
+    std::remove(path.c_str());
+
+    // Fidelity while ducked, across the loop point at 10 s: masker frame = engine frame until the stall
+    double gain = std::pow(10.0, (config.gainDb + config.duckDb) / 20.0);
+    double signal = 0.0, noise = 0.0;
+    for (int64_t i = 2 * SAMPLE_RATE; i < static_cast<int64_t>(CHECK_PAUSE_AT * SAMPLE_RATE); ++i) {
+        double ideal = gain * CHECK_TONE_LEVEL * std::sin(2.0 * M_PI * CHECK_TONE_HZ * i / SAMPLE_RATE);
+        signal += ideal * ideal;
+        noise += (masker[i] - ideal) * (masker[i] - ideal);
+    }
+    double snr = 10.0 * std::log10(signal / std::max(noise, 1e-300));
+    bool fidelityOk = snr >= 80.0;
+
+    double ducked = rmsDb(masker, 4.0, CHECK_PAUSE_AT);
+    double open = rmsDb(masker, CHECK_PAUSE_AT + 1.0, CHECK_STALL_AT);
+    double resumed = rmsDb(masker, CHECK_SECONDS - 3.0, CHECK_SECONDS - 1.0);
+    bool levelsOk = std::abs(ducked - (config.gainDb + config.duckDb)) < 0.2 && std::abs(open - config.gainDb) < 0.2 &&
+                    std::abs(resumed - config.gainDb) < 0.2;
+
+    // No step across the stall bigger than the tone's own
+    double toneStep = std::pow(10.0, config.gainDb / 20.0) * CHECK_TONE_LEVEL * 2.0 * M_PI * CHECK_TONE_HZ / SAMPLE_RATE;
+    double maxStep = 0.0;
+    for (int64_t i = static_cast<int64_t>(CHECK_STALL_AT * SAMPLE_RATE); i < total; ++i) {
+        maxStep = std::max(maxStep, static_cast<double>(std::abs(masker[i] - masker[i - 1])));
+    }
+    bool underrunOk = underrunsBefore == 0 && underruns == 1 && maxStep <= 1.1 * toneStep && silentFrames > 0;
+
+    std::cout << std::setprecision(3) << "Masker check: " << CHECK_SPEED << "x real time, " << CHECK_BLOCK_FRAMES << "-frame callbacks, "
+              << CHECK_RATE / 1000 << " kHz " << CHECK_TONE_HZ << " Hz tone looped every " << CHECK_FILE_SECONDS
+              << " s\n" << std::fixed << std::setprecision(1)
+              << "  fidelity     " << snr << " dB SNR under the pulses, across the loop point  "
+              << verdict(fidelityOk) << "\n"
+              << "  levels       " << ducked << " dB ducked, " << open << " dB paused, " << resumed
+              << " dB after the stall (expected " << config.gainDb + config.duckDb << " / " << config.gainDb << ")  "
+              << verdict(levelsOk) << "\n"
+              << "  underrun     " << underruns << " in a " << CHECK_STALL_SECONDS << " s decoder stall, silent "
+              << silentFrames / static_cast<double>(SAMPLE_RATE) << " s, largest step " << std::setprecision(4)
+              << maxStep << " (tone " << toneStep << ")  " << verdict(underrunOk) << "\n"
+              << std::setprecision(3) << "  callback     max " << pacer.maxCallbackMs() << " ms, budget "
+              << pacer.budgetMs() << " ms\n" << std::defaultfloat;
+    return fidelityOk && levelsOk && underrunOk ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+/**
+ * Background maskers: low-level music or noise files mixed under the
+ * pulse train for tolerability.
+ *
+ * A decoder thread reads each file with pread(), converts its samples to
+ * float (and its rate to SAMPLE_RATE through the Resampler), routes them
+ * to the stimulus channels and pushes them into a wait-free ring per
+ * source, keeping about two seconds queued. The audio thread only pops
+ * and mixes, as an engine mix stage: per-source gain, and ducking keyed
+ * on the pulse grid (not the sample level, which masking noise holds
+ * up), so the masker dips under the pulses while they play and comes
+ * back up when they pause. The trigger channel is never touched.
+ *
+ * If a ring runs low (the decoder stalled on the disk) the source fades
+ * out over the frames it still has, holding the last one if the ring runs
+ * dry first, counts an underrun, and fades back in once the ring has
+ * refilled; the masker then continues where it left off. A file that is
+ * not looped fades out over its last frames.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+constexpr int MAX_MASKERS = 4;
+
+struct MaskerConfig {
+    std::string path;
+    double gainDb = -20.0;      // Level of the file in the mix
+    double duckDb = -6.0;       // Further gain while the pulses play (0 = no ducking)
+    bool loop = true;           // Start over at the end of the file
+};
+
+/**
+ * Open every file, fill the rings and start the decoder thread. Call
+ * after the output layout is set and before the audio device is started.
+ */
+bool startMaskers(const std::vector<MaskerConfig>& maskers);
+
+/**
+ * Stop the decoder and report. Only after the audio device is closed.
+ */
+void stopMaskers();
+
+/**
+ * Headless check with a looped 48 kHz test tone: fidelity across the loop
+ * point, ducked and open levels, and a decoder stall longer than the ring
+ */
+int runMaskerCheck();
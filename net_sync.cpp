@@ -0,0 +1,485 @@
+#include "net_sync.h"
+#include "engine.h"
+#include "clock_drift.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t SYNC_MAGIC = 0x504E5359;     // "PNSY"
+constexpr int MESSAGE_FIELDS = 4;
+constexpr int MESSAGE_BYTES = 8 + 8 * MESSAGE_FIELDS;
+constexpr int64_t PING_INTERVAL_NS = 50000000;      // Agent exchange rate
+constexpr int64_t ANNOUNCE_INTERVAL_NS = 100000000; // Coordinator resends the start this often
+constexpr int READY_EXCHANGES = 40;             // Per agent before a start is agreed (~2 s)
+constexpr int FIT_WINDOW = 128;                 // Exchanges kept for the clock fit
+constexpr double FIT_FRACTION = 0.25;           // Lowest-delay share of them that is fitted
+constexpr int FIT_MIN_SAMPLES = 8;
+constexpr int64_t SKEW_MIN_SPAN_NS = 1000000000;    // Fit a slope only over at least 1 s
+constexpr int64_t FREEZE_NS = 100000000;        // Stop refining the start frame this close to it
+constexpr double CHECK_TOLERANCE_US = 500.0;
+constexpr int MAX_AGENTS = 64;
+
+enum MessageType : uint32_t {
+    MSG_PING = 1,       // seq, t1, audio clock fit converged
+    MSG_PONG = 2,       // seq, t1, t2, t3
+    MSG_START = 3,      // start (coordinator clock), start (coordinator host clock, same-host checks)
+    MSG_ACK = 4,        // start
+};
+
+struct Message {
+    uint32_t type = 0;
+    int64_t field[MESSAGE_FIELDS] = {};
+};
+
+// One NTP-style exchange, on this station's clock
+struct Exchange {
+    int64_t localNs;        // Midpoint of send and receive
+    double offsetNs;        // Coordinator minus station
+    int64_t delayNs;        // Round trip minus coordinator turnaround
+};
+
+// Coordinator clock minus station clock = offsetNs + skew * (local - refNs)
+struct ClockFit {
+    bool valid = false;
+    double offsetNs = 0.0;
+    double skew = 0.0;
+    int64_t refNs = 0;
+};
+
+struct Agent {
+    sockaddr_storage addr;
+    socklen_t len;
+    int exchanges;
+    bool audioReady;        // Its frame clock fit has converged
+    bool acked;
+};
+
+NetSyncConfig g_config;
+int g_socket = -1;
+std::thread g_thread;
+std::atomic<bool> g_running{false};
+int64_t g_simOriginNs = 0;
+
+// Worker state
+std::deque<Exchange> g_exchanges;
+uint64_t g_exchangeCount = 0;
+int64_t g_bestDelayNs = 0;
+ClockFit g_fit;
+std::vector<Agent> g_agents;
+bool g_haveStart = false;
+bool g_frozen = false;
+int64_t g_startCoordNs = 0;         // Agreed start on the coordinator clock
+int64_t g_agreedHostNs = 0;         // Same instant on the coordinator's host clock
+int64_t g_startHostNs = 0;          // This station's mapping of it
+
+// Set by the worker, read by the onset tap
+std::atomic<int64_t> g_startFrame{-1};
+std::atomic<int64_t> g_firstOnsetFrame{-1};
+std::atomic<int64_t> g_firstOnsetPulse{0};
+
+void put64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; ++i) p[i] = static_cast<uint8_t>(v >> (56 - 8 * i));
+}
+
+uint64_t get64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v = (v << 8) | p[i];
+    return v;
+}
+
+void encode(const Message& message, uint8_t* out) {
+    put64(out, (uint64_t(SYNC_MAGIC) << 32) | message.type);
+    for (int i = 0; i < MESSAGE_FIELDS; ++i) {
+        put64(out + 8 + 8 * i, static_cast<uint64_t>(message.field[i]));
+    }
+}
+
+bool decode(const uint8_t* in, int size, Message& message) {
+    if (size != MESSAGE_BYTES) return false;
+    uint64_t head = get64(in);
+    if (head >> 32 != SYNC_MAGIC) return false;
+    message.type = static_cast<uint32_t>(head);
+    for (int i = 0; i < MESSAGE_FIELDS; ++i) {
+        message.field[i] = static_cast<int64_t>(get64(in + 8 + 8 * i));
+    }
+    return true;
+}
+
+/**
+ * This station's clock: the host clock, distorted by the simulated offset
+ * and skew so several processes on one machine behave like separate hosts.
+ */
+int64_t hostToStation(int64_t hostNs) {
+    double dt = static_cast<double>(hostNs - g_simOriginNs);
+    return hostNs + std::llround(g_config.simOffsetMs * 1e6 + g_config.simSkewPpm * 1e-6 * dt);
+}
+
+int64_t stationToHost(int64_t stationNs) {
+    double dt = (stationNs - g_simOriginNs - g_config.simOffsetMs * 1e6) / (1.0 + g_config.simSkewPpm * 1e-6);
+    return g_simOriginNs + std::llround(dt);
+}
+
+int64_t stationNowNs() {
+    return hostToStation(hostTimeNs());
+}
+
+bool resolveCoordinator(const std::string& hostPort, sockaddr_storage& addr, socklen_t& len) {
+    size_t colon = hostPort.rfind(':');
+    if (colon == std::string::npos) {
+        std::cerr << "Sync coordinator must be HOST:PORT: " << hostPort << std::endl;
+        return false;
+    }
+    std::string host = hostPort.substr(0, colon);
+    std::string port = hostPort.substr(colon + 1);
+
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* result = nullptr;
+    int err = getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
+    if (err != 0 || !result) {
+        std::cerr << "Cannot resolve " << hostPort << ": " << gai_strerror(err) << std::endl;
+        return false;
+    }
+    std::memcpy(&addr, result->ai_addr, result->ai_addrlen);
+    len = result->ai_addrlen;
+    freeaddrinfo(result);
+    return true;
+}
+
+void sendMessage(const Message& message, const sockaddr* addr, socklen_t len) {
+    uint8_t packet[MESSAGE_BYTES];
+    encode(message, packet);
+    sendto(g_socket, packet, sizeof(packet), 0, addr, len);
+}
+
+/**
+ * Least-squares line through the lowest-delay exchanges in the window:
+ * queueing only ever adds delay, so those carry the least offset error.
+ */
+ClockFit fitClock() {
+    ClockFit fit;
+    if (g_exchanges.size() < FIT_MIN_SAMPLES) return fit;
+
+    std::vector<Exchange> best(g_exchanges.begin(), g_exchanges.end());
+    size_t used = std::max<size_t>(FIT_MIN_SAMPLES, static_cast<size_t>(best.size() * FIT_FRACTION));
+    std::nth_element(best.begin(), best.begin() + used - 1, best.end(),
+                     [](const Exchange& a, const Exchange& b) { return a.delayNs < b.delayNs; });
+    best.resize(used);
+
+    fit.refNs = best.front().localNs;
+    double meanT = 0.0, meanOffset = 0.0;
+    int64_t first = best.front().localNs, last = first;
+    for (const Exchange& e : best) {
+        meanT += static_cast<double>(e.localNs - fit.refNs);
+        meanOffset += e.offsetNs;
+        first = std::min(first, e.localNs);
+        last = std::max(last, e.localNs);
+    }
+    meanT /= used;
+    meanOffset /= used;
+
+    if (last - first >= SKEW_MIN_SPAN_NS) {
+        double cov = 0.0, var = 0.0;
+        for (const Exchange& e : best) {
+            double dt = static_cast<double>(e.localNs - fit.refNs) - meanT;
+            cov += dt * (e.offsetNs - meanOffset);
+            var += dt * dt;
+        }
+        fit.skew = cov / var;
+    }
+    fit.offsetNs = meanOffset - fit.skew * meanT;
+    fit.valid = true;
+    return fit;
+}
+
+/**
+ * Station time of coordinator time `coordNs` under the fit
+ */
+int64_t coordinatorToStation(int64_t coordNs, const ClockFit& fit) {
+    double sinceRef = (static_cast<double>(coordNs - fit.refNs) - fit.offsetNs) / (1.0 + fit.skew);
+    return fit.refNs + std::llround(sinceRef);
+}
+
+/**
+ * Point playback at the engine frame heard at the agreed instant. Repeated
+ * as the clock fit and the frame clock anchor improve, until shortly
+ * before the start.
+ */
+void scheduleStart(int64_t stationStartNs) {
+    if (g_frozen) return;
+    int64_t startHostNs = stationToHost(stationStartNs);
+    double frame;
+    if (!audibleFrameAt(startHostNs, frame)) return;
+
+    bool first = g_startFrame.load() < 0;
+    int64_t startFrame = std::llround(frame);
+    g_startHostNs = startHostNs;
+    g_startFrame.store(startFrame);
+    startPlaybackAt(startFrame);
+    g_frozen = startHostNs - hostTimeNs() <= FREEZE_NS;
+
+    if (first) {
+        std::cout << "Net sync: session starts in " << std::fixed << std::setprecision(2)
+                  << (startHostNs - hostTimeNs()) / 1e9 << " s" << std::defaultfloat << std::endl;
+    }
+}
+
+void onsetTap(int64_t frame, int64_t /*hostNs*/, int64_t pulse) {
+    int64_t start = g_startFrame.load(std::memory_order_relaxed);
+    if (start < 0 || frame < start || g_firstOnsetFrame.load(std::memory_order_relaxed) >= 0) return;
+    g_firstOnsetPulse.store(pulse, std::memory_order_relaxed);
+    g_firstOnsetFrame.store(frame, std::memory_order_release);
+}
+
+bool receive(Message& message, sockaddr_storage& from, socklen_t& fromLen, int64_t& stampNs, int timeoutMs) {
+    pollfd pfd{g_socket, POLLIN, 0};
+    if (poll(&pfd, 1, timeoutMs) <= 0) return false;
+    uint8_t packet[MESSAGE_BYTES + 1];
+    fromLen = sizeof(from);
+    ssize_t got = recvfrom(g_socket, packet, sizeof(packet), 0, reinterpret_cast<sockaddr*>(&from), &fromLen);
+    stampNs = stationNowNs();
+    return got > 0 && decode(packet, static_cast<int>(got), message);
+}
+
+Agent* findAgent(const sockaddr_storage& addr, socklen_t len) {
+    for (Agent& agent : g_agents) {
+        if (agent.len == len && std::memcmp(&agent.addr, &addr, len) == 0) return &agent;
+    }
+    if (g_agents.size() == MAX_AGENTS) return nullptr;
+    g_agents.push_back(Agent{addr, len, 0, false, false});
+    std::cout << "Net sync: agent " << g_agents.size() << " joined" << std::endl;
+    return &g_agents.back();
+}
+
+void coordinatorLoop() {
+    int64_t nextAnnounceNs = 0;
+    while (g_running.load()) {
+        Message message;
+        sockaddr_storage from;
+        socklen_t fromLen;
+        int64_t stampNs;
+        if (receive(message, from, fromLen, stampNs, 10)) {
+            Agent* agent = findAgent(from, fromLen);
+            if (agent && message.type == MSG_PING) {
+                ++agent->exchanges;
+                agent->audioReady = message.field[2] != 0;
+                Message reply;
+                reply.type = MSG_PONG;
+                reply.field[0] = message.field[0];
+                reply.field[1] = message.field[1];
+                reply.field[2] = stampNs;
+                reply.field[3] = stationNowNs();
+                sendMessage(reply, reinterpret_cast<sockaddr*>(&from), fromLen);
+            } else if (agent && message.type == MSG_ACK && message.field[0] == g_startCoordNs) {
+                agent->acked = true;
+            }
+        }
+
+        if (!g_haveStart) {
+            // Every station maps the start through its fitted frame clock;
+            // before that fit converges, callback jitter lands in the start
+            int ready = static_cast<int>(std::count_if(g_agents.begin(), g_agents.end(), [](const Agent& a) {
+                return a.exchanges >= READY_EXCHANGES && a.audioReady;
+            }));
+            if (ready < g_config.agents || !clockDriftEstimate().valid) continue;
+            g_startCoordNs = stationNowNs() + std::llround(g_config.leadSeconds * 1e9);
+            g_agreedHostNs = stationToHost(g_startCoordNs);
+            g_haveStart = true;
+        }
+
+        scheduleStart(g_startCoordNs);
+        // Late joiners still get the start and fall in at the next pulse
+        int64_t nowNs = hostTimeNs();
+        if (nowNs >= nextAnnounceNs) {
+            nextAnnounceNs = nowNs + ANNOUNCE_INTERVAL_NS;
+            Message start;
+            start.type = MSG_START;
+            start.field[0] = g_startCoordNs;
+            start.field[1] = g_agreedHostNs;
+            for (const Agent& agent : g_agents) {
+                sendMessage(start, reinterpret_cast<const sockaddr*>(&agent.addr), agent.len);
+            }
+        }
+    }
+}
+
+void agentLoop(const sockaddr_storage& coordinator, socklen_t coordinatorLen) {
+    const sockaddr* to = reinterpret_cast<const sockaddr*>(&coordinator);
+    int64_t seq = 0;
+    int64_t nextPingNs = 0;
+    while (g_running.load()) {
+        int64_t nowNs = hostTimeNs();
+        if (nowNs >= nextPingNs) {
+            nextPingNs = nowNs + PING_INTERVAL_NS;
+            Message ping;
+            ping.type = MSG_PING;
+            ping.field[0] = ++seq;
+            ping.field[1] = stationNowNs();
+            ping.field[2] = clockDriftEstimate().valid;
+            sendMessage(ping, to, coordinatorLen);
+        }
+
+        Message message;
+        sockaddr_storage from;
+        socklen_t fromLen;
+        int64_t stampNs;
+        if (receive(message, from, fromLen, stampNs, 10)) {
+            if (message.type == MSG_PONG) {
+                int64_t t1 = message.field[1], t2 = message.field[2], t3 = message.field[3], t4 = stampNs;
+                Exchange e;
+                e.localNs = t1 + (t4 - t1) / 2;
+                e.offsetNs = ((t2 - t1) + (t3 - t4)) / 2.0;
+                e.delayNs = (t4 - t1) - (t3 - t2);
+                g_bestDelayNs = g_exchangeCount == 0 ? e.delayNs : std::min(g_bestDelayNs, e.delayNs);
+                ++g_exchangeCount;
+                g_exchanges.push_back(e);
+                if (g_exchanges.size() > FIT_WINDOW) g_exchanges.pop_front();
+                g_fit = fitClock();
+            } else if (message.type == MSG_START) {
+                if (!g_haveStart) {
+                    g_startCoordNs = message.field[0];
+                    g_agreedHostNs = message.field[1];
+                    g_haveStart = true;
+                }
+                Message ack;
+                ack.type = MSG_ACK;
+                ack.field[0] = message.field[0];
+                sendMessage(ack, to, coordinatorLen);
+            }
+        }
+
+        if (g_haveStart && g_fit.valid) {
+            scheduleStart(coordinatorToStation(g_startCoordNs, g_fit));
+        }
+    }
+}
+
+} // namespace
+
+bool startNetSync(const NetSyncConfig& config) {
+    g_config = config;
+    g_simOriginNs = hostTimeNs();
+    g_exchanges.clear();
+    g_exchangeCount = 0;
+    g_agents.clear();
+    g_haveStart = false;
+    g_frozen = false;
+    g_startFrame.store(-1);
+    g_firstOnsetFrame.store(-1);
+
+    if (!addOnsetTap(onsetTap)) {
+        std::cerr << "No free engine tap for network sync" << std::endl;
+        return false;
+    }
+
+    g_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (g_socket < 0) {
+        std::cerr << "Sync socket failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (config.coordinatorPort > 0) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(config.coordinatorPort));
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(g_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            std::cerr << "Sync bind to port " << config.coordinatorPort << " failed: " << std::strerror(errno) << std::endl;
+            close(g_socket);
+            g_socket = -1;
+            return false;
+        }
+        std::cout << "Net sync: coordinator on UDP port " << config.coordinatorPort
+                  << ", waiting for " << config.agents << " agent(s)" << std::endl;
+        g_running.store(true);
+        g_thread = std::thread(coordinatorLoop);
+        return true;
+    }
+
+    sockaddr_storage coordinator;
+    socklen_t coordinatorLen;
+    if (!resolveCoordinator(config.coordinator, coordinator, coordinatorLen)) {
+        close(g_socket);
+        g_socket = -1;
+        return false;
+    }
+    std::cout << "Net sync: agent of " << config.coordinator << std::endl;
+    g_running.store(true);
+    g_thread = std::thread(agentLoop, coordinator, coordinatorLen);
+    return true;
+}
+
+bool stopNetSync() {
+    if (!g_thread.joinable()) return true;
+    g_running.store(false);
+    g_thread.join();
+    close(g_socket);
+    g_socket = -1;
+
+    bool coordinator = g_config.coordinatorPort > 0;
+    std::cout << std::fixed;
+    if (coordinator) {
+        int acked = static_cast<int>(std::count_if(g_agents.begin(), g_agents.end(), [](const Agent& a) { return a.acked; }));
+        std::cout << "Net sync (coordinator): " << g_agents.size() << " agent(s), "
+                  << acked << " acknowledged the start\n";
+    } else {
+        std::cout << "Net sync (agent): " << g_exchangeCount << " exchanges, best round trip "
+                  << std::setprecision(1) << g_bestDelayNs / 1e3 << " us\n";
+        if (g_fit.valid) {
+            std::cout << "  Station clock vs coordinator: " << std::showpos << std::setprecision(3)
+                      << -g_fit.offsetNs / 1e6 << " ms, " << std::setprecision(1) << -g_fit.skew * 1e6 << " ppm";
+            if (g_config.simOffsetMs != 0.0 || g_config.simSkewPpm != 0.0) {
+                int64_t refNs = g_fit.refNs;
+                double simOffsetMs = (refNs - stationToHost(refNs)) / 1e6;
+                std::cout << std::setprecision(3) << " (simulated " << simOffsetMs << " ms, "
+                          << std::setprecision(1) << g_config.simSkewPpm << " ppm)";
+            }
+            std::cout << std::noshowpos << "\n";
+        }
+    }
+
+    bool ok = g_haveStart && g_startFrame.load() >= 0;
+    if (!ok) {
+        std::cout << "  No session start was agreed\n" << std::defaultfloat;
+        return false;
+    }
+
+    int64_t startFrame = g_startFrame.load();
+    int64_t firstFrame = g_firstOnsetFrame.load(std::memory_order_acquire);
+    std::cout << "  Start: pulse 0 at frame " << startFrame;
+    if (firstFrame >= 0 && g_firstOnsetPulse.load() > 0) {
+        std::cout << ", joined late at pulse " << g_firstOnsetPulse.load();
+    }
+
+    // The agreed instant is on the coordinator's host clock, so this is
+    // only meaningful when every station runs on the same machine
+    int64_t heardNs;
+    if (firstFrame >= 0 && audibleHostNs(startFrame, heardNs)) {
+        double errorUs = (heardNs - g_agreedHostNs) / 1e3;
+        std::cout << ", heard " << std::showpos << std::setprecision(1) << errorUs << std::noshowpos
+                  << " us from the agreed instant (same-host clock)";
+        if (g_config.check) ok = std::fabs(errorUs) <= CHECK_TOLERANCE_US;
+    } else {
+        std::cout << ", not reached";
+        if (g_config.check) ok = false;
+    }
+    std::cout << "\n" << std::defaultfloat;
+    return ok;
+}
@@ -0,0 +1,46 @@
+/**
+ * Network-synchronized session start for group sessions on several
+ * machines.
+ *
+ * One station runs as coordinator and answers NTP-style time requests on
+ * a UDP port; every agent exchanges timestamps with it continuously and
+ * fits the coordinator clock against its own (offset and skew, from the
+ * lowest-delay exchanges). Once all expected agents are synchronized and
+ * every station's frame clock fit (clock_drift.h) has converged, about
+ * 10 s after its device opened, the coordinator announces a start
+ * instant on its clock. Each station maps
+ * that instant to its own host clock and then, through audibleFrameAt(),
+ * to an engine frame, and starts playback there with startPlaybackAt(),
+ * so pulse 0 is heard at the same moment everywhere.
+ *
+ * Stations stay paused until the start. After it they run on their own
+ * audio clocks.
+ */
+
+#pragma once
+
+#include <string>
+
+struct NetSyncConfig {
+    int coordinatorPort = 0;        // Coordinator: UDP port to listen on (0 = not a coordinator)
+    int agents = 0;                 // Coordinator: agents to wait for
+    std::string coordinator;        // Agent: coordinator HOST:PORT
+    double leadSeconds = 2.0;       // Coordinator: start this long after the last agent is ready
+    double simOffsetMs = 0.0;       // Simulated station clock error, for testing
+    double simSkewPpm = 0.0;
+    bool check = false;             // Fail the report if the start missed (same-host runs only)
+};
+
+/**
+ * Open the socket and start the exchange. Playback must be paused; the
+ * worker starts it at the agreed instant. Must be called before the audio
+ * device is started (registers an onset tap).
+ */
+bool startNetSync(const NetSyncConfig& config);
+
+/**
+ * Stop and print the clock fit and start report. Returns false if no
+ * start was agreed, or in check mode if the first onset missed the
+ * agreed instant by more than the tolerance.
+ */
+bool stopNetSync();
@@ -0,0 +1,592 @@
+#include "noise.h"
+#include "bench.h"
+#include "engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PNAS_NOISE_X86 1
+#endif
+
+// The filters must round the same on every kernel: no fused multiply-adds
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#endif
+
+namespace {
+
+typedef uint32_t U32x8 __attribute__((vector_size(32)));
+typedef int32_t I32x8 __attribute__((vector_size(32)));
+typedef uint64_t U64x8 __attribute__((vector_size(64)));
+typedef float F32x8 __attribute__((vector_size(32)));
+typedef float F32x4 __attribute__((vector_size(16)));
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+constexpr uint32_t PHILOX_M0 = 0xD2511F53u;
+constexpr uint32_t PHILOX_M1 = 0xCD9E8D57u;
+constexpr uint32_t PHILOX_W0 = 0x9E3779B9u;
+constexpr uint32_t PHILOX_W1 = 0xBB67AE85u;
+constexpr int PHILOX_ROUNDS = 10;
+constexpr int GROUP_FRAMES = 32;                // 8 lanes x 4 words per counter group
+constexpr float UNIFORM_SCALE = 1.0f / 8388608.0f;
+
+// Pink: Paul Kellet's refined filter bank at 44.1 kHz, one filter per lane.
+// Lane 6 is the direct path, lane 7 the white sample one frame late.
+constexpr float PINK_POLE[8] = {0.99886f, 0.99332f, 0.96900f, 0.86650f, 0.55000f, -0.7616f, 0.0f, 0.0f};
+constexpr float PINK_INPUT[8] = {0.0555179f, 0.0750759f, 0.1538520f, 0.3104856f,
+                                 0.5329522f, -0.0168980f, 0.5362f,    0.0f};
+constexpr float PINK_DELAYED = 0.115926f;
+
+// Poles as literals, not exp() at run time, so no libm enters the output
+constexpr float BROWN_POLE = 0.99857626f;       // exp(-2 pi 10 Hz / SAMPLE_RATE)
+constexpr float BAND_POLE = 0.97468040f;        // exp(-2 pi 180 Hz / SAMPLE_RATE), two per quadrature arm
+
+// Warm-up before each segment: several time constants of the slowest pole
+constexpr int PINK_WARMUP = 8192;
+constexpr int BROWN_WARMUP = 8192;
+constexpr int BAND_WARMUP = 1024;
+constexpr int RESPONSE_FRAMES = 1 << 17;        // Impulse response summed for the level
+
+// Band noise carrier: same period as the continuous tone
+constexpr int CARRIER_PERIOD = SAMPLE_RATE / std::gcd(SAMPLE_RATE, TONE_FREQUENCY);
+
+// Benchmark
+constexpr int BENCH_BLOCK = 512;
+constexpr int CHECK_FRAMES = 3 * NOISE_SEGMENT_FRAMES + 12345;
+constexpr int CHECK_STARTS = 64;
+constexpr int SPECTRUM_FRAMES = 8192;
+constexpr double SPECTRUM_SECONDS = 30.0;
+constexpr double OCTAVES[] = {125.0, 250.0, 500.0, 1000.0, 2000.0, 4000.0, 8000.0};
+constexpr double SLOPE_TOLERANCE_DB = 0.5;      // Per octave
+constexpr double LEVEL_TOLERANCE_DB = 0.5;
+constexpr double MIN_BAND_REJECTION_DB = 15.0;  // An octave either side of the carrier
+
+struct Carrier {
+    float cosine[CARRIER_PERIOD];
+    float sine[CARRIER_PERIOD];
+};
+
+const Carrier& carrier() {
+    static const Carrier table = [] {
+        Carrier c{};
+        for (int i = 0; i < CARRIER_PERIOD; ++i) {
+            double phase = 2.0 * M_PI * TONE_FREQUENCY * i / SAMPLE_RATE;
+            c.cosine[i] = static_cast<float>(std::cos(phase));
+            c.sine[i] = static_cast<float>(std::sin(phase));
+        }
+        return c;
+    }();
+    return table;
+}
+
+int64_t floorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+/**
+ * White samples of counter groups firstGroup .. firstGroup + groups - 1:
+ * frame 32 g + 8 w + l is word w of lane l of group g. Portable form
+ * through the compiler's vector types (NEON, or plain C elsewhere).
+ */
+#ifndef PNAS_NOISE_X86
+void philoxGeneric(uint64_t key, uint32_t stream, int64_t firstGroup, int groups, float* out) {
+    const U32x8 lanes = {0, 1, 2, 3, 4, 5, 6, 7};
+    for (int g = 0; g < groups; ++g) {
+        uint64_t counter = static_cast<uint64_t>(firstGroup + g) * 8;
+        U32x8 x0 = lanes + static_cast<uint32_t>(counter);
+        U32x8 x1 = U32x8{} + static_cast<uint32_t>(counter >> 32);
+        U32x8 x2 = U32x8{} + stream;
+        U32x8 x3 = U32x8{};
+        uint32_t k0 = static_cast<uint32_t>(key);
+        uint32_t k1 = static_cast<uint32_t>(key >> 32);
+        for (int r = 0; r < PHILOX_ROUNDS; ++r) {
+            U64x8 p0 = __builtin_convertvector(x0, U64x8) * static_cast<uint64_t>(PHILOX_M0);
+            U64x8 p1 = __builtin_convertvector(x2, U64x8) * static_cast<uint64_t>(PHILOX_M1);
+            x0 = __builtin_convertvector(p1 >> 32, U32x8) ^ x1 ^ k0;
+            x1 = __builtin_convertvector(p1, U32x8);
+            x2 = __builtin_convertvector(p0 >> 32, U32x8) ^ x3 ^ k1;
+            x3 = __builtin_convertvector(p0, U32x8);
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+        const U32x8 words[4] = {x0, x1, x2, x3};
+        for (int w = 0; w < 4; ++w) {
+            // Top 24 bits as a signed fraction in [-1, 1)
+            F32x8 value = __builtin_convertvector(reinterpret_cast<const I32x8&>(words[w]) >> 8, F32x8) * UNIFORM_SCALE;
+            std::memcpy(out + static_cast<size_t>(g) * GROUP_FRAMES + w * 8, &value, sizeof(value));
+        }
+    }
+}
+#endif
+
+#ifdef PNAS_NOISE_X86
+// 32 x 32 -> 64 bit products of four lanes: low halves in `lo`, high in `hi`
+inline void mulhiloSse(__m128i a, __m128i m, __m128i& hi, __m128i& lo) {
+    __m128i even = _mm_mul_epu32(a, m);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+    __m128i mask = _mm_set_epi32(0, -1, 0, -1);
+    lo = _mm_or_si128(_mm_and_si128(even, mask), _mm_slli_epi64(odd, 32));
+    hi = _mm_or_si128(_mm_srli_epi64(even, 32), _mm_andnot_si128(mask, odd));
+}
+
+void philoxSse(uint64_t key, uint32_t stream, int64_t firstGroup, int groups, float* out) {
+    const __m128i m0 = _mm_set1_epi32(static_cast<int>(PHILOX_M0));
+    const __m128i m1 = _mm_set1_epi32(static_cast<int>(PHILOX_M1));
+    const __m128 scale = _mm_set1_ps(UNIFORM_SCALE);
+    for (int g = 0; g < groups; ++g) {
+        uint64_t counter = static_cast<uint64_t>(firstGroup + g) * 8;
+        for (int half = 0; half < 2; ++half) {
+            uint32_t low = static_cast<uint32_t>(counter) + 4 * half;
+            __m128i x0 = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(low)), _mm_set_epi32(3, 2, 1, 0));
+            __m128i x1 = _mm_set1_epi32(static_cast<int>(counter >> 32));
+            __m128i x2 = _mm_set1_epi32(static_cast<int>(stream));
+            __m128i x3 = _mm_setzero_si128();
+            uint32_t k0 = static_cast<uint32_t>(key);
+            uint32_t k1 = static_cast<uint32_t>(key >> 32);
+            for (int r = 0; r < PHILOX_ROUNDS; ++r) {
+                __m128i hi0, lo0, hi1, lo1;
+                mulhiloSse(x0, m0, hi0, lo0);
+                mulhiloSse(x2, m1, hi1, lo1);
+                x0 = _mm_xor_si128(_mm_xor_si128(hi1, x1), _mm_set1_epi32(static_cast<int>(k0)));
+                x1 = lo1;
+                x2 = _mm_xor_si128(_mm_xor_si128(hi0, x3), _mm_set1_epi32(static_cast<int>(k1)));
+                x3 = lo0;
+                k0 += PHILOX_W0;
+                k1 += PHILOX_W1;
+            }
+            float* group = out + static_cast<size_t>(g) * GROUP_FRAMES + 4 * half;
+            const __m128i words[4] = {x0, x1, x2, x3};
+            for (int w = 0; w < 4; ++w) {
+                _mm_storeu_ps(group + w * 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(words[w], 8)), scale));
+            }
+        }
+    }
+}
+
+__attribute__((target("avx2"))) inline void mulhiloAvx2(__m256i a, __m256i m, __m256i& hi, __m256i& lo) {
+    __m256i even = _mm256_mul_epu32(a, m);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+    lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+    hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+}
+
+__attribute__((target("avx2"))) void philoxAvx2(uint64_t key, uint32_t stream, int64_t firstGroup, int groups,
+                                                float* out) {
+    const __m256i m0 = _mm256_set1_epi32(static_cast<int>(PHILOX_M0));
+    const __m256i m1 = _mm256_set1_epi32(static_cast<int>(PHILOX_M1));
+    const __m256i lanes = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256 scale = _mm256_set1_ps(UNIFORM_SCALE);
+    for (int g = 0; g < groups; ++g) {
+        uint64_t counter = static_cast<uint64_t>(firstGroup + g) * 8;
+        __m256i x0 = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>(counter))), lanes);
+        __m256i x1 = _mm256_set1_epi32(static_cast<int>(counter >> 32));
+        __m256i x2 = _mm256_set1_epi32(static_cast<int>(stream));
+        __m256i x3 = _mm256_setzero_si256();
+        uint32_t k0 = static_cast<uint32_t>(key);
+        uint32_t k1 = static_cast<uint32_t>(key >> 32);
+        for (int r = 0; r < PHILOX_ROUNDS; ++r) {
+            __m256i hi0, lo0, hi1, lo1;
+            mulhiloAvx2(x0, m0, hi0, lo0);
+            mulhiloAvx2(x2, m1, hi1, lo1);
+            x0 = _mm256_xor_si256(_mm256_xor_si256(hi1, x1), _mm256_set1_epi32(static_cast<int>(k0)));
+            x1 = lo1;
+            x2 = _mm256_xor_si256(_mm256_xor_si256(hi0, x3), _mm256_set1_epi32(static_cast<int>(k1)));
+            x3 = lo0;
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+        float* group = out + static_cast<size_t>(g) * GROUP_FRAMES;
+        const __m256i words[4] = {x0, x1, x2, x3};
+        for (int w = 0; w < 4; ++w) {
+            _mm256_storeu_ps(group + w * 8, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(words[w], 8)), scale));
+        }
+    }
+}
+#endif
+
+const char* baselineName() {
+#ifdef PNAS_NOISE_X86
+    return "SSE2";
+#elif defined(__ARM_NEON)
+    return "NEON";
+#else
+    return "generic";
+#endif
+}
+
+}  // namespace
+
+bool parseNoiseColor(const std::string& name, NoiseColor& color) {
+    if (name == "white") color = NOISE_WHITE;
+    else if (name == "pink") color = NOISE_PINK;
+    else if (name == "brown") color = NOISE_BROWN;
+    else if (name == "band") color = NOISE_BAND;
+    else return false;
+    return true;
+}
+
+const char* noiseColorName(NoiseColor color) {
+    switch (color) {
+        case NOISE_WHITE: return "white";
+        case NOISE_PINK: return "pink";
+        case NOISE_BROWN: return "brown";
+        case NOISE_BAND: return "band";
+    }
+    return "?";
+}
+
+void NoiseGenerator::init(const NoiseConfig& config, bool baseline) {
+    config_ = config;
+    avx2_ = false;
+#ifdef PNAS_NOISE_X86
+    philox_ = philoxSse;
+    if (!baseline && __builtin_cpu_supports("avx2")) {
+        philox_ = philoxAvx2;
+        avx2_ = true;
+    }
+#else
+    philox_ = philoxGeneric;
+    (void)baseline;
+#endif
+    switch (config.color) {
+        case NOISE_WHITE: warmup_ = 0; break;
+        case NOISE_PINK: warmup_ = PINK_WARMUP; break;
+        case NOISE_BROWN: warmup_ = BROWN_WARMUP; break;
+        case NOISE_BAND: warmup_ = BAND_WARMUP; carrier(); break;
+    }
+
+    // Unit gain, then the power the filter puts out for uniform white
+    // noise (variance 1/3) from its impulse response
+    gain_ = 1.0f;
+    double energy = 0.0;
+    if (config.color == NOISE_WHITE) {
+        energy = 1.0;
+    } else if (config.color == NOISE_BAND) {
+        // Each quadrature arm is two cascaded one-poles; I and Q each carry
+        // half the power after modulation
+        double a = BAND_POLE, h1 = 0.0, h2 = 0.0;
+        for (int n = 0; n < RESPONSE_FRAMES; ++n) {
+            h1 = a * h1 + (n == 0 ? 1.0 : 0.0);
+            h2 = a * h2 + h1;
+            energy += h2 * h2;
+        }
+    } else {
+        float impulse[NOISE_BLOCK_FRAMES];
+        float response[NOISE_BLOCK_FRAMES];
+        std::fill(std::begin(bank_), std::end(bank_), 0.0f);
+        previous_ = 0.0f;
+        std::fill(std::begin(stage_), std::end(stage_), 0.0f);
+        for (int n = 0; n < RESPONSE_FRAMES; n += NOISE_BLOCK_FRAMES) {
+            std::fill(std::begin(impulse), std::end(impulse), 0.0f);
+            if (n == 0) impulse[0] = 1.0f;
+            shape(response, impulse, nullptr, 0, NOISE_BLOCK_FRAMES, false);
+            for (float h : response) energy += static_cast<double>(h) * h;
+        }
+    }
+    gain_ = static_cast<float>(std::pow(10.0, config.levelDb / 20.0) / std::sqrt(energy / 3.0));
+    next_ = INT64_MIN;
+}
+
+const char* NoiseGenerator::kernelName() const {
+    return avx2_ ? "AVX2" : baselineName();
+}
+
+const float* NoiseGenerator::white(float* buffer, uint32_t stream, int64_t frame, int frames) {
+    int64_t first = floorDiv(frame, GROUP_FRAMES);
+    int64_t last = floorDiv(frame + frames - 1, GROUP_FRAMES);
+    philox_(config_.seed, stream, first, static_cast<int>(last - first + 1), buffer);
+    return buffer + (frame - first * GROUP_FRAMES);
+}
+
+void NoiseGenerator::shape(float* out, const float* w, const float* q, int64_t frame, int frames, bool add) {
+    float y[NOISE_BLOCK_FRAMES];
+    switch (config_.color) {
+        case NOISE_WHITE:
+            for (int i = 0; i < frames; ++i) y[i] = w[i];
+            break;
+        case NOISE_PINK: {
+            // The 8-lane bank as two native 4-lane halves, so the state
+            // stays in registers on SSE2 and NEON alike
+            F32x4 lo, hi, poleLo, poleHi, inputLo, inputHi;
+            std::memcpy(&lo, bank_, sizeof(lo));
+            std::memcpy(&hi, bank_ + 4, sizeof(hi));
+            std::memcpy(&poleLo, PINK_POLE, sizeof(poleLo));
+            std::memcpy(&poleHi, PINK_POLE + 4, sizeof(poleHi));
+            std::memcpy(&inputLo, PINK_INPUT, sizeof(inputLo));
+            std::memcpy(&inputHi, PINK_INPUT + 4, sizeof(inputHi));
+            const F32x4 delayed = {0.0f, 0.0f, 0.0f, PINK_DELAYED};
+            float p = previous_;
+            // Only the multiply-add on the bank is serial; the lanes are
+            // summed afterwards, off the recursion
+            alignas(16) float pairs[NOISE_BLOCK_FRAMES][4];
+            for (int i = 0; i < frames; ++i) {
+                lo = poleLo * lo + inputLo * w[i];
+                hi = poleHi * hi + (inputHi * w[i] + delayed * p);
+                p = w[i];
+                F32x4 pair = lo + hi;
+                std::memcpy(pairs[i], &pair, sizeof(pair));
+            }
+            for (int i = 0; i < frames; ++i) y[i] = (pairs[i][0] + pairs[i][2]) + (pairs[i][1] + pairs[i][3]);
+            std::memcpy(bank_, &lo, sizeof(lo));
+            std::memcpy(bank_ + 4, &hi, sizeof(hi));
+            previous_ = p;
+            break;
+        }
+        case NOISE_BROWN: {
+            float s = stage_[0];
+            for (int i = 0; i < frames; ++i) {
+                s = BROWN_POLE * s + w[i];
+                y[i] = s;
+            }
+            stage_[0] = s;
+            break;
+        }
+        case NOISE_BAND: {
+            const Carrier& c = carrier();
+            float i1 = stage_[0], q1 = stage_[1], i2 = stage_[2], q2 = stage_[3];
+            int phase = static_cast<int>(frame % CARRIER_PERIOD);
+            if (phase < 0) phase += CARRIER_PERIOD;
+            for (int i = 0; i < frames; ++i) {
+                i1 = BAND_POLE * i1 + w[i];
+                q1 = BAND_POLE * q1 + q[i];
+                i2 = BAND_POLE * i2 + i1;
+                q2 = BAND_POLE * q2 + q1;
+                y[i] = i2 * c.cosine[phase] - q2 * c.sine[phase];
+                if (++phase == CARRIER_PERIOD) phase = 0;
+            }
+            stage_[0] = i1;
+            stage_[1] = q1;
+            stage_[2] = i2;
+            stage_[3] = q2;
+            break;
+        }
+    }
+    if (!out) return;
+    if (add) {
+        for (int i = 0; i < frames; ++i) out[i] += y[i] * gain_;
+    } else {
+        for (int i = 0; i < frames; ++i) out[i] = y[i] * gain_;
+    }
+}
+
+void NoiseGenerator::filter(float* out, int64_t frame, int frames, bool add) {
+    const float* w = white(white_, 0, frame, frames);
+    const float* q = config_.color == NOISE_BAND ? white(quadrature_, 1, frame, frames) : nullptr;
+    shape(out, w, q, frame, frames, add);
+}
+
+void NoiseGenerator::restart(int64_t frame) {
+    std::fill(std::begin(bank_), std::end(bank_), 0.0f);
+    previous_ = 0.0f;
+    std::fill(std::begin(stage_), std::end(stage_), 0.0f);
+    next_ = floorDiv(frame, NOISE_SEGMENT_FRAMES) * NOISE_SEGMENT_FRAMES - warmup_;
+    while (next_ < frame) {
+        int n = static_cast<int>(std::min<int64_t>(NOISE_BLOCK_FRAMES, frame - next_));
+        filter(nullptr, next_, n, false);
+        next_ += n;
+    }
+}
+
+void NoiseGenerator::render(float* out, int64_t frame, int frames, bool add) {
+    if (frame != next_) restart(frame);
+    while (frames > 0) {
+        int64_t segmentEnd = (floorDiv(next_, NOISE_SEGMENT_FRAMES) + 1) * NOISE_SEGMENT_FRAMES;
+        int n = static_cast<int>(std::min<int64_t>({frames, NOISE_BLOCK_FRAMES, segmentEnd - next_}));
+        filter(out, next_, n, add);
+        out += n;
+        next_ += n;
+        frames -= n;
+        if (next_ == segmentEnd) restart(next_);
+    }
+}
+
+namespace {
+
+std::vector<float> renderSequential(const NoiseConfig& config, bool baseline, int64_t start, int frames, int block) {
+    NoiseGenerator gen;
+    gen.init(config, baseline);
+    std::vector<float> out(frames);
+    for (int i = 0; i < frames; i += block) gen.render(out.data() + i, start + i, std::min(block, frames - i));
+    return out;
+}
+
+/**
+ * Welch power at each octave centre: Hann-windowed segments, one Goertzel
+ * (direct DFT bin) per frequency, averaged
+ */
+std::vector<double> octavePower(const std::vector<float>& x) {
+    std::vector<double> window(SPECTRUM_FRAMES);
+    for (int n = 0; n < SPECTRUM_FRAMES; ++n) window[n] = 0.5 - 0.5 * std::cos(2.0 * M_PI * n / SPECTRUM_FRAMES);
+
+    std::vector<double> power;
+    for (double hz : OCTAVES) {
+        double coeff = 2.0 * std::cos(2.0 * M_PI * hz / SAMPLE_RATE);
+        double sum = 0.0;
+        int segments = 0;
+        for (size_t start = 0; start + SPECTRUM_FRAMES <= x.size(); start += SPECTRUM_FRAMES, ++segments) {
+            double s1 = 0.0, s2 = 0.0;
+            for (int n = 0; n < SPECTRUM_FRAMES; ++n) {
+                double s0 = x[start + n] * window[n] + coeff * s1 - s2;
+                s2 = s1;
+                s1 = s0;
+            }
+            sum += s1 * s1 + s2 * s2 - coeff * s1 * s2;
+        }
+        power.push_back(sum / std::max(1, segments));
+    }
+    return power;
+}
+
+}  // namespace
+
+int runNoiseBenchmark(double seconds) {
+    NoiseGenerator probe;
+    probe.init(NoiseConfig{});
+    const int64_t total = static_cast<int64_t>(seconds * SAMPLE_RATE);
+    std::cout << "Noise generators: " << seconds << " s per source in " << BENCH_BLOCK << "-frame blocks, "
+              << probe.kernelName() << " kernel\n"
+              << "  source               " << std::setw(8) << probe.kernelName() << " x RT  ns/frame  "
+              << baselineName() << " x RT  ns/frame\n";
+
+    std::vector<float> block(BENCH_BLOCK);
+    volatile float sink = 0.0f;
+    auto report = [&](const char* name, double fast, double slow) {
+        std::cout << "  " << std::left << std::setw(19) << name << std::right << std::fixed << std::setprecision(0)
+                  << std::setw(15) << total / fast / SAMPLE_RATE << std::setprecision(2) << std::setw(10)
+                  << 1e9 * fast / total;
+        if (slow > 0.0) {
+            std::cout << std::setprecision(0) << std::setw(11) << total / slow / SAMPLE_RATE << std::setprecision(2)
+                      << std::setw(10) << 1e9 * slow / total;
+        }
+        std::cout << "\n" << std::defaultfloat;
+    };
+
+    // The pulse train on its own, for scale
+    buildRenderTables();
+    auto start = std::chrono::steady_clock::now();
+    for (int64_t f = 0; f < total; f += BENCH_BLOCK) {
+        renderBlock(block.data(), f, BENCH_BLOCK);
+        sink = sink + block[f % BENCH_BLOCK];
+    }
+    report("tone (pulse train)", secondsSince(start), 0.0);
+
+    for (NoiseColor color : {NOISE_WHITE, NOISE_PINK, NOISE_BROWN, NOISE_BAND}) {
+        NoiseConfig config;
+        config.color = color;
+        double elapsed[2];
+        for (int baseline = 0; baseline < 2; ++baseline) {
+            NoiseGenerator gen;
+            gen.init(config, baseline != 0);
+            start = std::chrono::steady_clock::now();
+            for (int64_t f = 0; f < total; f += BENCH_BLOCK) {
+                gen.render(block.data(), f, BENCH_BLOCK);
+                sink = sink + block[f % BENCH_BLOCK];
+            }
+            elapsed[baseline] = secondsSince(start);
+        }
+        report(noiseColorName(color), elapsed[0], elapsed[1]);
+    }
+
+    // Same bits for any split, start and kernel
+    bool ok = true;
+    std::mt19937 rng(2024);
+    std::cout << "  determinism over " << CHECK_FRAMES << " frames (" << CHECK_FRAMES / NOISE_SEGMENT_FRAMES
+              << " segment seams): block splits, " << CHECK_STARTS << " random starts, " << baselineName()
+              << " kernel\n";
+    for (NoiseColor color : {NOISE_WHITE, NOISE_PINK, NOISE_BROWN, NOISE_BAND}) {
+        NoiseConfig config;
+        config.color = color;
+        config.seed = 0x5eed0000u + color;
+        const int64_t origin = -NOISE_SEGMENT_FRAMES / 2;
+        std::vector<float> reference = renderSequential(config, false, origin, CHECK_FRAMES, 4096);
+
+        std::vector<float> split(CHECK_FRAMES);
+        NoiseGenerator gen;
+        gen.init(config);
+        for (int i = 0; i < CHECK_FRAMES;) {
+            int n = std::min(CHECK_FRAMES - i, static_cast<int>(rng() % 3000) + 1);
+            gen.render(split.data() + i, origin + i, n);
+            i += n;
+        }
+        bool splitOk = std::memcmp(split.data(), reference.data(), CHECK_FRAMES * sizeof(float)) == 0;
+
+        bool startsOk = true;
+        for (int k = 0; k < CHECK_STARTS; ++k) {
+            int offset = static_cast<int>(rng() % (CHECK_FRAMES - 1));
+            int n = std::min(CHECK_FRAMES - offset, static_cast<int>(rng() % 5000) + 1);
+            NoiseGenerator fresh;
+            fresh.init(config);
+            std::vector<float> part(n);
+            fresh.render(part.data(), origin + offset, n);
+            startsOk = startsOk && std::memcmp(part.data(), reference.data() + offset, n * sizeof(float)) == 0;
+        }
+
+        std::vector<float> baseline = renderSequential(config, true, origin, CHECK_FRAMES, 777);
+        bool kernelOk = std::memcmp(baseline.data(), reference.data(), CHECK_FRAMES * sizeof(float)) == 0;
+
+        std::cout << "    " << std::left << std::setw(6) << noiseColorName(color) << std::right << " splits "
+                  << (splitOk ? "same" : "DIFFER") << ", starts " << (startsOk ? "same" : "DIFFER") << ", kernels "
+                  << (kernelOk ? "same" : "DIFFER") << "\n";
+        ok = ok && splitOk && startsOk && kernelOk;
+    }
+
+    // Spectral shape and level
+    const int spectrumFrames = static_cast<int>(std::min(seconds, SPECTRUM_SECONDS) * SAMPLE_RATE);
+    std::cout << "  spectrum, " << spectrumFrames / SAMPLE_RATE << " s, octaves " << static_cast<int>(OCTAVES[0]) << " - "
+              << static_cast<int>(OCTAVES[std::size(OCTAVES) - 1]) << " Hz (configured " << NoiseConfig{}.levelDb << " dBFS RMS)\n";
+    const double expectedSlope[] = {0.0, -3.0103, -6.0206};
+    for (NoiseColor color : {NOISE_WHITE, NOISE_PINK, NOISE_BROWN, NOISE_BAND}) {
+        NoiseConfig config;
+        config.color = color;
+        std::vector<float> x = renderSequential(config, false, 0, spectrumFrames, 4096);
+        double energy = 0.0;
+        for (float v : x) energy += static_cast<double>(v) * v;
+        double levelDb = 10.0 * std::log10(energy / x.size());
+        bool levelOk = std::fabs(levelDb - config.levelDb) <= LEVEL_TOLERANCE_DB;
+
+        std::vector<double> power = octavePower(x);
+        std::vector<double> db;
+        for (double p : power) db.push_back(10.0 * std::log10(p));
+
+        std::cout << "    " << std::left << std::setw(6) << noiseColorName(color) << std::right << std::fixed
+                  << std::setprecision(2) << " level " << std::setw(7) << levelDb << " dBFS";
+        bool shapeOk;
+        if (color == NOISE_BAND) {
+            // Carrier octave against the octaves either side
+            double below = db[3] - db[2];
+            double above = db[3] - db[4];
+            shapeOk = below >= MIN_BAND_REJECTION_DB && above >= MIN_BAND_REJECTION_DB;
+            std::cout << ", " << TONE_FREQUENCY << " Hz over 500 Hz " << std::setprecision(1) << below
+                      << " dB, over 2000 Hz " << above << " dB";
+        } else {
+            // Least-squares slope of dB against octave number
+            double n = static_cast<double>(db.size());
+            double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+            for (size_t k = 0; k < db.size(); ++k) {
+                sx += k;
+                sy += db[k];
+                sxx += static_cast<double>(k) * k;
+                sxy += k * db[k];
+            }
+            double slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+            shapeOk = std::fabs(slope - expectedSlope[color]) <= SLOPE_TOLERANCE_DB;
+            std::cout << ", slope " << std::setw(6) << slope << " dB/octave (expected " << expectedSlope[color] << ")";
+        }
+        std::cout << "  " << verdict(levelOk && shapeOk) << "\n" << std::defaultfloat;
+        ok = ok && levelOk && shapeOk;
+    }
+
+    std::cout << verdict(ok) << "\n";
+    return ok ? 0 : 1;
+}
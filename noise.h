@@ -0,0 +1,92 @@
+/**
+ * Noise for masking and sham conditions: white, pink, brown, and noise
+ * band-limited around the carrier.
+ *
+ * Every source starts from a counter-based generator (Philox4x32-10): the
+ * white value of frame n is a pure function of the seed and n, computed
+ * eight counters at a time across SIMD lanes (AVX2 chosen at run time,
+ * else SSE2, or NEON through the compiler's vector types). Frame n sits in
+ * lane n % 8, word (n / 8) % 4 of the counter block n / 32, so a block is
+ * stored without transposing. Pink noise comes from a bank of one-pole
+ * filters held in one 8-lane vector and updated together each frame;
+ * brown noise is a leaky integrator; band noise is a pair of quadrature
+ * low-pass noises modulated onto the carrier.
+ *
+ * The filters restart every NOISE_SEGMENT_FRAMES frames from a warm-up
+ * run over the frames before the segment, so frame n depends only on the
+ * seed and n: blocks of any size, rendered in any order by any number of
+ * threads, on any of the kernels, give the same bits. The warm-up is long
+ * enough that the seam lies far below the noise floor.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+enum NoiseColor {
+    NOISE_WHITE = 0,
+    NOISE_PINK = 1,             // -3 dB per octave
+    NOISE_BROWN = 2,            // -6 dB per octave above 10 Hz
+    NOISE_BAND = 3,             // About a third of an octave around TONE_FREQUENCY
+};
+
+constexpr int NOISE_SEGMENT_FRAMES = 1 << 16;   // Same as the offline render chunk
+constexpr int NOISE_BLOCK_FRAMES = 256;         // Filtered per pass
+
+struct NoiseConfig {
+    NoiseColor color = NOISE_PINK;
+    uint64_t seed = 1;
+    double levelDb = -30.0;     // RMS, dB full scale
+};
+
+bool parseNoiseColor(const std::string& name, NoiseColor& color);
+const char* noiseColorName(NoiseColor color);
+
+class NoiseGenerator {
+public:
+    /**
+     * Set up for `config`. With `baseline` the AVX2 kernel is not used
+     * (benchmark and cross-check). Does not allocate.
+     */
+    void init(const NoiseConfig& config, bool baseline = false);
+
+    /**
+     * Write (or with `add`, add) `frames` mono frames from frame `frame`
+     * on. Continuing from the previous call's end is cheapest; a jump
+     * replays from the segment's warm-up.
+     */
+    void render(float* out, int64_t frame, int frames, bool add = false);
+
+    const char* kernelName() const;
+
+private:
+    using PhiloxFn = void (*)(uint64_t key, uint32_t stream, int64_t firstGroup, int groups, float* out);
+
+    void restart(int64_t frame);
+    const float* white(float* buffer, uint32_t stream, int64_t frame, int frames);
+    void shape(float* out, const float* w, const float* q, int64_t frame, int frames, bool add);
+    void filter(float* out, int64_t frame, int frames, bool add);
+
+    NoiseConfig config_;
+    PhiloxFn philox_ = nullptr;
+    bool avx2_ = false;
+    float gain_ = 0.0f;
+    int warmup_ = 0;
+    int64_t next_ = INT64_MIN;      // Frame the filter state is at
+
+    // Filter state
+    alignas(32) float bank_[8] = {};
+    float previous_ = 0.0f;         // Last white sample (pink's delayed tap)
+    float stage_[4] = {};           // Brown: [0]; band: I1, Q1, I2, Q2
+
+    alignas(32) float white_[NOISE_BLOCK_FRAMES + 32];
+    alignas(32) float quadrature_[NOISE_BLOCK_FRAMES + 32];
+};
+
+/**
+ * Throughput of every colour against the tone path at 44.1 kHz (AVX2 and
+ * baseline kernels), determinism across block splits, random starts and
+ * kernels, and the measured spectral slope and level of each colour
+ */
+int runNoiseBenchmark(double seconds);
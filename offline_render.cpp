@@ -0,0 +1,180 @@
+#include "offline_render.h"
+#include "bench.h"
+#include "async_writer.h"
+#include "engine.h"
+#include "flac_export.h"
+#include "wav_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int CHUNK_FRAMES = 1 << 16;      // ~1.5 s: a few MB per worker buffer
+
+/**
+ * Render frames [0, totalFrames) in CHUNK_FRAMES pieces on `threads`
+ * workers. Each chunk is rendered into `acquire(startFrame, tag)` and
+ * then passed to `consume(samples, tag, startFrame, frames)` on the same
+ * worker, in no particular order; returning false stops all workers.
+ */
+template <typename Acquire, typename Consume>
+bool renderChunks(int64_t totalFrames, int threads, Acquire acquire, Consume consume) {
+    int64_t chunks = (totalFrames + CHUNK_FRAMES - 1) / CHUNK_FRAMES;
+    std::atomic<int64_t> next{0};
+    std::atomic<bool> failed{false};
+
+    auto worker = [&] {
+        while (!failed.load(std::memory_order_relaxed)) {
+            int64_t chunk = next.fetch_add(1, std::memory_order_relaxed);
+            if (chunk >= chunks) break;
+            int64_t start = chunk * CHUNK_FRAMES;
+            int frames = static_cast<int>(std::min<int64_t>(CHUNK_FRAMES, totalFrames - start));
+            int tag = 0;
+            float* buffer = acquire(start, tag);
+            renderOutputBlock(buffer, start, frames);
+            if (!consume(buffer, tag, start, frames)) failed.store(true);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; ++i) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+    return !failed.load();
+}
+
+uint64_t fnv1a(const float* samples, size_t count) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(samples);
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < count * sizeof(float); ++i) {
+        h = (h ^ p[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+} // namespace
+
+bool parseRenderFormat(const std::string& name, RenderFormat& format) {
+    std::string ext = name.substr(name.find_last_of('.') + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    WavContainer container;
+    if (ext == "raw" || ext == "f32") {
+        format = RENDER_RAW;
+    } else if (ext == "flac") {
+        format = RENDER_FLAC;
+    } else if (parseWavContainer(ext, container)) {
+        format = container == WAV_RF64 ? RENDER_RF64 : container == WAV_W64 ? RENDER_W64 : RENDER_WAV;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int runOfflineRender(const RenderConfig& config) {
+    if (config.format == RENDER_FLAC) {
+        return runFlacRender(config);
+    }
+    buildRenderTables();
+    int channels = outputChannels();
+    int threads = threadCount(config.threads);
+    int64_t totalFrames = static_cast<int64_t>(config.seconds * SAMPLE_RATE);
+    uint64_t dataBytes = static_cast<uint64_t>(totalFrames) * channels * sizeof(float);
+
+    std::vector<uint8_t> header;
+    const char* formatName = "raw float32";
+    if (config.format != RENDER_RAW) {
+        WavContainer container = config.format == RENDER_RF64 ? WAV_RF64 : config.format == RENDER_W64 ? WAV_W64 : WAV_RIFF;
+        formatName = wavContainerName(container);
+        // Padded so every chunk lands on a page boundary (O_DIRECT)
+        header = wavHeader(container, totalFrames, channels, SAMPLE_RATE, WAV_DATA_ALIGN);
+        if (header.empty()) {
+            std::cerr << "Session too long for a WAV file (" << dataBytes / (1 << 20)
+                      << " MB of samples, RIFF limit 4 GB); render to .rf64 or .w64 instead" << std::endl;
+            return 1;
+        }
+    }
+
+    // Each worker holds one buffer while it renders; `queueDepth` more
+    // are in flight to the disk
+    AsyncWriterConfig io = config.io;
+    io.bufferBytes = static_cast<size_t>(CHUNK_FRAMES) * channels * sizeof(float);
+    AsyncWriter writer;
+    if (!writer.open(config.path, io, threads)) return 1;
+
+    // Samples go out in host byte order; every supported target is little-endian
+    auto start = std::chrono::steady_clock::now();
+    int64_t dataOffset = static_cast<int64_t>(header.size());
+    bool ok = (header.empty() || writer.writeSync(header.data(), header.size(), 0)) &&
+              renderChunks(totalFrames, threads,
+                  [&](int64_t, int& slot) { return reinterpret_cast<float*>(writer.acquire(slot)); },
+                  [&](const float*, int slot, int64_t first, int frames) {
+                      int64_t offset = dataOffset + first * channels * static_cast<int64_t>(sizeof(float));
+                      return writer.submit(slot, static_cast<size_t>(frames) * channels * sizeof(float), offset);
+                  });
+    std::string backend = writer.backendName();
+    if (!writer.close(dataOffset + static_cast<int64_t>(dataBytes))) ok = false;
+    if (!ok) {
+        std::cerr << "Write to " << config.path << " failed: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    double elapsed = secondsSince(start);
+
+    double minutes = static_cast<double>(totalFrames) / SAMPLE_RATE / 60.0;
+    std::cout << "Rendered " << config.path << ": " << std::fixed << std::setprecision(1) << minutes
+              << " min, " << channels << " ch, " << formatName
+              << ", " << dataBytes / (1 << 20) << " MB in " << std::setprecision(2) << elapsed << " s on "
+              << threads << " threads, " << backend << (io.direct ? ", O_DIRECT" : "") << " ("
+              << std::setprecision(1) << minutes / elapsed << " min of audio/s)\n"
+              << std::defaultfloat;
+    return 0;
+}
+
+int runRenderBenchmark(double seconds) {
+    buildRenderTables();
+    int channels = outputChannels();
+    int64_t totalFrames = static_cast<int64_t>(seconds * SAMPLE_RATE);
+    double minutes = seconds / 60.0;
+    std::vector<float> out(static_cast<size_t>(totalFrames) * channels);
+
+    std::vector<int> counts;
+    int cores = threadCount(0);
+    for (int t = 1; t < cores; t *= 2) counts.push_back(t);
+    counts.push_back(cores);
+
+    std::cout << "Offline render: " << minutes << " min, " << channels << " ch, "
+              << CHUNK_FRAMES << "-frame chunks, into memory\n"
+              << "  threads   min of audio/s   speedup   output\n";
+    uint64_t reference = 0;
+    double baseRate = 0.0;
+    bool identical = true;
+    for (int threads : counts) {
+        // Poison the buffer so a chunk that was skipped cannot match
+        std::fill(out.begin(), out.end(), -2.0f);
+        auto start = std::chrono::steady_clock::now();
+        renderChunks(totalFrames, threads,
+            [&](int64_t first, int&) { return out.data() + first * channels; },
+            [](const float*, int, int64_t, int) { return true; });
+        double elapsed = secondsSince(start);
+
+        uint64_t hash = fnv1a(out.data(), out.size());
+        if (threads == 1) reference = hash;
+        bool same = hash == reference;
+        identical = identical && same;
+        double rate = minutes / elapsed;
+        if (threads == 1) baseRate = rate;
+        std::cout << std::fixed << std::setprecision(1) << "  " << std::setw(7) << threads
+                  << "   " << std::setw(14) << rate << "   " << std::setw(6) << std::setprecision(2)
+                  << rate / baseRate << "x   " << (same ? "identical" : "DIFFERS") << "\n" << std::defaultfloat;
+    }
+    std::cout << "  Output " << (identical ? "bit-identical" : "NOT bit-identical")
+              << " to the single-threaded render" << std::endl;
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+/**
+ * Offline session renderer: a whole session written to a file at disk
+ * speed, for pre-rendered home sessions.
+ *
+ * The stimulus is a pure function of the frame index, so the timeline is
+ * cut into fixed chunks that worker threads take from a shared counter,
+ * render with renderOutputBlock() straight into an AsyncWriter buffer and
+ * queue at their own file offset. The file is byte-identical whatever the
+ * thread count.
+ */
+
+#pragma once
+
+#include "async_writer.h"
+
+#include <string>
+
+enum RenderFormat {
+    RENDER_WAV = 0,     // 32-bit float WAV (RIFF, up to 4 GB of samples)
+    RENDER_RAW = 1,     // Headerless interleaved little-endian float32
+    RENDER_RF64 = 2,    // 32-bit float RF64 (64-bit sizes in a ds64 chunk)
+    RENDER_W64 = 3,     // 32-bit float Wave64
+    RENDER_FLAC = 4,    // 16- or 24-bit FLAC (flac_export.h)
+};
+
+struct RenderConfig {
+    std::string path;
+    double seconds = 3600.0;
+    RenderFormat format = RENDER_WAV;
+    int threads = 0;            // 0 = one per core
+    int bits = 16;              // RENDER_FLAC: 16 or 24
+    AsyncWriterConfig io;
+};
+
+/**
+ * Format from a name ("wav", "rf64", "w64", "raw", "flac") or a file extension
+ */
+bool parseRenderFormat(const std::string& name, RenderFormat& format);
+
+/**
+ * Render the default pulse grid in the current output layout to
+ * `config.path` and report the speed
+ */
+int runOfflineRender(const RenderConfig& config);
+
+/**
+ * Render `seconds` into memory at 1, 2, 4 ... cores; report minutes of
+ * audio per second and check every run against the single-threaded one
+ */
+int runRenderBenchmark(double seconds);
@@ -0,0 +1,192 @@
+#include "onset_log.h"
+#include "engine.h"
+#include "clock_drift.h"
+#include "spsc_ring.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr char ONSET_LOG_MAGIC[8] = {'P', 'N', 'A', 'S', 'O', 'N', 'S', '1'};
+constexpr uint32_t ONSET_LOG_VERSION = 1;
+constexpr auto FLUSH_INTERVAL = std::chrono::milliseconds(250);
+
+SpscRing<OnsetRecord> g_ring(16384);   // ~6 minutes of 40Hz onsets
+std::atomic<uint64_t> g_dropped{0};
+
+std::ofstream g_file;
+std::thread g_thread;
+std::mutex g_mutex;
+std::condition_variable g_wake;
+bool g_stop = false;
+uint64_t g_written = 0;
+
+// Delta state, writer thread only
+int64_t g_prevFrame = 0;
+int64_t g_prevHostNs = 0;
+
+void putLE(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+uint64_t getLE(const uint8_t* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) value |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return value;
+}
+
+void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+bool getVarint(std::istream& in, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = in.get();
+        if (c == EOF) return false;
+        value |= static_cast<uint64_t>(c & 0x7F) << shift;
+        if (!(c & 0x80)) return true;
+    }
+    return false;
+}
+
+uint64_t zigzag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+int64_t unzigzag(uint64_t v) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+void onsetTap(int64_t frame, int64_t hostNs, int64_t /*pulse*/) {
+    if (!g_ring.push(OnsetRecord{frame, hostNs})) {
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void drainToFile() {
+    std::vector<uint8_t> out;
+    OnsetRecord record;
+    while (g_ring.pop(record)) {
+        // Fitted device clock once converged; callback time until then
+        driftFrameToHostNs(record.frame, record.hostNs);
+        putVarint(out, zigzag(record.frame - g_prevFrame));
+        putVarint(out, zigzag(record.hostNs - g_prevHostNs));
+        g_prevFrame = record.frame;
+        g_prevHostNs = record.hostNs;
+        ++g_written;
+    }
+    if (!out.empty()) {
+        g_file.write(reinterpret_cast<const char*>(out.data()), out.size());
+        g_file.flush();
+    }
+}
+
+void writerLoop() {
+    std::unique_lock<std::mutex> lock(g_mutex);
+    while (!g_stop) {
+        g_wake.wait_for(lock, FLUSH_INTERVAL);
+        drainToFile();
+    }
+    drainToFile();
+}
+
+} // namespace
+
+bool startOnsetLog(const std::string& path, int sampleRate) {
+    g_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!g_file) {
+        std::cerr << "Cannot open onset log " << path << std::endl;
+        return false;
+    }
+
+    // Anchor the steady clock to wall time so epochs can be matched to EEG files
+    int64_t hostAnchor = hostTimeNs();
+    int64_t wallAnchor = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::vector<uint8_t> header(ONSET_LOG_MAGIC, ONSET_LOG_MAGIC + sizeof(ONSET_LOG_MAGIC));
+    putLE(header, ONSET_LOG_VERSION, 4);
+    putLE(header, static_cast<uint32_t>(sampleRate), 4);
+    putLE(header, static_cast<uint64_t>(hostAnchor), 8);
+    putLE(header, static_cast<uint64_t>(wallAnchor), 8);
+    g_file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    g_file.flush();
+
+    addOnsetTap(onsetTap);
+    g_stop = false;
+    g_thread = std::thread(writerLoop);
+    std::cout << "Onset log: " << path << "\n";
+    return true;
+}
+
+void stopOnsetLog() {
+    if (!g_thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_stop = true;
+    }
+    g_wake.notify_one();
+    g_thread.join();
+    g_file.close();
+
+    std::cout << "Onset log: " << g_written << " onsets written";
+    if (g_dropped.load() > 0) {
+        std::cout << ", " << g_dropped.load() << " dropped (ring full)";
+    }
+    std::cout << "\n";
+}
+
+int exportOnsetCsv(const std::string& logPath, const std::string& csvPath) {
+    std::ifstream in(logPath, std::ios::binary);
+    uint8_t header[32];
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+        !std::equal(ONSET_LOG_MAGIC, ONSET_LOG_MAGIC + 8, header)) {
+        std::cerr << logPath << " is not an onset log" << std::endl;
+        return 1;
+    }
+    uint32_t sampleRate = static_cast<uint32_t>(getLE(header + 12, 4));
+    int64_t hostAnchor = static_cast<int64_t>(getLE(header + 16, 8));
+    int64_t wallAnchor = static_cast<int64_t>(getLE(header + 24, 8));
+
+    std::ofstream file;
+    if (csvPath != "-") {
+        file.open(csvPath, std::ios::trunc);
+        if (!file) {
+            std::cerr << "Cannot open " << csvPath << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = csvPath == "-" ? std::cout : file;
+
+    out << "index,frame,host_ns,wall_ns,frame_seconds\n";
+    int64_t frame = 0;
+    int64_t hostNs = 0;
+    uint64_t index = 0;
+    uint64_t frameDelta, hostDelta;
+    while (getVarint(in, frameDelta) && getVarint(in, hostDelta)) {
+        frame += unzigzag(frameDelta);
+        hostNs += unzigzag(hostDelta);
+        out << index++ << "," << frame << "," << hostNs << ","
+            << wallAnchor + (hostNs - hostAnchor) << ","
+            << std::fixed << std::setprecision(6) << static_cast<double>(frame) / sampleRate
+            << std::defaultfloat << "\n";
+    }
+
+    if (csvPath != "-") {
+        std::cout << "Exported " << index << " onsets to " << csvPath << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+/**
+ * Pulse-onset timestamp log for EEG epoching.
+ *
+ * The audio thread pushes one record per onset into a wait-free ring; a
+ * background thread appends them to a compact binary file:
+ *
+ *   header  "PNASONS1", u32 version, u32 sample rate,
+ *           i64 host anchor (steady ns), i64 wall anchor (unix ns)
+ *   record  varint zigzag(frame delta), varint zigzag(host ns delta)
+ *
+ * All header integers are little-endian. Deltas are taken against the
+ * previous record (the first against zero).
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+struct OnsetRecord {
+    int64_t frame;      // Engine frame of the onset
+    int64_t hostNs;     // Host steady-clock time of the onset (drift-fitted once converged)
+};
+
+/**
+ * Start logging every onset the engine renders to `path`
+ */
+bool startOnsetLog(const std::string& path, int sampleRate);
+
+/**
+ * Flush outstanding records and close the file
+ */
+void stopOnsetLog();
+
+/**
+ * Convert a binary onset log to CSV (`csvPath` "-" writes to stdout)
+ */
+int exportOnsetCsv(const std::string& logPath, const std::string& csvPath);
@@ -0,0 +1,317 @@
+#include "phase_lock.h"
+#include "eeg_stream.h"
+#include "engine.h"
+#include "fft.h"
+#include "spsc_ring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <deque>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Complex = std::complex<double>;
+
+constexpr int HISTORY_SAMPLES = 8192;           // Power of two
+constexpr double ECHT_WINDOW_SECONDS = 0.25;    // ~10 gamma cycles
+constexpr double FREQ_SMOOTHING = 0.05;         // EMA weight of each new frequency reading
+constexpr int SCHEDULE_MARGIN_FRAMES = 64;      // Keep clear of the block being rendered
+constexpr int MAX_PENDING = 256;
+
+struct Request {
+    int64_t frame;          // Scheduled onset frame
+    int64_t eegNs;          // Newest EEG sample the decision used
+    int64_t decidedNs;
+};
+
+PhaseLockConfig g_config;
+double g_targetPhase = 0.0;
+int g_fd = -1;
+std::thread g_thread;
+std::atomic<bool> g_running{false};
+SpscRing<int64_t> g_delivered(256);
+
+// Worker state
+int g_sampleRate = 0;
+int64_t g_sampleNs = 0;             // Sample period
+std::vector<double> g_history;
+int64_t g_sampleCount = 0;          // Samples received so far
+int64_t g_lastSampleNs = 0;         // Host time of sample g_sampleCount - 1
+int g_window = 0;                   // ecHT window (power of two)
+std::vector<Complex> g_echtResponse;
+std::vector<Complex> g_fftBuffer;
+double g_freqHz = 0.0;
+double g_lastPhase = 0.0;
+int64_t g_lastPhaseNs = 0;
+std::deque<Request> g_requests;
+std::deque<int64_t> g_awaitingPhase;     // Acoustic onset times still to read back
+
+// Report
+uint64_t g_scheduled = 0;
+std::vector<double> g_latencyMs;    // EEG sample -> acoustic onset
+std::vector<double> g_decisionMs;   // EEG sample -> onset scheduled
+std::vector<double> g_phaseErrors;  // Acausal read-back at the acoustic onset
+std::vector<double> g_truthErrors;  // Generator ground truth
+
+double wrapPhase(double phase) {
+    phase = std::fmod(phase + M_PI, 2.0 * M_PI);
+    return phase < 0.0 ? phase + M_PI : phase - M_PI;
+}
+
+/**
+ * Second-order band-pass, unity gain and zero phase at the centre
+ */
+Complex bandPass(double f) {
+    double f0 = g_config.centerHz;
+    double bw = g_config.bandwidthHz;
+    Complex jfb(0.0, f * bw);
+    return jfb / (Complex(f0 * f0 - f * f, 0.0) + jfb);
+}
+
+void configureRate(int sampleRate) {
+    g_sampleRate = sampleRate;
+    g_sampleNs = 1000000000LL / sampleRate;
+    g_history.assign(HISTORY_SAMPLES, 0.0);
+    g_sampleCount = 0;
+
+    g_window = 1;
+    while (g_window < sampleRate * ECHT_WINDOW_SECONDS) g_window <<= 1;
+    g_window = std::min(g_window, HISTORY_SAMPLES / 4);
+
+    // Analytic signal (DC and Nyquist once, positive bins twice, negative
+    // bins zero) times the causal band-pass: the ecHT endpoint correction
+    g_echtResponse.assign(g_window, Complex(0.0));
+    for (int k = 0; k <= g_window / 2; ++k) {
+        double weight = (k == 0 || k == g_window / 2) ? 1.0 : 2.0;
+        g_echtResponse[k] = weight * bandPass(static_cast<double>(k) * sampleRate / g_window);
+    }
+    g_freqHz = g_config.centerHz;
+    g_lastPhaseNs = 0;
+}
+
+double historyAt(int64_t index) {
+    return g_history[static_cast<size_t>(index) & (HISTORY_SAMPLES - 1)];
+}
+
+/**
+ * Load `n` samples ending at `last` (inclusive), mean removed
+ */
+void loadWindow(int64_t last, int n) {
+    g_fftBuffer.resize(n);
+    double mean = 0.0;
+    for (int i = 0; i < n; ++i) mean += historyAt(last - n + 1 + i);
+    mean /= n;
+    for (int i = 0; i < n; ++i) g_fftBuffer[i] = Complex(historyAt(last - n + 1 + i) - mean, 0.0);
+}
+
+/**
+ * ecHT phase at the newest sample. The causal band-pass shifts the phase
+ * of a rhythm off its centre; that shift is taken back out at the tracked
+ * frequency.
+ */
+double endpointPhase() {
+    loadWindow(g_sampleCount - 1, g_window);
+    fft(g_fftBuffer, false);
+    for (int k = 0; k < g_window; ++k) g_fftBuffer[k] *= g_echtResponse[k];
+    fft(g_fftBuffer, true);
+    return wrapPhase(std::arg(g_fftBuffer[g_window - 1]) - std::arg(bandPass(g_freqHz)));
+}
+
+/**
+ * Acausal read-back: phase at host time `hostNs` from a window centred on
+ * it, band-limited with a brick-wall analytic filter. Needs EEG from both
+ * sides of the instant, so it runs once enough later samples are in.
+ */
+bool acausalPhaseAt(int64_t hostNs, double& phase) {
+    int n = g_window * 2;
+    int64_t centre = g_sampleCount - 1 - (g_lastSampleNs - hostNs) / g_sampleNs;
+    if (centre + n / 2 - 1 > g_sampleCount - 1 || centre - n / 2 < g_sampleCount - HISTORY_SAMPLES) return false;
+
+    loadWindow(centre + n / 2 - 1, n);
+    fft(g_fftBuffer, false);
+    double lo = g_config.centerHz - g_config.bandwidthHz / 2;
+    double hi = g_config.centerHz + g_config.bandwidthHz / 2;
+    for (int k = 0; k < n; ++k) {
+        double f = static_cast<double>(k) * g_sampleRate / n;
+        g_fftBuffer[k] *= (k <= n / 2 && f >= lo && f <= hi) ? 2.0 : 0.0;
+    }
+    fft(g_fftBuffer, true);
+
+    int64_t centreNs = g_lastSampleNs - (g_sampleCount - 1 - centre) * g_sampleNs;
+    phase = std::arg(g_fftBuffer[n / 2]) + 2.0 * M_PI * g_freqHz * (hostNs - centreNs) / 1e9;
+    return true;
+}
+
+void onsetTap(int64_t frame, int64_t /*hostNs*/, int64_t /*pulse*/) {
+    g_delivered.push(frame);  // Only used for the report; a full ring loses statistics, not pulses
+}
+
+/**
+ * Predict the next target-phase crossing and ask the engine for an onset
+ * heard exactly then
+ */
+void scheduleNext(double phase) {
+    double cycleNs = 1e9 / g_freqHz;
+    double aheadNs = (wrapPhase(g_targetPhase - phase - M_PI) + M_PI) / (2.0 * M_PI) * cycleNs;
+
+    int64_t earliest = g_samplePosition.load() + SCHEDULE_MARGIN_FRAMES;
+    int64_t recent[ONSET_HISTORY];
+    int count = recentOnsets(recent, ONSET_HISTORY);
+    int64_t lastOnset = std::max(count > 0 ? recent[count - 1] : 0, pulseGrid().base);
+    earliest = std::max(earliest, lastOnset + MIN_ONSET_SPACING_FRAMES);
+
+    double frame = -1.0;
+    for (int cycle = 0; cycle < 8; ++cycle, aheadNs += cycleNs) {
+        if (!audibleFrameAt(g_lastSampleNs + static_cast<int64_t>(aheadNs), frame)) return;
+        if (frame >= earliest) break;
+    }
+    if (frame < earliest) return;
+
+    int64_t target = std::llround(frame);
+    scheduleOnset(target);
+    if (g_requests.empty() || g_requests.back().frame != target) {
+        g_requests.push_back(Request{target, g_lastSampleNs, hostTimeNs()});
+        if (g_requests.size() > MAX_PENDING) g_requests.pop_front();
+        ++g_scheduled;
+    }
+}
+
+void processPacket(const EegPacketHeader& header, const float* samples) {
+    if (static_cast<int>(header.sampleRate) != g_sampleRate) configureRate(header.sampleRate);
+
+    for (uint32_t i = 0; i < header.count; ++i) {
+        g_history[static_cast<size_t>(g_sampleCount++) & (HISTORY_SAMPLES - 1)] = samples[i];
+    }
+    g_lastSampleNs = header.firstNs + static_cast<int64_t>(header.count - 1) * g_sampleNs;
+    if (g_sampleCount < g_window) return;
+
+    double phase = endpointPhase();
+    if (g_lastPhaseNs != 0) {
+        double dt = (g_lastSampleNs - g_lastPhaseNs) / 1e9;
+        double advance = wrapPhase(phase - g_lastPhase - 2.0 * M_PI * g_freqHz * dt) + 2.0 * M_PI * g_freqHz * dt;
+        double measured = advance / (2.0 * M_PI * dt);
+        double half = g_config.bandwidthHz / 2;
+        g_freqHz += FREQ_SMOOTHING * (std::clamp(measured, g_config.centerHz - half, g_config.centerHz + half) - g_freqHz);
+    }
+    g_lastPhase = phase;
+    g_lastPhaseNs = g_lastSampleNs;
+
+    scheduleNext(phase);
+}
+
+/**
+ * Match delivered onsets to their requests, and read back the phase of
+ * those old enough to have EEG on both sides
+ */
+void collectResults() {
+    int64_t frame;
+    while (g_delivered.pop(frame)) {
+        auto it = std::find_if(g_requests.begin(), g_requests.end(),
+                               [frame](const Request& r) { return r.frame == frame; });
+        if (it == g_requests.end()) continue;  // Grid continuation, not a locked onset
+
+        int64_t audibleNs;
+        if (audibleHostNs(frame, audibleNs)) {
+            g_latencyMs.push_back((audibleNs - it->eegNs) / 1e6);
+            g_decisionMs.push_back((it->decidedNs - it->eegNs) / 1e6);
+            g_awaitingPhase.push_back(audibleNs);
+
+            double truth;
+            if (eegSynthPhaseAt(audibleNs, truth)) {
+                g_truthErrors.push_back(wrapPhase(truth - g_targetPhase));
+            }
+        }
+        g_requests.erase(g_requests.begin(), it + 1);
+    }
+
+    while (!g_awaitingPhase.empty()) {
+        double phase;
+        if (!acausalPhaseAt(g_awaitingPhase.front(), phase)) {
+            if (g_lastSampleNs - g_awaitingPhase.front() > 1000000000LL) {
+                g_awaitingPhase.pop_front();  // Fell out of the history
+                continue;
+            }
+            break;
+        }
+        g_phaseErrors.push_back(wrapPhase(phase - g_targetPhase));
+        g_awaitingPhase.pop_front();
+    }
+}
+
+void workerLoop() {
+    EegPacketHeader header;
+    float samples[EEG_MAX_PACKET_SAMPLES];
+    while (g_running.load()) {
+        if (receiveEegPacket(g_fd, header, samples, 50)) {
+            processPacket(header, samples);
+        }
+        collectResults();
+    }
+}
+
+void reportPhase(const char* label, const std::vector<double>& errors) {
+    if (errors.empty()) return;
+    Complex sum(0.0);
+    for (double e : errors) sum += std::polar(1.0, e);
+    sum /= static_cast<double>(errors.size());
+    std::cout << "  " << label << ": mean error " << std::showpos << std::setprecision(1)
+              << std::arg(sum) * 180.0 / M_PI << std::noshowpos << " deg, PLV " << std::setprecision(3)
+              << std::abs(sum) << " (" << errors.size() << " onsets)\n";
+}
+
+double percentile(std::vector<double> values, double p) {
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+}
+
+} // namespace
+
+bool startPhaseLock(const PhaseLockConfig& config) {
+    g_config = config;
+    g_targetPhase = wrapPhase(config.targetPhaseDeg * M_PI / 180.0);
+    g_fd = openEegReceiver(config.socketPath);
+    if (g_fd < 0) return false;
+    if (!addOnsetTap(onsetTap)) {
+        std::cerr << "No free engine tap for phase locking" << std::endl;
+        closeEegReceiver(g_fd, config.socketPath);
+        g_fd = -1;
+        return false;
+    }
+
+    g_running.store(true);
+    g_thread = std::thread(workerLoop);
+    std::cout << "Phase lock: EEG on " << config.socketPath << ", target " << config.targetPhaseDeg
+              << " deg, band " << config.centerHz - config.bandwidthHz / 2 << "-"
+              << config.centerHz + config.bandwidthHz / 2 << " Hz\n";
+    return true;
+}
+
+bool stopPhaseLock() {
+    if (!g_thread.joinable()) return true;
+    g_running.store(false);
+    g_thread.join();
+    closeEegReceiver(g_fd, g_config.socketPath);
+    g_fd = -1;
+
+    OnsetScheduleStats stats = onsetScheduleStats();
+    std::cout << "Phase lock: " << g_scheduled << " schedule updates, " << g_latencyMs.size() << " onsets delivered locked"
+              << " (grid moves " << stats.applied << ", late " << stats.late
+              << ", too close " << stats.tooClose << ")\n";
+    if (g_latencyMs.empty()) return false;
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "  EEG sample -> acoustic onset: median " << percentile(g_latencyMs, 0.5)
+              << " ms, p95 " << percentile(g_latencyMs, 0.95)
+              << " ms, max " << percentile(g_latencyMs, 1.0) << " ms"
+              << " (scheduled after " << percentile(g_decisionMs, 0.5) << " ms median)\n";
+    reportPhase("Phase at onset (acausal read-back)", g_phaseErrors);
+    reportPhase("Phase at onset (generator truth)", g_truthErrors);
+    std::cout << std::defaultfloat;
+    return true;
+}
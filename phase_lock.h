@@ -0,0 +1,40 @@
+/**
+ * Closed-loop phase-locked stimulation driven by a local EEG stream.
+ *
+ * A worker thread reads EEG packets (eeg_stream.h), band-passes the newest
+ * window around the gamma band and estimates the phase at its last sample
+ * with an endpoint-corrected Hilbert transform (ecHT): the window's
+ * spectrum is made analytic and multiplied by a causal band-pass response
+ * before the inverse FFT, which removes most of the Hilbert edge error at
+ * the endpoint. The phase and a tracked frequency predict when the rhythm
+ * next reaches the target phase; that instant is mapped through
+ * audibleFrameAt() and handed to scheduleOnset(), so the pulse is heard,
+ * not merely rendered, at the target phase.
+ *
+ * Every delivered onset is matched to the EEG sample that scheduled it
+ * (end-to-end latency) and, once enough later EEG has arrived, to the
+ * phase an acausal band-pass reads at its acoustic onset (phase accuracy).
+ */
+
+#pragma once
+
+#include <string>
+
+struct PhaseLockConfig {
+    std::string socketPath;     // UNIX datagram socket to receive EEG on
+    double targetPhaseDeg = 0.0;  // 0 = gamma peak
+    double centerHz = 40.0;
+    double bandwidthHz = 8.0;
+};
+
+/**
+ * Bind the EEG socket and start estimating and scheduling. Must be called
+ * before the audio device is started (registers an onset tap).
+ */
+bool startPhaseLock(const PhaseLockConfig& config);
+
+/**
+ * Stop and print the latency and phase report. Returns false if no onset
+ * was phase-locked.
+ */
+bool stopPhaseLock();
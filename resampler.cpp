@@ -0,0 +1,520 @@
+#include "resampler.h"
+#include "bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PNAS_RESAMPLER_X86 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define PNAS_RESAMPLER_NEON 1
+#endif
+
+namespace {
+
+enum Kernel {
+    KERNEL_SCALAR = 0,
+    KERNEL_SSE = 1,
+    KERNEL_AVX2 = 2,
+    KERNEL_NEON = 3,
+};
+
+constexpr double MIN_SNR_DB = 90.0;             // Benchmark pass marks: against the exact signal,
+constexpr double MAX_RIPPLE_DB = 0.001;         // peak-to-peak gain across the passband,
+constexpr double MIN_REJECTION_DB = 100.0;      // and images or aliases below a passband tone
+constexpr int RESPONSE_TONES = 16;              // Sine tones per band
+constexpr double RESPONSE_SECONDS = 0.25;
+constexpr int BENCH_CHANNELS = 2;
+constexpr int BENCH_PULL = 512;
+constexpr int REFERENCE_FRAMES = 4096;          // Outputs checked against the direct form
+constexpr int REFERENCE_TAPS_SCALE = 4;         // Reference window, in converter filter lengths
+constexpr double REFERENCE_KAISER_BETA = 14.0;
+
+// Test signal: per channel, tones inside every hop's passband
+struct Tone {
+    double hz;
+    double amplitude;
+};
+constexpr Tone BENCH_TONES[] = {{997.0, 0.3}, {6007.0, 0.2}, {15503.0, 0.1}};
+
+float dotScalar(const float* a, const float* b, int n) {
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+    for (int i = 0; i < n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+#ifdef PNAS_RESAMPLER_X86
+float dotSse(const float* a, const float* b, int n) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (int i = 0; i < n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    __m128 acc = _mm_add_ps(acc0, acc1);
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc);
+}
+
+__attribute__((target("avx2,fma"))) float dotAvx2(const float* a, const float* b, int n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    if (i < n) acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    return _mm_cvtss_f32(half);
+}
+#endif
+
+#ifdef PNAS_RESAMPLER_NEON
+float dotNeon(const float* a, const float* b, int n) {
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    for (int i = 0; i < n; i += 8) {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    return vaddvq_f32(vaddq_f32(acc0, acc1));
+}
+#endif
+
+/**
+ * Zeroth-order modified Bessel function of the first kind (Kaiser window)
+ */
+double besselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 64; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-17) break;
+    }
+    return sum;
+}
+
+/**
+ * Windowed-sinc low-pass at `x` input frames from the centre: cutoff
+ * `cutoff` cycles per input frame, Kaiser window of half-width `half`
+ */
+double windowedSinc(double x, double cutoff, double half, double beta) {
+    double r = x / half;
+    if (r <= -1.0 || r >= 1.0) return 0.0;
+    double arg = 2.0 * cutoff * x;
+    double sinc = std::abs(arg) < 1e-12 ? 1.0 : std::sin(M_PI * arg) / (M_PI * arg);
+    return 2.0 * cutoff * sinc * besselI0(beta * std::sqrt(1.0 - r * r)) / besselI0(beta);
+}
+
+int64_t floorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+/**
+ * Cutoff in cycles per input frame: midway between the passband edge and
+ * the lower of the two Nyquist frequencies
+ */
+double cutoffFor(int64_t up, int64_t down) {
+    double nyquist = 0.5 * std::min(1.0, static_cast<double>(up) / down);
+    return nyquist * (1.0 + RESAMPLER_ROLLOFF) / 2.0;
+}
+
+double toneSample(double t, int channel) {
+    double s = 0.0;
+    for (const Tone& tone : BENCH_TONES) {
+        s += tone.amplitude * std::sin(2.0 * M_PI * tone.hz * t + 0.7 * channel + tone.hz * 1e-4);
+    }
+    return s;
+}
+
+std::vector<float> toneSignal(int rate, int64_t frames) {
+    std::vector<float> signal(static_cast<size_t>(frames) * BENCH_CHANNELS);
+    for (int64_t i = 0; i < frames; ++i) {
+        for (int c = 0; c < BENCH_CHANNELS; ++c) {
+            signal[static_cast<size_t>(i) * BENCH_CHANNELS + c] = static_cast<float>(toneSample(static_cast<double>(i) / rate, c));
+        }
+    }
+    return signal;
+}
+
+/**
+ * Run `in` through `resampler` in BENCH_PULL pulls; returns the seconds taken
+ */
+double convert(Resampler& resampler, const std::vector<float>& in, std::vector<float>& out) {
+    int64_t inFrames = static_cast<int64_t>(in.size()) / BENCH_CHANNELS;
+    int64_t outFrames = inFrames * resampler.ratioUp() / resampler.ratioDown() - resampler.latency() * 2;
+    out.assign(static_cast<size_t>(std::max<int64_t>(outFrames, 0)) * BENCH_CHANNELS, 0.0f);
+    resampler.reset();
+
+    std::vector<float> silence(static_cast<size_t>(resampler.taps()) * BENCH_CHANNELS, 0.0f);
+    auto start = std::chrono::steady_clock::now();
+    for (int64_t done = 0; done < outFrames;) {
+        int frames = static_cast<int>(std::min<int64_t>(BENCH_PULL, outFrames - done));
+        for (int need = resampler.needed(frames); need > 0;) {
+            int64_t from = resampler.nextInput();
+            if (from < 0) {
+                int n = static_cast<int>(std::min<int64_t>(need, -from));
+                resampler.push(silence.data(), n);
+                need -= n;
+            } else {
+                resampler.push(in.data() + from * BENCH_CHANNELS, need);
+                need = 0;
+            }
+        }
+        resampler.pull(out.data() + done * BENCH_CHANNELS, frames);
+        done += frames;
+    }
+    return secondsSince(start);
+}
+
+/**
+ * SNR of `out` (at `outRate`) against the tone signal itself, past the
+ * start-up transient
+ */
+double snrExact(const std::vector<float>& out, int outRate, int skip) {
+    double signal = 0.0, noise = 0.0;
+    int64_t frames = static_cast<int64_t>(out.size()) / BENCH_CHANNELS;
+    for (int64_t i = skip; i < frames; ++i) {
+        for (int c = 0; c < BENCH_CHANNELS; ++c) {
+            double ideal = toneSample(static_cast<double>(i) / outRate, c);
+            double error = out[static_cast<size_t>(i) * BENCH_CHANNELS + c] - ideal;
+            signal += ideal * ideal;
+            noise += error * error;
+        }
+    }
+    return 10.0 * std::log10(signal / std::max(noise, 1e-300));
+}
+
+/**
+ * SNR of REFERENCE_FRAMES outputs from the middle of `out` against a
+ * double-precision direct-form conversion of `in` with a longer window
+ */
+double snrReference(const std::vector<float>& in, int inRate, const std::vector<float>& out, int outRate,
+                    const Resampler& resampler) {
+    double cutoff = cutoffFor(resampler.ratioUp(), resampler.ratioDown());
+    double half = resampler.taps() / 2.0 * REFERENCE_TAPS_SCALE;
+    int64_t inFrames = static_cast<int64_t>(in.size()) / BENCH_CHANNELS;
+    int64_t outFrames = static_cast<int64_t>(out.size()) / BENCH_CHANNELS;
+    int64_t first = std::max<int64_t>(0, outFrames / 2 - REFERENCE_FRAMES / 2);
+
+    double signal = 0.0, noise = 0.0;
+    for (int64_t t = first; t < std::min(outFrames, first + REFERENCE_FRAMES); ++t) {
+        double time = static_cast<double>(t) * inRate / outRate;
+        int64_t from = std::max<int64_t>(0, static_cast<int64_t>(std::ceil(time - half)));
+        int64_t to = std::min<int64_t>(inFrames - 1, static_cast<int64_t>(std::floor(time + half)));
+        double acc[BENCH_CHANNELS] = {};
+        for (int64_t j = from; j <= to; ++j) {
+            double h = windowedSinc(time - j, cutoff, half, REFERENCE_KAISER_BETA);
+            for (int c = 0; c < BENCH_CHANNELS; ++c) acc[c] += h * in[static_cast<size_t>(j) * BENCH_CHANNELS + c];
+        }
+        for (int c = 0; c < BENCH_CHANNELS; ++c) {
+            double error = out[static_cast<size_t>(t) * BENCH_CHANNELS + c] - acc[c];
+            signal += acc[c] * acc[c];
+            noise += error * error;
+        }
+    }
+    return 10.0 * std::log10(signal / std::max(noise, 1e-300));
+}
+
+/**
+ * Response of a `from` -> `to` converter to a sine at `hz`: the gain of
+ * that tone in the output (zero above the output Nyquist frequency) and
+ * everything else the converter added, relative to the input tone
+ */
+struct ToneResponse {
+    double gainDb;
+    double residualDb;
+};
+
+ToneResponse toneResponse(int from, int to, double hz) {
+    int64_t inFrames = static_cast<int64_t>(RESPONSE_SECONDS * from);
+    std::vector<float> in(static_cast<size_t>(inFrames) * BENCH_CHANNELS);
+    for (int64_t i = 0; i < inFrames; ++i) {
+        float x = static_cast<float>(std::sin(2.0 * M_PI * hz * i / from));
+        for (int c = 0; c < BENCH_CHANNELS; ++c) in[static_cast<size_t>(i) * BENCH_CHANNELS + c] = x;
+    }
+    Resampler r;
+    r.init(from, to, BENCH_CHANNELS, BENCH_PULL);
+    std::vector<float> out;
+    convert(r, in, out);
+
+    // Least-squares fit of the tone past the start-up transient; the rest is residual
+    int64_t frames = static_cast<int64_t>(out.size()) / BENCH_CHANNELS;
+    int64_t skip = std::min<int64_t>(frames / 2, r.taps() * 4);
+    double ss = 0.0, sc = 0.0, cc = 0.0, ys = 0.0, yc = 0.0;
+    bool audible = hz < to / 2.0;
+    for (int64_t i = skip; audible && i < frames; ++i) {
+        double w = 2.0 * M_PI * hz * i / to;
+        double sn = std::sin(w), cs = std::cos(w), y = out[static_cast<size_t>(i) * BENCH_CHANNELS];
+        ss += sn * sn;
+        sc += sn * cs;
+        cc += cs * cs;
+        ys += y * sn;
+        yc += y * cs;
+    }
+    double det = ss * cc - sc * sc;
+    double a = audible ? (ys * cc - yc * sc) / det : 0.0;
+    double b = audible ? (yc * ss - ys * sc) / det : 0.0;
+    double residual = 0.0;
+    for (int64_t i = skip; i < frames; ++i) {
+        double w = 2.0 * M_PI * hz * i / to;
+        double e = out[static_cast<size_t>(i) * BENCH_CHANNELS] - a * std::sin(w) - b * std::cos(w);
+        residual += e * e;
+    }
+    residual /= std::max<int64_t>(frames - skip, 1);
+    return ToneResponse{10.0 * std::log10(std::max(a * a + b * b, 1e-300)),
+                        10.0 * std::log10(std::max(residual / 0.5, 1e-300))};
+}
+
+/**
+ * Passband ripple (peak-to-peak) and stopband rejection of a hop. The
+ * passband runs to RESAMPLER_ROLLOFF of the lower Nyquist frequency; the
+ * stopband starts as far above that Nyquist frequency, where images of
+ * passband tones and aliases of input tones land.
+ */
+void bandResponse(int from, int to, double& rippleDb, double& rejectionDb) {
+    double nyquist = 0.5 * std::min(from, to);
+    double low = 1e9, high = -1e9, worst = -1e9;
+    for (int k = 1; k <= RESPONSE_TONES; ++k) {
+        ToneResponse r = toneResponse(from, to, nyquist * RESAMPLER_ROLLOFF * k / RESPONSE_TONES);
+        low = std::min(low, r.gainDb);
+        high = std::max(high, r.gainDb);
+        worst = std::max(worst, r.residualDb);
+    }
+    double stop = nyquist * (2.0 - RESAMPLER_ROLLOFF);
+    for (int k = 0; from > to && k < RESPONSE_TONES; ++k) {
+        double hz = stop + (0.5 * from - stop) * k / RESPONSE_TONES;
+        worst = std::max(worst, toneResponse(from, to, hz).residualDb);
+    }
+    rippleDb = high - low;
+    rejectionDb = -worst;
+}
+
+} // namespace
+
+bool Resampler::init(int inRate, int outRate, int channels, int maxPull, bool scalar) {
+    if (inRate <= 0 || outRate <= 0 || channels <= 0 || maxPull <= 0) return false;
+    int64_t g = std::gcd(static_cast<int64_t>(inRate), static_cast<int64_t>(outRate));
+    up_ = outRate / g;
+    down_ = inRate / g;
+    channels_ = channels;
+    maxPull_ = maxPull;
+
+    // Constant length in output frames: widen when converting down
+    double widen = std::max(1.0, static_cast<double>(down_) / up_);
+    taps_ = (static_cast<int>(std::ceil(RESAMPLER_TAPS * widen)) + 7) / 8 * 8;
+    exact_ = up_ <= RESAMPLER_MAX_PHASES;
+    int steps = exact_ ? static_cast<int>(up_) : RESAMPLER_MAX_PHASES;   // Rows per input frame
+    phases_ = exact_ ? steps : steps + 1;
+    center_ = up_ * taps_ / 2;
+
+    // Row r holds the prototype at r/steps of a frame past each tap,
+    // reversed to run oldest input first
+    double cutoff = cutoffFor(up_, down_);
+    double half = taps_ / 2.0;
+    bank_.assign(static_cast<size_t>(phases_) * taps_, 0.0f);
+    std::vector<double> row(taps_);
+    for (int r = 0; r < phases_; ++r) {
+        for (int i = 0; i < taps_; ++i) {
+            int k = taps_ - 1 - i;
+            double x = (static_cast<double>(k) * steps + r) / steps - half;
+            row[i] = windowedSinc(x, cutoff, half, RESAMPLER_KAISER_BETA);
+        }
+        double sum = std::accumulate(row.begin(), row.end(), 0.0);
+        for (int i = 0; i < taps_; ++i) bank_[static_cast<size_t>(r) * taps_ + i] = static_cast<float>(row[i] / sum);
+    }
+
+    capacity_ = taps_ + static_cast<int>(std::ceil(static_cast<double>(maxPull_) * down_ / up_)) + 2;
+    lines_.assign(static_cast<size_t>(capacity_) * channels_, 0.0f);
+
+    dot_ = dotScalar;
+    kernel_ = KERNEL_SCALAR;
+    if (!scalar) {
+#ifdef PNAS_RESAMPLER_X86
+        dot_ = dotSse;
+        kernel_ = KERNEL_SSE;
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            dot_ = dotAvx2;
+            kernel_ = KERNEL_AVX2;
+        }
+#elif defined(PNAS_RESAMPLER_NEON)
+        dot_ = dotNeon;
+        kernel_ = KERNEL_NEON;
+#endif
+    }
+    reset();
+    return true;
+}
+
+void Resampler::reset(int64_t frame) {
+    next_ = std::max<int64_t>(frame, 0);
+    lineStart_ = newestInput(next_) - taps_ + 1;
+    lineLen_ = 0;
+}
+
+int Resampler::needed(int frames) const {
+    if (frames <= 0) return 0;
+    int64_t newest = newestInput(next_ + frames - 1);
+    return static_cast<int>(std::max<int64_t>(0, newest - (nextInput() - 1)));
+}
+
+void Resampler::compact() {
+    int64_t keepFrom = newestInput(next_) - taps_ + 1;
+    int drop = static_cast<int>(std::clamp<int64_t>(keepFrom - lineStart_, 0, lineLen_));
+    if (drop == 0) return;
+    for (int c = 0; c < channels_; ++c) {
+        float* line = lines_.data() + static_cast<size_t>(c) * capacity_;
+        std::memmove(line, line + drop, static_cast<size_t>(lineLen_ - drop) * sizeof(float));
+    }
+    lineStart_ += drop;
+    lineLen_ -= drop;
+}
+
+void Resampler::push(const float* in, int frames) {
+    compact();
+    frames = std::min(frames, capacity_ - lineLen_);
+    for (int c = 0; c < channels_; ++c) {
+        float* line = lines_.data() + static_cast<size_t>(c) * capacity_ + lineLen_;
+        for (int i = 0; i < frames; ++i) line[i] = in[static_cast<size_t>(i) * channels_ + c];
+    }
+    lineLen_ += frames;
+}
+
+int Resampler::available() const {
+    int64_t last = nextInput() - 1;
+    int64_t lastOutput = floorDiv(last * up_ + up_ - 1 - center_, down_);
+    return static_cast<int>(std::clamp<int64_t>(lastOutput - next_ + 1, 0, maxPull_));
+}
+
+int Resampler::pull(float* out, int frames) {
+    frames = std::min(frames, available());
+    for (int i = 0; i < frames; ++i, ++next_) {
+        int64_t u = next_ * down_ + center_;
+        int64_t base = u / up_ - taps_ + 1 - lineStart_;
+        int64_t phase = u % up_;
+        const float* line = lines_.data() + base;
+        float* frame = out + static_cast<size_t>(i) * channels_;
+        if (exact_) {
+            const float* row = bank_.data() + static_cast<size_t>(phase) * taps_;
+            for (int c = 0; c < channels_; ++c) frame[c] = dot_(row, line + static_cast<size_t>(c) * capacity_, taps_);
+        } else {
+            double position = static_cast<double>(phase) * RESAMPLER_MAX_PHASES / up_;
+            int r = static_cast<int>(position);
+            float frac = static_cast<float>(position - r);
+            const float* row = bank_.data() + static_cast<size_t>(r) * taps_;
+            for (int c = 0; c < channels_; ++c) {
+                const float* x = line + static_cast<size_t>(c) * capacity_;
+                float a = dot_(row, x, taps_);
+                float b = dot_(row + taps_, x, taps_);
+                frame[c] = a + frac * (b - a);
+            }
+        }
+    }
+    return frames;
+}
+
+const char* Resampler::kernelName() const {
+    switch (kernel_) {
+        case KERNEL_SSE: return "SSE";
+        case KERNEL_AVX2: return "AVX2+FMA";
+        case KERNEL_NEON: return "NEON";
+        default: return "scalar";
+    }
+}
+
+int runResamplerBenchmark(double seconds) {
+    struct Hop {
+        int from;
+        int to;
+    };
+    const Hop hops[] = {{44100, 48000}, {48000, 96000}, {44100, 96000}, {96000, 44100}, {44100, 44101}};
+
+    Resampler probe;
+    probe.init(44100, 48000, BENCH_CHANNELS);
+    std::cout << "Sample-rate conversion: " << seconds << " s of " << BENCH_CHANNELS << "-channel tones ("
+              << BENCH_TONES[0].hz << ", " << BENCH_TONES[1].hz << ", " << BENCH_TONES[2].hz << " Hz) per hop, "
+              << BENCH_PULL << "-frame pulls, " << probe.kernelName() << " kernel\n"
+              << "  hop                       L/M            taps  rows    latency  " << probe.kernelName()
+              << " x RT  scalar x RT  SNR exact  SNR reference     ripple  rejection\n";
+
+    bool ok = true;
+    std::vector<float> chain;                   // 44.1 kHz -> 48 kHz output, for the chained hop
+    double chainSeconds = 0.0;
+    auto report = [&](const std::string& name, const Resampler& r, int outRate, double simdSeconds, double scalarSeconds,
+                      double outputSeconds, double exact, double reference, double ripple, double rejection) {
+        std::ostringstream ratio;
+        ratio << r.ratioUp() << "/" << r.ratioDown();
+        std::cout << "  " << std::left << std::setw(24) << name << "  " << std::setw(13) << ratio.str() << std::right
+                  << std::setw(6) << r.taps() << std::setw(6) << r.phases() << std::fixed << std::setprecision(2)
+                  << std::setw(8) << 1000.0 * r.latency() * r.ratioUp() / r.ratioDown() / outRate << " ms"
+                  << std::setprecision(0) << std::setw(15) << outputSeconds / simdSeconds;
+        if (scalarSeconds > 0.0) std::cout << std::setw(13) << outputSeconds / scalarSeconds;
+        else std::cout << std::setw(13) << "-";
+        std::cout << std::setprecision(1) << std::setw(8) << exact << " dB";
+        if (reference > 0.0) {
+            std::cout << std::setw(12) << reference << " dB" << std::setprecision(4) << std::setw(10) << ripple << " dB"
+                      << std::setprecision(1) << std::setw(8) << rejection << " dB";
+        }
+        bool hopOk = exact >= MIN_SNR_DB && (reference <= 0.0 || (ripple <= MAX_RIPPLE_DB && rejection >= MIN_REJECTION_DB));
+        std::cout << (hopOk ? "" : "  LOW") << "\n" << std::defaultfloat;
+        ok = ok && hopOk;
+    };
+
+    for (const Hop& hop : hops) {
+        std::vector<float> in = toneSignal(hop.from, static_cast<int64_t>(seconds * hop.from));
+        Resampler simd, scalar;
+        simd.init(hop.from, hop.to, BENCH_CHANNELS, BENCH_PULL);
+        scalar.init(hop.from, hop.to, BENCH_CHANNELS, BENCH_PULL, true);
+        std::vector<float> out, scalarOut;
+        double simdSeconds = convert(simd, in, out);
+        double scalarSeconds = convert(scalar, in, scalarOut);
+        double outputSeconds = static_cast<double>(out.size()) / BENCH_CHANNELS / hop.to;
+
+        int skip = simd.taps() * 4 * static_cast<int>(std::max<int64_t>(1, simd.ratioUp() / simd.ratioDown()));
+        double exact = snrExact(out, hop.to, skip);
+        double reference = snrReference(in, hop.from, out, hop.to, simd);
+        double ripple, rejection;
+        bandResponse(hop.from, hop.to, ripple, rejection);
+        report(std::to_string(hop.from) + " -> " + std::to_string(hop.to), simd, hop.to, simdSeconds, scalarSeconds,
+               outputSeconds, exact, reference, ripple, rejection);
+
+        if (hop.from == 44100 && hop.to == 48000) {
+            chain = std::move(out);
+            chainSeconds = simdSeconds;
+        }
+    }
+
+    // 44.1 -> 48 -> 96 kHz, as two streaming stages
+    Resampler second;
+    second.init(48000, 96000, BENCH_CHANNELS, BENCH_PULL);
+    std::vector<float> out;
+    double stageSeconds = convert(second, chain, out);
+    double outputSeconds = static_cast<double>(out.size()) / BENCH_CHANNELS / 96000;
+    report("44100 -> 48000 -> 96000", second, 96000, chainSeconds + stageSeconds, 0.0, outputSeconds,
+           snrExact(out, 96000, second.taps() * 16), 0.0, 0.0, 0.0);
+
+    std::cout << "  " << verdict(ok) << ": SNR against the exact signal at least " << static_cast<int>(MIN_SNR_DB)
+              << " dB, passband ripple at most " << MAX_RIPPLE_DB << " dB and stopband rejection at least "
+              << static_cast<int>(MIN_REJECTION_DB) << " dB " << (ok ? "on every hop" : "NOT on every hop") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+/**
+ * Polyphase windowed-sinc sample-rate converter for file-based sources
+ * whose rate differs from the engine's.
+ *
+ * A conversion from rate A to rate B runs at the reduced ratio L/M = B/A:
+ * the Kaiser-windowed sinc prototype is sampled once at L phases per input
+ * sample into a bank of rows, each stored reversed so an output sample is
+ * one contiguous dot product (SSE, AVX2+FMA chosen at run time, or NEON)
+ * per channel with the input history. Ratios whose L exceeds
+ * RESAMPLER_MAX_PHASES keep that many rows and interpolate linearly
+ * between the two nearest, so any rational ratio works with a bounded
+ * bank.
+ *
+ * The filter has a constant length in output samples: when converting
+ * down it is widened by M/L, with the cutoff on the lower Nyquist
+ * frequency. Passband to RESAMPLER_ROLLOFF of that Nyquist, about 100 dB
+ * stopband.
+ *
+ * Streaming is pull-based with bounded latency: push() input frames until
+ * needed() is zero, then pull() exactly the output frames wanted. Output
+ * frame t is the input signal at time t * A / B; the group delay of half
+ * the filter is absorbed by reading that far ahead (latency()). After
+ * init() neither call allocates, so the audio thread may convert.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+constexpr int RESAMPLER_TAPS = 128;             // Per row at a 1:1 ratio
+constexpr int RESAMPLER_MAX_PHASES = 1024;
+constexpr double RESAMPLER_ROLLOFF = 0.9;
+constexpr double RESAMPLER_KAISER_BETA = 10.0;
+
+class Resampler {
+public:
+    /**
+     * Convert `channels` interleaved channels from `inRate` to `outRate`.
+     * `maxPull` bounds the frames of one pull() (larger requests are
+     * served in pieces by the caller). With `scalar` the SIMD kernels
+     * are not used (benchmark baseline).
+     */
+    bool init(int inRate, int outRate, int channels, int maxPull = 4096, bool scalar = false);
+
+    /**
+     * Restart the stream so the next pull() returns output frame `frame`.
+     * Input is then pushed from nextInput() on (negative frames are
+     * silence before the start).
+     */
+    void reset(int64_t frame = 0);
+
+    /**
+     * Input frames to push before `frames` (<= maxPull) outputs can be
+     * pulled
+     */
+    int needed(int frames) const;
+
+    /**
+     * Absolute index of the next input frame push() expects
+     */
+    int64_t nextInput() const { return lineStart_ + lineLen_; }
+
+    /**
+     * Append interleaved input frames (at most needed(maxPull) at a time)
+     */
+    void push(const float* in, int frames);
+
+    /**
+     * Outputs the pushed input completes
+     */
+    int available() const;
+
+    /**
+     * Write min(frames, available()) interleaved output frames; returns
+     * the number written
+     */
+    int pull(float* out, int frames);
+
+    int64_t position() const { return next_; }
+    int latency() const { return taps_ / 2; }   // Input frames read ahead
+    int taps() const { return taps_; }
+    int phases() const { return phases_; }
+    int64_t ratioUp() const { return up_; }
+    int64_t ratioDown() const { return down_; }
+    const char* kernelName() const;
+
+private:
+    using DotFn = float (*)(const float*, const float*, int);
+
+    int64_t newestInput(int64_t frame) const { return (frame * down_ + center_) / up_; }
+    void compact();
+
+    int channels_ = 1;
+    int64_t up_ = 1;                // L
+    int64_t down_ = 1;              // M
+    int taps_ = RESAMPLER_TAPS;
+    int phases_ = 1;                // Rows in the bank (exact: L; else MAX_PHASES + 1)
+    bool exact_ = true;
+    int64_t center_ = 0;            // Filter centre in units of 1/L input frame
+    int maxPull_ = 4096;
+    DotFn dot_ = nullptr;
+    int kernel_ = 0;
+
+    std::vector<float> bank_;       // phases_ rows of taps_ coefficients
+    std::vector<float> lines_;      // Per channel: capacity_ input frames
+    int capacity_ = 0;
+    int64_t lineStart_ = 0;         // Absolute input frame of lines_[0]
+    int lineLen_ = 0;
+    int64_t next_ = 0;              // Absolute index of the next output frame
+};
+
+/**
+ * Conversion at 44.1 -> 48 -> 96 kHz (and the direct and downward hops):
+ * SIMD and scalar throughput, SNR against the exact signal and a
+ * double-precision reference, passband ripple and stopband rejection
+ */
+int runResamplerBenchmark(double seconds);
@@ -0,0 +1,833 @@
+#include "rtp.h"
+#include "engine.h"
+#include "spsc_ring.h"
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int RTP_HEADER_BYTES = 12;
+constexpr int RTP_EXTENSION_BYTES = 16;     // 0xBEDE profile word + 8-byte and 1-byte elements + padding
+constexpr int RTP_EXT_ORIGIN = 1;           // Header extension element: render time, 8 bytes
+constexpr int RTP_EXT_CHANNELS = 2;         // Header extension element: channel count, 1 byte
+constexpr int RTP_MAX_PACKET = 1472;        // Fits an Ethernet MTU without fragmentation over IPv4
+constexpr int RTP_MAX_PACKET_V6 = 1452;     // ...and over IPv6 (20 more header bytes)
+constexpr int RTP_BATCH = 64;               // Packets per sendmmsg/recvmmsg call
+constexpr uint8_t RTP_PT_L16 = 96;
+constexpr uint8_t RTP_PT_L24 = 97;
+constexpr uint32_t RTP_SSRC = 0x504E4153;   // "PNAS"
+
+void put32(uint8_t* p, uint32_t v) {
+    p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+uint32_t get32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+int bytesPerSample(RtpEncoding encoding) {
+    return encoding == RTP_L24 ? 3 : 2;
+}
+
+/**
+ * Full-scale integer for a float sample, as sent on the wire
+ */
+int32_t quantize(float sample, RtpEncoding encoding) {
+    float s = std::clamp(sample, -1.0f, 1.0f);
+    return encoding == RTP_L24 ? static_cast<int32_t>(std::lrint(s * 8388607.0f))
+                               : static_cast<int32_t>(std::lrint(s * 32767.0f));
+}
+
+float dequantize(int32_t value, RtpEncoding encoding) {
+    return encoding == RTP_L24 ? value / 8388607.0f : value / 32767.0f;
+}
+
+void encodeSample(uint8_t* p, float sample, RtpEncoding encoding) {
+    int32_t v = quantize(sample, encoding);
+    if (encoding == RTP_L24) {
+        p[0] = v >> 16; p[1] = v >> 8; p[2] = v;
+    } else {
+        p[0] = v >> 8; p[1] = v;
+    }
+}
+
+float decodeSample(const uint8_t* p, RtpEncoding encoding) {
+    if (encoding == RTP_L24) {
+        int32_t v = (int32_t(int8_t(p[0])) << 16) | (p[1] << 8) | p[2];
+        return dequantize(v, encoding);
+    }
+    return dequantize(int16_t((p[0] << 8) | p[1]), encoding);
+}
+
+bool resolveDestination(const std::string& hostPort, sockaddr_storage& addr, socklen_t& len) {
+    size_t colon = hostPort.rfind(':');
+    if (colon == std::string::npos) {
+        std::cerr << "RTP destination must be HOST:PORT: " << hostPort << std::endl;
+        return false;
+    }
+    std::string host = hostPort.substr(0, colon);
+    std::string port = hostPort.substr(colon + 1);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* result = nullptr;
+    int err = getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
+    if (err != 0 || !result) {
+        std::cerr << "Cannot resolve " << hostPort << ": " << gai_strerror(err) << std::endl;
+        return false;
+    }
+    std::memcpy(&addr, result->ai_addr, result->ai_addrlen);
+    len = result->ai_addrlen;
+    freeaddrinfo(result);
+    return true;
+}
+
+struct BlockMark {
+    int64_t startFrame;
+    int frames;
+    int64_t hostNs;
+};
+
+struct RtpPacket {
+    uint8_t data[RTP_MAX_PACKET];
+    int size;
+};
+
+/**
+ * Packetizer + batched UDP sender fed from the audio thread
+ */
+class RtpSender {
+public:
+    bool start(const RtpConfig& config, int sampleRate, int channels) {
+        config_ = config;
+        sampleRate_ = sampleRate;
+        channels_ = channels;
+        bytesPerFrame_ = channels * bytesPerSample(config.encoding);
+
+        destinations_.clear();
+        for (const auto& dest : config.destinations) {
+            Destination d;
+            if (!resolveDestination(dest, d.addr, d.len)) return false;
+            if (!destinations_.empty() && d.addr.ss_family != destinations_[0].addr.ss_family) {
+                std::cerr << "RTP destinations must all be IPv4 or all IPv6" << std::endl;
+                return false;
+            }
+            destinations_.push_back(d);
+        }
+        if (destinations_.empty()) {
+            std::cerr << "No RTP destination given" << std::endl;
+            return false;
+        }
+
+        int maxPacket = destinations_[0].addr.ss_family == AF_INET6 ? RTP_MAX_PACKET_V6 : RTP_MAX_PACKET;
+        int maxFrames = (maxPacket - RTP_HEADER_BYTES - RTP_EXTENSION_BYTES) / bytesPerFrame_;
+        framesPerPacket_ = std::clamp(static_cast<int>(std::lround(sampleRate * config.ptimeMs / 1000.0)), 1, maxFrames);
+
+        socket_ = socket(destinations_[0].addr.ss_family, SOCK_DGRAM, 0);
+        if (socket_ < 0) {
+            std::cerr << "RTP socket failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        // ~1.5s of audio between the callback and the sender thread
+        samples_.reset(static_cast<size_t>(sampleRate) * channels * 3 / 2);
+        marks_.reset(1024);
+        packets_.assign(RTP_BATCH, RtpPacket{});
+        batchCount_ = 0;
+        pendingFrames_ = 0;
+        marker_ = true;
+        running_.store(true);
+        thread_ = std::thread(&RtpSender::run, this);
+        return true;
+    }
+
+    void stop() {
+        if (!thread_.joinable()) return;
+        running_.store(false);
+        thread_.join();
+        close(socket_);
+        socket_ = -1;
+    }
+
+    /**
+     * Audio thread: copy the block into the rings, nothing else
+     */
+    void tap(const float* block, int frames, int64_t startFrame, int64_t hostNs) {
+        size_t count = static_cast<size_t>(frames) * channels_;
+        if (marks_.size() == marks_.capacity() || !samples_.push(block, count)) {
+            overruns_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        marks_.push(BlockMark{startFrame, frames, hostNs});
+    }
+
+    int framesPerPacket() const { return framesPerPacket_; }
+    uint64_t packetsSent() const { return packetsSent_.load(); }
+    uint64_t packetsDropped() const { return packetsDropped_.load(); }
+    uint64_t overruns() const { return overruns_.load(); }
+
+private:
+    struct Destination {
+        sockaddr_storage addr;
+        socklen_t len;
+    };
+
+    void run() {
+        auto interval = std::chrono::microseconds(std::max<int64_t>(250, static_cast<int64_t>(config_.ptimeMs * 500)));
+        while (running_.load()) {
+            std::this_thread::sleep_for(interval);
+            drain();
+        }
+        drain();
+    }
+
+    void drain() {
+        BlockMark mark;
+        while (marks_.pop(mark)) {
+            scratch_.resize(static_cast<size_t>(mark.frames) * channels_);
+            samples_.pop(scratch_.data(), scratch_.size());
+            appendFrames(scratch_.data(), mark.frames, mark.startFrame, mark.hostNs);
+        }
+        flush();
+    }
+
+    void appendFrames(const float* samples, int frames, int64_t startFrame, int64_t hostNs) {
+        // Frame clock jumped (device reopen): close the packet, mark the next one
+        if (pendingFrames_ > 0 && startFrame != pendingStart_ + pendingFrames_) {
+            finishPacket();
+            marker_ = true;
+        }
+
+        int bps = bytesPerSample(config_.encoding);
+        for (int i = 0; i < frames; ++i) {
+            if (pendingFrames_ == 0) {
+                pendingStart_ = startFrame + i;
+                pendingOriginNs_ = hostNs;
+            }
+            uint8_t* p = packets_[batchCount_].data + RTP_HEADER_BYTES + RTP_EXTENSION_BYTES +
+                         pendingFrames_ * bytesPerFrame_;
+            for (int c = 0; c < channels_; ++c) {
+                encodeSample(p + c * bps, samples[static_cast<size_t>(i) * channels_ + c], config_.encoding);
+            }
+            ++pendingFrames_;
+
+            // Packet boundaries sit on multiples of the packet size in frame time
+            if ((pendingStart_ + pendingFrames_) % framesPerPacket_ == 0) {
+                finishPacket();
+            }
+        }
+    }
+
+    void finishPacket() {
+        if (pendingFrames_ == 0) return;
+
+        RtpPacket& packet = packets_[batchCount_];
+        uint8_t* p = packet.data;
+        p[0] = 0x90;  // V=2, X=1
+        p[1] = (marker_ ? 0x80 : 0) | (config_.encoding == RTP_L24 ? RTP_PT_L24 : RTP_PT_L16);
+        p[2] = sequence_ >> 8;
+        p[3] = sequence_ & 0xFF;
+        put32(p + 4, static_cast<uint32_t>(pendingStart_));
+        put32(p + 8, RTP_SSRC);
+
+        // One-byte header extension: 8 bytes of render time, then the
+        // channel count so a receiver can tell a layout it was not set up for
+        uint8_t* ext = p + RTP_HEADER_BYTES;
+        ext[0] = 0xBE; ext[1] = 0xDE; ext[2] = 0; ext[3] = 3;
+        ext[4] = (RTP_EXT_ORIGIN << 4) | 7;
+        uint64_t origin = static_cast<uint64_t>(pendingOriginNs_);
+        put32(ext + 5, static_cast<uint32_t>(origin >> 32));
+        put32(ext + 9, static_cast<uint32_t>(origin));
+        ext[13] = (RTP_EXT_CHANNELS << 4) | 0;
+        ext[14] = static_cast<uint8_t>(channels_);
+        ext[15] = 0;
+
+        packet.size = RTP_HEADER_BYTES + RTP_EXTENSION_BYTES + pendingFrames_ * bytesPerFrame_;
+        ++sequence_;
+        marker_ = false;
+        pendingFrames_ = 0;
+
+        // Simulated loss keeps the sequence gap so receivers see it
+        lossState_ = lossState_ * 6364136223846793005ULL + 1442695040888963407ULL;
+        if (config_.lossPercent > 0 && (lossState_ >> 11) * 0x1.0p-53 * 100.0 < config_.lossPercent) {
+            packetsDropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        if (++batchCount_ == RTP_BATCH) flush();
+    }
+
+    void flush() {
+        if (batchCount_ == 0) return;
+
+        size_t total = static_cast<size_t>(batchCount_) * destinations_.size();
+        iovecs_.resize(total);
+        messages_.resize(total);
+        size_t n = 0;
+        for (int i = 0; i < batchCount_; ++i) {
+            for (auto& dest : destinations_) {
+                iovecs_[n].iov_base = packets_[i].data;
+                iovecs_[n].iov_len = packets_[i].size;
+                msghdr& msg = messageHeader(n);
+                std::memset(&msg, 0, sizeof(msg));
+                msg.msg_name = &dest.addr;
+                msg.msg_namelen = dest.len;
+                msg.msg_iov = &iovecs_[n];
+                msg.msg_iovlen = 1;
+                ++n;
+            }
+        }
+
+#ifdef __linux__
+        size_t sent = 0;
+        while (sent < total) {
+            int r = sendmmsg(socket_, messages_.data() + sent, static_cast<unsigned>(total - sent), 0);
+            if (r <= 0) {
+                if (r < 0 && errno == EINTR) continue;
+                break;
+            }
+            sent += r;
+        }
+#else
+        for (size_t i = 0; i < total; ++i) {
+            sendmsg(socket_, &messageHeader(i), 0);
+        }
+#endif
+        packetsSent_.fetch_add(batchCount_, std::memory_order_relaxed);
+
+        // Keep the partially filled packet at the front of the pool
+        if (pendingFrames_ > 0) {
+            std::memcpy(packets_[0].data + RTP_HEADER_BYTES + RTP_EXTENSION_BYTES,
+                        packets_[batchCount_].data + RTP_HEADER_BYTES + RTP_EXTENSION_BYTES,
+                        pendingFrames_ * bytesPerFrame_);
+        }
+        batchCount_ = 0;
+    }
+
+#ifdef __linux__
+    msghdr& messageHeader(size_t i) { return messages_[i].msg_hdr; }
+    std::vector<mmsghdr> messages_;
+#else
+    msghdr& messageHeader(size_t i) { return messages_[i]; }
+    std::vector<msghdr> messages_;
+#endif
+
+    RtpConfig config_;
+    int sampleRate_ = 0;
+    int channels_ = 1;
+    int bytesPerFrame_ = 2;
+    int framesPerPacket_ = 1;
+    int socket_ = -1;
+    std::vector<Destination> destinations_;
+
+    SpscRing<float> samples_;
+    SpscRing<BlockMark> marks_;
+    std::vector<float> scratch_;
+
+    std::vector<RtpPacket> packets_;
+    std::vector<iovec> iovecs_;
+    int batchCount_ = 0;
+    int pendingFrames_ = 0;
+    int64_t pendingStart_ = 0;
+    int64_t pendingOriginNs_ = 0;
+    uint16_t sequence_ = 0;
+    bool marker_ = true;
+    uint64_t lossState_ = 0x9E3779B97F4A7C15ULL;
+
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> packetsSent_{0};
+    std::atomic<uint64_t> packetsDropped_{0};
+    std::atomic<uint64_t> overruns_{0};
+};
+
+/**
+ * UDP receive thread + lock-free jitter buffer drained by the playout clock
+ */
+class RtpReceiver {
+public:
+    struct Stats {
+        std::atomic<uint64_t> packets{0};
+        std::atomic<uint64_t> lost{0};          // Sequence gaps
+        std::atomic<uint64_t> late{0};          // Arrived after their playout time
+        std::atomic<uint64_t> concealed{0};     // Frames played as silence
+        std::atomic<uint64_t> skipped{0};       // Frames dropped to pull the buffer back to target
+        std::atomic<uint64_t> rejected{0};      // Packets for another channel count
+        std::atomic<int> senderChannels{0};     // As announced by the last rejected packet
+        std::atomic<int64_t> latencySumNs{0};   // Render -> playout
+        std::atomic<int64_t> latencyMaxNs{0};
+        std::atomic<uint64_t> latencyCount{0};
+    };
+
+    bool open(int port, bool loopbackOnly) {
+        socket_ = socket(AF_INET, SOCK_DGRAM, 0);
+        if (socket_ < 0) {
+            std::cerr << "RTP socket failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        int size = 4 << 20;
+        setsockopt(socket_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+        if (bind(socket_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            std::cerr << "RTP bind to port " << port << " failed: " << std::strerror(errno) << std::endl;
+            close(socket_);
+            return false;
+        }
+        socklen_t len = sizeof(addr);
+        getsockname(socket_, reinterpret_cast<sockaddr*>(&addr), &len);
+        port_ = ntohs(addr.sin_port);
+        return true;
+    }
+
+    void start(int sampleRate, int channels, double jitterMs) {
+        sampleRate_ = sampleRate;
+        channels_ = channels;
+        jitterFrames_ = static_cast<int64_t>(sampleRate * jitterMs / 1000.0);
+
+        size_t size = 1;
+        while (size < static_cast<size_t>(sampleRate) * 4) size <<= 1;
+        mask_ = size - 1;
+        samples_.assign(size * channels, 0.0f);
+        originNs_.assign(size, 0);
+        stamps_ = std::vector<std::atomic<uint32_t>>(size);
+        for (auto& s : stamps_) s.store(~0u, std::memory_order_relaxed);
+
+        running_.store(true);
+        thread_ = std::thread(&RtpReceiver::run, this);
+    }
+
+    void stop() {
+        if (!thread_.joinable()) return;
+        running_.store(false);
+        thread_.join();
+        close(socket_);
+    }
+
+    int port() const { return port_; }
+    int channels() const { return channels_; }
+    const Stats& stats() const { return stats_; }
+    int64_t playheadFrame() const { return playhead_.load(std::memory_order_relaxed); }
+    bool playing() const { return started_.load(std::memory_order_acquire); }
+
+    double bufferedMs() const {
+        if (!started_.load(std::memory_order_acquire)) return 0.0;
+        return (newest_.load(std::memory_order_relaxed) - playhead_.load(std::memory_order_relaxed)) * 1000.0 / sampleRate_;
+    }
+
+    /**
+     * Playout clock (audio callback). Returns the render-to-playout latency
+     * of the first received frame in the block, or -1.
+     */
+    int64_t playout(float* out, int frames, int64_t nowNs) {
+        std::fill(out, out + static_cast<size_t>(frames) * channels_, 0.0f);
+        if (!haveFirst_.load(std::memory_order_acquire)) return -1;
+
+        int64_t newest = newest_.load(std::memory_order_acquire);
+        if (!started_.load(std::memory_order_relaxed)) {
+            int64_t first = first_.load(std::memory_order_relaxed);
+            if (newest - first < jitterFrames_) return -1;
+            playhead_.store(first, std::memory_order_relaxed);
+            started_.store(true, std::memory_order_release);
+        }
+
+        int64_t playhead = playhead_.load(std::memory_order_relaxed);
+        if (newest - playhead > 2 * jitterFrames_ + frames) {
+            // Sender jumped ahead or clocks drifted: pull back to target depth
+            int64_t target = newest - jitterFrames_;
+            stats_.skipped.fetch_add(target - playhead, std::memory_order_relaxed);
+            playhead = target;
+        }
+
+        int64_t latency = -1;
+        uint64_t concealed = 0;
+        for (int i = 0; i < frames; ++i) {
+            int64_t f = playhead + i;
+            size_t idx = static_cast<size_t>(f) & mask_;
+            if (stamps_[idx].load(std::memory_order_acquire) != static_cast<uint32_t>(f)) {
+                ++concealed;
+                continue;
+            }
+            std::copy_n(&samples_[idx * channels_], channels_, out + static_cast<size_t>(i) * channels_);
+            if (latency < 0) {
+                latency = nowNs + static_cast<int64_t>(i * 1e9 / sampleRate_) - originNs_[idx];
+            }
+        }
+        playhead_.store(playhead + frames, std::memory_order_relaxed);
+
+        stats_.concealed.fetch_add(concealed, std::memory_order_relaxed);
+        if (latency >= 0) {
+            stats_.latencySumNs.fetch_add(latency, std::memory_order_relaxed);
+            stats_.latencyCount.fetch_add(1, std::memory_order_relaxed);
+            if (latency > stats_.latencyMaxNs.load(std::memory_order_relaxed)) {
+                stats_.latencyMaxNs.store(latency, std::memory_order_relaxed);
+            }
+        }
+        return latency;
+    }
+
+private:
+    void run() {
+        std::vector<std::array<uint8_t, RTP_MAX_PACKET>> buffers(RTP_BATCH);
+#ifdef __linux__
+        std::vector<iovec> iov(RTP_BATCH);
+        std::vector<mmsghdr> msgs(RTP_BATCH);
+#endif
+        pollfd pfd{socket_, POLLIN, 0};
+        while (running_.load()) {
+            if (poll(&pfd, 1, 100) <= 0) continue;
+#ifdef __linux__
+            for (int i = 0; i < RTP_BATCH; ++i) {
+                iov[i].iov_base = buffers[i].data();
+                iov[i].iov_len = RTP_MAX_PACKET;
+                std::memset(&msgs[i], 0, sizeof(mmsghdr));
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            int n = recvmmsg(socket_, msgs.data(), RTP_BATCH, MSG_DONTWAIT, nullptr);
+            for (int i = 0; i < n; ++i) {
+                handlePacket(buffers[i].data(), static_cast<int>(msgs[i].msg_len));
+            }
+#else
+            ssize_t len;
+            while ((len = recv(socket_, buffers[0].data(), RTP_MAX_PACKET, MSG_DONTWAIT)) > 0) {
+                handlePacket(buffers[0].data(), static_cast<int>(len));
+            }
+#endif
+        }
+    }
+
+    void handlePacket(const uint8_t* p, int len) {
+        if (len < RTP_HEADER_BYTES || (p[0] >> 6) != 2) return;
+        uint8_t pt = p[1] & 0x7F;
+        if (pt != RTP_PT_L16 && pt != RTP_PT_L24) return;
+        RtpEncoding encoding = pt == RTP_PT_L24 ? RTP_L24 : RTP_L16;
+        uint16_t seq = static_cast<uint16_t>((p[2] << 8) | p[3]);
+        uint32_t ts = get32(p + 4);
+
+        int offset = RTP_HEADER_BYTES + 4 * (p[0] & 0x0F);
+        int64_t originNs = 0;
+        int channels = 0;
+        if (p[0] & 0x10) {
+            if (offset + 4 > len) return;
+            int extWords = (p[offset + 2] << 8) | p[offset + 3];
+            int end = offset + 4 + 4 * extWords;
+            if (end > len) return;
+            if (p[offset] == 0xBE && p[offset + 1] == 0xDE) {
+                // One-byte elements: id in the high nibble, length - 1 in the low
+                for (int e = offset + 4; e < end && (p[e] >> 4) != 15;) {
+                    int id = p[e] >> 4;
+                    if (id == 0) {
+                        ++e;
+                        continue;
+                    }
+                    int size = (p[e] & 0x0F) + 1;
+                    if (e + 1 + size > end) break;
+                    if (id == RTP_EXT_ORIGIN && size == 8) {
+                        originNs = static_cast<int64_t>((uint64_t(get32(p + e + 1)) << 32) | get32(p + e + 5));
+                    } else if (id == RTP_EXT_CHANNELS && size == 1) {
+                        channels = p[e + 1];
+                    }
+                    e += 1 + size;
+                }
+            }
+            offset = end;
+        }
+        if (p[0] & 0x20) len -= p[len - 1];  // Padding
+        if (offset > len) return;
+
+        // A sender in another layout would be deinterleaved wrongly
+        int bps = bytesPerSample(encoding);
+        if ((channels != 0 && channels != channels_) || (len - offset) % (bps * channels_) != 0) {
+            stats_.rejected.fetch_add(1, std::memory_order_relaxed);
+            stats_.senderChannels.store(channels, std::memory_order_relaxed);
+            return;
+        }
+        int frames = (len - offset) / (bps * channels_);
+        stats_.packets.fetch_add(1, std::memory_order_relaxed);
+
+        // Sequence accounting
+        if (!haveSeq_) {
+            haveSeq_ = true;
+        } else {
+            int16_t gap = static_cast<int16_t>(seq - expectedSeq_);
+            if (gap > 0) stats_.lost.fetch_add(gap, std::memory_order_relaxed);
+            if (gap < 0) return;  // Duplicate or reordered behind the newest
+        }
+        expectedSeq_ = seq + 1;
+
+        // Unwrap the 32-bit timestamp into the 64-bit frame clock
+        int64_t frame = haveFirst_.load(std::memory_order_relaxed)
+            ? lastFrame_ + static_cast<int32_t>(ts - static_cast<uint32_t>(lastFrame_))
+            : ts;
+        lastFrame_ = frame;
+
+        if (started_.load(std::memory_order_acquire) && frame + frames <= playhead_.load(std::memory_order_relaxed)) {
+            stats_.late.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        const uint8_t* payload = p + offset;
+        for (int i = 0; i < frames; ++i) {
+            int64_t f = frame + i;
+            size_t idx = static_cast<size_t>(f) & mask_;
+            for (int c = 0; c < channels_; ++c) {
+                samples_[idx * channels_ + c] = decodeSample(payload + (i * channels_ + c) * bps, encoding);
+            }
+            originNs_[idx] = originNs;
+            stamps_[idx].store(static_cast<uint32_t>(f), std::memory_order_release);
+        }
+
+        if (!haveFirst_.load(std::memory_order_relaxed)) {
+            first_.store(frame, std::memory_order_relaxed);
+            newest_.store(frame + frames, std::memory_order_relaxed);
+            haveFirst_.store(true, std::memory_order_release);
+        } else if (frame + frames > newest_.load(std::memory_order_relaxed)) {
+            newest_.store(frame + frames, std::memory_order_release);
+        }
+    }
+
+    int socket_ = -1;
+    int port_ = 0;
+    int sampleRate_ = SAMPLE_RATE;
+    int channels_ = 1;
+    int64_t jitterFrames_ = 0;
+
+    std::vector<float> samples_;
+    std::vector<int64_t> originNs_;
+    std::vector<std::atomic<uint32_t>> stamps_;   // Frame index held by each slot
+    size_t mask_ = 0;
+
+    // Receive thread only
+    bool haveSeq_ = false;
+    uint16_t expectedSeq_ = 0;
+    int64_t lastFrame_ = 0;
+
+    std::atomic<bool> haveFirst_{false};
+    std::atomic<int64_t> first_{0};
+    std::atomic<int64_t> newest_{0};      // One past the newest received frame
+    std::atomic<int64_t> playhead_{0};    // Next frame to play
+    std::atomic<bool> started_{false};    // Set by the playout thread once the playhead is placed
+
+    Stats stats_;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+};
+
+RtpSender g_sender;
+std::atomic<bool> g_receiverStop{false};
+
+void senderTap(const float* block, int frames, int64_t startFrame, int64_t hostNs) {
+    g_sender.tap(block, frames, startFrame, hostNs);
+}
+
+void receiverCallback(void* userdata, Uint8* stream, int len) {
+    auto* receiver = static_cast<RtpReceiver*>(userdata);
+    receiver->playout(reinterpret_cast<float*>(stream), len / static_cast<int>(sizeof(float) * receiver->channels()),
+                      hostTimeNs());
+}
+
+void onInterrupt(int) {
+    g_receiverStop.store(true);
+}
+
+} // namespace
+
+bool parseRtpEncoding(const std::string& name, RtpEncoding& encoding) {
+    if (name == "L16" || name == "l16") {
+        encoding = RTP_L16;
+    } else if (name == "L24" || name == "l24") {
+        encoding = RTP_L24;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool startRtpOutput(const RtpConfig& config, int sampleRate, int channels) {
+    if (!g_sender.start(config, sampleRate, channels)) {
+        return false;
+    }
+    addBlockTap(senderTap);
+    std::cout << "RTP output: " << (config.encoding == RTP_L24 ? "L24" : "L16") << ", "
+              << g_sender.framesPerPacket() << " frames/packet, " << config.destinations.size()
+              << " destination(s)\n";
+    return true;
+}
+
+void stopRtpOutput() {
+    g_sender.stop();
+}
+
+int runRtpReceiver(int port, int channels, double jitterMs) {
+    if (SDL_Init(SDL_INIT_AUDIO) < 0) {
+        std::cerr << "SDL initialization failed: " << SDL_GetError() << std::endl;
+        return 1;
+    }
+
+    RtpReceiver receiver;
+    if (!receiver.open(port, false)) {
+        SDL_Quit();
+        return 1;
+    }
+    receiver.start(SAMPLE_RATE, channels, jitterMs);
+
+    // The device must take the stream's layout as it is
+    SDL_AudioSpec desiredSpec, obtainedSpec;
+    SDL_zero(desiredSpec);
+    desiredSpec.freq = SAMPLE_RATE;
+    desiredSpec.format = AUDIO_F32SYS;
+    desiredSpec.channels = static_cast<Uint8>(channels);
+    desiredSpec.samples = 256;           // Small buffer; the jitter buffer absorbs network variance
+    desiredSpec.callback = receiverCallback;
+    desiredSpec.userdata = &receiver;
+
+    SDL_AudioDeviceID device = SDL_OpenAudioDevice(nullptr, 0, &desiredSpec, &obtainedSpec, 0);
+    if (device == 0) {
+        std::cerr << "Failed to open audio device: " << SDL_GetError() << std::endl;
+        receiver.stop();
+        SDL_Quit();
+        return 1;
+    }
+
+    std::cout << "Receiving RTP on UDP port " << receiver.port() << ", " << channels << " ch, jitter buffer "
+              << jitterMs << " ms (Ctrl-C to stop)\n";
+    std::signal(SIGINT, onInterrupt);
+    SDL_PauseAudioDevice(device, 0);
+
+    const auto& stats = receiver.stats();
+    while (!g_receiverStop.load()) {
+        SDL_Delay(1000);
+        uint64_t count = stats.latencyCount.load();
+        std::cout << std::fixed << std::setprecision(1)
+                  << "packets " << stats.packets.load() << " | lost " << stats.lost.load()
+                  << " | late " << stats.late.load() << " | concealed " << stats.concealed.load()
+                  << " | buffer " << receiver.bufferedMs() << " ms"
+                  << " | latency avg " << (count ? stats.latencySumNs.load() / 1e6 / count : 0.0)
+                  << " max " << stats.latencyMaxNs.load() / 1e6 << " ms (+"
+                  << 1000.0 * obtainedSpec.samples / obtainedSpec.freq << " ms device)"
+                  << std::defaultfloat << std::endl;
+        if (stats.rejected.load() > 0) {
+            std::cout << "  " << stats.rejected.load() << " packets rejected: sender has "
+                      << stats.senderChannels.load() << " channels, receiver expects " << channels
+                      << " (--rtp-channels)" << std::endl;
+        }
+    }
+
+    SDL_CloseAudioDevice(device);
+    receiver.stop();
+    SDL_Quit();
+    return 0;
+}
+
+int runRtpBenchmark(const RtpConfig& baseConfig, double jitterMs) {
+    constexpr int BLOCK_FRAMES = 256;
+    constexpr double DURATION_SECONDS = 5.0;
+
+    buildRenderTables();
+
+    RtpReceiver receiver;
+    if (!receiver.open(0, true)) return 1;
+    receiver.start(SAMPLE_RATE, 1, jitterMs);
+
+    RtpConfig config = baseConfig;
+    config.destinations = {"127.0.0.1:" + std::to_string(receiver.port())};
+    RtpSender sender;
+    if (!sender.start(config, SAMPLE_RATE, 1)) {
+        receiver.stop();
+        return 1;
+    }
+
+    std::cout << "RTP loopback: " << (config.encoding == RTP_L24 ? "L24" : "L16") << ", ptime "
+              << config.ptimeMs << " ms, jitter buffer " << jitterMs << " ms, simulated loss "
+              << config.lossPercent << "%\n";
+
+    auto period = std::chrono::nanoseconds(static_cast<int64_t>(1e9 * BLOCK_FRAMES / SAMPLE_RATE));
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::duration<double>(DURATION_SECONDS);
+
+    // Stand-in for the sender's audio callback
+    std::thread producer([&] {
+        float block[BLOCK_FRAMES];
+        int64_t frame = 0;
+        auto next = start;
+        while (next < end) {
+            std::this_thread::sleep_until(next);
+            renderBlock(block, frame, BLOCK_FRAMES);
+            sender.tap(block, BLOCK_FRAMES, frame, hostTimeNs());
+            frame += BLOCK_FRAMES;
+            next += period;
+        }
+    });
+
+    // Stand-in for the receiver's audio callback, checking every sample
+    std::vector<int64_t> latencies;
+    uint64_t compared = 0;
+    uint64_t mismatches = 0;
+    float out[BLOCK_FRAMES];
+    float expected[BLOCK_FRAMES];
+    auto next = start;
+    while (next < end + std::chrono::milliseconds(static_cast<int64_t>(jitterMs) + 50)) {
+        std::this_thread::sleep_until(next);
+        int64_t playhead = receiver.playheadFrame();
+        bool wasPlaying = receiver.playing();
+        int64_t latency = receiver.playout(out, BLOCK_FRAMES, hostTimeNs());
+        if (latency >= 0) latencies.push_back(latency);
+        if (wasPlaying) {
+            renderBlock(expected, playhead, BLOCK_FRAMES);
+            for (int i = 0; i < BLOCK_FRAMES; ++i) {
+                float reference = dequantize(quantize(expected[i], config.encoding), config.encoding);
+                if (out[i] == 0.0f && reference != 0.0f) continue;  // Concealed
+                ++compared;
+                if (out[i] != reference) ++mismatches;
+            }
+        }
+        next += period;
+    }
+
+    producer.join();
+    sender.stop();
+    receiver.stop();
+
+    const auto& stats = receiver.stats();
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies.empty() ? 0.0 : latencies[static_cast<size_t>(p * (latencies.size() - 1))] / 1e6;
+    };
+    uint64_t sent = sender.packetsSent() + sender.packetsDropped();
+    std::cout << std::fixed << std::setprecision(2)
+              << "Packets: sent " << sent << ", dropped " << sender.packetsDropped()
+              << ", received " << stats.packets.load() << ", lost " << stats.lost.load()
+              << ", late " << stats.late.load() << "\n"
+              << "Concealed frames: " << stats.concealed.load() << " ("
+              << 100.0 * stats.concealed.load() / std::max<uint64_t>(1, compared + stats.concealed.load()) << "%)\n"
+              << "Render->playout latency: p50 " << percentile(0.5) << " ms, p99 " << percentile(0.99)
+              << " ms, max " << percentile(1.0) << " ms\n"
+              << "Sample check: " << compared << " frames compared, " << mismatches << " mismatches, "
+              << stats.rejected.load() << " packets rejected\n"
+              << std::defaultfloat;
+    return mismatches == 0 && stats.rejected.load() == 0 ? 0 : 1;
+}
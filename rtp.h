@@ -0,0 +1,51 @@
+/**
+ * RTP/UDP PCM streaming: sender sink for the engine and a jitter-buffered
+ * receiver that plays through SDL.
+ *
+ * RTP timestamps are engine frame indices, so every packet is
+ * frame-accurate. Each packet carries one-byte header extensions
+ * (RFC 8285): id 1 with the sender's block render time, which the
+ * receiver uses to measure latency when both ends share a clock, and
+ * id 2 with the channel count. Packets fit the path MTU of their address
+ * family (1472 bytes over IPv4, 1452 over IPv6).
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+enum RtpEncoding {
+    RTP_L16 = 0,    // 16-bit big-endian PCM
+    RTP_L24 = 1,    // 24-bit big-endian PCM
+};
+
+struct RtpConfig {
+    std::vector<std::string> destinations;  // host:port, one packet copy each
+    RtpEncoding encoding = RTP_L16;
+    double ptimeMs = 1.0;                   // Packet time
+    double lossPercent = 0.0;               // Simulated sender-side loss, for testing
+};
+
+bool parseRtpEncoding(const std::string& name, RtpEncoding& encoding);
+
+/**
+ * Stream every block the engine renders. Packetizing and sending happen
+ * on a background thread fed through a wait-free ring.
+ */
+bool startRtpOutput(const RtpConfig& config, int sampleRate, int channels);
+void stopRtpOutput();
+
+/**
+ * Receive a `channels`-channel stream on `port` and play it through the
+ * default SDL device after `jitterMs` of buffering. Packets announcing
+ * another channel count, or whose payload does not divide into frames of
+ * `channels`, are counted and dropped. Runs until interrupted.
+ */
+int runRtpReceiver(int port, int channels, double jitterMs);
+
+/**
+ * Sender -> loopback -> receiver in one process with a simulated playout
+ * clock. Reports end-to-end latency, loss and concealment.
+ */
+int runRtpBenchmark(const RtpConfig& config, double jitterMs);
@@ -0,0 +1,236 @@
+#include "session_record.h"
+#include "engine.h"
+#include "spsc_ring.h"
+#include "wav_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr double RING_SECONDS = 2.0;
+constexpr auto DRAIN_INTERVAL = std::chrono::milliseconds(20);
+constexpr auto FLUSH_INTERVAL = std::chrono::seconds(1);
+
+struct BlockMark {
+    int64_t startFrame;
+    int frames;
+};
+
+WavStreamWriter g_writer;
+std::string g_path;
+int g_channels = 1;
+int g_sampleRate = SAMPLE_RATE;
+SpscRing<float> g_samples;
+SpscRing<BlockMark> g_marks(1024);
+std::atomic<uint64_t> g_overruns{0};
+std::thread g_thread;
+std::atomic<bool> g_running{false};
+
+// Writer thread only
+int64_t g_firstFrame = -1;
+int64_t g_nextFrame = -1;
+int64_t g_gapFrames = 0;
+bool g_failed = false;
+std::vector<float> g_block;
+
+void recordTap(const float* block, int frames, int64_t startFrame, int64_t /*hostNs*/) {
+    size_t count = static_cast<size_t>(frames) * g_channels;
+    if (g_marks.size() == g_marks.capacity() || !g_samples.push(block, count)) {
+        g_overruns.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    g_marks.push(BlockMark{startFrame, frames});
+}
+
+bool append(const float* samples, int64_t frames) {
+    if (g_failed) return false;
+    if (!g_writer.write(samples, frames)) {
+        std::cerr << "Recording to " << g_path << " stopped at " << g_writer.frames() << " frames: "
+                  << (g_path.size() > 4 && g_path.compare(g_path.size() - 4, 4, ".wav") == 0
+                      ? "4 GB WAV limit, record to .rf64 or .w64" : "write failed") << std::endl;
+        g_failed = true;
+    }
+    return !g_failed;
+}
+
+void drain() {
+    BlockMark mark;
+    while (g_marks.pop(mark)) {
+        size_t count = static_cast<size_t>(mark.frames) * g_channels;
+        g_block.resize(count);
+        g_samples.pop(g_block.data(), count);
+
+        if (g_firstFrame < 0) g_firstFrame = mark.startFrame;
+        if (g_nextFrame >= 0 && mark.startFrame > g_nextFrame) {
+            // Silence for frames that never reached the device
+            int64_t gap = mark.startFrame - g_nextFrame;
+            g_gapFrames += gap;
+            std::vector<float> silence(static_cast<size_t>(std::min<int64_t>(gap, g_sampleRate)) * g_channels, 0.0f);
+            for (int64_t left = gap; left > 0;) {
+                int64_t n = std::min<int64_t>(left, g_sampleRate);
+                append(silence.data(), n);
+                left -= n;
+            }
+        }
+        g_nextFrame = mark.startFrame + mark.frames;
+        append(g_block.data(), mark.frames);
+    }
+}
+
+void writerLoop() {
+    auto lastFlush = std::chrono::steady_clock::now();
+    while (g_running.load()) {
+        std::this_thread::sleep_for(DRAIN_INTERVAL);
+        drain();
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastFlush >= FLUSH_INTERVAL && !g_failed) {
+            if (!g_writer.flush()) {
+                std::cerr << "Recording flush to " << g_path << " failed" << std::endl;
+                g_failed = true;
+            }
+            lastFlush = now;
+        }
+    }
+    drain();
+}
+
+// Check pattern: distinct per frame and channel, exact in float32
+float testSample(int64_t frame, int channel, int channels) {
+    return static_cast<float>((frame * channels + channel) % 65521) / 65536.0f;
+}
+
+void writeTestStream(const std::string& path, WavContainer container, int channels, int64_t maxFrames, bool paced) {
+    constexpr int BLOCK_FRAMES = 1024;
+    constexpr int FLUSH_EVERY = 48;         // Blocks between flushes
+    WavStreamWriter writer;
+    if (!writer.open(path, container, channels, SAMPLE_RATE)) return;
+    std::vector<float> block(static_cast<size_t>(BLOCK_FRAMES) * channels);
+    for (int64_t frame = 0, n = 0; frame < maxFrames; frame += BLOCK_FRAMES, ++n) {
+        int frames = static_cast<int>(std::min<int64_t>(BLOCK_FRAMES, maxFrames - frame));
+        for (int i = 0; i < frames; ++i) {
+            for (int c = 0; c < channels; ++c) block[static_cast<size_t>(i) * channels + c] = testSample(frame + i, c, channels);
+        }
+        writer.write(block.data(), frames);
+        if (n % FLUSH_EVERY == FLUSH_EVERY - 1) writer.flush();
+        if (paced) std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    writer.close();
+}
+
+/**
+ * Parse `path` and compare every sample the header claims with the
+ * pattern. Returns the frame count, or -1 on any mismatch.
+ */
+int64_t verifyTestStream(const std::string& path, int channels) {
+    WavInfo info;
+    if (!readWavInfo(path, info) || info.channels != channels || !info.isFloat || info.bitsPerSample != 32) return -1;
+    std::ifstream in(path, std::ios::binary);
+    in.seekg(info.dataOffset);
+    std::vector<float> block(static_cast<size_t>(SAMPLE_RATE) * channels);
+    for (int64_t frame = 0; frame < info.frames;) {
+        int64_t n = std::min<int64_t>(SAMPLE_RATE, info.frames - frame);
+        if (!in.read(reinterpret_cast<char*>(block.data()), n * channels * sizeof(float))) return -1;
+        for (int64_t i = 0; i < n; ++i) {
+            for (int c = 0; c < channels; ++c) {
+                if (block[static_cast<size_t>(i) * channels + c] != testSample(frame + i, c, channels)) return -1;
+            }
+        }
+        frame += n;
+    }
+    return info.frames;
+}
+
+} // namespace
+
+bool startSessionRecord(const std::string& path, int sampleRate, int channels, const AsyncWriterConfig& io) {
+    WavContainer container;
+    if (!parseWavContainer(path, container)) {
+        std::cerr << "Unknown recording format: " << path << " (use .wav, .rf64 or .w64)" << std::endl;
+        return false;
+    }
+    if (!g_writer.open(path, container, channels, sampleRate, io)) return false;
+    g_path = path;
+    g_channels = channels;
+    g_sampleRate = sampleRate;
+    g_samples.reset(static_cast<size_t>(RING_SECONDS * sampleRate * channels));
+    g_firstFrame = -1;
+    g_nextFrame = -1;
+    g_gapFrames = 0;
+    g_failed = false;
+
+    if (!addBlockTap(recordTap)) {
+        std::cerr << "No free engine tap for recording" << std::endl;
+        g_writer.close();
+        return false;
+    }
+    g_running.store(true);
+    g_thread = std::thread(writerLoop);
+    std::cout << "Recording to " << path << " (" << wavContainerName(container) << ", " << channels
+              << " ch float32, " << g_writer.backendName() << (io.direct ? ", O_DIRECT" : "")
+              << ", flushed every second)\n";
+    return true;
+}
+
+void stopSessionRecord() {
+    if (!g_thread.joinable()) return;
+    g_running.store(false);
+    g_thread.join();
+    int64_t frames = g_writer.frames();
+    bool ok = g_writer.close();
+
+    double seconds = static_cast<double>(frames) / g_sampleRate;
+    std::cout << "Recorded " << g_path << ": " << std::fixed << std::setprecision(1) << seconds / 60.0
+              << " min, " << frames * g_channels * sizeof(float) / (1 << 20) << " MB"
+              << std::defaultfloat << ", " << g_gapFrames << " gap frames filled with silence, "
+              << g_overruns.load() << " ring overruns" << (ok ? "" : " (close failed)") << "\n";
+}
+
+int runRecordCheck() {
+    constexpr int CHANNELS = 16;
+    constexpr auto KILL_AFTER = std::chrono::milliseconds(400);
+    const WavContainer containers[] = {WAV_RIFF, WAV_RF64, WAV_W64};
+    const char* extensions[] = {"wav", "rf64", "w64"};
+    bool ok = true;
+
+    std::cout << "Streaming writer crash test: " << CHANNELS << " ch float32, "
+              << WAV_WRITE_BLOCK / (1 << 20) << " MB aligned blocks\n";
+    for (int k = 0; k < 3; ++k) {
+        std::string path = std::string("record_check.") + extensions[k];
+
+        // Killed mid-stream: the header must describe only samples on disk
+        pid_t child = fork();
+        if (child == 0) {
+            writeTestStream(path, containers[k], CHANNELS, INT64_MAX, true);
+            _exit(0);
+        }
+        std::this_thread::sleep_for(KILL_AFTER);
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+        int64_t killed = verifyTestStream(path, CHANNELS);
+
+        // Clean close, ending mid-block and mid-buffer
+        int64_t expected = 3 * SAMPLE_RATE + 777;
+        writeTestStream(path, containers[k], CHANNELS, expected, false);
+        int64_t closed = verifyTestStream(path, CHANNELS);
+        std::remove(path.c_str());
+
+        bool pass = killed > 0 && closed == expected;
+        ok = ok && pass;
+        std::cout << "  " << std::left << std::setw(7) << wavContainerName(containers[k]) << std::right
+                  << " killed: " << (killed < 0 ? std::string("unreadable") : std::to_string(killed) + " frames readable")
+                  << ", closed: " << (closed < 0 ? std::string("unreadable") : std::to_string(closed) + " frames")
+                  << "  " << (pass ? "PASS" : "FAIL") << "\n";
+    }
+    return ok ? 0 : 1;
+}
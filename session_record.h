@@ -0,0 +1,32 @@
+/**
+ * Session recording: every block the engine hands to the device, in the
+ * output layout, streamed to a float WAV, RF64 or Wave64 file.
+ *
+ * The audio thread only copies blocks into wait-free rings; a background
+ * thread appends them through WavStreamWriter and flushes once a second,
+ * so a crash loses at most the last second. Frames the device never got
+ * (a reopen gap, a ring overrun) are written as silence, keeping file
+ * frame n at engine frame first + n.
+ */
+
+#pragma once
+
+#include "async_writer.h"
+
+#include <string>
+
+/**
+ * Start recording to `path` (container from the extension: .wav, .rf64,
+ * .w64). Must be called before the audio device is started.
+ */
+bool startSessionRecord(const std::string& path, int sampleRate, int channels,
+                        const AsyncWriterConfig& io = AsyncWriterConfig());
+void stopSessionRecord();
+
+/**
+ * Crash test for the streaming writer: a child process writes 16-channel
+ * float in each container and is killed mid-stream; the file it leaves
+ * must parse and hold exactly the samples written up to its header.
+ * Then a clean write-and-close round trip per container.
+ */
+int runRecordCheck();
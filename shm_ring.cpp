@@ -0,0 +1,363 @@
+#include "shm_ring.h"
+#include "engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+ShmRing g_outputRing;
+
+size_t slotStrideFor(uint32_t channels, uint32_t slotFrames) {
+    size_t bytes = sizeof(ShmSlotHeader) + static_cast<size_t>(slotFrames) * channels * sizeof(float);
+    return (bytes + 63) & ~static_cast<size_t>(63);
+}
+
+size_t headerBytes() {
+    return (sizeof(ShmRingHeader) + 63) & ~static_cast<size_t>(63);
+}
+
+void outputTap(const float* block, int frames, int64_t startFrame, int64_t hostNs) {
+    shmRingWrite(g_outputRing, block, frames, startFrame, hostNs);
+}
+
+/**
+ * Consumer state shared by the reader tool and the benchmark child
+ */
+struct ShmReadStats {
+    uint64_t blocks = 0;
+    uint64_t frames = 0;
+    uint64_t lapped = 0;        // Blocks overwritten before we got to them
+    uint64_t onsets = 0;
+    int64_t lastFrame = -1;
+    int silentRun = 0;
+    double checksum = 0.0;
+};
+
+/**
+ * Consume one published block in place. Returns false if it was torn.
+ */
+bool consumeSlot(const ShmRing& ring, uint64_t seq, ShmReadStats& stats, bool sentinelStops, bool& stop) {
+    const ShmRingHeader* h = ring.header;
+    ShmSlotHeader* slot = shmRingSlot(ring, seq);
+    uint32_t expected = 2 * static_cast<uint32_t>(seq / h->slotCount + 1);
+
+    uint32_t s1 = slot->seq.load(std::memory_order_acquire);
+    if (s1 != expected) return false;
+
+    int64_t frameIndex = slot->frameIndex;
+    uint32_t frames = std::min(slot->frames, h->slotFrames);
+    const float* samples = shmSlotSamples(slot);
+
+    // Work directly on the mapped samples, validate afterwards
+    uint64_t onsets = 0;
+    int silentRun = stats.silentRun;
+    int onsetGap = static_cast<int>(h->sampleRate / 1000);
+    double sum = 0.0;
+    for (uint32_t i = 0; i < frames; ++i) {
+        float s = samples[i * h->channels];
+        sum += s;
+        if (s != 0.0f) {
+            if (silentRun >= onsetGap) ++onsets;
+            silentRun = 0;
+        } else {
+            ++silentRun;
+        }
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot->seq.load(std::memory_order_relaxed) != s1) return false;
+
+    if (sentinelStops && frameIndex < 0) {
+        stop = true;
+        return true;
+    }
+    stats.blocks++;
+    stats.frames += frames;
+    stats.onsets += onsets;
+    stats.silentRun = silentRun;
+    stats.lastFrame = frameIndex + frames;
+    stats.checksum += sum;
+    return true;
+}
+
+/**
+ * Drain everything published since `next`. Returns the new cursor.
+ */
+uint64_t drainRing(const ShmRing& ring, uint64_t next, ShmReadStats& stats, bool sentinelStops, bool& stop) {
+    uint64_t w = ring.header->writeSeq.load(std::memory_order_acquire);
+    if (w - next > ring.header->slotCount) {
+        stats.lapped += w - next - ring.header->slotCount;
+        next = w - ring.header->slotCount;
+    }
+    while (next < w && !stop) {
+        if (!consumeSlot(ring, next, stats, sentinelStops, stop)) {
+            stats.lapped++;
+        }
+        ++next;
+    }
+    return next;
+}
+
+} // namespace
+
+bool shmRingCreate(ShmRing& ring, const std::string& name, uint32_t sampleRate,
+                   uint32_t channels, uint32_t slotFrames, uint32_t slotCount) {
+    size_t stride = slotStrideFor(channels, slotFrames);
+    size_t size = headerBytes() + stride * slotCount;
+
+    shm_unlink(name.c_str());  // Stale ring from a crashed run
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        std::cerr << "shm_open(" << name << ") failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        std::cerr << "ftruncate(" << name << ") failed: " << std::strerror(errno) << std::endl;
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        std::cerr << "mmap(" << name << ") failed: " << std::strerror(errno) << std::endl;
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // Fault every page in now so the audio callback never does
+    std::memset(base, 0, size);
+    mlock(base, size);
+
+    ring.name = name;
+    ring.base = base;
+    ring.size = size;
+    ring.owner = true;
+    ring.header = new (base) ShmRingHeader();
+    ring.header->sampleRate = sampleRate;
+    ring.header->channels = channels;
+    ring.header->slotFrames = slotFrames;
+    ring.header->slotCount = slotCount;
+    ring.header->slotStride = static_cast<uint32_t>(stride);
+    ring.header->writeSeq.store(0, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < slotCount; ++i) {
+        new (shmRingSlot(ring, i)) ShmSlotHeader();
+    }
+    ring.header->version = SHM_RING_VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    ring.header->magic = SHM_RING_MAGIC;
+    return true;
+}
+
+bool shmRingAttach(ShmRing& ring, const std::string& name) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        std::cerr << "shm_open(" << name << ") failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < headerBytes()) {
+        std::cerr << "Shared-memory ring " << name << " is not initialized" << std::endl;
+        close(fd);
+        return false;
+    }
+    void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        std::cerr << "mmap(" << name << ") failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    auto* header = static_cast<ShmRingHeader*>(base);
+    if (header->magic != SHM_RING_MAGIC || header->version != SHM_RING_VERSION) {
+        std::cerr << "Shared-memory ring " << name << " has an unknown layout" << std::endl;
+        munmap(base, st.st_size);
+        return false;
+    }
+
+    ring.name = name;
+    ring.base = base;
+    ring.size = st.st_size;
+    ring.owner = false;
+    ring.header = header;
+    return true;
+}
+
+void shmRingClose(ShmRing& ring) {
+    if (!ring.base) return;
+    munmap(ring.base, ring.size);
+    if (ring.owner) shm_unlink(ring.name.c_str());
+    ring.base = nullptr;
+    ring.header = nullptr;
+}
+
+ShmSlotHeader* shmRingSlot(const ShmRing& ring, uint64_t seq) {
+    uint64_t index = seq % ring.header->slotCount;
+    auto* bytes = static_cast<uint8_t*>(ring.base) + headerBytes() + index * ring.header->slotStride;
+    return reinterpret_cast<ShmSlotHeader*>(bytes);
+}
+
+void shmRingWrite(ShmRing& ring, const float* samples, int frames, int64_t frameIndex, int64_t hostNs) {
+    ShmRingHeader* h = ring.header;
+    uint64_t seq = h->writeSeq.load(std::memory_order_relaxed);
+    int done = 0;
+    while (done < frames) {
+        int n = std::min<int>(frames - done, h->slotFrames);
+        ShmSlotHeader* slot = shmRingSlot(ring, seq);
+
+        uint32_t s = slot->seq.load(std::memory_order_relaxed);
+        slot->seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot->frames = static_cast<uint32_t>(n);
+        slot->frameIndex = frameIndex + done;
+        slot->hostTimeNs = hostNs;
+        std::memcpy(reinterpret_cast<float*>(slot + 1), samples + static_cast<size_t>(done) * h->channels,
+                    static_cast<size_t>(n) * h->channels * sizeof(float));
+
+        slot->seq.store(s + 2, std::memory_order_release);
+        h->writeSeq.store(++seq, std::memory_order_release);
+        done += n;
+    }
+}
+
+bool startShmOutput(const std::string& name, uint32_t sampleRate, uint32_t channels, uint32_t slotFrames) {
+    // ~3s of history at the default block size
+    if (!shmRingCreate(g_outputRing, name, sampleRate, channels, slotFrames, 128)) {
+        return false;
+    }
+    addBlockTap(outputTap);
+    std::cout << "Shared-memory ring: " << name << " (" << g_outputRing.size / 1024 << " KiB)\n";
+    return true;
+}
+
+void stopShmOutput() {
+    shmRingClose(g_outputRing);
+}
+
+int runShmReader(const std::string& name) {
+    ShmRing ring;
+    if (!shmRingAttach(ring, name)) {
+        return 1;
+    }
+    const ShmRingHeader* h = ring.header;
+    std::cout << "Attached to " << name << ": " << h->sampleRate << " Hz, " << h->channels
+              << " ch, " << h->slotCount << " x " << h->slotFrames << " frame slots\n";
+
+    ShmReadStats stats;
+    ShmReadStats lastReport;
+    uint64_t next = h->writeSeq.load(std::memory_order_acquire);
+    bool stop = false;
+    auto lastPrint = std::chrono::steady_clock::now();
+
+    while (!stop) {
+        uint64_t before = next;
+        next = drainRing(ring, next, stats, false, stop);
+        if (next == before) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastPrint >= std::chrono::seconds(1)) {
+            double seconds = std::chrono::duration<double>(now - lastPrint).count();
+            std::cout << "frame " << stats.lastFrame
+                      << " | blocks " << stats.blocks - lastReport.blocks
+                      << " | onsets/s " << std::fixed << std::setprecision(1)
+                      << (stats.onsets - lastReport.onsets) / seconds << std::defaultfloat
+                      << " | lapped " << stats.lapped << std::endl;
+            lastReport = stats;
+            lastPrint = now;
+        }
+    }
+
+    shmRingClose(ring);
+    return 0;
+}
+
+int runShmBenchmark() {
+    constexpr uint32_t channels = 8;
+    constexpr uint32_t slotFrames = 1024;
+    constexpr uint32_t slotCount = 256;
+    constexpr double durationSeconds = 2.0;
+
+    std::string name = "/pnas_bench_" + std::to_string(getpid());
+    ShmRing ring;
+    if (!shmRingCreate(ring, name, SAMPLE_RATE, channels, slotFrames, slotCount)) {
+        return 1;
+    }
+
+    pid_t child = fork();
+    if (child < 0) {
+        std::cerr << "fork failed: " << std::strerror(errno) << std::endl;
+        shmRingClose(ring);
+        return 1;
+    }
+
+    if (child == 0) {
+        // Reader process: spin on writeSeq, consume in place
+        ShmRing reader;
+        if (!shmRingAttach(reader, name)) _exit(1);
+        ShmReadStats stats;
+        uint64_t next = 0;
+        bool stop = false;
+        auto start = std::chrono::steady_clock::now();
+        while (!stop) {
+            next = drainRing(reader, next, stats, true, stop);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double bytes = static_cast<double>(stats.frames) * channels * sizeof(float);
+        std::cout << "Reader: " << stats.blocks << " blocks, " << std::fixed << std::setprecision(1)
+                  << bytes / seconds / 1e6 << " MB/s, lapped " << stats.lapped
+                  << " (" << 100.0 * stats.lapped / std::max<uint64_t>(1, stats.blocks + stats.lapped)
+                  << "%)" << std::defaultfloat << std::endl;
+        shmRingClose(reader);
+        _exit(0);
+    }
+
+    // Give the child time to attach before the clock starts
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<float> block(static_cast<size_t>(slotFrames) * channels);
+    for (size_t i = 0; i < block.size(); ++i) {
+        block[i] = static_cast<float>(i % 97) / 97.0f;
+    }
+
+    uint64_t blocks = 0;
+    int64_t frame = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration<double>(durationSeconds);
+    while (std::chrono::steady_clock::now() < deadline) {
+        for (int i = 0; i < 64; ++i) {
+            shmRingWrite(ring, block.data(), slotFrames, frame, 0);
+            frame += slotFrames;
+            ++blocks;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    shmRingWrite(ring, block.data(), 1, -1, 0);  // Sentinel
+
+    int status = 0;
+    waitpid(child, &status, 0);
+
+    double bytes = static_cast<double>(blocks) * slotFrames * channels * sizeof(float);
+    std::cout << "Writer: " << blocks << " blocks of " << slotFrames << " x " << channels << " ch, "
+              << std::fixed << std::setprecision(1) << bytes / seconds / 1e6 << " MB/s, "
+              << blocks / seconds / 1e6 << " M blocks/s ("
+              << frame / seconds / SAMPLE_RATE << "x realtime)\n" << std::defaultfloat;
+
+    shmRingClose(ring);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+/**
+ * POSIX shared-memory ring carrying every rendered block to other processes.
+ *
+ * Layout: ShmRingHeader, then slotCount slots of ShmSlotHeader + samples.
+ * Each slot is guarded by a seqlock (odd while being written), so readers
+ * can work directly on the mapped samples and validate afterwards; no
+ * copies, locks or syscalls on either side once mapped.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+constexpr uint32_t SHM_RING_MAGIC = 0x534E4150;  // "PNAS"
+constexpr uint32_t SHM_RING_VERSION = 1;
+
+struct ShmRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sampleRate;
+    uint32_t channels;
+    uint32_t slotFrames;        // Max frames per slot
+    uint32_t slotCount;
+    uint32_t slotStride;        // Bytes between slot headers
+    uint32_t reserved;
+    alignas(64) std::atomic<uint64_t> writeSeq;  // Blocks published so far
+};
+
+struct ShmSlotHeader {
+    std::atomic<uint32_t> seq;  // Seqlock counter
+    uint32_t frames;
+    int64_t frameIndex;         // Engine frame of the first sample
+    int64_t hostTimeNs;         // Callback time on the writer's steady clock
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory atomics must be lock-free");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared-memory atomics must be lock-free");
+
+struct ShmRing {
+    std::string name;
+    void* base = nullptr;
+    size_t size = 0;
+    bool owner = false;
+    ShmRingHeader* header = nullptr;
+};
+
+/**
+ * Create (writer) or attach to (reader) a ring
+ */
+bool shmRingCreate(ShmRing& ring, const std::string& name, uint32_t sampleRate,
+                   uint32_t channels, uint32_t slotFrames, uint32_t slotCount);
+bool shmRingAttach(ShmRing& ring, const std::string& name);
+void shmRingClose(ShmRing& ring);
+
+/**
+ * Publish one block, splitting it across slots if it exceeds slotFrames.
+ * Wait-free; safe to call from the audio callback.
+ */
+void shmRingWrite(ShmRing& ring, const float* samples, int frames, int64_t frameIndex, int64_t hostNs);
+
+/**
+ * Slot for block number `seq` (seq < writeSeq)
+ */
+ShmSlotHeader* shmRingSlot(const ShmRing& ring, uint64_t seq);
+inline const float* shmSlotSamples(const ShmSlotHeader* slot) {
+    return reinterpret_cast<const float*>(slot + 1);
+}
+
+/**
+ * Route every block the engine renders into the ring
+ */
+bool startShmOutput(const std::string& name, uint32_t sampleRate, uint32_t channels, uint32_t slotFrames);
+void stopShmOutput();
+
+/**
+ * Reader tool: follow a ring and print per-second statistics
+ */
+int runShmReader(const std::string& name);
+
+/**
+ * Throughput test: writer in this process, reader in a forked child
+ */
+int runShmBenchmark();
@@ -0,0 +1,96 @@
+/**
+ * Wait-free single-producer / single-consumer ring buffer.
+ *
+ * Used to move data off the audio thread (the callback is the only
+ * producer, one background thread the only consumer) and, for maskers,
+ * onto it the other way round. Capacity is rounded up to a power of two.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity = 1024) { reset(capacity); }
+
+    /**
+     * Resize and clear. Not thread-safe; call before either side runs.
+     */
+    void reset(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        buffer_.assign(size, T{});
+        mask_ = size - 1;
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+    size_t size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Producer side. Returns false (and drops the item) when full.
+     */
+    bool push(const T& item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) > mask_) return false;
+        buffer_[head & mask_] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Producer side, bulk. Pushes all of `count` or nothing.
+     */
+    bool push(const T* items, size_t count) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (capacity() - (head - tail_.load(std::memory_order_acquire)) < count) return false;
+        size_t start = head & mask_;
+        size_t first = std::min(count, capacity() - start);
+        std::copy(items, items + first, buffer_.begin() + start);
+        std::copy(items + first, items + count, buffer_.begin());
+        head_.store(head + count, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer side
+     */
+    bool pop(T& item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) return false;
+        item = buffer_[tail & mask_];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer side, bulk. Returns the number of items copied (<= count).
+     */
+    size_t pop(T* items, size_t count) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t available = head_.load(std::memory_order_acquire) - tail;
+        count = std::min(count, available);
+        size_t start = tail & mask_;
+        size_t first = std::min(count, capacity() - start);
+        std::copy(buffer_.begin() + start, buffer_.begin() + start + first, items);
+        std::copy(buffer_.begin(), buffer_.begin() + (count - first), items + first);
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    std::vector<T> buffer_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
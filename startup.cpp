@@ -0,0 +1,114 @@
+#include "startup.h"
+#include "engine.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+bool g_startupProbe = false;
+
+namespace {
+
+const char* const STARTUP_MARKS[] = {"audio_open", "first_pulse", "window"};
+
+/**
+ * Run one probe and collect its milestones relative to spawn time
+ */
+bool runProbe(const char* exe, std::map<std::string, double>& marksMs) {
+    int pipeFds[2];
+    if (pipe(pipeFds) != 0) {
+        std::cerr << "pipe failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, pipeFds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, pipeFds[0]);
+
+    char probeFlag[] = "--startup-probe";
+    char* args[] = {const_cast<char*>(exe), probeFlag, nullptr};
+
+    pid_t pid;
+    int64_t spawnNs = hostTimeNs();
+    int err = posix_spawnp(&pid, exe, &actions, nullptr, args, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(pipeFds[1]);
+    if (err != 0) {
+        std::cerr << "posix_spawn(" << exe << ") failed: " << std::strerror(err) << std::endl;
+        close(pipeFds[0]);
+        return false;
+    }
+
+    FILE* out = fdopen(pipeFds[0], "r");
+    char line[512];
+    while (std::fgets(line, sizeof(line), out)) {
+        char mark[64];
+        long long ns;
+        if (std::sscanf(line, "STARTUP %63s %lld", mark, &ns) == 2) {
+            marksMs[mark] = (ns - spawnNs) / 1e6;
+        }
+    }
+    std::fclose(out);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+} // namespace
+
+void reportStartupMark(const char* mark, int64_t hostNs) {
+    if (!g_startupProbe) return;
+    std::cout << "STARTUP " << mark << " " << hostNs << std::endl;
+}
+
+int runStartupBenchmark(const char* argv0, int launches) {
+#ifdef __linux__
+    (void)argv0;
+    const char* exe = "/proc/self/exe";
+#else
+    const char* exe = argv0;
+#endif
+
+    std::map<std::string, std::vector<double>> results;
+    std::cout << "Measuring time to first pulse over " << launches << " launches\n";
+    for (int i = 0; i < launches; ++i) {
+        std::map<std::string, double> marks;
+        if (!runProbe(exe, marks)) {
+            std::cerr << "Probe " << i + 1 << " failed" << std::endl;
+            return 1;
+        }
+        std::cout << "  #" << i + 1 << std::fixed << std::setprecision(1);
+        for (const char* mark : STARTUP_MARKS) {
+            if (marks.count(mark)) {
+                std::cout << "  " << mark << " " << marks[mark] << " ms";
+                results[mark].push_back(marks[mark]);
+            }
+        }
+        std::cout << std::defaultfloat << "\n";
+    }
+
+    std::cout << "Process start to:\n" << std::fixed << std::setprecision(1);
+    for (const char* mark : STARTUP_MARKS) {
+        auto& values = results[mark];
+        if (values.empty()) continue;
+        std::sort(values.begin(), values.end());
+        std::cout << "  " << std::left << std::setw(12) << mark << std::right
+                  << " min " << values.front() << " ms, median " << values[values.size() / 2]
+                  << " ms, max " << values.back() << " ms\n";
+    }
+    std::cout << std::defaultfloat;
+    return 0;
+}
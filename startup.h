@@ -0,0 +1,25 @@
+/**
+ * Time-to-first-pulse measurement.
+ *
+ * The benchmark relaunches this executable with --startup-probe; the probe
+ * prints "STARTUP <mark> <hostNs>" lines on stdout and exits as soon as the
+ * first pulse has been written and the window is up. Both processes read
+ * the same monotonic clock, so the parent can subtract its spawn time.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+extern bool g_startupProbe;
+
+/**
+ * Emit a startup milestone (no-op unless running as a probe)
+ */
+void reportStartupMark(const char* mark, int64_t hostNs);
+
+/**
+ * Launch the probe `launches` times and report process start to audio
+ * open, first non-zero sample and window ready.
+ */
+int runStartupBenchmark(const char* argv0, int launches);
@@ -0,0 +1,368 @@
+#include "stdout_stream.h"
+#include "bench.h"
+#include "engine.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr size_t SLOT_BYTES = 1 << 20;      // Requested pipe capacity, and the write size
+constexpr int SLOTS = 3;
+constexpr auto PROGRESS_INTERVAL = std::chrono::milliseconds(500);
+constexpr size_t READER_BYTES = 1 << 20;
+
+/**
+ * Page-aligned output slots and the call that hands them to the kernel
+ */
+class PcmSink {
+public:
+    PcmSink() = default;
+    PcmSink(const PcmSink&) = delete;
+    PcmSink& operator=(const PcmSink&) = delete;
+    ~PcmSink() {
+        for (uint8_t* slot : slots_) std::free(slot);
+    }
+
+    bool open(int fd, bool splice) {
+        fd_ = fd;
+        slotBytes_ = SLOT_BYTES;
+        struct stat st;
+        splice_ = false;
+#if defined(__linux__) && defined(F_SETPIPE_SZ)
+        if (splice && fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode)) {
+            // One slot fills the pipe, so a slot two behind has been
+            // read() out of it (not so for a reader that splices it on)
+            fcntl(fd, F_SETPIPE_SZ, static_cast<int>(SLOT_BYTES));
+            int capacity = fcntl(fd, F_GETPIPE_SZ);
+            if (capacity > 0) {
+                slotBytes_ = static_cast<size_t>(capacity);
+                splice_ = true;
+            }
+        }
+#else
+        (void)splice;
+        (void)st;
+#endif
+        for (uint8_t*& slot : slots_) {
+            slot = static_cast<uint8_t*>(std::aligned_alloc(4096, slotBytes_));
+            if (!slot) return false;
+        }
+        return true;
+    }
+
+    uint8_t* slot() { return slots_[next_]; }
+    size_t slotBytes() const { return slotBytes_; }
+    bool spliced() const { return splice_; }
+    bool readerGone() const { return readerGone_; }
+
+    /**
+     * Send the first `bytes` of the current slot and move to the next.
+     * Returns false once the reader has gone or on an error.
+     */
+    bool emit(size_t bytes) {
+        const uint8_t* p = slots_[next_];
+        next_ = (next_ + 1) % SLOTS;
+        while (bytes > 0) {
+            ssize_t n;
+#ifdef __linux__
+            if (splice_) {
+                struct iovec iov = {const_cast<uint8_t*>(p), bytes};
+                n = vmsplice(fd_, &iov, 1, 0);
+                if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                    splice_ = false;    // Not a pipe after all, or no vmsplice
+                    continue;
+                }
+            } else {
+                n = write(fd_, p, bytes);
+            }
+#else
+            n = write(fd_, p, bytes);
+#endif
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EPIPE) readerGone_ = true;
+                return false;
+            }
+            p += n;
+            bytes -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+private:
+    int fd_ = -1;
+    bool splice_ = false;
+    bool readerGone_ = false;
+    size_t slotBytes_ = SLOT_BYTES;
+    uint8_t* slots_[SLOTS] = {};
+    int next_ = 0;
+};
+
+void convertPcm(const float* in, size_t count, PcmFormat format, uint8_t* out) {
+    switch (format) {
+        case PCM_S16LE:
+            for (size_t i = 0; i < count; ++i) {
+                int16_t v = static_cast<int16_t>(std::lrint(std::clamp(in[i], -1.0f, 1.0f) * 32767.0f));
+                std::memcpy(out + 2 * i, &v, 2);
+            }
+            break;
+        case PCM_S24LE:
+            for (size_t i = 0; i < count; ++i) {
+                int32_t v = static_cast<int32_t>(std::lrint(std::clamp(in[i], -1.0f, 1.0f) * 8388607.0f));
+                out[3 * i] = static_cast<uint8_t>(v);
+                out[3 * i + 1] = static_cast<uint8_t>(v >> 8);
+                out[3 * i + 2] = static_cast<uint8_t>(v >> 16);
+            }
+            break;
+        case PCM_S32LE:
+            for (size_t i = 0; i < count; ++i) {
+                int32_t v = static_cast<int32_t>(std::lrint(std::clamp<double>(in[i], -1.0, 1.0) * 2147483647.0));
+                std::memcpy(out + 4 * i, &v, 4);
+            }
+            break;
+        case PCM_F32LE:
+            std::memcpy(out, in, count * sizeof(float));
+            break;
+    }
+}
+
+/**
+ * Byte count with a binary unit, as pv prints it
+ */
+std::string binaryUnits(double bytes) {
+    const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    int unit = 0;
+    while (bytes >= 1024.0 && unit < 4) {
+        bytes /= 1024.0;
+        ++unit;
+    }
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(unit == 0 ? 0 : 2) << bytes << units[unit];
+    return text.str();
+}
+
+/**
+ * pv's progress line: bytes, elapsed time and rate
+ */
+std::string pvLine(int64_t bytes, double seconds) {
+    int whole = static_cast<int>(seconds);
+    std::ostringstream line;
+    line << std::setw(10) << binaryUnits(static_cast<double>(bytes)) << " " << whole / 3600 << ":"
+         << std::setfill('0') << std::setw(2) << whole / 60 % 60 << ":" << std::setw(2) << whole % 60
+         << std::setfill(' ') << " [" << std::setw(10) << binaryUnits(bytes / std::max(seconds, 1e-9)) << "/s]";
+    return line.str();
+}
+
+struct StreamResult {
+    int64_t bytes = 0;
+    double seconds = 0.0;
+    bool ok = false;
+    bool readerGone = false;
+    bool spliced = false;
+};
+
+/**
+ * Render `totalFrames` of the default grid to `fd` in `format`. Without
+ * `render` only the first slots are rendered and then sent over and
+ * over, leaving the transport alone. With a `progress` stream a pv-style
+ * line after `label` is redrawn on it as the bytes go out.
+ */
+StreamResult streamPcm(int fd, PcmFormat format, int64_t totalFrames, bool splice, bool render,
+                       std::ostream* progress, const std::string& label = std::string()) {
+    StreamResult result;
+    int channels = outputChannels();
+    int64_t frameBytes = static_cast<int64_t>(channels) * pcmFormatBytes(format);
+    PcmSink sink;
+    if (!sink.open(fd, splice)) return result;
+    int64_t slotFrames = static_cast<int64_t>(sink.slotBytes()) / frameBytes;
+    std::vector<float> scratch(format == PCM_F32LE ? 0 : static_cast<size_t>(slotFrames) * channels);
+
+    auto start = std::chrono::steady_clock::now();
+    auto nextProgress = start + PROGRESS_INTERVAL;
+    result.ok = true;
+    for (int64_t first = 0, n = 0; first < totalFrames; ++n) {
+        int frames = static_cast<int>(std::min(slotFrames, totalFrames - first));
+        uint8_t* out = sink.slot();
+        if (render || n < SLOTS) {
+            float* samples = format == PCM_F32LE ? reinterpret_cast<float*>(out) : scratch.data();
+            renderOutputBlock(samples, first, frames);
+            if (format != PCM_F32LE) convertPcm(samples, static_cast<size_t>(frames) * channels, format, out);
+        }
+        if (!sink.emit(static_cast<size_t>(frames * frameBytes))) {
+            result.ok = sink.readerGone();
+            break;
+        }
+        first += frames;
+        result.bytes += frames * frameBytes;
+
+        if (progress) {
+            auto now = std::chrono::steady_clock::now();
+            if (now >= nextProgress) {
+                *progress << "\r" << label << pvLine(result.bytes, std::chrono::duration<double>(now - start).count())
+                          << std::flush;
+                nextProgress = now + PROGRESS_INTERVAL;
+            }
+        }
+    }
+    result.seconds = secondsSince(start);
+    result.readerGone = sink.readerGone();
+    result.spliced = sink.spliced();
+    return result;
+}
+
+/**
+ * Benchmark reader: read and discard, then report a hash of the stream
+ */
+void readerProcess(int in, int report) {
+    std::vector<uint64_t> buffer(READER_BYTES / sizeof(uint64_t));
+    uint64_t hash = 1469598103934665603ULL;
+    size_t carry = 0;                       // Bytes of a partial word at the front
+    for (;;) {
+        ssize_t n = read(in, reinterpret_cast<uint8_t*>(buffer.data()) + carry, READER_BYTES - carry);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        size_t have = carry + static_cast<size_t>(n);
+        size_t words = have / sizeof(uint64_t);
+        for (size_t i = 0; i < words; ++i) hash = (hash ^ buffer[i]) * 1099511628211ULL;
+        carry = have % sizeof(uint64_t);
+        std::memmove(buffer.data(), buffer.data() + words, carry);
+    }
+    for (size_t i = 0; i < carry; ++i) {
+        hash = (hash ^ reinterpret_cast<uint8_t*>(buffer.data())[i]) * 1099511628211ULL;
+    }
+    if (write(report, &hash, sizeof(hash)) != sizeof(hash)) _exit(1);
+    _exit(0);
+}
+
+} // namespace
+
+bool parsePcmFormat(const std::string& name, PcmFormat& format) {
+    const PcmFormat formats[] = {PCM_S16LE, PCM_S24LE, PCM_S32LE, PCM_F32LE};
+    for (PcmFormat candidate : formats) {
+        if (name == pcmFormatName(candidate)) {
+            format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* pcmFormatName(PcmFormat format) {
+    switch (format) {
+        case PCM_S16LE: return "s16le";
+        case PCM_S24LE: return "s24le";
+        case PCM_S32LE: return "s32le";
+        case PCM_F32LE: return "f32le";
+    }
+    return "?";
+}
+
+int pcmFormatBytes(PcmFormat format) {
+    return format == PCM_S16LE ? 2 : format == PCM_S24LE ? 3 : 4;
+}
+
+int runStdoutStream(const StdoutConfig& config) {
+    if (isatty(STDOUT_FILENO)) {
+        std::cerr << "stdout is a terminal; pipe --stdout into sox, ffmpeg or a file" << std::endl;
+        return 1;
+    }
+    buildRenderTables();
+    signal(SIGPIPE, SIG_IGN);
+
+    int64_t totalFrames = static_cast<int64_t>(config.seconds * SAMPLE_RATE);
+    bool tty = isatty(STDERR_FILENO);
+    StreamResult result = streamPcm(STDOUT_FILENO, config.format, totalFrames, config.vmsplice, true,
+                                    tty ? &std::cerr : nullptr);
+    if (!result.ok) {
+        std::cerr << (tty ? "\n" : "") << "Write to stdout failed: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    double minutes = result.bytes / (static_cast<double>(outputChannels()) * pcmFormatBytes(config.format)) /
+                     SAMPLE_RATE / 60.0;
+    std::cerr << (tty ? "\r" : "") << pvLine(result.bytes, result.seconds) << "  " << std::fixed
+              << std::setprecision(1) << minutes << " min, " << outputChannels() << " ch "
+              << pcmFormatName(config.format) << " at " << SAMPLE_RATE << " Hz via "
+              << (result.spliced ? "vmsplice" : "write()")
+              << (result.readerGone ? " (reader closed the pipe)" : "") << std::defaultfloat << std::endl;
+    return 0;
+}
+
+int runStdoutBenchmark(double seconds) {
+    buildRenderTables();
+    signal(SIGPIPE, SIG_IGN);
+    int channels = outputChannels();
+    int64_t totalFrames = static_cast<int64_t>(seconds * SAMPLE_RATE);
+    bool tty = isatty(STDOUT_FILENO);
+
+    std::cout << "stdout pipe throughput: " << seconds / 60.0 << " min, " << channels
+              << " ch, into a reader process that discards it\n"
+              << "  format  source       method            bytes      time       rate        real-time channels\n";
+    bool identical = true;
+    const PcmFormat formats[] = {PCM_F32LE, PCM_S16LE};
+    for (PcmFormat format : formats) {
+        uint64_t reference = 0;
+        for (int render = 1; render >= 0; --render) {
+            for (int splice = 0; splice <= 1; ++splice) {
+                int data[2], report[2];
+                if (pipe(data) != 0 || pipe(report) != 0) {
+                    std::cerr << "pipe() failed: " << std::strerror(errno) << std::endl;
+                    return 1;
+                }
+                pid_t child = fork();
+                if (child == 0) {
+                    close(data[1]);
+                    close(report[0]);
+                    readerProcess(data[0], report[1]);
+                }
+                close(data[0]);
+                close(report[1]);
+
+                std::ostringstream prefix;
+                prefix << "  " << std::left << std::setw(6) << pcmFormatName(format) << "  " << std::setw(11)
+                       << (render ? "rendered" : "transport") << "  " << std::setw(13)
+                       << (splice ? "vmsplice" : "write()") << std::right;
+                std::cout << prefix.str() << std::flush;
+                StreamResult result = streamPcm(data[1], format, totalFrames, splice, render,
+                                                tty ? &std::cout : nullptr, prefix.str());
+                if (tty) std::cout << "\r" << prefix.str();
+                close(data[1]);
+                uint64_t hash = 0;
+                bool read = ::read(report[0], &hash, sizeof(hash)) == sizeof(hash);
+                close(report[0]);
+                waitpid(child, nullptr, 0);
+
+                // The reader must see the same stream whichever call fed it
+                bool same = true;
+                if (render) {
+                    if (!splice) reference = hash;
+                    same = read && result.ok && hash == reference;
+                    identical = identical && same;
+                }
+                double rate = result.bytes / std::max(result.seconds, 1e-9);
+                std::cout << "  " << pvLine(result.bytes, result.seconds) << "  " << std::setw(10)
+                          << static_cast<int64_t>(rate / (static_cast<double>(SAMPLE_RATE) * pcmFormatBytes(format)))
+                          << (splice && !result.spliced ? "  (fell back to write())" : "")
+                          << (same ? "" : "  STREAM DIFFERS") << "\n";
+            }
+        }
+    }
+    std::cout << "  Rendered streams " << (identical ? "identical" : "NOT identical")
+              << " through write() and vmsplice" << std::endl;
+    return identical ? 0 : 1;
+}
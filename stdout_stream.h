@@ -0,0 +1,53 @@
+/**
+ * Raw PCM on standard output, for piping the generator into sox, ffmpeg
+ * or an analyzer without a file in between.
+ *
+ * The default grid is rendered in the current output layout as fast as
+ * the reader takes it, converted to the chosen sample format and written
+ * with write() in page-aligned slots of one pipe's capacity.
+ *
+ * On request (`vmsplice`) and when stdout is a pipe, the slots are handed
+ * to the kernel with vmsplice() instead, which maps the pages into the
+ * pipe by reference rather than copying them. A slot is refilled once two
+ * further slots have gone in after it, so this is only correct for a
+ * reader that consumes the pipe with read(): a reader that splice()s or
+ * tee()s the buffers on (pv, tee, socat) still points at the old pages
+ * and would see them rewritten.
+ */
+
+#pragma once
+
+#include <string>
+
+enum PcmFormat {
+    PCM_S16LE = 0,
+    PCM_S24LE = 1,      // Packed, 3 bytes per sample
+    PCM_S32LE = 2,
+    PCM_F32LE = 3,
+};
+
+struct StdoutConfig {
+    PcmFormat format = PCM_F32LE;
+    double seconds = 3600.0;
+    bool vmsplice = false;      // Map slots into the pipe; the reader must use read()
+};
+
+/**
+ * Format from its ffmpeg/sox-style name: s16le, s24le, s32le, f32le
+ */
+bool parsePcmFormat(const std::string& name, PcmFormat& format);
+const char* pcmFormatName(PcmFormat format);
+int pcmFormatBytes(PcmFormat format);
+
+/**
+ * Stream `config.seconds` to file descriptor 1. Progress and the summary
+ * go to stderr; a reader that closes the pipe early ends the stream
+ * without an error.
+ */
+int runStdoutStream(const StdoutConfig& config);
+
+/**
+ * Pipe throughput into a discarding reader, write() against vmsplice(),
+ * rendered and transport only, for `seconds` of audio per format
+ */
+int runStdoutBenchmark(double seconds);
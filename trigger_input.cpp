@@ -0,0 +1,298 @@
+#include "trigger_input.h"
+#include "engine.h"
+#include "spsc_ring.h"
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr double REARM_FRACTION = 0.5;      // Re-arm below this share of the threshold
+constexpr double STAND_IN_LEVEL = 0.8;
+constexpr double STAND_IN_PRESS_MS = 30.0;
+constexpr double STAND_IN_BOUNCE_MS = 2.0;  // Contact chatter at the start of each press
+constexpr auto PROCESS_INTERVAL = std::chrono::milliseconds(50);
+constexpr int MAX_INPUT_CHANNELS = 8;       // Most SDL opens as 7.1
+
+struct Crossing {
+    int64_t sourceNs;       // Host time of the crossing sample
+    int64_t deliveredNs;    // Capture callback that carried it
+};
+
+struct FiredOnset {
+    int64_t frame;
+    int64_t renderNs;       // Output callback that rendered it
+};
+
+TriggerInputConfig g_config;
+int g_sampleRate = SAMPLE_RATE;
+int g_channels = 1;
+SDL_AudioDeviceID g_device = 0;
+
+// Detector, capture thread only
+bool g_armed = true;
+bool g_above = false;                       // Last sample was at or over the threshold
+int64_t g_sinceCrossing = 0;                // Samples since the last crossing
+int64_t g_debounceSamples = 0;
+std::atomic<uint64_t> g_bounces{0};
+
+SpscRing<Crossing> g_crossings(1024);       // Capture thread -> worker
+SpscRing<FiredOnset> g_fired(1024);         // Audio thread -> worker
+
+std::thread g_worker;
+std::thread g_standIn;
+std::atomic<bool> g_standInRunning{false};
+std::mutex g_mutex;
+std::condition_variable g_wake;
+bool g_stop = false;
+
+// Worker state
+std::deque<Crossing> g_pending;
+uint64_t g_crossingCount = 0;
+uint64_t g_unmatched = 0;                   // Crossings that fired no pulse of their own
+std::vector<double> g_totalMs;
+std::vector<double> g_captureMs;
+std::vector<double> g_waitMs;
+std::vector<double> g_outputMs;
+
+/**
+ * Sample-level threshold detector over one interleaved block that ended
+ * at `callbackNs`
+ */
+void detect(const float* block, int frames, int64_t callbackNs) {
+    int channel = g_config.channel - 1;
+    double threshold = g_config.threshold;
+    for (int i = 0; i < frames; ++i) {
+        double level = std::fabs(block[i * g_channels + channel]);
+        bool rising = level >= threshold && !g_above;
+        g_above = level >= threshold;
+        ++g_sinceCrossing;
+        if (!g_armed) {
+            if (rising) g_bounces.fetch_add(1, std::memory_order_relaxed);
+            g_armed = level < threshold * REARM_FRACTION && g_sinceCrossing >= g_debounceSamples;
+            continue;
+        }
+        if (!rising) continue;
+
+        fireOnset();
+        g_armed = false;
+        g_sinceCrossing = 0;
+        int64_t sourceNs = callbackNs - static_cast<int64_t>(frames - i) * 1000000000LL / g_sampleRate;
+        g_crossings.push(Crossing{sourceNs, callbackNs});
+    }
+}
+
+void captureCallback(void* /*userdata*/, Uint8* stream, int len) {
+    int64_t callbackNs = hostTimeNs();
+    int frames = len / static_cast<int>(sizeof(float) * g_channels);
+    detect(reinterpret_cast<const float*>(stream), frames, callbackNs);
+}
+
+void onsetTap(int64_t frame, int64_t hostNs, int64_t /*pulse*/) {
+    g_fired.push(FiredOnset{frame, hostNs});
+}
+
+/**
+ * Synthetic response box: presses with contact chatter at random
+ * intervals, delivered in capture-sized blocks in real time
+ */
+void standInLoop() {
+    std::mt19937 rng(40);
+    std::uniform_real_distribution<double> gapMs(100.0, 400.0);
+    std::vector<float> block(static_cast<size_t>(g_config.bufferFrames) * g_channels, 0.0f);
+    int64_t pressSamples = std::llround(STAND_IN_PRESS_MS * g_sampleRate / 1000.0);
+    int64_t bounceSamples = std::llround(STAND_IN_BOUNCE_MS * g_sampleRate / 1000.0);
+    int64_t bounceCycle = std::max<int64_t>(2, g_sampleRate / 2000);    // 0.5 ms on / off
+
+    int64_t sample = 0;
+    int64_t nextPress = std::llround(gapMs(rng) * g_sampleRate / 1000.0);
+    auto blockTime = std::chrono::steady_clock::now();
+    auto blockPeriod = std::chrono::nanoseconds(static_cast<int64_t>(g_config.bufferFrames) * 1000000000LL / g_sampleRate);
+    while (g_standInRunning.load()) {
+        for (int i = 0; i < g_config.bufferFrames; ++i, ++sample) {
+            if (sample >= nextPress + pressSamples) {
+                nextPress = sample + std::llround(gapMs(rng) * g_sampleRate / 1000.0);
+            }
+            int64_t into = sample - nextPress;
+            bool closed = into >= 0 && into < pressSamples &&
+                          (into >= bounceSamples || (into / bounceCycle) % 2 == 0);
+            block[static_cast<size_t>(i) * g_channels + g_config.channel - 1] = closed ? STAND_IN_LEVEL : 0.0f;
+        }
+        blockTime += blockPeriod;
+        std::this_thread::sleep_until(blockTime);
+        detect(block.data(), g_config.bufferFrames, hostTimeNs());
+    }
+}
+
+/**
+ * Pair each fired pulse with the newest crossing before it was rendered;
+ * older unpaired crossings were merged into it or fell too close to the
+ * previous pulse
+ */
+void process() {
+    Crossing crossing;
+    while (g_crossings.pop(crossing)) {
+        g_pending.push_back(crossing);
+        ++g_crossingCount;
+    }
+
+    FiredOnset onset;
+    while (g_fired.pop(onset)) {
+        if (g_pending.empty() || g_pending.front().sourceNs > onset.renderNs) continue;
+        while (g_pending.size() > 1 && g_pending[1].sourceNs <= onset.renderNs) {
+            g_pending.pop_front();
+            ++g_unmatched;
+        }
+        crossing = g_pending.front();
+        g_pending.pop_front();
+
+        int64_t heardNs;
+        if (!audibleHostNs(onset.frame, heardNs)) continue;
+        g_totalMs.push_back((heardNs - crossing.sourceNs) / 1e6);
+        g_captureMs.push_back((crossing.deliveredNs - crossing.sourceNs) / 1e6);
+        g_waitMs.push_back((onset.renderNs - crossing.deliveredNs) / 1e6);
+        g_outputMs.push_back((heardNs - onset.renderNs) / 1e6);
+    }
+}
+
+void workerLoop() {
+    std::unique_lock<std::mutex> lock(g_mutex);
+    while (!g_stop) {
+        g_wake.wait_for(lock, PROCESS_INTERVAL, [] { return g_stop; });
+        lock.unlock();
+        process();
+        lock.lock();
+    }
+}
+
+double percentile(std::vector<double> values, double p) {
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+}
+
+} // namespace
+
+bool startTriggerInput(const TriggerInputConfig& config, int sampleRate) {
+    g_config = config;
+    g_sampleRate = sampleRate;
+    if (config.channel < 1 || config.channel > MAX_INPUT_CHANNELS) {
+        std::cerr << "Trigger input channel must be 1-" << MAX_INPUT_CHANNELS << std::endl;
+        return false;
+    }
+    g_channels = config.channel;
+    g_debounceSamples = std::llround(config.debounceMs * sampleRate / 1000.0);
+    g_armed = true;
+    g_above = false;
+    g_sinceCrossing = 0;
+    g_bounces.store(0);
+
+    // Per-run state, so a second start in the same process reports only its own run
+    g_crossings.reset(g_crossings.capacity());
+    g_fired.reset(g_fired.capacity());
+    g_pending.clear();
+    g_crossingCount = 0;
+    g_unmatched = 0;
+    g_totalMs.clear();
+    g_captureMs.clear();
+    g_waitMs.clear();
+    g_outputMs.clear();
+
+    if (!addOnsetTap(onsetTap)) {
+        std::cerr << "No free engine tap for the trigger input" << std::endl;
+        return false;
+    }
+
+    setTriggeredMode(true);
+    if (config.standIn) {
+        g_standInRunning.store(true);
+        g_standIn = std::thread(standInLoop);
+    } else {
+        SDL_AudioSpec desired;
+        SDL_zero(desired);
+        desired.freq = sampleRate;
+        desired.format = AUDIO_F32SYS;
+        desired.channels = static_cast<Uint8>(g_channels);
+        desired.samples = static_cast<Uint16>(config.bufferFrames);
+        desired.callback = captureCallback;
+        desired.userdata = nullptr;
+
+        SDL_AudioSpec obtained;
+        const char* name = config.device.empty() ? nullptr : config.device.c_str();
+        g_device = SDL_OpenAudioDevice(name, 1, &desired, &obtained, SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
+        if (g_device == 0) {
+            std::cerr << "Cannot open trigger input " << (name ? name : "(default)") << ": " << SDL_GetError() << std::endl;
+            return false;
+        }
+        if (obtained.channels < config.channel) {
+            std::cerr << "Trigger input " << (name ? name : "(default)") << " has " << static_cast<int>(obtained.channels)
+                      << " channels, no channel " << config.channel << std::endl;
+            SDL_CloseAudioDevice(g_device);
+            g_device = 0;
+            return false;
+        }
+        g_channels = obtained.channels;
+        g_config.bufferFrames = obtained.samples;
+        SDL_PauseAudioDevice(g_device, 0);
+    }
+
+    g_stop = false;
+    g_worker = std::thread(workerLoop);
+    std::string source = config.standIn ? "synthetic response box"
+                       : config.device.empty() ? "default capture device" : config.device;
+    std::cout << "Trigger input: " << source << ", channel " << config.channel << ", threshold " << config.threshold
+              << ", debounce " << config.debounceMs << " ms, " << g_config.bufferFrames << "-frame buffer" << std::endl;
+    return true;
+}
+
+bool stopTriggerInput() {
+    if (!g_worker.joinable()) return true;
+    if (g_device != 0) {
+        SDL_CloseAudioDevice(g_device);
+        g_device = 0;
+    }
+    if (g_standIn.joinable()) {
+        g_standInRunning.store(false);
+        g_standIn.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_stop = true;
+    }
+    g_wake.notify_all();
+    g_worker.join();
+    process();
+
+    std::cout << "Trigger input: " << g_crossingCount << " crossings (" << g_bounces.load()
+              << " bounces debounced), " << g_totalMs.size() << " pulses fired, "
+              << triggeredTooClose() << " too close to the previous pulse, " << g_unmatched << " merged\n";
+    if (g_totalMs.empty()) return false;
+
+    double bufferMs = 1000.0 * g_config.bufferFrames / g_sampleRate;
+    double outputMs = outputLatencyNs() / 1e6;
+    double medianMs = percentile(g_totalMs, 0.5);
+    std::cout << std::fixed << std::setprecision(2)
+              << "  Input -> heard: median " << medianMs << " ms, p95 " << percentile(g_totalMs, 0.95)
+              << " ms, max " << percentile(g_totalMs, 1.0) << " ms\n"
+              << "  Median path: capture buffer " << percentile(g_captureMs, 0.5)
+              << " ms + wait for the next output block " << percentile(g_waitMs, 0.5)
+              << " ms + output buffer " << percentile(g_outputMs, 0.5) << " ms\n" << std::defaultfloat;
+
+    if (!g_config.standIn) return true;
+    // Worst case: a whole capture block, a whole output period, then the output buffer
+    double boundMs = bufferMs + 2.0 * outputMs + 1.0;
+    bool ok = g_unmatched == 0 && triggeredTooClose() == 0 && percentile(g_totalMs, 0.95) <= boundMs;
+    std::cout << "  Check: " << (ok ? "PASS" : "FAIL") << " (p95 bound " << std::fixed << std::setprecision(2)
+              << boundMs << " ms)\n" << std::defaultfloat;
+    return ok;
+}
@@ -0,0 +1,43 @@
+/**
+ * External trigger input: pulses gated by a device wired into an audio
+ * input (a response box, another stimulator).
+ *
+ * The capture callback watches one input channel sample by sample. A
+ * crossing of the threshold calls fireOnset(), so the pulse goes into the
+ * very next output block the engine renders; the output device runs with
+ * a short buffer in this mode to keep that wait small. Contact bounce is
+ * suppressed with a refractory time and hysteresis.
+ *
+ * A worker thread pairs every crossing with the pulse it fired and
+ * reports the input-to-heard latency, split into capture buffering, the
+ * wait for the next output block and the output buffer.
+ */
+
+#pragma once
+
+#include <string>
+
+struct TriggerInputConfig {
+    std::string device;         // SDL capture device (empty = default)
+    int channel = 1;            // 1-based input channel to watch
+    double threshold = 0.5;     // |level| that counts as a crossing
+    double debounceMs = 20.0;   // Further crossings within this are contact bounce
+    int bufferFrames = 64;      // Capture buffer (bounds the input-side wait)
+    bool standIn = false;       // Synthetic response box instead of a device
+};
+
+// Output device buffer while the trigger input is active
+constexpr int TRIGGER_OUTPUT_BUFFER_FRAMES = 128;
+
+/**
+ * Open the input and switch the engine to triggered mode. Must be called
+ * before the audio device is started (registers an onset tap).
+ */
+bool startTriggerInput(const TriggerInputConfig& config, int sampleRate);
+
+/**
+ * Stop and print the latency report. Returns false if no pulse was fired,
+ * or with the stand-in if a press was lost or the latency exceeded the
+ * buffering bound.
+ */
+bool stopTriggerInput();
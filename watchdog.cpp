@@ -0,0 +1,143 @@
+#include "watchdog.h"
+#include "engine.h"
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <condition_variable>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+
+std::atomic<int> g_watchdogState{WATCHDOG_IDLE};
+
+namespace {
+
+constexpr int STALL_PERIODS = 3;              // Missed periods before flagging
+constexpr int64_t STALL_MARGIN_NS = 20000000; // Scheduler slack on top of that
+constexpr int64_t FAILOVER_GRACE_NS = 500000000; // Time a reopen gets to produce a heartbeat
+
+std::thread g_thread;
+std::mutex g_mutex;
+std::condition_variable g_wake;
+bool g_stop = false;
+bool g_haveBackup = false;
+
+std::atomic<bool> g_armed{false};
+std::atomic<int64_t> g_periodNs{0};
+std::atomic<int64_t> g_armedAtNs{0};
+uint32_t g_eventType = 0;
+
+int64_t stallThresholdNs(int64_t periodNs) {
+    return STALL_PERIODS * periodNs + STALL_MARGIN_NS;
+}
+
+int64_t pollIntervalNs(int64_t periodNs) {
+    return std::clamp<int64_t>(periodNs / 4, 2000000, 20000000);
+}
+
+void postAction(WatchdogAction action) {
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = g_eventType;
+    event.user.code = action;
+    SDL_PushEvent(&event);
+}
+
+void watchdogLoop() {
+    uint64_t countAtEscalation = 0;
+    int64_t escalatedAt = 0;
+    int64_t stallStart = 0;
+
+    std::unique_lock<std::mutex> lock(g_mutex);
+    while (!g_stop) {
+        int64_t periodNs = g_periodNs.load();
+        g_wake.wait_for(lock, std::chrono::nanoseconds(periodNs > 0 ? pollIntervalNs(periodNs) : 20000000));
+        if (g_stop) break;
+
+        int state = g_watchdogState.load();
+        periodNs = g_periodNs.load();
+        if (!g_armed.load() || periodNs == 0) {
+            if (state == WATCHDOG_OK) g_watchdogState.store(WATCHDOG_IDLE);
+            continue;
+        }
+
+        int64_t now = hostTimeNs();
+        uint64_t count = g_callbackCount.load(std::memory_order_relaxed);
+        int64_t last = std::max(g_lastCallbackNs.load(std::memory_order_relaxed), g_armedAtNs.load());
+        int64_t silentNs = now - last;
+
+        switch (state) {
+            case WATCHDOG_IDLE:
+            case WATCHDOG_OK:
+                g_watchdogState.store(WATCHDOG_OK);
+                if (silentNs > stallThresholdNs(periodNs)) {
+                    std::cerr << "⚠ Audio callback stalled: silent for " << std::fixed << std::setprecision(1)
+                              << silentNs / 1e6 << " ms (expected every " << periodNs / 1e6
+                              << " ms), reopening device\n" << std::defaultfloat;
+                    g_watchdogState.store(WATCHDOG_STALLED);
+                    countAtEscalation = count;
+                    escalatedAt = now;
+                    stallStart = last;
+                    postAction(WATCHDOG_REOPEN);
+                }
+                break;
+
+            case WATCHDOG_STALLED:
+            case WATCHDOG_FAILED_OVER:
+                if (count != countAtEscalation) {
+                    std::cout << "✅ Audio callback recovered after " << std::fixed << std::setprecision(1)
+                              << (now - stallStart) / 1e6 << " ms\n" << std::defaultfloat;
+                    g_watchdogState.store(WATCHDOG_OK);
+                } else if (state == WATCHDOG_STALLED && now - escalatedAt > FAILOVER_GRACE_NS) {
+                    if (g_haveBackup) {
+                        std::cerr << "⚠ Reopen did not restore the callback, failing over to backup device\n";
+                        postAction(WATCHDOG_FAILOVER);
+                    } else {
+                        std::cerr << "⚠ Reopen did not restore the callback and no backup device is configured\n";
+                    }
+                    g_watchdogState.store(WATCHDOG_FAILED_OVER);
+                    escalatedAt = now;
+                }
+                break;
+        }
+    }
+}
+
+} // namespace
+
+uint32_t watchdogEventType() {
+    return g_eventType;
+}
+
+void startWatchdog(bool haveBackup) {
+    g_eventType = SDL_RegisterEvents(1);
+    g_haveBackup = haveBackup;
+    g_stop = false;
+    g_thread = std::thread(watchdogLoop);
+}
+
+void stopWatchdog() {
+    if (!g_thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_stop = true;
+    }
+    g_wake.notify_one();
+    g_thread.join();
+}
+
+void armWatchdog(double periodMs) {
+    g_periodNs.store(static_cast<int64_t>(periodMs * 1e6));
+    g_armedAtNs.store(hostTimeNs());
+    g_armed.store(true);
+}
+
+void disarmWatchdog() {
+    g_armed.store(false);
+}
+
+double watchdogDetectionBoundMs() {
+    int64_t periodNs = g_periodNs.load();
+    return (stallThresholdNs(periodNs) + pollIntervalNs(periodNs)) / 1e6;
+}
@@ -0,0 +1,49 @@
+/**
+ * Audio watchdog: detects a stalled audioCallback() and escalates.
+ *
+ * The watchdog only reads the engine heartbeat atomics, so the audio path
+ * takes no locks. Recovery actions are posted to the main thread as SDL
+ * user events because device open/close belongs to the event loop.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+enum WatchdogAction {
+    WATCHDOG_REOPEN = 1,    // Reopen the current device
+    WATCHDOG_FAILOVER = 2,  // Switch to the configured backup device
+};
+
+enum WatchdogState {
+    WATCHDOG_IDLE = 0,      // Device not running, nothing to watch
+    WATCHDOG_OK,
+    WATCHDOG_STALLED,       // Flagged, reopen requested
+    WATCHDOG_FAILED_OVER,   // Backup requested
+};
+
+extern std::atomic<int> g_watchdogState;
+
+/**
+ * SDL event type carrying WatchdogAction in event.user.code
+ */
+uint32_t watchdogEventType();
+
+/**
+ * Start the watchdog thread
+ */
+void startWatchdog(bool haveBackup);
+void stopWatchdog();
+
+/**
+ * Arm with the expected callback period once a device is running, and
+ * disarm whenever the device is closed on purpose.
+ */
+void armWatchdog(double periodMs);
+void disarmWatchdog();
+
+/**
+ * Worst-case stall detection latency for the armed period, in ms
+ */
+double watchdogDetectionBoundMs();
@@ -0,0 +1,352 @@
+#include "wav_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t RIFF_SIZE_UNKNOWN = 0xFFFFFFFFU;     // RF64: real size in ds64
+constexpr uint64_t RIFF_LIMIT = 0xFFFFFFFFULL;
+
+// Wave64 chunk ids: the FOURCC as the first four bytes of a fixed GUID
+const uint8_t W64_RIFF[16] = {'r', 'i', 'f', 'f', 0x2E, 0x91, 0xCF, 0x11, 0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00};
+const uint8_t W64_WAVE[16] = {'w', 'a', 'v', 'e', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A};
+const uint8_t W64_FMT[16] = {'f', 'm', 't', ' ', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A};
+const uint8_t W64_FACT[16] = {'f', 'a', 'c', 't', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A};
+const uint8_t W64_JUNK[16] = {'j', 'u', 'n', 'k', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A};
+const uint8_t W64_DATA[16] = {'d', 'a', 't', 'a', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A};
+
+constexpr size_t RIFF_BASE_HEADER = 58;     // RIFF, fmt (18), fact, data
+constexpr size_t RF64_BASE_HEADER = 94;     // ... plus ds64
+constexpr size_t W64_BASE_HEADER = 144;     // riff, wave, fmt (padded), fact, data
+constexpr size_t W64_CHUNK_HEADER = 24;
+
+void putLE(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+void putId(std::vector<uint8_t>& out, const char* fourcc) {
+    out.insert(out.end(), fourcc, fourcc + 4);
+}
+
+void putGuid(std::vector<uint8_t>& out, const uint8_t* guid) {
+    out.insert(out.end(), guid, guid + 16);
+}
+
+uint64_t getLE(const uint8_t* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; --i) value = (value << 8) | p[i];
+    return value;
+}
+
+// WAVEFORMATEX for IEEE float, no extension
+void putFormat(std::vector<uint8_t>& out, int channels, int sampleRate) {
+    putLE(out, 3, 2);
+    putLE(out, channels, 2);
+    putLE(out, sampleRate, 4);
+    putLE(out, static_cast<uint64_t>(sampleRate) * channels * sizeof(float), 4);
+    putLE(out, channels * sizeof(float), 2);
+    putLE(out, 32, 2);
+    putLE(out, 0, 2);
+}
+
+bool parseFormat(const uint8_t* p, size_t size, WavInfo& info) {
+    if (size < 16) return false;
+    int tag = static_cast<int>(getLE(p, 2));
+    info.channels = static_cast<int>(getLE(p + 2, 2));
+    info.sampleRate = static_cast<int>(getLE(p + 4, 4));
+    info.bitsPerSample = static_cast<int>(getLE(p + 14, 2));
+    if (tag == 0xFFFE && size >= 26) tag = static_cast<int>(getLE(p + 24, 2));  // Extensible: subformat
+    info.isFloat = tag == 3;
+    return (tag == 1 || tag == 3) && info.channels > 0 && info.sampleRate > 0 && info.bitsPerSample % 8 == 0;
+}
+
+} // namespace
+
+bool parseWavContainer(const std::string& name, WavContainer& container) {
+    std::string ext = name.substr(name.find_last_of('.') + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (ext == "wav") {
+        container = WAV_RIFF;
+    } else if (ext == "rf64") {
+        container = WAV_RF64;
+    } else if (ext == "w64") {
+        container = WAV_W64;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* wavContainerName(WavContainer container) {
+    switch (container) {
+    case WAV_RIFF: return "WAV";
+    case WAV_RF64: return "RF64";
+    case WAV_W64: return "Wave64";
+    }
+    return "?";
+}
+
+std::vector<uint8_t> wavHeader(WavContainer container, int64_t frames, int channels, int sampleRate, int align) {
+    uint64_t dataBytes = static_cast<uint64_t>(frames) * channels * sizeof(float);
+    std::vector<uint8_t> h;
+
+    if (container == WAV_W64) {
+        size_t junk = align > 0 ? align - W64_BASE_HEADER : 0;
+        if (align > 0 && (static_cast<size_t>(align) < W64_BASE_HEADER + W64_CHUNK_HEADER || junk % 8 != 0)) return h;
+        uint64_t padded = (dataBytes + 7) & ~7ULL;
+        putGuid(h, W64_RIFF);
+        putLE(h, W64_BASE_HEADER + junk + padded, 8);
+        putGuid(h, W64_WAVE);
+        putGuid(h, W64_FMT);
+        putLE(h, W64_CHUNK_HEADER + 18, 8);
+        putFormat(h, channels, sampleRate);
+        h.insert(h.end(), 6, 0);            // Chunks start on 8 bytes
+        putGuid(h, W64_FACT);
+        putLE(h, W64_CHUNK_HEADER + 8, 8);
+        putLE(h, static_cast<uint64_t>(frames), 8);
+        if (junk > 0) {
+            putGuid(h, W64_JUNK);
+            putLE(h, junk, 8);
+            h.insert(h.end(), junk - W64_CHUNK_HEADER, 0);
+        }
+        putGuid(h, W64_DATA);
+        putLE(h, W64_CHUNK_HEADER + dataBytes, 8);
+        return h;
+    }
+
+    size_t base = container == WAV_RF64 ? RF64_BASE_HEADER : RIFF_BASE_HEADER;
+    size_t junk = align > 0 ? align - base : 0;
+    if (align > 0 && static_cast<size_t>(align) < base + 8) return h;
+    uint64_t riffSize = base - 8 + junk + dataBytes;
+    if (container == WAV_RIFF && riffSize > RIFF_LIMIT) return h;
+
+    bool rf64 = container == WAV_RF64;
+    putId(h, rf64 ? "RF64" : "RIFF");
+    putLE(h, rf64 ? RIFF_SIZE_UNKNOWN : riffSize, 4);
+    putId(h, "WAVE");
+    if (rf64) {
+        putId(h, "ds64");
+        putLE(h, 28, 4);
+        putLE(h, riffSize, 8);
+        putLE(h, dataBytes, 8);
+        putLE(h, static_cast<uint64_t>(frames), 8);
+        putLE(h, 0, 4);                     // No table
+    }
+    putId(h, "fmt ");
+    putLE(h, 18, 4);
+    putFormat(h, channels, sampleRate);
+    putId(h, "fact");                       // Required for non-PCM data
+    putLE(h, 4, 4);
+    putLE(h, rf64 ? RIFF_SIZE_UNKNOWN : static_cast<uint64_t>(frames), 4);
+    if (junk > 0) {
+        putId(h, "JUNK");
+        putLE(h, junk - 8, 4);
+        h.insert(h.end(), junk - 8, 0);
+    }
+    putId(h, "data");
+    putLE(h, rf64 ? RIFF_SIZE_UNKNOWN : dataBytes, 4);
+    return h;
+}
+
+bool readWavInfo(const std::string& path, WavInfo& info) {
+    std::ifstream in(path, std::ios::binary);
+    struct stat st;
+    if (!in || stat(path.c_str(), &st) != 0) return false;
+    int64_t fileSize = st.st_size;
+
+    uint8_t head[16];
+    if (!in.read(reinterpret_cast<char*>(head), 16)) return false;
+
+    bool haveFormat = false;
+    uint64_t dataBytes = 0;
+    std::vector<uint8_t> body;
+    if (std::memcmp(head, W64_RIFF, 16) == 0) {
+        info.container = WAV_W64;
+        int64_t pos = 40;                   // riff GUID, size, wave GUID
+        uint8_t chunk[W64_CHUNK_HEADER];
+        while (pos + static_cast<int64_t>(W64_CHUNK_HEADER) <= fileSize) {
+            in.seekg(pos);
+            if (!in.read(reinterpret_cast<char*>(chunk), W64_CHUNK_HEADER)) return false;
+            uint64_t size = getLE(chunk + 16, 8);
+            if (size < W64_CHUNK_HEADER) return false;
+            if (std::memcmp(chunk, W64_FMT, 16) == 0) {
+                body.resize(std::min<uint64_t>(size - W64_CHUNK_HEADER, 64));
+                if (!in.read(reinterpret_cast<char*>(body.data()), body.size()) ||
+                    !parseFormat(body.data(), body.size(), info)) return false;
+                haveFormat = true;
+            } else if (std::memcmp(chunk, W64_DATA, 16) == 0) {
+                info.dataOffset = pos + W64_CHUNK_HEADER;
+                dataBytes = size - W64_CHUNK_HEADER;
+                break;
+            }
+            pos += static_cast<int64_t>((size + 7) & ~7ULL);
+        }
+    } else {
+        bool rf64 = std::memcmp(head, "RF64", 4) == 0;
+        if ((!rf64 && std::memcmp(head, "RIFF", 4) != 0) || std::memcmp(head + 8, "WAVE", 4) != 0) return false;
+        info.container = rf64 ? WAV_RF64 : WAV_RIFF;
+        uint64_t ds64Data = 0;
+        int64_t pos = 12;
+        uint8_t chunk[8];
+        while (pos + 8 <= fileSize) {
+            in.seekg(pos);
+            if (!in.read(reinterpret_cast<char*>(chunk), 8)) return false;
+            uint64_t size = getLE(chunk + 4, 4);
+            if (std::memcmp(chunk, "ds64", 4) == 0 || std::memcmp(chunk, "fmt ", 4) == 0) {
+                body.resize(std::min<uint64_t>(size, 64));
+                if (!in.read(reinterpret_cast<char*>(body.data()), body.size())) return false;
+                if (chunk[0] == 'd') {
+                    if (body.size() < 24) return false;
+                    ds64Data = getLE(body.data() + 8, 8);
+                } else {
+                    if (!parseFormat(body.data(), body.size(), info)) return false;
+                    haveFormat = true;
+                }
+            } else if (std::memcmp(chunk, "data", 4) == 0) {
+                info.dataOffset = pos + 8;
+                dataBytes = rf64 && size == RIFF_SIZE_UNKNOWN ? ds64Data : size;
+                break;
+            }
+            pos += 8 + static_cast<int64_t>(size + (size & 1));
+        }
+    }
+
+    if (!haveFormat || info.dataOffset == 0) return false;
+    int64_t frameBytes = static_cast<int64_t>(info.channels) * info.bitsPerSample / 8;
+    int64_t available = std::max<int64_t>(0, fileSize - info.dataOffset);
+    info.frames = static_cast<int64_t>(std::min<uint64_t>(dataBytes, static_cast<uint64_t>(available))) / frameBytes;
+    return true;
+}
+
+bool decodeWavSamples(const uint8_t* raw, const WavInfo& info, float* out, size_t count) {
+    if (info.isFloat && info.bitsPerSample == 32) {
+        std::memcpy(out, raw, count * 4);
+    } else if (info.isFloat && info.bitsPerSample == 64) {
+        for (size_t i = 0; i < count; ++i, raw += 8) {
+            double v;
+            std::memcpy(&v, raw, 8);
+            out[i] = static_cast<float>(v);
+        }
+    } else if (!info.isFloat && info.bitsPerSample == 16) {
+        for (size_t i = 0; i < count; ++i, raw += 2) {
+            int16_t v;
+            std::memcpy(&v, raw, 2);
+            out[i] = v * (1.0f / 32768.0f);
+        }
+    } else if (!info.isFloat && info.bitsPerSample == 24) {
+        for (size_t i = 0; i < count; ++i, raw += 3) {
+            int32_t v = static_cast<int32_t>(static_cast<uint32_t>(raw[0]) << 8 | static_cast<uint32_t>(raw[1]) << 16 |
+                                             static_cast<uint32_t>(raw[2]) << 24) >> 8;
+            out[i] = v * (1.0f / 8388608.0f);
+        }
+    } else if (!info.isFloat && info.bitsPerSample == 32) {
+        for (size_t i = 0; i < count; ++i, raw += 4) {
+            int32_t v;
+            std::memcpy(&v, raw, 4);
+            out[i] = static_cast<float>(v * (1.0 / 2147483648.0));
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool writeAt(int fd, const void* data, size_t bytes, int64_t offset) {
+    const char* p = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t n = pwrite(fd, p, bytes, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        bytes -= static_cast<size_t>(n);
+        offset += n;
+    }
+    return true;
+}
+
+bool WavStreamWriter::open(const std::string& path, WavContainer container, int channels, int sampleRate,
+                           const AsyncWriterConfig& io) {
+    close();
+    container_ = container;
+    channels_ = channels;
+    sampleRate_ = sampleRate;
+    fill_ = 0;
+    blockOffset_ = WAV_DATA_ALIGN;
+    frames_ = 0;
+    flushedBytes_ = 0;
+
+    AsyncWriterConfig config = io;
+    config.bufferBytes = WAV_WRITE_BLOCK;
+    if (!io_.open(path, config, 1)) return false;
+    if (!patchHeader()) {
+        std::cerr << "Cannot write " << path << ": " << std::strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    buffer_ = io_.acquire(slot_);
+    return true;
+}
+
+bool WavStreamWriter::write(const float* samples, int64_t frames) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(samples);
+    size_t bytes = static_cast<size_t>(frames) * channels_ * sizeof(float);
+    if (container_ == WAV_RIFF &&
+        static_cast<uint64_t>(frames_ + frames) * channels_ * sizeof(float) + WAV_DATA_ALIGN - 8 > RIFF_LIMIT) {
+        return false;
+    }
+
+    while (bytes > 0) {
+        size_t n = std::min(bytes, WAV_WRITE_BLOCK - fill_);
+        std::memcpy(buffer_ + fill_, p, n);
+        fill_ += n;
+        p += n;
+        bytes -= n;
+        if (fill_ == WAV_WRITE_BLOCK) {
+            // Queued; the header catches up at the next flush
+            if (!io_.submit(slot_, WAV_WRITE_BLOCK, blockOffset_)) return false;
+            buffer_ = io_.acquire(slot_);
+            blockOffset_ += WAV_WRITE_BLOCK;
+            fill_ = 0;
+        }
+    }
+    frames_ += frames;
+    return true;
+}
+
+bool WavStreamWriter::flush() {
+    // A partial block stays in the buffer and is written again, from the
+    // same aligned offset, once it fills
+    if (fill_ > 0 && !io_.submit(slot_, fill_, blockOffset_, false)) return false;
+    if (!io_.drain()) return false;
+    int64_t bytes = blockOffset_ - WAV_DATA_ALIGN + static_cast<int64_t>(fill_);
+    if (bytes == flushedBytes_) return true;
+    flushedBytes_ = bytes;
+    return patchHeader();
+}
+
+bool WavStreamWriter::patchHeader() {
+    int64_t frames = flushedBytes_ / (channels_ * static_cast<int64_t>(sizeof(float)));
+    std::vector<uint8_t> header = wavHeader(container_, frames, channels_, sampleRate_, WAV_DATA_ALIGN);
+    return !header.empty() && io_.writeSync(header.data(), header.size(), 0);
+}
+
+bool WavStreamWriter::close() {
+    if (!io_.isOpen()) return true;
+    bool ok = buffer_ == nullptr || flush();
+    if (buffer_ != nullptr) io_.release(slot_);
+    buffer_ = nullptr;
+    // Drop a torn trailing frame; Wave64 data is padded to 8 bytes
+    int64_t bytes = frames_ * channels_ * static_cast<int64_t>(sizeof(float));
+    if (container_ == WAV_W64) bytes = (bytes + 7) & ~7LL;
+    return io_.close(ok ? WAV_DATA_ALIGN + bytes : -1) && ok;
+}
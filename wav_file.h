@@ -0,0 +1,114 @@
+/**
+ * Float32 WAV-family files: headers for plain RIFF, RF64 and Wave64, a
+ * header reader, and a streaming writer for long recordings.
+ *
+ * Plain RIFF stops at 4 GB. RF64 (EBU Tech 3306) keeps the RIFF layout
+ * but sets the 32-bit sizes to 0xFFFFFFFF and carries the real ones in a
+ * ds64 chunk; Wave64 (Sony) uses GUID chunk ids and 64-bit sizes
+ * throughout. All integers are little-endian.
+ *
+ * The streaming writer collects samples in page-aligned buffers and
+ * hands whole buffers to an AsyncWriter at page-aligned file offsets (the
+ * header is padded to WAV_DATA_ALIGN with a junk chunk), so the caller
+ * keeps filling the next buffer while the last one is written. Every
+ * flush waits for the samples to reach the file and then rewrites the
+ * header with the sizes of what is there, so a file left behind by a
+ * crashed process is complete and readable up to the last flush.
+ */
+
+#pragma once
+
+#include "async_writer.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum WavContainer {
+    WAV_RIFF = 0,
+    WAV_RF64 = 1,
+    WAV_W64 = 2,
+};
+
+constexpr int WAV_DATA_ALIGN = 4096;            // Streaming writer: data starts on a page
+constexpr size_t WAV_WRITE_BLOCK = 4 << 20;     // Streaming writer buffer (bytes)
+
+bool parseWavContainer(const std::string& name, WavContainer& container);
+const char* wavContainerName(WavContainer container);
+
+/**
+ * Header for `frames` interleaved float32 frames. With `align` > 0 a junk
+ * chunk pads the header so the samples start at file offset `align`.
+ * Returns an empty vector if the data does not fit the container.
+ */
+std::vector<uint8_t> wavHeader(WavContainer container, int64_t frames, int channels, int sampleRate, int align = 0);
+
+struct WavInfo {
+    WavContainer container = WAV_RIFF;
+    int channels = 0;
+    int sampleRate = 0;
+    int bitsPerSample = 0;
+    bool isFloat = false;
+    int64_t frames = 0;
+    int64_t dataOffset = 0;
+};
+
+/**
+ * Parse the header of a RIFF, RF64 or Wave64 file. The frame count is
+ * clamped to what the file actually holds.
+ */
+bool readWavInfo(const std::string& path, WavInfo& info);
+
+/**
+ * Convert `count` samples of the file's format (16/24/32-bit PCM, 32/64-bit
+ * float) from `raw` to float. Returns false for other formats.
+ */
+bool decodeWavSamples(const uint8_t* raw, const WavInfo& info, float* out, size_t count);
+
+/**
+ * pwrite() all of `data` at `offset`, retrying short writes
+ */
+bool writeAt(int fd, const void* data, size_t bytes, int64_t offset);
+
+class WavStreamWriter {
+public:
+    WavStreamWriter() = default;
+    WavStreamWriter(const WavStreamWriter&) = delete;
+    WavStreamWriter& operator=(const WavStreamWriter&) = delete;
+    ~WavStreamWriter() { close(); }
+
+    bool open(const std::string& path, WavContainer container, int channels, int sampleRate,
+              const AsyncWriterConfig& io = AsyncWriterConfig());
+
+    /**
+     * Append interleaved frames. Fails once a plain RIFF file would pass
+     * 4 GB.
+     */
+    bool write(const float* samples, int64_t frames);
+
+    /**
+     * Put everything written so far on disk and update the header
+     */
+    bool flush();
+
+    bool close();
+
+    bool isOpen() const { return io_.isOpen(); }
+    int64_t frames() const { return frames_; }
+    int64_t bytesFlushed() const { return flushedBytes_; }
+    const char* backendName() const { return io_.backendName(); }
+
+private:
+    bool patchHeader();
+
+    AsyncWriter io_;
+    WavContainer container_ = WAV_RF64;
+    int channels_ = 1;
+    int sampleRate_ = 0;
+    int slot_ = -1;                 // io_ buffer being filled
+    uint8_t* buffer_ = nullptr;     // WAV_WRITE_BLOCK bytes, page-aligned
+    size_t fill_ = 0;               // Bytes in the buffer
+    int64_t blockOffset_ = 0;       // File offset of the buffer's first byte
+    int64_t frames_ = 0;            // Frames accepted
+    int64_t flushedBytes_ = 0;      // Sample bytes on disk and in the header
+};